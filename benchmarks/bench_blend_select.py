@@ -0,0 +1,64 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+CacheBlend check layer token selection: c_ops.select_deviated_tokens vs the
+torch ops of LMCBlender.process_qkv (float32 upcasts, topk, sort, gathers).
+
+    python benchmarks/bench_blend_select.py --tokens 8192 32768 --dtype bfloat16
+"""
+# Standard
+import argparse
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _torch_select(q, k, v, residual, old_k, topk):
+    diff_k = torch.sum((k.to(torch.float32) - old_k.to(torch.float32)) ** 2, dim=[1])
+    indices = torch.sort(torch.topk(diff_k, k=topk).indices).values
+    return indices, q[indices], k[indices], v[indices], residual[indices]
+
+
+def _time(fn, repeat):
+    fn()
+    start = time.perf_counter()
+    for _ in range(repeat):
+        fn()
+    return (time.perf_counter() - start) / repeat
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--tokens", type=int, nargs="+", default=[8192, 32768])
+    parser.add_argument("--num-heads", type=int, default=32)
+    parser.add_argument("--num-kv-heads", type=int, default=8)
+    parser.add_argument("--head-size", type=int, default=128)
+    parser.add_argument("--ratio", type=float, default=0.15)
+    parser.add_argument("--dtype", default="bfloat16")
+    parser.add_argument("--repeat", type=int, default=10)
+    args = parser.parse_args()
+
+    dtype = getattr(torch, args.dtype)
+    q_size = args.num_heads * args.head_size
+    kv_size = args.num_kv_heads * args.head_size
+    print(f"{'tokens':>8} {'torch ms':>10} {'fused ms':>10}")
+    for num_tokens in args.tokens:
+        qkv = torch.randn(num_tokens, q_size + 2 * kv_size, dtype=dtype)
+        q, k, v = qkv.split([q_size, kv_size, kv_size], dim=-1)
+        residual = torch.randn(num_tokens, q_size, dtype=dtype)
+        old_k = k + 0.1 * torch.randn(num_tokens, kv_size, dtype=dtype)
+        topk = int(num_tokens * args.ratio)
+        selection = (q, k, v, residual, old_k, topk)
+
+        t_torch = _time(lambda s=selection: _torch_select(*s), args.repeat)
+        t_fused = _time(
+            lambda s=selection: lmc_ops.select_deviated_tokens(*s), args.repeat
+        )
+        print(f"{num_tokens:>8} {t_torch * 1e3:>10.2f} {t_fused * 1e3:>10.2f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host CacheGen codec throughput per core count.
+
+    python benchmarks/bench_cachegen.py --threads 1 2 4 8 16 32
+
+Throughput is reported against the size of the symbol tensor
+([nlayers, ntokens, nchannels] int8), i.e. the quantised KV chunk.
+"""
+# Standard
+import argparse
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _timeit(fn, iters):
+    fn()
+    start = time.perf_counter()
+    for _ in range(iters):
+        fn()
+    return (time.perf_counter() - start) / iters
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--nlayers", type=int, default=64)
+    parser.add_argument("--ntokens", type=int, default=256)
+    parser.add_argument("--nchannels", type=int, default=1024)
+    parser.add_argument("--max-bins", type=int, default=32)
+    parser.add_argument("--iters", type=int, default=5)
+    parser.add_argument("--threads", type=int, nargs="+", default=[1, 2, 4, 8])
+    args = parser.parse_args()
+
+    shape = (args.nlayers, args.ntokens, args.nchannels)
+    sym = torch.randn(shape) * (args.max_bins / 8) + args.max_bins // 2
+    sym = sym.round().clamp_(0, args.max_bins - 1).to(torch.int8).pin_memory()
+    nbytes = sym.numel()
+
+    output_buffer = torch.empty(
+        (args.nlayers, args.nchannels, args.ntokens + 8), dtype=torch.uint8
+    ).pin_memory()
+    output_lengths = torch.empty((args.nlayers, args.nchannels), dtype=torch.int32)
+    output = torch.empty_like(sym)
+
+    print(f"symbols {shape}, {nbytes / 1e6:.1f} MB")
+    print(
+        f"{'threads':>8} {'cdf GB/s':>10} {'enc GB/s':>10} {'dec GB/s':>10} "
+        f"{'prefsum':>10}"
+    )
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        cdf = lmc_ops.calculate_cdf(sym, args.max_bins)
+        t_cdf = _timeit(lambda: lmc_ops.calculate_cdf(sym, args.max_bins), args.iters)
+        t_enc = _timeit(
+            lambda: lmc_ops.encode_fast_new(cdf, sym, output_buffer, output_lengths),
+            args.iters,
+        )
+        streams = output_buffer.flatten(0, 1)
+        lengths = output_lengths.flatten().tolist()
+        bytestreams = torch.cat([streams[i, :n] for i, n in enumerate(lengths)])
+        t_dec = _timeit(
+            lambda: lmc_ops.decode_fast_new(cdf, bytestreams, output_lengths, output),
+            args.iters,
+        )
+        assert (output == sym).all()
+        prefsum = output_lengths.flatten().cumsum(0).to(torch.int32)
+        t_pre = _timeit(
+            lambda: lmc_ops.decode_fast_prefsum(cdf, bytestreams, prefsum, output),
+            args.iters,
+        )
+        assert (output == sym).all()
+        print(
+            f"{threads:>8} {nbytes / t_cdf / 1e9:>10.2f} "
+            f"{nbytes / t_enc / 1e9:>10.2f} {nbytes / t_dec / 1e9:>10.2f} "
+            f"{nbytes / t_pre / 1e9:>10.2f}"
+        )
+    print(f"compression ratio {nbytes / bytestreams.numel():.2f}x")
+
+
+if __name__ == "__main__":
+    main()
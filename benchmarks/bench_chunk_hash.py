@@ -0,0 +1,66 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Chunk key computation: c_ops.chunk_hashes vs chained per-chunk hashing in
+Python, the way the token database computes keys.
+
+    python benchmarks/bench_chunk_hash.py --tokens 8192 131072 --chunk-size 256
+"""
+# Standard
+import argparse
+import hashlib
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _python_hash(tokens, chunk_size):
+    prefix_hash = None
+    keys = []
+    for start in range(0, tokens.numel(), chunk_size):
+        chunk = tokens[start : start + chunk_size]
+        prefix_hash = hash((prefix_hash, tuple(chunk.tolist())))
+        keys.append(prefix_hash)
+    return keys
+
+
+def _python_sha256(tokens, chunk_size):
+    prefix_hash = b""
+    keys = []
+    for start in range(0, tokens.numel(), chunk_size):
+        chunk = tokens[start : start + chunk_size]
+        prefix_hash = hashlib.sha256(prefix_hash + chunk.numpy().tobytes()).digest()
+        keys.append(prefix_hash)
+    return keys
+
+
+def _time(fn, repeat):
+    fn()
+    start = time.perf_counter()
+    for _ in range(repeat):
+        fn()
+    return (time.perf_counter() - start) / repeat
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--tokens", type=int, nargs="+", default=[8192, 131072])
+    parser.add_argument("--chunk-size", type=int, default=256)
+    parser.add_argument("--repeat", type=int, default=20)
+    args = parser.parse_args()
+
+    print(f"{'tokens':>8} {'python hash':>12} {'sha256':>12} {'native':>12} (ms)")
+    for num_tokens in args.tokens:
+        tokens = torch.randint(0, 150000, [num_tokens], dtype=torch.int64)
+        times = [
+            _time(lambda fn=fn: fn(tokens, args.chunk_size), args.repeat) * 1e3
+            for fn in (_python_hash, _python_sha256, lmc_ops.chunk_hashes)
+        ]
+        print(f"{num_tokens:>8} " + " ".join(f"{t:>12.3f}" for t in times))
+
+
+if __name__ == "__main__":
+    main()
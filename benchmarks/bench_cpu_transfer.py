@@ -0,0 +1,108 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Host backend of the KV transfer ops: GB/s per op and thread count.
+
+    python benchmarks/bench_cpu_transfer.py --threads 1 8 32
+
+Useful to compare layout choices (layer-major vs token-major, chunk sizes)
+without hardware. Slot patterns:
+  random      one token per extent, the per token path
+  blocks      whole blocks scattered over the cache, as vLLM allocates them
+  contiguous  a single run of slots
+"""
+# Standard
+import argparse
+import random
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _timeit(fn, iters):
+    fn()
+    start = time.perf_counter()
+    for _ in range(iters):
+        fn()
+    return (time.perf_counter() - start) / iters
+
+
+def _slots(pattern, num_tokens, num_blocks, block_size):
+    page_buffer_size = num_blocks * block_size
+    if pattern == "random":
+        return torch.tensor(random.sample(range(page_buffer_size), num_tokens))
+    if pattern == "contiguous":
+        start = random.randrange(0, page_buffer_size - num_tokens)
+        return torch.arange(start, start + num_tokens)
+    num_used = (num_tokens + block_size - 1) // block_size
+    blocks = torch.tensor(random.sample(range(num_blocks), num_used))
+    slots = blocks[:, None] * block_size + torch.arange(block_size)
+    return slots.flatten()[:num_tokens].contiguous()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--num-layers", type=int, default=32)
+    parser.add_argument("--num-blocks", type=int, default=2000)
+    parser.add_argument("--block-size", type=int, default=16)
+    parser.add_argument("--hidden", type=int, default=1024)
+    parser.add_argument("--num-tokens", type=int, default=256)
+    parser.add_argument("--iters", type=int, default=20)
+    parser.add_argument(
+        "--patterns",
+        nargs="+",
+        default=["random", "blocks", "contiguous"],
+        choices=["random", "blocks", "contiguous"],
+    )
+    parser.add_argument("--threads", type=int, nargs="+", default=[1, 4, 16])
+    args = parser.parse_args()
+
+    dtype = torch.bfloat16
+    page_buffer_size = args.num_blocks * args.block_size
+    kv_caches = [
+        torch.rand([2, page_buffer_size, args.hidden], dtype=dtype)
+        for _ in range(args.num_layers)
+    ]
+    ptrs = torch.tensor([t.data_ptr() for t in kv_caches])
+
+    multi = torch.empty([2, args.num_layers, args.num_tokens, args.hidden], dtype=dtype)
+    token_major = torch.empty([args.num_tokens, 2, args.hidden], dtype=dtype)
+    nbytes = multi.numel() * multi.element_size()
+    cpu = torch.device("cpu")
+
+    def run_multi(slots, direction):
+        lmc_ops.multi_layer_kv_transfer(
+            multi, ptrs, slots, cpu, page_buffer_size, direction, False
+        )
+
+    def run_single(slots, direction):
+        for layer in kv_caches:
+            lmc_ops.single_layer_kv_transfer(
+                token_major, layer[0], layer[1], slots, direction, True
+            )
+
+    print(f"{args.num_layers} layers x {args.num_tokens} tokens, {nbytes / 1e6:.1f} MB")
+    print(
+        f"{'pattern':>10} {'extents':>8} {'threads':>8} "
+        f"{'multi d2l':>10} {'multi l2d':>10} {'layer d2l':>10}"
+    )
+    for pattern in args.patterns:
+        slots = _slots(pattern, args.num_tokens, args.num_blocks, args.block_size)
+        num_extents = lmc_ops.slot_mapping_extents(slots).shape[0]
+        for threads in args.threads:
+            torch.set_num_threads(threads)
+            t_gather = _timeit(lambda: run_multi(slots, True), args.iters)
+            t_scatter = _timeit(lambda: run_multi(slots, False), args.iters)
+            t_layer = _timeit(lambda: run_single(slots, True), args.iters)
+            print(
+                f"{pattern:>10} {num_extents:>8} {threads:>8} "
+                f"{nbytes / t_gather / 1e9:>10.2f} "
+                f"{nbytes / t_scatter / 1e9:>10.2f} {nbytes / t_layer / 1e9:>10.2f}"
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Disk tier throughput: c_ops.DiskEngine (io_uring, O_DIRECT, fixed buffers)
+vs buffered Python file I/O with one file per chunk, the way the local
+disk backend stores chunks.
+
+    python benchmarks/bench_disk_engine.py --dir /mnt/nvme --queue-depth 8 32
+
+Buffered reads of data written moments ago are served from the page cache.
+For the cold read numbers of the baseline use a total size above the free
+memory or drop the caches between phases (echo 3 > /proc/sys/vm/drop_caches).
+"""
+# Standard
+import argparse
+import os
+import tempfile
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+ALIGNMENT = 4096
+
+
+def _aligned_buffer(nbytes):
+    raw = torch.empty(nbytes + ALIGNMENT, dtype=torch.uint8)
+    offset = -raw.data_ptr() % ALIGNMENT
+    return raw[offset : offset + nbytes]
+
+
+def _buffered(directory, chunks):
+    paths = [os.path.join(directory, f"chunk_{i}.bin") for i in range(len(chunks))]
+    start = time.perf_counter()
+    for path, chunk in zip(paths, chunks, strict=False):
+        with open(path, "wb") as f:
+            f.write(chunk.numpy().data)
+    t_write = time.perf_counter() - start
+    start = time.perf_counter()
+    for path, chunk in zip(paths, chunks, strict=False):
+        with open(path, "rb") as f:
+            f.readinto(chunk.numpy().data)
+    t_read = time.perf_counter() - start
+    for path in paths:
+        os.remove(path)
+    return t_write, t_read
+
+
+def _engine(directory, pool, chunks, queue_depth):
+    path = os.path.join(directory, "chunks.bin")
+    chunk_bytes = chunks[0].numel()
+    engine = lmc_ops.DiskEngine(path, [pool], queue_depth, True, pool.numel())
+    start = time.perf_counter()
+    for i, chunk in enumerate(chunks):
+        engine.submit_write(chunk, i * chunk_bytes)
+    while engine.inflight() > 0:
+        engine.poll(1)
+    t_write = time.perf_counter() - start
+    start = time.perf_counter()
+    for i, chunk in enumerate(chunks):
+        engine.submit_read(chunk, i * chunk_bytes)
+    while engine.inflight() > 0:
+        engine.poll(1)
+    t_read = time.perf_counter() - start
+    direct = engine.direct()
+    engine.close()
+    os.remove(path)
+    return t_write, t_read, direct
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--dir", default=None, help="directory on the disk to test")
+    parser.add_argument("--chunk-mb", type=int, default=8)
+    parser.add_argument("--num-chunks", type=int, default=128)
+    parser.add_argument("--queue-depth", type=int, nargs="+", default=[1, 8, 32])
+    args = parser.parse_args()
+
+    chunk_bytes = args.chunk_mb << 20
+    total = chunk_bytes * args.num_chunks
+    pool = _aligned_buffer(total)
+    pool.copy_(torch.randint(0, 256, [total], dtype=torch.uint8))
+    chunks = [
+        pool[offset : offset + chunk_bytes] for offset in range(0, total, chunk_bytes)
+    ]
+
+    with tempfile.TemporaryDirectory(dir=args.dir) as directory:
+        print(f"{args.num_chunks} x {args.chunk_mb} MB chunks in {directory}")
+        print(f"{'engine':>16} {'qd':>4} {'write GB/s':>10} {'read GB/s':>10}")
+        t_write, t_read = _buffered(directory, chunks)
+        print(
+            f"{'buffered python':>16} {'-':>4} "
+            f"{total / t_write / 1e9:>10.2f} {total / t_read / 1e9:>10.2f}"
+        )
+        for queue_depth in args.queue_depth:
+            t_write, t_read, direct = _engine(directory, pool, chunks, queue_depth)
+            name = "io_uring direct" if direct else "io_uring"
+            print(
+                f"{name:>16} {queue_depth:>4} "
+                f"{total / t_write / 1e9:>10.2f} {total / t_read / 1e9:>10.2f}"
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Trace replay of the host KV pool: chunk hit ratio and throughput of
+c_ops.EvictionEngine (S3-FIFO) vs LRU and FIFO on an OrderedDict.
+
+Each request of the trace is a list of chunk keys. It is looked up chunk by
+chunk up to the first miss, then its missing chunks are inserted. The
+synthetic trace mixes requests on a few shared system prompts (Zipf
+popularity) followed by chunks of their own with bursts of one-shot scans:
+
+    python benchmarks/bench_eviction.py --capacity-chunks 2000 8000
+
+or replays a trace file, one request per line as whitespace separated
+integer chunk keys (e.g. logged chunk hashes):
+
+    python benchmarks/bench_eviction.py --trace requests.txt
+"""
+# Standard
+from collections import OrderedDict
+import argparse
+import random
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _synthetic_trace(args):
+    rng = random.Random(0)
+    weights = [1 / (rank + 1) ** args.zipf for rank in range(args.num_prompts)]
+    next_key = args.num_prompts * args.shared_chunks
+    trace = []
+    for request in range(args.requests):
+        if request % args.scan_every < args.scan_length:
+            # One-shot prompt sharing nothing
+            keys = list(range(next_key, next_key + args.scan_chunks))
+            next_key += args.scan_chunks
+        else:
+            prompt = rng.choices(range(args.num_prompts), weights)[0]
+            first = prompt * args.shared_chunks
+            own = rng.randint(1, args.own_chunks)
+            keys = list(range(first, first + args.shared_chunks))
+            keys += list(range(next_key, next_key + own))
+            next_key += own
+        trace.append(keys)
+    return trace
+
+
+def _load_trace(path):
+    with open(path) as f:
+        return [[int(key) for key in line.split()] for line in f if line.strip()]
+
+
+class _OrderedDictPolicy:
+    def __init__(self, capacity, lru):
+        self.capacity = capacity
+        self.lru = lru
+        self.chunks = OrderedDict()
+
+    def lookup(self, keys):
+        matched = 0
+        for key in keys:
+            if key not in self.chunks:
+                break
+            if self.lru:
+                self.chunks.move_to_end(key)
+            matched += 1
+        return matched
+
+    def insert(self, keys):
+        for key in keys:
+            self.chunks[key] = None
+            while len(self.chunks) > self.capacity:
+                self.chunks.popitem(last=False)
+
+
+class _S3FifoPolicy:
+    def __init__(self, capacity, small_ratio):
+        self.engine = lmc_ops.EvictionEngine(capacity, small_ratio)
+
+    def lookup(self, keys):
+        return self.engine.touch_prefix(torch.tensor(keys, dtype=torch.int64))
+
+    def insert(self, keys):
+        for key in keys:
+            self.engine.insert(key, 1)
+
+
+def _replay(policy, trace):
+    hits = 0
+    total = 0
+    start = time.perf_counter()
+    for keys in trace:
+        matched = policy.lookup(keys)
+        policy.insert(keys[matched:])
+        hits += matched
+        total += len(keys)
+    elapsed = time.perf_counter() - start
+    return hits / max(total, 1), total / elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--trace", default=None)
+    parser.add_argument("--capacity-chunks", type=int, nargs="+", default=[2000, 8000])
+    parser.add_argument("--small-ratio", type=float, default=0.1)
+    parser.add_argument("--requests", type=int, default=20000)
+    parser.add_argument("--num-prompts", type=int, default=200)
+    parser.add_argument("--shared-chunks", type=int, default=16)
+    parser.add_argument("--own-chunks", type=int, default=8)
+    parser.add_argument("--zipf", type=float, default=1.0)
+    parser.add_argument("--scan-every", type=int, default=1000)
+    parser.add_argument("--scan-length", type=int, default=200)
+    parser.add_argument("--scan-chunks", type=int, default=64)
+    args = parser.parse_args()
+
+    trace = _load_trace(args.trace) if args.trace else _synthetic_trace(args)
+    num_chunks = sum(len(keys) for keys in trace)
+    num_keys = len({key for keys in trace for key in keys})
+    print(f"{len(trace)} requests, {num_chunks} chunk lookups, {num_keys} keys")
+
+    print(f"{'capacity':>9} {'policy':>8} {'hit ratio':>10} {'chunks/s':>10}")
+    for capacity in args.capacity_chunks:
+        policies = {
+            "FIFO": _OrderedDictPolicy(capacity, lru=False),
+            "LRU": _OrderedDictPolicy(capacity, lru=True),
+            "S3-FIFO": _S3FifoPolicy(capacity, args.small_ratio),
+        }
+        for name, policy in policies.items():
+            hit_ratio, rate = _replay(policy, trace)
+            print(f"{capacity:>9} {name:>8} {hit_ratio:>10.3f} {rate:>10.0f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,130 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Lossless KV codec (kv_codec.h): compression ratio and GB/s of
+c_ops.lossless_compress / lossless_decompress per codec, with and without
+the byte plane shuffle.
+
+    python benchmarks/bench_kv_codec.py --dump kv_layer0.pt kv_layer1.pt
+    python benchmarks/bench_kv_codec.py --threads 1 8 --levels 1 3
+
+A dump is anything torch.load returns holding KV tensors: a tensor, or a
+list / tuple / dict of them (e.g. the key and value caches of a model, or
+memory objects saved from the host pool). Dumps are cut in chunks of
+--chunk-mb. Without dumps a bf16 sample with a few outlier channels, like
+real K caches, is used; random values compress worse than real KV, so
+prefer dumps for numbers to compare with.
+
+GB/s counts raw bytes, the ratio is raw / compressed bytes.
+"""
+# Standard
+import argparse
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _tensors(obj):
+    if isinstance(obj, torch.Tensor):
+        return [obj]
+    if isinstance(obj, dict):
+        obj = list(obj.values())
+    if isinstance(obj, (list, tuple)):
+        return [tensor for item in obj for tensor in _tensors(item)]
+    return []
+
+
+def _chunks(args):
+    if args.dump:
+        tensors = []
+        for path in args.dump:
+            tensors += _tensors(torch.load(path, map_location="cpu"))
+    else:
+        sample = torch.randn([2, 32, 1024, 1024]) * 0.05
+        sample[:, :, :, :: args.hidden_stride] *= 20
+        tensors = [sample.to(getattr(torch, args.dtype))]
+    chunk_bytes = int(args.chunk_mb * 2**20)
+    chunks = []
+    for tensor in tensors:
+        flat = tensor.detach().contiguous().flatten()
+        step = max(1, chunk_bytes // flat.element_size())
+        chunks += [flat[start : start + step] for start in range(0, flat.numel(), step)]
+    return chunks
+
+
+def _timeit(fn, iters):
+    fn()
+    start = time.perf_counter()
+    for _ in range(iters):
+        fn()
+    return (time.perf_counter() - start) / iters
+
+
+def _measure(chunks, codec, level, shuffle, block_bytes, iters):
+    sources = [chunk if shuffle else chunk.view(torch.uint8) for chunk in chunks]
+    frames = [
+        torch.empty(
+            lmc_ops.lossless_max_compressed_size(src.nbytes, block_bytes),
+            dtype=torch.uint8,
+        )
+        for src in sources
+    ]
+    outputs = [torch.empty_like(src) for src in sources]
+    sizes = [0] * len(sources)
+
+    def compress():
+        for i, (src, frame) in enumerate(zip(sources, frames)):
+            sizes[i] = lmc_ops.lossless_compress(src, frame, codec, level, block_bytes)
+
+    def decompress():
+        for frame, size, out in zip(frames, sizes, outputs):
+            lmc_ops.lossless_decompress(frame[:size], out)
+
+    t_compress = _timeit(compress, iters)
+    t_decompress = _timeit(decompress, iters)
+    for src, out in zip(sources, outputs):
+        assert torch.equal(src.view(torch.uint8), out.view(torch.uint8))
+    raw = sum(src.nbytes for src in sources)
+    return raw / sum(sizes), raw / t_compress / 1e9, raw / t_decompress / 1e9
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--dump", nargs="+", default=None)
+    parser.add_argument("--dtype", default="bfloat16")
+    parser.add_argument("--hidden-stride", type=int, default=64)
+    parser.add_argument("--chunk-mb", type=float, default=32)
+    parser.add_argument("--block-kb", type=int, default=256)
+    parser.add_argument("--codecs", nargs="+", default=lmc_ops.lossless_codecs())
+    parser.add_argument("--levels", type=int, nargs="+", default=[1])
+    parser.add_argument("--threads", type=int, nargs="+", default=[1, 8])
+    parser.add_argument("--iters", type=int, default=3)
+    args = parser.parse_args()
+
+    chunks = _chunks(args)
+    raw_mb = sum(chunk.nbytes for chunk in chunks) / 2**20
+    dtypes = sorted({str(chunk.dtype) for chunk in chunks})
+    print(f"{len(chunks)} chunks, {raw_mb:.0f} MB, {', '.join(dtypes)}")
+    print(
+        f"{'codec':>6} {'level':>6} {'shuffle':>8} {'threads':>8} {'ratio':>7} "
+        f"{'comp GB/s':>10} {'decomp GB/s':>12}"
+    )
+    for codec in args.codecs:
+        for level in args.levels if codec != "none" else [0]:
+            for shuffle in (True, False):
+                for threads in args.threads:
+                    torch.set_num_threads(threads)
+                    ratio, comp, decomp = _measure(
+                        chunks, codec, level, shuffle, args.block_kb * 1024, args.iters
+                    )
+                    print(
+                        f"{codec:>6} {level:>6} {str(shuffle):>8} {threads:>8} "
+                        f"{ratio:>7.3f} {comp:>10.2f} {decomp:>12.2f}"
+                    )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,88 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+KV chunk layout conversion, layer major [2, num_layers, num_tokens, hidden]
+to token major [num_layers, num_tokens, 2, hidden] and back: GB/s of
+c_ops.convert_kv_layout (out of place and in place) vs permute().contiguous().
+
+    python benchmarks/bench_kv_layout.py --num-tokens 256 1024 --threads 1 8
+
+Bandwidth counts the chunk once read and once written.
+"""
+# Standard
+import argparse
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _timeit(fn, iters):
+    fn()
+    start = time.perf_counter()
+    for _ in range(iters):
+        fn()
+    return (time.perf_counter() - start) / iters
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--num-layers", type=int, default=32)
+    parser.add_argument("--num-tokens", type=int, nargs="+", default=[256, 1024])
+    parser.add_argument("--hidden", type=int, default=1024)
+    parser.add_argument("--dtype", default="bfloat16")
+    parser.add_argument("--threads", type=int, nargs="+", default=[1, 8])
+    parser.add_argument("--iters", type=int, default=20)
+    args = parser.parse_args()
+
+    dtype = getattr(torch, args.dtype)
+    print(
+        f"{'tokens':>7} {'threads':>8} {'MB':>7} {'permute':>9} "
+        f"{'native':>9} {'in place':>9} {'back':>9}"
+    )
+    for num_tokens in args.num_tokens:
+        layer_major = torch.randn([2, args.num_layers, num_tokens, args.hidden]).to(
+            dtype
+        )
+        token_major = torch.empty(
+            [args.num_layers, num_tokens, 2, args.hidden], dtype=dtype
+        )
+        in_place = layer_major.clone()
+        in_place_view = in_place.view(token_major.shape)
+        nbytes = layer_major.numel() * layer_major.element_size()
+
+        def run_in_place(chunk=in_place, view=in_place_view):
+            lmc_ops.convert_kv_layout(chunk, view, True)
+            lmc_ops.convert_kv_layout(view, chunk, False)
+
+        for threads in args.threads:
+            torch.set_num_threads(threads)
+            t_permute = _timeit(
+                lambda x=layer_major: x.permute(1, 2, 0, 3).contiguous(), args.iters
+            )
+            t_native = _timeit(
+                lambda x=layer_major, y=token_major: lmc_ops.convert_kv_layout(
+                    x, y, True
+                ),
+                args.iters,
+            )
+            # One round trip per iteration, so the chunk stays layer major
+            t_in_place = _timeit(run_in_place, args.iters) / 2
+            t_back = _timeit(
+                lambda x=token_major, y=layer_major: lmc_ops.convert_kv_layout(
+                    x, y, False
+                ),
+                args.iters,
+            )
+            times = (t_permute, t_native, t_in_place, t_back)
+            gbps = [2 * nbytes / t / 1e9 for t in times]
+            print(
+                f"{num_tokens:>7} {threads:>8} {nbytes / 1e6:>7.1f} "
+                + " ".join(f"{value:>9.2f}" for value in gbps)
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,148 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Accuracy and throughput of the 8-bit KV host format (kv_quant.h).
+
+    python benchmarks/bench_kv_quant.py --device cpu --threads 1 8
+    python benchmarks/bench_kv_quant.py --device npu
+
+For every format (int8 / float8_e4m3fn, one scale per token or per head)
+prints the reconstruction error of a KV sample and the time of a multi
+layer offload / load through KVTransferPlan against the full precision
+transfer. The sample has a few outlier channels like real K caches, which
+is where per head scales pay off.
+"""
+# Standard
+import argparse
+import random
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _synchronize(device):
+    if device.type == "npu":
+        torch.npu.synchronize()
+
+
+def _timeit(fn, iters, device):
+    fn()
+    _synchronize(device)
+    start = time.perf_counter()
+    for _ in range(iters):
+        fn()
+    _synchronize(device)
+    return (time.perf_counter() - start) / iters
+
+
+def _kv_sample(shape, dtype, num_outliers):
+    sample = torch.randn(shape)
+    channels = random.sample(range(shape[-1]), num_outliers)
+    sample[..., channels] *= 20
+    return sample.to(dtype)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--device", default="npu", choices=["npu", "cpu"])
+    parser.add_argument("--num-layers", type=int, default=32)
+    parser.add_argument("--num-blocks", type=int, default=512)
+    parser.add_argument("--block-size", type=int, default=128)
+    parser.add_argument("--num-heads", type=int, default=8)
+    parser.add_argument("--head-size", type=int, default=128)
+    parser.add_argument("--num-tokens", type=int, default=2048)
+    parser.add_argument("--num-outliers", type=int, default=8)
+    parser.add_argument("--iters", type=int, default=10)
+    parser.add_argument("--threads", type=int, nargs="+", default=[1])
+    args = parser.parse_args()
+
+    if args.device == "npu":
+        # Third Party
+        import torch_npu  # noqa: F401
+    device = torch.device(args.device)
+    dtype = torch.bfloat16
+    hidden = args.num_heads * args.head_size
+    page_buffer_size = args.num_blocks * args.block_size
+    kv_caches = [
+        _kv_sample(
+            [2, args.num_blocks, args.block_size, hidden], dtype, args.num_outliers
+        ).to(device)
+        for _ in range(args.num_layers)
+    ]
+    plan = lmc_ops.KVTransferPlan([t[0] for t in kv_caches], [t[1] for t in kv_caches])
+    slots = torch.tensor(random.sample(range(page_buffer_size), args.num_tokens))
+    slots = slots.to(device)
+
+    # The full precision baseline stages the KV on the device and copies it
+    # to / from pinned host memory, like the quantized path does with its
+    # 8-bit data
+    shape = [2, args.num_layers, args.num_tokens]
+    full = torch.empty(shape + [hidden], dtype=dtype, device=device)
+    full_host = full
+    if args.device == "npu":
+        full_host = torch.empty(shape + [hidden], dtype=dtype).pin_memory()
+    plan.multi_layer_transfer(full, slots, True)
+    full_host.copy_(full)
+    reference = full_host.float()
+
+    def offload_full():
+        plan.multi_layer_transfer(full, slots, True)
+        if full is not full_host:
+            full_host.copy_(full, non_blocking=True)
+
+    def load_full():
+        if full is not full_host:
+            full.copy_(full_host, non_blocking=True)
+        plan.multi_layer_transfer(full, slots, False)
+
+    formats = [
+        (qtype, groups)
+        for qtype in (torch.int8, torch.float8_e4m3fn)
+        for groups in (1, args.num_heads)
+    ]
+    print(f"{args.num_layers} layers x {args.num_tokens} tokens ({args.device})")
+    print(
+        f"{'format':>16} {'groups':>6} {'threads':>8} {'bytes':>6} {'max err':>8} "
+        f"{'rel rms':>8} {'offload ms':>10} {'load ms':>8}"
+    )
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t_offload = _timeit(offload_full, args.iters, device)
+        t_load = _timeit(load_full, args.iters, device)
+        print(
+            f"{str(dtype):>16} {'-':>6} {threads:>8} {1.0:>6.2f} {0.0:>8.4f} "
+            f"{0.0:>8.4f} {t_offload * 1e3:>10.2f} {t_load * 1e3:>8.2f}"
+        )
+        for qtype, groups in formats:
+            quantized = torch.empty(shape + [hidden], dtype=qtype)
+            scales = torch.empty(shape + [groups], dtype=torch.float32)
+            if args.device == "npu":
+                quantized, scales = quantized.pin_memory(), scales.pin_memory()
+
+            def offload(quantized=quantized, scales=scales):
+                plan.multi_layer_transfer_quantized(quantized, scales, slots, True)
+
+            def load(quantized=quantized, scales=scales):
+                plan.multi_layer_transfer_quantized(quantized, scales, slots, False)
+
+            t_offload = _timeit(offload, args.iters, device)
+            restored = torch.empty(reference.shape, dtype=torch.float32)
+            lmc_ops.dequantize_kv(quantized, scales, restored)
+            error = restored - reference
+            rel_rms = error.pow(2).mean().sqrt() / reference.pow(2).mean().sqrt()
+            size = (quantized.nbytes + scales.nbytes) / full_host.nbytes
+            t_load = _timeit(load, args.iters, device)
+            # Put the full precision KV back for the next format
+            load_full()
+            print(
+                f"{str(qtype):>16} {groups:>6} {threads:>8} {size:>6.2f} "
+                f"{error.abs().max().item():>8.4f} {rel_rms.item():>8.4f} "
+                f"{t_offload * 1e3:>10.2f} {t_load * 1e3:>8.2f}"
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Longest cached prefix lookup: c_ops.PrefixIndex vs probing a dict one chunk
+key at a time, with heavy prefix sharing.
+
+Sessions start with one of a few shared system prompts and continue with
+chunks of their own:
+
+    python benchmarks/bench_prefix_index.py --sessions 4000 --session-chunks 250
+
+gives 1M cached chunks. Queries are cached sessions extended with new
+chunks, so every lookup walks the full cached prefix.
+"""
+# Standard
+import argparse
+import os
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _rss_mb():
+    with open("/proc/self/statm") as f:
+        return int(f.read().split()[1]) * os.sysconf("SC_PAGE_SIZE") / 2**20
+
+
+def _chained(tokens, chunk_size):
+    return lmc_ops.chunk_hashes(tokens, chunk_size, include_partial=False)
+
+
+def _dict_lookup(cached, keys):
+    matched = 0
+    for key in keys.tolist():
+        if key not in cached:
+            break
+        matched += 1
+    return matched
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--sessions", type=int, default=4000)
+    parser.add_argument("--session-chunks", type=int, default=250)
+    parser.add_argument("--shared-chunks", type=int, default=64)
+    parser.add_argument("--num-prompts", type=int, default=100)
+    parser.add_argument("--queries", type=int, default=2000)
+    parser.add_argument("--chunk-size", type=int, default=16)
+    args = parser.parse_args()
+
+    chunk_size = args.chunk_size
+    generator = torch.Generator().manual_seed(0)
+    prompts = torch.randint(
+        0,
+        150000,
+        [args.num_prompts, args.shared_chunks * chunk_size],
+        generator=generator,
+    )
+    sessions = []
+    for session in range(args.sessions):
+        own = args.session_chunks - args.shared_chunks
+        tokens = torch.cat(
+            [
+                prompts[session % args.num_prompts],
+                torch.randint(0, 150000, [own * chunk_size], generator=generator),
+            ]
+        )
+        sessions.append(_chained(tokens, chunk_size))
+
+    rss = _rss_mb()
+    start = time.perf_counter()
+    cached = {}
+    for session, keys in enumerate(sessions):
+        for i, key in enumerate(keys.tolist()):
+            cached[key] = session * args.session_chunks + i
+    t_dict_build = time.perf_counter() - start
+    dict_mb = _rss_mb() - rss
+
+    rss = _rss_mb()
+    start = time.perf_counter()
+    index = lmc_ops.PrefixIndex()
+    for session, keys in enumerate(sessions):
+        base = session * args.session_chunks
+        index.insert(keys, torch.arange(base, base + keys.numel()))
+    t_index_build = time.perf_counter() - start
+    index_mb = _rss_mb() - rss
+    print(
+        f"{index.size()} cached chunks ({len(cached)} dict keys), "
+        f"{index.num_nodes()} tree nodes"
+    )
+
+    queries = []
+    for query in range(args.queries):
+        keys = sessions[query * 7919 % args.sessions]
+        extra = torch.randint(0, 1 << 62, [8], generator=generator)
+        queries.append(torch.cat([keys, extra]))
+
+    start = time.perf_counter()
+    dict_matched = [_dict_lookup(cached, keys) for keys in queries]
+    t_dict = time.perf_counter() - start
+    start = time.perf_counter()
+    index_matched = [index.longest_prefix(keys) for keys in queries]
+    t_index = time.perf_counter() - start
+    start = time.perf_counter()
+    batch_matched = index.longest_prefixes(queries)
+    t_batch = time.perf_counter() - start
+    assert dict_matched == index_matched == batch_matched
+
+    print(f"{'':>22} {'build s':>8} {'RSS MB':>8} {'lookup us':>10}")
+    us = 1e6 / args.queries
+    print(
+        f"{'dict probing':>22} {t_dict_build:>8.2f} {dict_mb:>8.0f} "
+        f"{t_dict * us:>10.1f}"
+    )
+    print(
+        f"{'PrefixIndex':>22} {t_index_build:>8.2f} {index_mb:>8.0f} "
+        f"{t_index * us:>10.1f}"
+    )
+    print(f"{'PrefixIndex batched':>22} {'':>8} {'':>8} {t_batch * us:>10.1f}")
+
+
+if __name__ == "__main__":
+    main()
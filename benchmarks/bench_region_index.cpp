@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Host -> device address translation latency, per number of registered
+ * regions and lookup threads: the previous shared_mutex + linear scan against
+ * the lock-free RegionIndex used by HostRegisteredMemoryManager.
+ *
+ *     g++ -O2 -std=c++17 -pthread -Icsrc benchmarks/bench_region_index.cpp \
+ *         -o /tmp/bench_region_index && /tmp/bench_region_index
+ */
+#include "region_index.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+
+namespace {
+
+constexpr size_t REGION_BYTES = 1 << 20;
+constexpr int LOOKUPS_PER_THREAD = 1 << 18;
+
+class LockedLinearScan {
+public:
+    explicit LockedLinearScan(const std::map<void*, lmc::RegisteredMemoryRecord>& regions)
+        : allocatedMap(regions) {}
+
+    const lmc::RegisteredMemoryRecord* find(uintptr_t addr) const {
+        const std::shared_lock<std::shared_mutex> guard(mux);
+        for (const auto& pair : allocatedMap) {
+            const lmc::RegisteredMemoryRecord& record = pair.second;
+            if (addr >= record.ptr && addr < record.ptr + record.buffSize) {
+                return &record;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    std::map<void*, lmc::RegisteredMemoryRecord> allocatedMap;
+    mutable std::shared_mutex mux;
+};
+
+// Average ns per lookup over all threads, every address hits a region
+template <typename Index>
+double measure(const Index& index, size_t numRegions, int numThreads) {
+    std::vector<std::thread> threads;
+    std::vector<double> elapsed(numThreads);
+    std::atomic<uintptr_t> sink{0};
+    for (int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937_64 rng(t);
+            std::vector<uintptr_t> addrs(4096);
+            for (auto& addr : addrs) {
+                // Regions are spaced 2 * REGION_BYTES apart starting at REGION_BYTES
+                addr = (2 * (rng() % numRegions) + 1) * REGION_BYTES + rng() % REGION_BYTES;
+            }
+            uintptr_t acc = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < LOOKUPS_PER_THREAD; ++i) {
+                acc += index.find(addrs[i & 4095])->devptr;
+            }
+            const auto stop = std::chrono::steady_clock::now();
+            elapsed[t] = std::chrono::duration<double, std::nano>(stop - start).count();
+            sink += acc;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double total = 0;
+    for (double e : elapsed) {
+        total += e;
+    }
+    return total / (static_cast<double>(numThreads) * LOOKUPS_PER_THREAD);
+}
+
+} // namespace
+
+int main() {
+    const size_t regionCounts[] = {1, 4, 16, 64, 256, 1024};
+    const int threadCounts[] = {1, 2, 4, 8, 16};
+
+    std::printf("%8s %8s %14s %14s\n", "regions", "threads", "locked ns", "lock-free ns");
+    for (size_t numRegions : regionCounts) {
+        std::map<void*, lmc::RegisteredMemoryRecord> regions;
+        for (size_t i = 0; i < numRegions; ++i) {
+            const uintptr_t ptr = (2 * i + 1) * REGION_BYTES;
+            regions.emplace(reinterpret_cast<void*>(ptr), lmc::RegisteredMemoryRecord{ptr, ptr << 1, REGION_BYTES});
+        }
+        LockedLinearScan locked(regions);
+        lmc::RegionIndex index;
+        index.publish(regions);
+
+        for (int numThreads : threadCounts) {
+            std::printf("%8zu %8d %14.1f %14.1f\n", numRegions, numThreads,
+                        measure(locked, numRegions, numThreads), measure(index, numRegions, numThreads));
+        }
+    }
+    return 0;
+}
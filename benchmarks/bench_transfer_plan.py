@@ -0,0 +1,117 @@
+# SPDX-License-Identifier: Apache-2.0
+"""
+Per-call overhead of the KV transfer ops, free functions vs KVTransferPlan.
+
+    python benchmarks/bench_transfer_plan.py --device npu --num-tokens 16
+
+With few tokens per call the kernels are tiny and the time per call is
+dominated by the host-side setup, which is what the plan removes. Times are
+host wall time per call (launches are asynchronous on the NPU, the stream
+is synchronized once per measurement).
+"""
+# Standard
+import argparse
+import random
+import time
+
+# Third Party
+import torch
+
+# First Party
+import lmcache_ascend.c_ops as lmc_ops
+
+
+def _synchronize(device):
+    if device.type == "npu":
+        torch.npu.synchronize()
+
+
+def _per_call(fn, calls, device):
+    fn()
+    _synchronize(device)
+    start = time.perf_counter()
+    fn()
+    _synchronize(device)
+    return (time.perf_counter() - start) / calls
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--device", default="npu", choices=["npu", "cpu"])
+    parser.add_argument("--num-layers", type=int, default=32)
+    parser.add_argument("--num-blocks", type=int, default=256)
+    parser.add_argument("--block-size", type=int, default=128)
+    parser.add_argument("--hidden", type=int, default=1024)
+    parser.add_argument("--num-tokens", type=int, nargs="+", default=[16, 256])
+    parser.add_argument("--iters", type=int, default=50)
+    args = parser.parse_args()
+
+    if args.device == "npu":
+        # Third Party
+        import torch_npu  # noqa: F401
+    device = torch.device(args.device)
+    dtype = torch.bfloat16
+    page_buffer_size = args.num_blocks * args.block_size
+    kv_caches = [
+        torch.rand([2, args.num_blocks, args.block_size, args.hidden], dtype=dtype).to(
+            device
+        )
+        for _ in range(args.num_layers)
+    ]
+    key_caches = [t[0] for t in kv_caches]
+    value_caches = [t[1] for t in kv_caches]
+    ptrs = torch.tensor([t.data_ptr() for t in kv_caches]).to(device)
+    plan = lmc_ops.KVTransferPlan(key_caches, value_caches)
+
+    print(f"{args.num_layers} layers, per call overhead in us ({args.device})")
+    print(f"{'tokens':>8} {'op':>14} {'free':>10} {'plan':>10}")
+    for num_tokens in args.num_tokens:
+        slots = torch.tensor(random.sample(range(page_buffer_size), num_tokens)).to(
+            device
+        )
+        multi = torch.empty([2, args.num_layers, num_tokens, args.hidden], dtype=dtype)
+        layer_buffer = torch.empty([num_tokens, 2, args.hidden], dtype=dtype)
+        multi, layer_buffer = multi.to(device), layer_buffer.to(device)
+
+        def multi_free():
+            for _ in range(args.iters):
+                lmc_ops.multi_layer_kv_transfer(
+                    multi, ptrs, slots, device, page_buffer_size, True, False
+                )
+
+        def multi_plan():
+            for _ in range(args.iters):
+                plan.multi_layer_transfer(multi, slots, True)
+
+        def layer_free():
+            for _ in range(args.iters):
+                for layer in range(args.num_layers):
+                    lmc_ops.single_layer_kv_transfer(
+                        layer_buffer,
+                        key_caches[layer],
+                        value_caches[layer],
+                        slots,
+                        True,
+                        True,
+                    )
+
+        def layer_plan():
+            for _ in range(args.iters):
+                for layer in range(args.num_layers):
+                    plan.single_layer_transfer(layer_buffer, slots, layer, True, True)
+
+        layer_calls = args.iters * args.num_layers
+        for name, free, planned, calls in (
+            ("multi_layer", multi_free, multi_plan, args.iters),
+            ("single_layer", layer_free, layer_plan, layer_calls),
+        ):
+            t_free = _per_call(free, calls, device)
+            t_plan = _per_call(planned, calls, device)
+            print(
+                f"{num_tokens:>8} {name:>14} "
+                f"{t_free * 1e6:>10.1f} {t_plan * 1e6:>10.1f}"
+            )
+
+
+if __name__ == "__main__":
+    main()
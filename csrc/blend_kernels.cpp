@@ -0,0 +1,190 @@
+#include "blend_kernels.h"
+#include <ATen/Dispatch.h>
+#include <ATen/Parallel.h>
+#include <ATen/cpu/vec/vec.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <mutex>
+#include <utility>
+
+/*
+ * Fused replacement of the check layer selection of LMCBlender.process_qkv:
+ *   diff = ((k.float() - old_k.float()) ** 2).sum(1)
+ *   indices = sort(topk(diff, topk).indices)
+ *   q, k, v, residual = q[indices], k[indices], v[indices], residual[indices]
+ *
+ * On the CPU k and old_k are read once in their own dtype and widened to
+ * float a block at a time, each task keeps only its own topk candidates, and
+ * the rows are gathered straight into the outputs: no full size float copy
+ * of k and old_k, and no score tensor.
+ *
+ * A NaN deviation (a NaN in k or old_k, or inf in both) scores -inf on both
+ * paths: such tokens are picked last, and the comparator stays a strict weak
+ * ordering.
+ */
+
+namespace {
+
+using fVec = at::vec::Vectorized<float>;
+
+constexpr int64_t BLOCK = 64;
+
+using Candidate = std::pair<float, int64_t>;
+
+// Larger deviation first, lower token first on ties
+inline bool deviates_more(const Candidate& a, const Candidate& b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+// Keeps the topk best of candidates, in no particular order
+inline void keep_top(std::vector<Candidate>& candidates, int64_t topk) {
+    if (static_cast<int64_t>(candidates.size()) > topk) {
+        std::nth_element(candidates.begin(), candidates.begin() + topk, candidates.end(), deviates_more);
+        candidates.resize(topk);
+    }
+}
+
+template <typename scalar_t>
+float squared_distance(const scalar_t* a, const scalar_t* b, int64_t n) {
+    alignas(64) float wa[BLOCK];
+    alignas(64) float wb[BLOCK];
+    fVec acc(0.0f);
+    for (int64_t i = 0; i < n; i += BLOCK) {
+        const int64_t count = std::min(BLOCK, n - i);
+        for (int64_t j = 0; j < count; ++j) {
+            wa[j] = static_cast<float>(a[i + j]);
+            wb[j] = static_cast<float>(b[i + j]);
+        }
+        for (int64_t j = 0; j < count; j += fVec::size()) {
+            // Partial loads are zero filled on both sides
+            const int64_t lanes = std::min<int64_t>(fVec::size(), count - j);
+            const fVec d = fVec::loadu(wa + j, lanes) - fVec::loadu(wb + j, lanes);
+            acc = at::vec::fmadd(d, d, acc);
+        }
+    }
+    alignas(64) float lanes[fVec::size()];
+    acc.store(lanes);
+    float sum = 0.0f;
+    for (int64_t i = 0; i < fVec::size(); ++i) {
+        sum += lanes[i];
+    }
+    return sum;
+}
+
+template <typename scalar_t>
+std::vector<int64_t> top_deviations_cpu(const torch::Tensor& k, const torch::Tensor& old_k, int64_t topk) {
+    const int64_t num_tokens = k.size(0);
+    const int64_t hidden = k.size(1);
+    const scalar_t* k_ptr = k.data_ptr<scalar_t>();
+    const scalar_t* old_ptr = old_k.data_ptr<scalar_t>();
+    const int64_t k_stride = k.stride(0);
+    const int64_t old_stride = old_k.stride(0);
+
+    std::mutex mutex;
+    std::vector<Candidate> merged;
+    at::parallel_for(0, num_tokens, 64, [&](int64_t begin, int64_t end) {
+        std::vector<Candidate> local;
+        local.reserve(end - begin);
+        for (int64_t t = begin; t < end; ++t) {
+            const float distance = squared_distance(k_ptr + t * k_stride, old_ptr + t * old_stride, hidden);
+            local.emplace_back(std::isnan(distance) ? -INFINITY : distance, t);
+        }
+        keep_top(local, topk);
+        std::lock_guard<std::mutex> guard(mutex);
+        merged.insert(merged.end(), local.begin(), local.end());
+    });
+    keep_top(merged, topk);
+
+    std::vector<int64_t> indices(merged.size());
+    std::transform(merged.begin(), merged.end(), indices.begin(), [](const Candidate& c) { return c.second; });
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+// Rows of x (whose rows are contiguous) at indices, into a new tensor
+torch::Tensor gather_rows_cpu(const torch::Tensor& x, const std::vector<int64_t>& indices) {
+    std::vector<int64_t> shape(x.sizes().begin(), x.sizes().end());
+    const int64_t row_bytes =
+        std::accumulate(shape.begin() + 1, shape.end(), int64_t{1}, std::multiplies<int64_t>()) * x.element_size();
+    shape[0] = static_cast<int64_t>(indices.size());
+    torch::Tensor out = torch::empty(shape, x.options());
+    const int64_t src_stride = x.stride(0) * x.element_size();
+    const uint8_t* src = static_cast<const uint8_t*>(x.data_ptr());
+    uint8_t* dst = static_cast<uint8_t*>(out.data_ptr());
+    at::parallel_for(0, static_cast<int64_t>(indices.size()), 16, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            std::memcpy(dst + i * row_bytes, src + indices[i] * src_stride, row_bytes);
+        }
+    });
+    return out;
+}
+
+// x with contiguous rows, i.e. dense trailing dimensions: vLLM's q / k / v
+// are column slices of the fused qkv tensor, which already qualify and are
+// not copied. The strides of x itself are checked: flatten(1) of trailing
+// dimensions that are not dense would be a contiguous copy and hide them.
+torch::Tensor row_major(const torch::Tensor& x) {
+    int64_t expected = 1;
+    for (int64_t dim = x.dim() - 1; dim >= 1; --dim) {
+        if (x.size(dim) != 1 && x.stride(dim) != expected) {
+            return x.contiguous();
+        }
+        expected *= x.size(dim);
+    }
+    return x;
+}
+
+// Device path built from ATen ops, used until a dedicated AscendC kernel
+// exists. Scores are computed a token block at a time so that the float
+// copies stay bounded.
+torch::Tensor top_deviations_aten(const torch::Tensor& k, const torch::Tensor& old_k, int64_t topk) {
+    constexpr int64_t TOKEN_BLOCK = 4096;
+    const int64_t num_tokens = k.size(0);
+    torch::Tensor scores = torch::empty({num_tokens}, k.options().dtype(torch::kFloat));
+    for (int64_t start = 0; start < num_tokens; start += TOKEN_BLOCK) {
+        const int64_t n = std::min(TOKEN_BLOCK, num_tokens - start);
+        const torch::Tensor d =
+            k.narrow(0, start, n).to(torch::kFloat) - old_k.narrow(0, start, n).to(torch::kFloat);
+        scores.narrow(0, start, n).copy_(d.square_().sum(at::IntArrayRef{1}));
+    }
+    // topk ranks NaN above every number, the CPU path below every number
+    scores.masked_fill_(scores.isnan(), -INFINITY);
+    return std::get<0>(torch::sort(std::get<1>(scores.topk(topk))));
+}
+
+} // namespace
+
+std::vector<torch::Tensor> select_deviated_tokens(const torch::Tensor& q, const torch::Tensor& k,
+                                                  const torch::Tensor& v, const torch::Tensor& residual,
+                                                  const torch::Tensor& old_k, int64_t topk) {
+    TORCH_CHECK(k.dim() >= 2 && old_k.dim() >= 2, "k and old_k must be [num_tokens, ...].");
+    const int64_t num_tokens = k.size(0);
+    TORCH_CHECK(old_k.size(0) == num_tokens && old_k.numel() == k.numel(), "old_k must have the shape of k.");
+    TORCH_CHECK(old_k.scalar_type() == k.scalar_type(), "k and old_k must have the same dtype.");
+    TORCH_CHECK(q.size(0) == num_tokens && v.size(0) == num_tokens && residual.size(0) == num_tokens,
+                "q, v and residual must have one row per token.");
+    TORCH_CHECK(k.device() == old_k.device() && q.device() == k.device() && v.device() == k.device() &&
+                    residual.device() == k.device(),
+                "all tensors must be on the same device.");
+    topk = std::max<int64_t>(0, std::min(topk, num_tokens));
+
+    const torch::Tensor k_rows = row_major(k).flatten(1);
+    const torch::Tensor old_rows = row_major(old_k).flatten(1);
+    if (!k.device().is_cpu()) {
+        const torch::Tensor indices = top_deviations_aten(k_rows, old_rows, topk);
+        return {indices, q.index_select(0, indices), k.index_select(0, indices), v.index_select(0, indices),
+                residual.index_select(0, indices)};
+    }
+
+    std::vector<int64_t> indices;
+    AT_DISPATCH_FLOATING_TYPES_AND2(at::kHalf, at::kBFloat16, k.scalar_type(), "select_deviated_tokens", [&] {
+        indices = top_deviations_cpu<scalar_t>(k_rows, old_rows, topk);
+    });
+    torch::Tensor index_tensor = torch::empty({topk}, k.options().dtype(torch::kInt64));
+    std::copy(indices.begin(), indices.end(), index_tensor.data_ptr<int64_t>());
+    return {index_tensor, gather_rows_cpu(row_major(q), indices), gather_rows_cpu(row_major(k), indices),
+            gather_rows_cpu(row_major(v), indices), gather_rows_cpu(row_major(residual), indices)};
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <torch/torch.h>
+#include <vector>
+
+// Tokens to recompute on a CacheBlend check layer: the topk tokens whose
+// key deviates most (squared L2 distance) from the cached old_k, and their
+// rows of q, k, v and residual.
+// Returns {indices (int64, ascending), q, k, v, residual} gathered at them.
+// Tokens with a NaN deviation are selected last.
+//
+// Only the CPU path is fused. On the NPU this is still ATen: scores a block
+// of 4096 tokens at a time, then topk, sort and index_select, until an
+// AscendC kernel replaces it.
+std::vector<torch::Tensor> select_deviated_tokens(const torch::Tensor& q, const torch::Tensor& k,
+                                                  const torch::Tensor& v, const torch::Tensor& residual,
+                                                  const torch::Tensor& old_k, int64_t topk);
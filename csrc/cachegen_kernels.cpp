@@ -1,32 +1,490 @@
 #include "cachegen_kernels.h"
-#include <pybind11/pybind11.h>
-#include <Python.h> 
+#include <ATen/Parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
-namespace py = pybind11;
+/*
+ * Host implementation of the CacheGen arithmetic coder.
+ *
+ * The coder is the torchac range coder used by the upstream LMCache CUDA
+ * kernels (16 bit precision cdfs, 32 bit low/high registers and E3 pending
+ * bits), so the produced bitstreams are interchangeable with the ones
+ * written by CUDA nodes.
+ *
+ * Layouts follow upstream:
+ *  - cdf:            int16 [nlayers, nchannels, Lp]   (values read as uint16)
+ *  - input_sym:      int8  [nlayers, ntokens, nchannels]
+ *  - output_buffer:  uint8 [nlayers, nchannels, buffer_size]
+ *  - output_lengths: int32 [nlayers, nchannels]
+ *  - bytestreams:    uint8 [total_bytes], streams concatenated in
+ *                    (layer, channel) order
+ *  - output:         int8/uint8 [nlayers, ntokens, nchannels]
+ *
+ * Every (layer, channel) pair is an independent bytestream. Work is split
+ * across the ATen intra-op pool by stream, and each worker advances
+ * CODER_LANES neighbouring streams in lock step so that the reads of a token
+ * row are contiguous and the independent coder states overlap in the
+ * pipeline (the renormalisation loop is too branchy to vectorise directly).
+ */
+
+namespace {
+
+using cdf_t = uint16_t;
+
+constexpr int PRECISION = 16;
+constexpr uint32_t CDF_MAX = 0x10000U;
+constexpr int CODER_LANES = 8;
+constexpr int64_t STREAM_GRAIN = CODER_LANES;
+constexpr int64_t DECODE_PARTS_PER_THREAD = 4;
+
+class BitWriter {
+public:
+    BitWriter() = default;
+    BitWriter(uint8_t* out, int64_t capacity) : out_(out), capacity_(capacity) {}
+
+    inline void append(const int bit) {
+        cache_ = static_cast<uint8_t>((cache_ << 1) | bit);
+        if (++count_ == 8) {
+            TORCH_CHECK(pos_ < capacity_, "CacheGen output buffer too small for the encoded stream.");
+            out_[pos_++] = cache_;
+            count_ = 0;
+        }
+    }
+
+    inline void append_bit_and_pending(const int bit, uint64_t& pending_bits) {
+        append(bit);
+        while (pending_bits > 0) {
+            append(!bit);
+            pending_bits -= 1;
+        }
+    }
+
+    inline void flush() {
+        while (count_ > 0) {
+            append(0);
+        }
+    }
+
+    int64_t size() const { return pos_; }
+
+private:
+    uint8_t* out_ = nullptr;
+    int64_t capacity_ = 0;
+    int64_t pos_ = 0;
+    uint8_t cache_ = 0;
+    uint8_t count_ = 0;
+};
+
+class BitReader {
+public:
+    BitReader() = default;
+    BitReader(const uint8_t* in, int64_t size) : in_(in), size_(size) {}
+
+    // Past the end of the stream we shift in zeros, as the reference does.
+    inline void get(uint32_t& value) {
+        if (cached_bits_ == 0) {
+            if (pos_ == size_) {
+                value <<= 1;
+                return;
+            }
+            cache_ = in_[pos_++];
+            cached_bits_ = 8;
+        }
+        value <<= 1;
+        value |= (cache_ >> (cached_bits_ - 1)) & 1;
+        cached_bits_--;
+    }
+
+    inline void initialize(uint32_t& value) {
+        for (int i = 0; i < 32; ++i) {
+            get(value);
+        }
+    }
+
+private:
+    const uint8_t* in_ = nullptr;
+    int64_t size_ = 0;
+    int64_t pos_ = 0;
+    uint8_t cache_ = 0;
+    uint8_t cached_bits_ = 0;
+};
+
+struct EncoderState {
+    uint32_t low = 0;
+    uint32_t high = 0xFFFFFFFFU;
+    uint64_t pending_bits = 0;
+    BitWriter writer;
+};
+
+struct DecoderState {
+    uint32_t low = 0;
+    uint32_t high = 0xFFFFFFFFU;
+    uint32_t value = 0;
+    BitReader reader;
+};
+
+// Same search as the reference, including the early exit on an exact hit,
+// so that non strictly increasing cdfs decode identically.
+inline cdf_t binsearch(const cdf_t* cdf, cdf_t target, cdf_t max_sym) {
+    cdf_t left = 0;
+    cdf_t right = max_sym + 1;
+    while (left + 1 < right) {
+        const auto m = static_cast<cdf_t>((left + right) / 2);
+        const auto v = cdf[m];
+        if (v < target) {
+            left = m;
+        } else if (v > target) {
+            right = m;
+        } else {
+            return m;
+        }
+    }
+    return left;
+}
+
+inline void encode_symbol(EncoderState& s, const cdf_t* cdf, const int sym, const int max_symbol) {
+    const uint64_t span = static_cast<uint64_t>(s.high) - static_cast<uint64_t>(s.low) + 1;
+    const uint32_t c_low = cdf[sym];
+    const uint32_t c_high = sym == max_symbol ? CDF_MAX : cdf[sym + 1];
+
+    s.high = (s.low - 1) + static_cast<uint32_t>((span * static_cast<uint64_t>(c_high)) >> PRECISION);
+    s.low = s.low + static_cast<uint32_t>((span * static_cast<uint64_t>(c_low)) >> PRECISION);
+
+    while (true) {
+        if (s.high < 0x80000000U) {
+            s.writer.append_bit_and_pending(0, s.pending_bits);
+            s.low <<= 1;
+            s.high <<= 1;
+            s.high |= 1;
+        } else if (s.low >= 0x80000000U) {
+            s.writer.append_bit_and_pending(1, s.pending_bits);
+            s.low <<= 1;
+            s.high <<= 1;
+            s.high |= 1;
+        } else if (s.low >= 0x40000000U && s.high < 0xC0000000U) {
+            s.pending_bits++;
+            s.low <<= 1;
+            s.low &= 0x7FFFFFFFU;
+            s.high <<= 1;
+            s.high |= 0x80000001U;
+        } else {
+            break;
+        }
+    }
+}
+
+inline void encode_finish(EncoderState& s) {
+    s.pending_bits += 1;
+    if (s.low < 0x40000000U) {
+        s.writer.append_bit_and_pending(0, s.pending_bits);
+    } else {
+        s.writer.append_bit_and_pending(1, s.pending_bits);
+    }
+    s.writer.flush();
+}
+
+inline uint8_t decode_symbol(DecoderState& s, const cdf_t* cdf, const int max_symbol, const bool last) {
+    const uint64_t span = static_cast<uint64_t>(s.high) - static_cast<uint64_t>(s.low) + 1;
+    const uint16_t count = static_cast<uint16_t>(
+        ((static_cast<uint64_t>(s.value) - static_cast<uint64_t>(s.low) + 1) * CDF_MAX - 1) / span);
+
+    const cdf_t sym = binsearch(cdf, count, static_cast<cdf_t>(max_symbol));
+    if (last) {
+        return static_cast<uint8_t>(sym);
+    }
+
+    const uint32_t c_low = cdf[sym];
+    const uint32_t c_high = sym == max_symbol ? CDF_MAX : cdf[sym + 1];
+
+    s.high = (s.low - 1) + static_cast<uint32_t>((span * static_cast<uint64_t>(c_high)) >> PRECISION);
+    s.low = s.low + static_cast<uint32_t>((span * static_cast<uint64_t>(c_low)) >> PRECISION);
+
+    while (true) {
+        if (s.low >= 0x80000000U || s.high < 0x80000000U) {
+            s.low <<= 1;
+            s.high <<= 1;
+            s.high |= 1;
+            s.reader.get(s.value);
+        } else if (s.low >= 0x40000000U && s.high < 0xC0000000U) {
+            s.low <<= 1;
+            s.low &= 0x7FFFFFFFU;
+            s.high <<= 1;
+            s.high |= 0x80000001U;
+            s.value -= 0x40000000U;
+            s.reader.get(s.value);
+        } else {
+            break;
+        }
+    }
+    return static_cast<uint8_t>(sym);
+}
+
+void check_cdf(const at::Tensor& cdf) {
+    TORCH_CHECK(cdf.device().is_cpu(), "CacheGen host codec expects the cdf on cpu.");
+    TORCH_CHECK(cdf.dim() == 3, "cdf must be [nlayers, nchannels, Lp].");
+    TORCH_CHECK(cdf.scalar_type() == at::ScalarType::Short, "cdf must be int16.");
+    TORCH_CHECK(cdf.is_contiguous(), "cdf must be contiguous.");
+    TORCH_CHECK(cdf.size(2) >= 2, "cdf must hold at least one symbol.");
+}
+
+void check_symbols(const at::Tensor& t, const char* name) {
+    TORCH_CHECK(t.device().is_cpu(), name, " must be a (pinned) cpu tensor.");
+    TORCH_CHECK(t.dim() == 3, name, " must be [nlayers, ntokens, nchannels].");
+    TORCH_CHECK(t.scalar_type() == at::ScalarType::Char || t.scalar_type() == at::ScalarType::Byte,
+                name, " must be int8 or uint8.");
+    TORCH_CHECK(t.is_contiguous(), name, " must be contiguous.");
+}
+
+// Decodes the streams [begin, end). offsets[i] is the first byte of stream i,
+// offsets[i + 1] one past its last byte.
+void decode_streams(const cdf_t* cdf_ptr, const uint8_t* in_ptr, const int64_t* offsets,
+                    uint8_t* out_ptr, int64_t begin, int64_t end, int64_t nchannels,
+                    int64_t ntokens, int64_t Lp) {
+    const int max_symbol = static_cast<int>(Lp - 2);
+    DecoderState states[CODER_LANES];
+    const cdf_t* cdfs[CODER_LANES];
+    uint8_t* outs[CODER_LANES];
+
+    for (int64_t first = begin; first < end; first += CODER_LANES) {
+        const int lanes = static_cast<int>(std::min<int64_t>(CODER_LANES, end - first));
+        for (int l = 0; l < lanes; ++l) {
+            const int64_t stream = first + l;
+            const int64_t layer = stream / nchannels;
+            const int64_t channel = stream % nchannels;
+            states[l] = DecoderState();
+            states[l].reader = BitReader(in_ptr + offsets[stream], offsets[stream + 1] - offsets[stream]);
+            states[l].reader.initialize(states[l].value);
+            cdfs[l] = cdf_ptr + stream * Lp;
+            outs[l] = out_ptr + layer * ntokens * nchannels + channel;
+        }
+        for (int64_t t = 0; t < ntokens; ++t) {
+            const bool last = t == ntokens - 1;
+            for (int l = 0; l < lanes; ++l) {
+                outs[l][t * nchannels] = decode_symbol(states[l], cdfs[l], max_symbol, last);
+            }
+        }
+    }
+}
+
+void check_decode_args(const at::Tensor& cdf, const at::Tensor& bytestreams,
+                       const at::Tensor& lengths, const at::Tensor& output) {
+    check_cdf(cdf);
+    check_symbols(output, "output");
+    TORCH_CHECK(bytestreams.device().is_cpu() && bytestreams.is_contiguous() && bytestreams.element_size() == 1,
+                "bytestreams must be a contiguous cpu byte tensor.");
+    TORCH_CHECK(lengths.device().is_cpu() && lengths.scalar_type() == at::ScalarType::Int,
+                "lengths must be an int32 cpu tensor [nlayers, nchannels].");
+    TORCH_CHECK(cdf.size(0) == output.size(0) && cdf.size(1) == output.size(2),
+                "cdf and output shapes mismatch.");
+    TORCH_CHECK(lengths.numel() == output.size(0) * output.size(2), "lengths must be [nlayers, nchannels].");
+}
+
+/*
+ * Decoding a stream costs a binary search per token plus a renormalisation
+ * step per input bit, so an even split by stream count is uneven in time
+ * when stream lengths differ. We cut the streams into DECODE_PARTS_PER_THREAD
+ * contiguous ranges per thread of roughly equal estimated cost (the
+ * cumulative cost is monotone and closed form given the byte offsets, so each
+ * cut is a binary search) and let the pool pick them up.
+ */
+void decode_partitioned(const at::Tensor& cdf, const at::Tensor& bytestreams,
+                        const std::vector<int64_t>& offsets, at::Tensor& output) {
+    const int64_t ntokens = output.size(1);
+    const int64_t nchannels = output.size(2);
+    const int64_t nstreams = static_cast<int64_t>(offsets.size()) - 1;
+    const int64_t Lp = cdf.size(2);
+    TORCH_CHECK(offsets[nstreams] <= bytestreams.numel(), "lengths exceed the size of bytestreams.");
+    if (ntokens == 0 || nstreams == 0) {
+        return;
+    }
+
+    int64_t search_steps = 1;
+    while ((int64_t{1} << search_steps) < Lp) {
+        search_steps++;
+    }
+    const int64_t stream_cost = ntokens * search_steps;
+    auto cost_before = [&](int64_t stream) { return offsets[stream] * 8 + stream * stream_cost; };
+
+    const int64_t total_cost = cost_before(nstreams);
+    const int64_t nparts = std::min<int64_t>(
+        (nstreams + CODER_LANES - 1) / CODER_LANES,
+        static_cast<int64_t>(at::get_num_threads()) * DECODE_PARTS_PER_THREAD);
+    std::vector<int64_t> bounds(nparts + 1, nstreams);
+    bounds[0] = 0;
+    for (int64_t p = 1; p < nparts; ++p) {
+        const int64_t target = total_cost * p / nparts;
+        int64_t lo = bounds[p - 1];
+        int64_t hi = nstreams;
+        while (lo < hi) {
+            const int64_t mid = lo + (hi - lo) / 2;
+            if (cost_before(mid) < target) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        bounds[p] = lo;
+    }
+
+    const cdf_t* cdf_ptr = reinterpret_cast<const cdf_t*>(cdf.data_ptr<int16_t>());
+    const uint8_t* in_ptr = static_cast<const uint8_t*>(bytestreams.data_ptr());
+    uint8_t* out_ptr = static_cast<uint8_t*>(output.data_ptr());
+
+    at::parallel_for(0, nparts, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t p = begin; p < end; ++p) {
+            decode_streams(cdf_ptr, in_ptr, offsets.data(), out_ptr, bounds[p], bounds[p + 1],
+                           nchannels, ntokens, Lp);
+        }
+    });
+}
+
+} // namespace
 
 void encode_cuda_new(const at::Tensor& cdf, const at::Tensor& input_sym,
                      at::Tensor& output_buffer, at::Tensor& output_lengths) {
-    // TODO:
-    PyErr_SetString(PyExc_NotImplementedError, "Please contact LMCache Ascend.");
-    throw py::error_already_set();
+    check_cdf(cdf);
+    check_symbols(input_sym, "input_sym");
+    TORCH_CHECK(output_buffer.device().is_cpu() && output_buffer.dim() == 3 && output_buffer.is_contiguous(),
+                "output_buffer must be a contiguous cpu tensor [nlayers, nchannels, buffer_size].");
+    TORCH_CHECK(output_buffer.element_size() == 1, "output_buffer must be a byte tensor.");
+    TORCH_CHECK(output_lengths.device().is_cpu() && output_lengths.is_contiguous() &&
+                output_lengths.scalar_type() == at::ScalarType::Int,
+                "output_lengths must be a contiguous int32 cpu tensor [nlayers, nchannels].");
+
+    const int64_t nlayers = input_sym.size(0);
+    const int64_t ntokens = input_sym.size(1);
+    const int64_t nchannels = input_sym.size(2);
+    const int64_t Lp = cdf.size(2);
+    const int64_t buffer_size = output_buffer.size(2);
+    TORCH_CHECK(cdf.size(0) == nlayers && cdf.size(1) == nchannels, "cdf and input_sym shapes mismatch.");
+    TORCH_CHECK(output_buffer.size(0) == nlayers && output_buffer.size(1) == nchannels,
+                "output_buffer and input_sym shapes mismatch.");
+    TORCH_CHECK(output_lengths.numel() == nlayers * nchannels, "output_lengths must be [nlayers, nchannels].");
+
+    const cdf_t* cdf_ptr = reinterpret_cast<const cdf_t*>(cdf.data_ptr<int16_t>());
+    const uint8_t* in_ptr = static_cast<const uint8_t*>(input_sym.data_ptr());
+    uint8_t* out_ptr = static_cast<uint8_t*>(output_buffer.data_ptr());
+    int32_t* len_ptr = output_lengths.data_ptr<int32_t>();
+    const int max_symbol = static_cast<int>(Lp - 2);
+
+    at::parallel_for(0, nlayers * nchannels, STREAM_GRAIN, [&](int64_t begin, int64_t end) {
+        EncoderState states[CODER_LANES];
+        const cdf_t* cdfs[CODER_LANES];
+        const uint8_t* ins[CODER_LANES];
+
+        for (int64_t first = begin; first < end; first += CODER_LANES) {
+            const int lanes = static_cast<int>(std::min<int64_t>(CODER_LANES, end - first));
+            for (int l = 0; l < lanes; ++l) {
+                const int64_t stream = first + l;
+                const int64_t layer = stream / nchannels;
+                const int64_t channel = stream % nchannels;
+                states[l] = EncoderState();
+                states[l].writer = BitWriter(out_ptr + stream * buffer_size, buffer_size);
+                cdfs[l] = cdf_ptr + stream * Lp;
+                ins[l] = in_ptr + layer * ntokens * nchannels + channel;
+            }
+            for (int64_t t = 0; t < ntokens; ++t) {
+                for (int l = 0; l < lanes; ++l) {
+                    const int sym = ins[l][t * nchannels];
+                    TORCH_CHECK(sym <= max_symbol, "CacheGen symbol ", sym, " is out of the cdf range.");
+                    encode_symbol(states[l], cdfs[l], sym, max_symbol);
+                }
+            }
+            for (int l = 0; l < lanes; ++l) {
+                encode_finish(states[l]);
+                len_ptr[first + l] = static_cast<int32_t>(states[l].writer.size());
+            }
+        }
+    });
 };
 
 void decode_cuda_new(const at::Tensor& cdf, const at::Tensor& bytestreams,
                      const at::Tensor& lengths, at::Tensor& output) {
-    // TODO:
-    PyErr_SetString(PyExc_NotImplementedError, "Please contact LMCache Ascend.");
-    throw py::error_already_set();
+    check_decode_args(cdf, bytestreams, lengths, output);
+
+    const int64_t nstreams = output.size(0) * output.size(2);
+    const at::Tensor lengths_c = lengths.contiguous();
+    const int32_t* len_ptr = lengths_c.data_ptr<int32_t>();
+    std::vector<int64_t> offsets(nstreams + 1, 0);
+    for (int64_t i = 0; i < nstreams; ++i) {
+        TORCH_CHECK(len_ptr[i] >= 0, "lengths must be non negative.");
+        offsets[i + 1] = offsets[i] + len_ptr[i];
+    }
+    decode_partitioned(cdf, bytestreams, offsets, output);
 };
 
+/*
+ * Same as decode_cuda_new, but lengths holds the inclusive prefix sum of the
+ * stream lengths, so stream i spans [lengths[i - 1], lengths[i]) of
+ * bytestreams. Streams are decoded in place out of bytestreams and straight
+ * into output.
+ */
 void decode_cuda_prefsum(const at::Tensor& cdf, const at::Tensor& bytestreams,
                          const at::Tensor& lengths, at::Tensor& output) {
-    // TODO:
-    PyErr_SetString(PyExc_NotImplementedError, "Please contact LMCache Ascend.");
-    throw py::error_already_set();
+    check_decode_args(cdf, bytestreams, lengths, output);
+
+    const int64_t nstreams = output.size(0) * output.size(2);
+    const at::Tensor lengths_c = lengths.contiguous();
+    const int32_t* prefsum_ptr = lengths_c.data_ptr<int32_t>();
+    std::vector<int64_t> offsets(nstreams + 1, 0);
+    for (int64_t i = 0; i < nstreams; ++i) {
+        TORCH_CHECK(prefsum_ptr[i] >= offsets[i], "lengths must be a non decreasing prefix sum.");
+        offsets[i + 1] = prefsum_ptr[i];
+    }
+    decode_partitioned(cdf, bytestreams, offsets, output);
 };
 
+/*
+ * Builds the per (layer, channel) cdf of the symbols in input, quantised to
+ * 16 bits the same way torchac's _renorm_cast_cdf_ does:
+ *   cdf[i] = round(P(sym < i) * (2^16 - (Lp - 1))) + i,  Lp = max_bins + 1
+ * The "+ i" keeps the cdf strictly increasing so every symbol stays codable.
+ * The histogram walks input token row by token row, so each row is read
+ * contiguously while the counters for all channels stay hot.
+ */
 at::Tensor calculate_cdf(const at::Tensor& input, const int max_bins) {
-    // TODO:
-    PyErr_SetString(PyExc_NotImplementedError, "Please contact LMCache Ascend.");
-    throw py::error_already_set();
-};
\ No newline at end of file
+    check_symbols(input, "input");
+    TORCH_CHECK(max_bins > 0 && max_bins < CDF_MAX, "max_bins must be in (0, 65536).");
+
+    const int64_t nlayers = input.size(0);
+    const int64_t ntokens = input.size(1);
+    const int64_t nchannels = input.size(2);
+    const int64_t Lp = max_bins + 1;
+
+    at::Tensor output = at::empty({nlayers, nchannels, Lp}, input.options().dtype(at::kShort));
+    const uint8_t* in_ptr = static_cast<const uint8_t*>(input.data_ptr());
+    int16_t* out_ptr = output.data_ptr<int16_t>();
+    const float factor = static_cast<float>(CDF_MAX - (Lp - 1));
+    const float total = static_cast<float>(ntokens);
+
+    at::parallel_for(0, nlayers, 1, [&](int64_t begin, int64_t end) {
+        std::vector<int32_t> counts(nchannels * max_bins);
+        for (int64_t layer = begin; layer < end; ++layer) {
+            std::fill(counts.begin(), counts.end(), 0);
+            const uint8_t* layer_in = in_ptr + layer * ntokens * nchannels;
+            for (int64_t t = 0; t < ntokens; ++t) {
+                const uint8_t* row = layer_in + t * nchannels;
+                for (int64_t c = 0; c < nchannels; ++c) {
+                    const int sym = row[c];
+                    TORCH_CHECK(sym < max_bins, "CacheGen symbol ", sym, " is out of range for max_bins ", max_bins);
+                    counts[c * max_bins + sym]++;
+                }
+            }
+            for (int64_t c = 0; c < nchannels; ++c) {
+                int16_t* cdf = out_ptr + (layer * nchannels + c) * Lp;
+                const int32_t* count = counts.data() + c * max_bins;
+                int64_t cumulative = 0;
+                for (int64_t i = 0; i < Lp; ++i) {
+                    const float prob = ntokens == 0 ? 0.f : static_cast<float>(cumulative) / total;
+                    const int32_t value = static_cast<int32_t>(std::nearbyint(prob * factor)) + static_cast<int32_t>(i);
+                    cdf[i] = static_cast<int16_t>(static_cast<uint16_t>(value));
+                    if (i < max_bins) {
+                        cumulative += count[i];
+                    }
+                }
+            }
+        }
+    });
+    return output;
+};
@@ -0,0 +1,68 @@
+#include "chunk_hash.h"
+#include <ATen/Parallel.h>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "xxh64.h"
+
+namespace {
+
+// Tokens per parallel task, below this threads cost more than they save
+constexpr int64_t MIN_TASK_TOKENS = 16384;
+
+constexpr bool BIG_ENDIAN_HOST = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+
+template <typename T>
+void hash_chunks(const T* tokens, int64_t numTokens, int64_t chunkSize, int64_t numChunks, uint64_t* out) {
+    const int64_t grain = std::max<int64_t>(1, MIN_TASK_TOKENS / chunkSize);
+    at::parallel_for(0, numChunks, grain, [&](int64_t begin, int64_t end) {
+        std::vector<int64_t> widened;
+        for (int64_t chunk = begin; chunk < end; ++chunk) {
+            const int64_t first = chunk * chunkSize;
+            const int64_t length = std::min(chunkSize, numTokens - first);
+            const void* data = tokens + first;
+            if constexpr (!std::is_same_v<T, int64_t> || BIG_ENDIAN_HOST) {
+                widened.resize(length);
+                std::transform(tokens + first, tokens + first + length, widened.begin(), [](T token) {
+                    return static_cast<int64_t>(lmc::xxh64::littleEndian64(static_cast<int64_t>(token)));
+                });
+                data = widened.data();
+            }
+            out[chunk] = lmc::xxhash64(data, length * sizeof(int64_t));
+        }
+    });
+}
+
+} // namespace
+
+torch::Tensor chunk_hashes(const torch::Tensor& tokens, int64_t chunk_size, int64_t prefix_hash,
+                           bool include_partial) {
+    TORCH_CHECK(tokens.device().is_cpu() && tokens.dim() == 1, "tokens must be a 1-D cpu tensor.");
+    TORCH_CHECK(tokens.scalar_type() == torch::kInt32 || tokens.scalar_type() == torch::kInt64,
+                "tokens must be int32 or int64.");
+    TORCH_CHECK(chunk_size > 0, "chunk_size must be positive.");
+    const torch::Tensor contiguous = tokens.contiguous();
+    const int64_t numTokens = contiguous.numel();
+    const int64_t numChunks =
+        include_partial ? (numTokens + chunk_size - 1) / chunk_size : numTokens / chunk_size;
+    torch::Tensor out = torch::empty({numChunks}, contiguous.options().dtype(torch::kInt64));
+    if (numChunks == 0) {
+        return out;
+    }
+
+    uint64_t* hashes = reinterpret_cast<uint64_t*>(out.data_ptr<int64_t>());
+    if (contiguous.scalar_type() == torch::kInt64) {
+        hash_chunks(contiguous.data_ptr<int64_t>(), numTokens, chunk_size, numChunks, hashes);
+    } else {
+        hash_chunks(contiguous.data_ptr<int32_t>(), numTokens, chunk_size, numChunks, hashes);
+    }
+
+    // Records hold little-endian words, like the tokens
+    uint64_t record[2] = {lmc::xxh64::littleEndian64(static_cast<uint64_t>(prefix_hash)), 0};
+    for (int64_t chunk = 0; chunk < numChunks; ++chunk) {
+        record[1] = lmc::xxh64::littleEndian64(hashes[chunk]);
+        hashes[chunk] = lmc::xxhash64(record, sizeof(record));
+        record[0] = lmc::xxh64::littleEndian64(hashes[chunk]);
+    }
+    return out;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <torch/torch.h>
+
+/*
+ * Chained prefix hashes of a token sequence, one per chunk of chunk_size
+ * tokens: the key of chunk i depends on every token up to the end of that
+ * chunk, so equal keys mean equal prefixes.
+ *
+ *   h[i] = XXH64(tokens of chunk i as little-endian int64)
+ *   H[i] = XXH64(H[i-1] . h[i]),  H[-1] = prefix_hash
+ *
+ * The chunk hashes are computed in parallel and only the chaining, over one
+ * 16-byte record per chunk, is sequential. Tokens are widened to int64
+ * before hashing, so int32 and int64 token tensors give the same keys. Tokens
+ * and records are hashed as little-endian words, which keeps keys equal
+ * across hosts of either byte order.
+ */
+
+// int64 tensor of the chained hashes of the chunks of tokens (1-D int32 /
+// int64, cpu). With include_partial a trailing chunk shorter than
+// chunk_size gets a key too. prefix_hash continues the chain of an earlier
+// call, e.g. the last key of the tokens preceding tokens.
+torch::Tensor chunk_hashes(const torch::Tensor& tokens, int64_t chunk_size, int64_t prefix_hash,
+                           bool include_partial);
@@ -0,0 +1,473 @@
+#include "chunk_store.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "xxh64.h"
+
+namespace lmc {
+
+namespace {
+
+constexpr char MAGIC[8] = {'L', 'M', 'C', 'S', 'T', 'O', 'R', 'E'};
+constexpr uint32_t VERSION = 1;
+
+enum SlotState : uint32_t { SLOT_FREE = 0, SLOT_WRITING = 1, SLOT_VALID = 2 };
+enum EntryState : uint32_t { ENTRY_EMPTY = 0, ENTRY_USED = 1, ENTRY_TOMBSTONE = 2 };
+
+uint64_t roundUp(uint64_t value, uint64_t align) {
+    return (value + align - 1) / align * align;
+}
+
+uint64_t nextPow2(uint64_t value) {
+    uint64_t pow2 = 1;
+    while (pow2 < value) {
+        pow2 <<= 1;
+    }
+    return pow2;
+}
+
+} // namespace
+
+struct ChunkStore::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t slotSize;
+    uint64_t numSlots;
+    uint64_t indexCapacity;
+    uint64_t metaOffset;
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+    uint64_t fileSize;
+};
+
+struct ChunkStore::SlotMeta {
+    uint64_t key;
+    uint64_t generation;
+    uint64_t checksum;
+    uint32_t length;
+    uint32_t state;
+};
+
+struct ChunkStore::IndexEntry {
+    uint64_t key;
+    uint64_t generation;
+    uint32_t slot;
+    uint32_t state;
+};
+
+struct ChunkStore::Mapping {
+    uint8_t* base;
+    size_t bytes;
+
+    Mapping(uint8_t* base, size_t bytes) : base(base), bytes(bytes) {}
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+    ~Mapping() {
+        munmap(base, bytes);
+    }
+};
+
+ChunkStore::ChunkStore(const std::string& path, int64_t slot_size, int64_t num_slots) {
+    TORCH_CHECK(slot_size >= 0 && num_slots >= 0, "slot_size and num_slots must be non-negative.");
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    TORCH_CHECK(fd >= 0, "Unable to open ", path, ": ", std::strerror(errno));
+    try {
+        struct stat st;
+        TORCH_CHECK(fstat(fd, &st) == 0, "Unable to stat ", path, ": ", std::strerror(errno));
+        if (st.st_size == 0) {
+            TORCH_CHECK(slot_size > 0 && num_slots > 0 && num_slots < (1LL << 32),
+                        "Creating a chunk store needs slot_size > 0 and 0 < num_slots < 2^32.");
+            create(fd, roundUp(slot_size, PAGE), num_slots);
+        } else {
+            Header stored;
+            TORCH_CHECK(pread(fd, &stored, sizeof(stored), 0) == static_cast<ssize_t>(sizeof(stored)) &&
+                        std::memcmp(stored.magic, MAGIC, sizeof(MAGIC)) == 0 && stored.version == VERSION,
+                        path, " is not a chunk store.");
+            TORCH_CHECK(slot_size == 0 || roundUp(slot_size, PAGE) == stored.slotSize,
+                        "slot_size does not match the store (", stored.slotSize, ").");
+            TORCH_CHECK(num_slots == 0 || static_cast<uint64_t>(num_slots) == stored.numSlots,
+                        "num_slots does not match the store (", stored.numSlots, ").");
+            checkLayout(stored, static_cast<uint64_t>(st.st_size), path);
+            // Stores created sparse may still have holes
+            allocate(fd, stored.fileSize);
+            map(fd, stored.fileSize);
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    recover();
+}
+
+ChunkStore::~ChunkStore() {
+    close();
+}
+
+void ChunkStore::create(int fd, uint64_t slotSize, uint64_t numSlots) {
+    const uint64_t indexCapacity = nextPow2(2 * numSlots);
+    const uint64_t metaOffset = PAGE;
+    const uint64_t indexOffset = metaOffset + roundUp(numSlots * sizeof(SlotMeta), PAGE);
+    const uint64_t dataOffset = indexOffset + roundUp(indexCapacity * sizeof(IndexEntry), PAGE);
+    const uint64_t fileSize = dataOffset + numSlots * slotSize;
+    try {
+        allocate(fd, fileSize);
+    } catch (...) {
+        // Left empty, the next open creates the store again
+        (void)ftruncate(fd, 0);
+        throw;
+    }
+    map(fd, fileSize);
+    Header* h = reinterpret_cast<Header*>(this->mapping->base);
+    h->version = VERSION;
+    h->slotSize = slotSize;
+    h->numSlots = numSlots;
+    h->indexCapacity = indexCapacity;
+    h->metaOffset = metaOffset;
+    h->indexOffset = indexOffset;
+    h->dataOffset = dataOffset;
+    h->fileSize = fileSize;
+    // The magic goes last: a store interrupted while being created is not
+    // mistaken for a valid one
+    std::memcpy(h->magic, MAGIC, sizeof(MAGIC));
+    msync(this->mapping->base, PAGE, MS_SYNC);
+}
+
+void ChunkStore::checkLayout(const Header& h, uint64_t fileBytes, const std::string& path) {
+    // A region [offset, offset + count * size) must start after the previous
+    // one and not overflow
+    auto regionEnd = [](uint64_t offset, uint64_t count, uint64_t size, uint64_t& end) {
+        uint64_t bytes;
+        return !__builtin_mul_overflow(count, size, &bytes) && !__builtin_add_overflow(offset, bytes, &end);
+    };
+    uint64_t metaEnd = 0;
+    uint64_t indexEnd = 0;
+    uint64_t dataEnd = 0;
+    const bool valid =
+        h.slotSize > 0 && h.slotSize % PAGE == 0 && h.numSlots > 0 && h.numSlots < (1ULL << 32) &&
+        h.indexCapacity > h.numSlots && (h.indexCapacity & (h.indexCapacity - 1)) == 0 &&
+        h.metaOffset >= sizeof(Header) && h.metaOffset % PAGE == 0 &&
+        regionEnd(h.metaOffset, h.numSlots, sizeof(SlotMeta), metaEnd) &&
+        h.indexOffset >= metaEnd && h.indexOffset % PAGE == 0 &&
+        regionEnd(h.indexOffset, h.indexCapacity, sizeof(IndexEntry), indexEnd) &&
+        h.dataOffset >= indexEnd && h.dataOffset % PAGE == 0 &&
+        regionEnd(h.dataOffset, h.numSlots, h.slotSize, dataEnd) && h.fileSize >= dataEnd;
+    TORCH_CHECK(valid, path, " has a corrupted chunk store header.");
+    TORCH_CHECK(fileBytes >= h.fileSize, path, " is truncated.");
+}
+
+void ChunkStore::allocate(int fd, uint64_t fileSize) {
+    // Returns the error instead of setting errno
+    const int err = posix_fallocate(fd, 0, static_cast<off_t>(fileSize));
+    TORCH_CHECK(err != ENOSPC, "Not enough disk space for a chunk store of ", fileSize, " bytes.");
+    TORCH_CHECK(err == 0, "Unable to allocate the chunk store: ", std::strerror(err));
+}
+
+void ChunkStore::map(int fd, uint64_t fileSize) {
+    void* base = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    TORCH_CHECK(base != MAP_FAILED, "Unable to map the chunk store: ", std::strerror(errno));
+    this->mapping = std::make_shared<Mapping>(static_cast<uint8_t*>(base), fileSize);
+    this->header = static_cast<Header*>(base);
+}
+
+void ChunkStore::recover() {
+    uint8_t* base = this->mapping->base;
+    this->slotSize = static_cast<int64_t>(this->header->slotSize);
+    this->numSlots = static_cast<int64_t>(this->header->numSlots);
+    this->indexCapacity = this->header->indexCapacity;
+    this->metas = reinterpret_cast<SlotMeta*>(base + this->header->metaOffset);
+    this->index = reinterpret_cast<IndexEntry*>(base + this->header->indexOffset);
+    this->dataBase = base + this->header->dataOffset;
+
+    this->nextGeneration = 1;
+    for (int64_t slot = 0; slot < this->numSlots; ++slot) {
+        SlotMeta& meta = this->metas[slot];
+        if (meta.state == SLOT_VALID) {
+            this->nextGeneration = std::max(this->nextGeneration, meta.generation + 1);
+        } else if (meta.state != SLOT_FREE) {
+            // Interrupted put
+            meta.state = SLOT_FREE;
+        }
+    }
+
+    // Entries whose slot moved on are dropped, valid slots missing from the
+    // index (put interrupted before the index update) are added back
+    this->usedEntries = this->tombstones = 0;
+    for (uint64_t i = 0; i < this->indexCapacity; ++i) {
+        IndexEntry& entry = this->index[i];
+        if (entry.state == ENTRY_USED && !entryValid(entry)) {
+            entry.state = ENTRY_TOMBSTONE;
+        }
+        this->usedEntries += entry.state == ENTRY_USED;
+        this->tombstones += entry.state == ENTRY_TOMBSTONE;
+    }
+    if ((this->usedEntries + this->tombstones) * 4 > this->indexCapacity * 3) {
+        rebuildIndex();
+    } else {
+        for (int64_t slot = 0; slot < this->numSlots; ++slot) {
+            if (this->metas[slot].state == SLOT_VALID) {
+                const SlotMeta& meta = this->metas[slot];
+                insertEntry(meta.key, static_cast<uint32_t>(slot), meta.generation);
+            }
+        }
+    }
+
+    this->freeSlots.clear();
+    for (int64_t slot = this->numSlots - 1; slot >= 0; --slot) {
+        if (this->metas[slot].state == SLOT_FREE) {
+            this->freeSlots.push_back(static_cast<uint32_t>(slot));
+        }
+    }
+    this->verified.assign(this->numSlots, 0);
+}
+
+void ChunkStore::rebuildIndex() {
+    std::memset(this->index, 0, this->indexCapacity * sizeof(IndexEntry));
+    this->usedEntries = this->tombstones = 0;
+    for (int64_t slot = 0; slot < this->numSlots; ++slot) {
+        if (this->metas[slot].state == SLOT_VALID) {
+            const SlotMeta& meta = this->metas[slot];
+            insertEntry(meta.key, static_cast<uint32_t>(slot), meta.generation);
+        }
+    }
+}
+
+bool ChunkStore::entryValid(const IndexEntry& entry) const {
+    if (entry.slot >= static_cast<uint64_t>(this->numSlots)) {
+        return false;
+    }
+    const SlotMeta& meta = this->metas[entry.slot];
+    return meta.state == SLOT_VALID && meta.key == entry.key && meta.generation == entry.generation;
+}
+
+ChunkStore::IndexEntry* ChunkStore::findEntry(uint64_t key) {
+    const uint64_t mask = this->indexCapacity - 1;
+    uint64_t i = xxh64::avalanche(key) & mask;
+    for (uint64_t probe = 0; probe < this->indexCapacity; ++probe, i = (i + 1) & mask) {
+        IndexEntry& entry = this->index[i];
+        if (entry.state == ENTRY_EMPTY) {
+            return nullptr;
+        }
+        if (entry.state == ENTRY_USED && entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// Points key at slot. When key already has a valid slot, the newer
+// generation wins and the other slot is freed.
+void ChunkStore::insertEntry(uint64_t key, uint32_t slot, uint64_t generation) {
+    IndexEntry* existing = findEntry(key);
+    if (existing != nullptr) {
+        if (existing->slot == slot && existing->generation == generation) {
+            return;
+        }
+        if (entryValid(*existing)) {
+            if (existing->generation > generation) {
+                freeSlot(slot);
+                return;
+            }
+            freeSlot(existing->slot);
+        }
+        existing->slot = slot;
+        existing->generation = generation;
+        return;
+    }
+
+    const uint64_t mask = this->indexCapacity - 1;
+    uint64_t i = xxh64::avalanche(key) & mask;
+    while (this->index[i].state == ENTRY_USED) {
+        i = (i + 1) & mask;
+    }
+    IndexEntry& entry = this->index[i];
+    if (entry.state == ENTRY_TOMBSTONE) {
+        --this->tombstones;
+    }
+    entry.key = key;
+    entry.slot = slot;
+    entry.generation = generation;
+    __atomic_store_n(&entry.state, static_cast<uint32_t>(ENTRY_USED), __ATOMIC_RELEASE);
+    ++this->usedEntries;
+}
+
+void ChunkStore::eraseEntry(IndexEntry* entry) {
+    entry->state = ENTRY_TOMBSTONE;
+    --this->usedEntries;
+    ++this->tombstones;
+    if ((this->usedEntries + this->tombstones) * 4 > this->indexCapacity * 3) {
+        rebuildIndex();
+    }
+}
+
+void ChunkStore::freeSlot(uint32_t slot) {
+    this->metas[slot].state = SLOT_FREE;
+    if (!this->verified.empty()) {
+        this->verified[slot] = 0;
+    }
+    this->freeSlots.push_back(slot);
+}
+
+uint8_t* ChunkStore::slotData(uint32_t slot) const {
+    return this->dataBase + static_cast<uint64_t>(slot) * this->slotSize;
+}
+
+bool ChunkStore::put(int64_t key, const torch::Tensor& data) {
+    TORCH_CHECK(data.device().is_cpu() && data.is_contiguous(), "data must be a contiguous cpu tensor.");
+    const int64_t nbytes = data.nbytes();
+    TORCH_CHECK(nbytes <= this->slotSize, "Chunk of ", nbytes, " bytes does not fit a ", this->slotSize,
+                " bytes slot.");
+    uint32_t slot;
+    uint64_t generation;
+    std::shared_ptr<Mapping> keep;
+    {
+        std::lock_guard<std::mutex> guard(this->mutex);
+        TORCH_CHECK(this->mapping != nullptr, "ChunkStore is closed.");
+        if (this->freeSlots.empty()) {
+            return false;
+        }
+        keep = this->mapping;
+        slot = this->freeSlots.back();
+        this->freeSlots.pop_back();
+        generation = this->nextGeneration++;
+        SlotMeta& meta = this->metas[slot];
+        meta.key = static_cast<uint64_t>(key);
+        meta.generation = generation;
+        __atomic_store_n(&meta.state, static_cast<uint32_t>(SLOT_WRITING), __ATOMIC_RELEASE);
+        this->verified[slot] = 0;
+    }
+
+    // The slot is owned by this call, the copy runs unlocked
+    uint8_t* dst = slotData(slot);
+    std::memcpy(dst, data.data_ptr(), nbytes);
+    const uint64_t checksum = xxhash64(dst, nbytes, generation);
+
+    std::lock_guard<std::mutex> guard(this->mutex);
+    TORCH_CHECK(this->mapping != nullptr, "ChunkStore was closed during put.");
+    SlotMeta& meta = this->metas[slot];
+    meta.length = static_cast<uint32_t>(nbytes);
+    meta.checksum = checksum;
+    __atomic_store_n(&meta.state, static_cast<uint32_t>(SLOT_VALID), __ATOMIC_RELEASE);
+    this->verified[slot] = 1;
+    insertEntry(static_cast<uint64_t>(key), slot, generation);
+    return true;
+}
+
+std::optional<torch::Tensor> ChunkStore::get(int64_t key) {
+    uint32_t slot;
+    SlotMeta meta;
+    bool verify;
+    std::shared_ptr<Mapping> keep;
+    {
+        std::lock_guard<std::mutex> guard(this->mutex);
+        TORCH_CHECK(this->mapping != nullptr, "ChunkStore is closed.");
+        const IndexEntry* entry = findEntry(static_cast<uint64_t>(key));
+        if (entry == nullptr || !entryValid(*entry)) {
+            return std::nullopt;
+        }
+        slot = entry->slot;
+        meta = this->metas[slot];
+        verify = !this->verified[slot];
+        keep = this->mapping;
+    }
+
+    uint8_t* chunk = slotData(slot);
+    if (verify) {
+        // First access since the store was opened: this pages the chunk in
+        const bool intact =
+            meta.length <= this->slotSize && xxhash64(chunk, meta.length, meta.generation) == meta.checksum;
+        std::lock_guard<std::mutex> guard(this->mutex);
+        TORCH_CHECK(this->mapping != nullptr, "ChunkStore is closed.");
+        if (this->metas[slot].generation != meta.generation || this->metas[slot].state != SLOT_VALID) {
+            return std::nullopt;
+        }
+        if (!intact) {
+            TORCH_WARN("Dropping corrupted chunk ", key, " of the chunk store.");
+            IndexEntry* entry = findEntry(static_cast<uint64_t>(key));
+            if (entry != nullptr && entry->slot == slot) {
+                eraseEntry(entry);
+            }
+            freeSlot(slot);
+            return std::nullopt;
+        }
+        this->verified[slot] = 1;
+    }
+    return torch::from_blob(chunk, {static_cast<int64_t>(meta.length)}, [keep](void*) {},
+                            torch::TensorOptions().dtype(torch::kUInt8));
+}
+
+bool ChunkStore::contains(int64_t key) {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    TORCH_CHECK(this->mapping != nullptr, "ChunkStore is closed.");
+    const IndexEntry* entry = findEntry(static_cast<uint64_t>(key));
+    return entry != nullptr && entryValid(*entry);
+}
+
+bool ChunkStore::remove(int64_t key) {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    TORCH_CHECK(this->mapping != nullptr, "ChunkStore is closed.");
+    IndexEntry* entry = findEntry(static_cast<uint64_t>(key));
+    if (entry == nullptr) {
+        return false;
+    }
+    const bool valid = entryValid(*entry);
+    if (valid) {
+        freeSlot(entry->slot);
+    }
+    eraseEntry(entry);
+    return valid;
+}
+
+std::vector<int64_t> ChunkStore::keys() {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    TORCH_CHECK(this->mapping != nullptr, "ChunkStore is closed.");
+    std::vector<int64_t> out;
+    out.reserve(this->usedEntries);
+    for (uint64_t i = 0; i < this->indexCapacity; ++i) {
+        if (this->index[i].state == ENTRY_USED && entryValid(this->index[i])) {
+            out.push_back(static_cast<int64_t>(this->index[i].key));
+        }
+    }
+    return out;
+}
+
+void ChunkStore::flush(bool sync) {
+    std::shared_ptr<Mapping> keep;
+    {
+        std::lock_guard<std::mutex> guard(this->mutex);
+        TORCH_CHECK(this->mapping != nullptr, "ChunkStore is closed.");
+        keep = this->mapping;
+    }
+    TORCH_CHECK(msync(keep->base, keep->bytes, sync ? MS_SYNC : MS_ASYNC) == 0, "msync failed: ",
+                std::strerror(errno));
+}
+
+torch::Tensor ChunkStore::data() {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    TORCH_CHECK(this->mapping != nullptr, "ChunkStore is closed.");
+    std::shared_ptr<Mapping> keep = this->mapping;
+    return torch::from_blob(this->dataBase, {this->numSlots * this->slotSize}, [keep](void*) {},
+                            torch::TensorOptions().dtype(torch::kUInt8));
+}
+
+int64_t ChunkStore::num_chunks() {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    return static_cast<int64_t>(this->usedEntries);
+}
+
+void ChunkStore::close() {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    // Unmapped once the last view is gone
+    this->mapping.reset();
+    this->header = nullptr;
+    this->metas = nullptr;
+    this->index = nullptr;
+    this->dataBase = nullptr;
+    this->freeSlots.clear();
+}
+
+} // namespace lmc
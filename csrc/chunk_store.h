@@ -0,0 +1,113 @@
+#pragma once
+#include <torch/torch.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lmc {
+
+/*
+* Persistent KV chunk store in a memory-mapped file, exposed to Python as
+* c_ops.ChunkStore. It lets a restarted worker find its host KV again
+* instead of recomputing it.
+*
+* File layout (all offsets page aligned):
+*   header | slot metadata [num_slots] | hash index | data [num_slots][slot_size]
+* The index maps 64-bit chunk keys to slots with open addressing and lives
+* in the file too: opening a store maps it as is, and chunk data is paged in
+* lazily on access. Slot data is page aligned, and data() exposes the whole
+* data region so that it can be registered once with host_register.
+*
+* The file blocks are allocated up front (posix_fallocate): a store that
+* does not fit the disk fails to create or open rather than raising SIGBUS
+* on the first write to an unbacked page of the mapping.
+*
+* There is no fsync per write. Consistency comes from the slot metadata:
+*   - a slot is marked WRITING before its data is touched and VALID, with
+*     the key, length, generation and checksum, once it is complete,
+*   - the checksum is XXH64 of the data seeded with the generation, and is
+*     verified on the first get of a slot after a restart,
+*   - index entries carry the generation of their slot and are ignored when
+*     the slot no longer matches,
+*   - on open, WRITING slots are freed, and VALID slots missing from the
+*     index are reinserted. Of two slots with one key the newer generation
+*     wins.
+* flush() msyncs when a durability point is wanted.
+*
+* get() returns a view of the mapping, valid until the key is removed or
+* overwritten. Views keep the mapping alive after close().
+*/
+class ChunkStore {
+public:
+    static constexpr uint64_t PAGE = 4096;
+
+    // Opens the store at path, or creates it when the file is missing or
+    // empty. slot_size and num_slots are required to create a store, and
+    // must be 0 or match the file otherwise.
+    ChunkStore(const std::string& path, int64_t slot_size, int64_t num_slots);
+    ~ChunkStore();
+
+    ChunkStore(const ChunkStore&) = delete;
+    ChunkStore& operator=(const ChunkStore&) = delete;
+
+    // Stores the bytes of data (contiguous cpu) under key, replacing any
+    // previous chunk. False when every slot is taken.
+    bool put(int64_t key, const torch::Tensor& data);
+    // uint8 view of the chunk, nullopt if missing or corrupted
+    std::optional<torch::Tensor> get(int64_t key);
+    bool contains(int64_t key);
+    bool remove(int64_t key);
+    std::vector<int64_t> keys();
+    // msync of the mapping, blocking when sync
+    void flush(bool sync);
+    // uint8 view of the data region (num_slots * slot_size bytes)
+    torch::Tensor data();
+
+    int64_t num_chunks();
+    int64_t num_slots() const { return numSlots; }
+    int64_t slot_size() const { return slotSize; }
+    void close();
+
+    struct Mapping;
+
+private:
+    struct Header;
+    struct SlotMeta;
+    struct IndexEntry;
+
+    void create(int fd, uint64_t slotSize, uint64_t numSlots);
+    // Checks that the regions of a stored header fit in fileBytes
+    static void checkLayout(const Header& header, uint64_t fileBytes, const std::string& path);
+    // Allocates the blocks of [0, fileSize), an error on a full disk
+    static void allocate(int fd, uint64_t fileSize);
+    void map(int fd, uint64_t fileSize);
+    // Makes index and slot metadata agree after a restart
+    void recover();
+    void rebuildIndex();
+    IndexEntry* findEntry(uint64_t key);
+    void insertEntry(uint64_t key, uint32_t slot, uint64_t generation);
+    void eraseEntry(IndexEntry* entry);
+    void freeSlot(uint32_t slot);
+    bool entryValid(const IndexEntry& entry) const;
+    uint8_t* slotData(uint32_t slot) const;
+
+    std::mutex mutex;
+    std::shared_ptr<Mapping> mapping;
+    Header* header = nullptr;
+    SlotMeta* metas = nullptr;
+    IndexEntry* index = nullptr;
+    uint8_t* dataBase = nullptr;
+    int64_t slotSize = 0;
+    int64_t numSlots = 0;
+    uint64_t indexCapacity = 0;
+    uint64_t usedEntries = 0;
+    uint64_t tombstones = 0;
+    uint64_t nextGeneration = 1;
+    std::vector<uint32_t> freeSlots;
+    // Slots whose checksum has been verified (or written) by this process
+    std::vector<uint8_t> verified;
+};
+
+} // namespace lmc
@@ -0,0 +1,465 @@
+#include "cpu_mem_kernels.h"
+#include "kv_quant.h"
+#include <ATen/Parallel.h>
+#include <ATen/cpu/vec/vec.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace cpu_ops {
+
+namespace {
+
+// Tokens are processed in tiles: the slots of a tile are read once and reused
+// for every (kv, layer), and a tile moves about TILE_BYTES per (kv, layer) so
+// the source and destination lines of one pass stay in L2.
+constexpr int64_t TILE_BYTES = 64 * 1024;
+constexpr int64_t MIN_TILE_TOKENS = 8;
+constexpr int64_t MAX_TILE_TOKENS = 256;
+// Average extent length from which a transfer is done extent by extent
+// rather than token by token
+constexpr int64_t MIN_EXTENT_TOKENS = 4;
+
+using bVec = at::vec::Vectorized<uint8_t>;
+
+// A slot must address a row of the paged buffers: a bad slot_mapping entry
+// would otherwise read or write arbitrary host memory
+inline void check_slot(int64_t slot, int64_t numSlots) {
+    TORCH_CHECK(slot < numSlots, "slot_mapping holds slot ", slot, " but the paged cache has ", numSlots,
+                " slots.");
+}
+
+template <typename slot_t>
+void check_slots(const slot_t* slots, int64_t begin, int64_t end, int64_t numSlots) {
+    for (int64_t token = begin; token < end; ++token) {
+        check_slot(static_cast<int64_t>(slots[token]), numSlots);
+    }
+}
+
+// Rows are a few KiB at most (num_heads * head_size), so an inlined vector
+// loop beats the call and size dispatch of memcpy; odd sizes fall back.
+inline void copy_row(uint8_t* dst, const uint8_t* src, int64_t bytes) {
+    if (bytes % (4 * bVec::size()) != 0) {
+        std::memcpy(dst, src, bytes);
+        return;
+    }
+    for (int64_t i = 0; i < bytes; i += 4 * bVec::size()) {
+        const bVec a = bVec::loadu(src + i);
+        const bVec b = bVec::loadu(src + i + bVec::size());
+        const bVec c = bVec::loadu(src + i + 2 * bVec::size());
+        const bVec d = bVec::loadu(src + i + 3 * bVec::size());
+        a.store(dst + i);
+        b.store(dst + i + bVec::size());
+        c.store(dst + i + 2 * bVec::size());
+        d.store(dst + i + 3 * bVec::size());
+    }
+}
+
+template <typename slot_t>
+void paged_transfer_impl(const LMCacheLayout& lmc, const std::vector<uint8_t*>& pagedBases,
+                         const slot_t* slots, int64_t numTokens, int64_t numKVs, int64_t numLayers,
+                         int64_t rowBytes, bool page2L) {
+    const int64_t tileTokens = std::clamp(TILE_BYTES / std::max<int64_t>(rowBytes, 1),
+                                          MIN_TILE_TOKENS, MAX_TILE_TOKENS);
+    const int64_t numTiles = (numTokens + tileTokens - 1) / tileTokens;
+    const int64_t numRows = numKVs * numLayers;
+
+    // Work items are (tile, kv * layer) pairs so that short chunks with many
+    // layers still spread over the whole pool.
+    at::parallel_for(0, numTiles * numRows, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t item = begin; item < end; ++item) {
+            const int64_t tile = item / numRows;
+            const int64_t row = item % numRows;
+            const int64_t kv = row / numLayers;
+            const int64_t layer = row % numLayers;
+            uint8_t* paged = pagedBases[row];
+            uint8_t* lmcRows = lmc.base + kv * lmc.kvStride + layer * lmc.layerStride;
+
+            const int64_t tokenEnd = std::min(numTokens, (tile + 1) * tileTokens);
+            for (int64_t token = tile * tileTokens; token < tokenEnd; ++token) {
+                const int64_t slot = static_cast<int64_t>(slots[token]);
+                if (slot < 0) {
+                    continue;
+                }
+                uint8_t* pagedRow = paged + slot * rowBytes;
+                uint8_t* tokenRow = lmcRows + token * lmc.tokenStride;
+                if (page2L) {
+                    copy_row(tokenRow, pagedRow, rowBytes);
+                } else {
+                    copy_row(pagedRow, tokenRow, rowBytes);
+                }
+            }
+        }
+    });
+}
+
+// Returns false, with extents partly filled, when there would be more than
+// maxExtents of them. Every slot is checked against numSlots either way.
+template <typename slot_t>
+bool slot_extents_impl(const slot_t* slots, int64_t numTokens, int64_t numSlots, int64_t maxLength,
+                       size_t maxExtents, std::vector<SlotExtent>& extents) {
+    bool complete = true;
+    for (int64_t token = 0; token < numTokens; ++token) {
+        const int64_t slot = static_cast<int64_t>(slots[token]);
+        if (slot < 0) {
+            continue;
+        }
+        check_slot(slot, numSlots);
+        if (!complete) {
+            continue;
+        }
+        if (!extents.empty()) {
+            SlotExtent& last = extents.back();
+            if (last.token + last.length == token && last.slot + last.length == slot && last.length < maxLength) {
+                ++last.length;
+                continue;
+            }
+        }
+        if (extents.size() == maxExtents) {
+            complete = false;
+            continue;
+        }
+        extents.push_back(SlotExtent{token, slot, 1});
+    }
+    return complete;
+}
+
+bool collect_slot_extents(const torch::Tensor& slotMapping, int64_t numSlots, int64_t maxLength,
+                          size_t maxExtents, std::vector<SlotExtent>& extents) {
+    TORCH_CHECK(slotMapping.device().is_cpu() && slotMapping.is_contiguous(),
+                "slot_mapping must be a contiguous cpu tensor.");
+    TORCH_CHECK(maxLength > 0, "maxLength must be greater than 0.");
+    if (slotMapping.scalar_type() == at::ScalarType::Long) {
+        return slot_extents_impl(slotMapping.data_ptr<int64_t>(), slotMapping.numel(), numSlots, maxLength,
+                                 maxExtents, extents);
+    } else if (slotMapping.scalar_type() == at::ScalarType::Int) {
+        return slot_extents_impl(slotMapping.data_ptr<int32_t>(), slotMapping.numel(), numSlots, maxLength,
+                                 maxExtents, extents);
+    }
+    TORCH_CHECK(false, "slot_mapping must be int32 or int64.");
+}
+
+// One work item per (extent, kv * layer). When LMCache rows are packed
+// (tokenStride == rowBytes) an extent is a single memcpy on both sides,
+// large enough for the library to switch to non-temporal stores.
+void extent_transfer(const LMCacheLayout& lmc, const std::vector<uint8_t*>& pagedBases,
+                     const std::vector<SlotExtent>& extents, int64_t numLayers, int64_t rowBytes,
+                     bool page2L) {
+    const int64_t numRows = static_cast<int64_t>(pagedBases.size());
+    const int64_t numExtents = static_cast<int64_t>(extents.size());
+    const bool packed = lmc.tokenStride == rowBytes;
+    at::parallel_for(0, numExtents * numRows, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t item = begin; item < end; ++item) {
+            const SlotExtent& extent = extents[item / numRows];
+            const int64_t row = item % numRows;
+            const int64_t kv = row / numLayers;
+            const int64_t layer = row % numLayers;
+            uint8_t* pagedRows = pagedBases[row] + extent.slot * rowBytes;
+            uint8_t* tokenRows = lmc.base + kv * lmc.kvStride + layer * lmc.layerStride +
+                                 extent.token * lmc.tokenStride;
+            if (packed) {
+                if (page2L) {
+                    std::memcpy(tokenRows, pagedRows, extent.length * rowBytes);
+                } else {
+                    std::memcpy(pagedRows, tokenRows, extent.length * rowBytes);
+                }
+                continue;
+            }
+            for (int64_t i = 0; i < extent.length; ++i) {
+                if (page2L) {
+                    copy_row(tokenRows + i * lmc.tokenStride, pagedRows + i * rowBytes, rowBytes);
+                } else {
+                    copy_row(pagedRows + i * rowBytes, tokenRows + i * lmc.tokenStride, rowBytes);
+                }
+            }
+        }
+    });
+}
+
+// Work items are (kv * layer, token) pairs: rows are quantized one at a
+// time, so unlike plain copies there is no gain in batching slots per tile.
+template <typename slot_t>
+void quantized_transfer_impl(const LMCacheLayout& lmc, const LMCacheLayout& scales,
+                             const std::vector<uint8_t*>& pagedBases, const slot_t* slots,
+                             int64_t numTokens, int64_t numLayers, int64_t hidden, int64_t groupSize,
+                             int64_t numSlots, at::ScalarType pagedType, at::ScalarType qType, bool page2L) {
+    check_slots(slots, 0, numTokens, numSlots);
+    const int64_t numRows = static_cast<int64_t>(pagedBases.size());
+    const int64_t pagedRowBytes = hidden * static_cast<int64_t>(c10::elementSize(pagedType));
+    const QuantizeRowFn quantize = page2L ? quantize_row_fn(pagedType, qType) : nullptr;
+    const DequantizeRowFn dequantize = page2L ? nullptr : dequantize_row_fn(qType, pagedType);
+    at::parallel_for(0, numRows * numTokens, MIN_TILE_TOKENS, [&](int64_t begin, int64_t end) {
+        for (int64_t item = begin; item < end; ++item) {
+            const int64_t row = item / numTokens;
+            const int64_t token = item % numTokens;
+            const int64_t slot = static_cast<int64_t>(slots[token]);
+            if (slot < 0) {
+                continue;
+            }
+            const int64_t kv = row / numLayers;
+            const int64_t layer = row % numLayers;
+            uint8_t* pagedRow = pagedBases[row] + slot * pagedRowBytes;
+            uint8_t* tokenRow = lmc.base + kv * lmc.kvStride + layer * lmc.layerStride + token * lmc.tokenStride;
+            float* scaleRow = reinterpret_cast<float*>(scales.base + kv * scales.kvStride +
+                                                       layer * scales.layerStride + token * scales.tokenStride);
+            if (page2L) {
+                quantize(pagedRow, tokenRow, scaleRow, hidden, groupSize);
+            } else {
+                dequantize(tokenRow, scaleRow, pagedRow, hidden, groupSize);
+            }
+        }
+    });
+}
+
+// Work items are (segment, kv) pairs, a segment is a chunk of a few hundred
+// tokens so there are enough of them to spread over the pool.
+template <typename slot_t>
+void segmented_transfer_impl(const std::vector<LMCacheLayout>& segments, const std::vector<uint8_t*>& pagedBases,
+                             const slot_t* slots, const std::vector<int64_t>& starts,
+                             const std::vector<int64_t>& ends, int64_t numSlots, int64_t rowBytes, bool page2L) {
+    for (size_t segment = 0; segment < segments.size(); ++segment) {
+        check_slots(slots, starts[segment], ends[segment], numSlots);
+    }
+    const int64_t numKVs = static_cast<int64_t>(pagedBases.size());
+    const int64_t numItems = static_cast<int64_t>(segments.size()) * numKVs;
+    at::parallel_for(0, numItems, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t item = begin; item < end; ++item) {
+            const int64_t segment = item / numKVs;
+            const int64_t kv = item % numKVs;
+            const LMCacheLayout& lmc = segments[segment];
+            uint8_t* lmcRows = lmc.base + kv * lmc.kvStride;
+            for (int64_t token = starts[segment]; token < ends[segment]; ++token) {
+                const int64_t slot = static_cast<int64_t>(slots[token]);
+                if (slot < 0) {
+                    continue;
+                }
+                uint8_t* pagedRow = pagedBases[kv] + slot * rowBytes;
+                uint8_t* tokenRow = lmcRows + (token - starts[segment]) * lmc.tokenStride;
+                if (page2L) {
+                    copy_row(tokenRow, pagedRow, rowBytes);
+                } else {
+                    copy_row(pagedRow, tokenRow, rowBytes);
+                }
+            }
+        }
+    });
+}
+
+// Slots of a [num_blocks, block_size, ...] paged cache (and of value_cache,
+// which must have its shape), after checking that its rows are row_bytes
+// wide like the LMCache rows
+int64_t paged_slots(const torch::Tensor& key_cache, const torch::Tensor* value_cache, int64_t row_bytes) {
+    TORCH_CHECK(key_cache.dim() >= 2, "The paged caches must be [num_blocks, block_size, ...].");
+    TORCH_CHECK(value_cache == nullptr ||
+                    (value_cache->sizes() == key_cache.sizes() && value_cache->nbytes() == key_cache.nbytes()),
+                "The key and value caches must have the same shape and dtype size.");
+    const int64_t num_slots = key_cache.size(0) * key_cache.size(1);
+    TORCH_CHECK(num_slots > 0 && key_cache.nbytes() == num_slots * row_bytes,
+                "The paged cache rows must have the size of the LMCache rows (", row_bytes, " bytes).");
+    return num_slots;
+}
+
+std::vector<uint8_t*> read_ptr_table(const torch::Tensor& ptrs) {
+    const torch::Tensor table = ptrs.to(torch::kLong).contiguous();
+    const int64_t* data = table.data_ptr<int64_t>();
+    std::vector<uint8_t*> result(table.numel());
+    for (int64_t i = 0; i < table.numel(); ++i) {
+        result[i] = reinterpret_cast<uint8_t*>(data[i]);
+    }
+    return result;
+}
+
+} // namespace
+
+void paged_transfer(const LMCacheLayout& lmc, const std::vector<uint8_t*>& pagedBases,
+                    const torch::Tensor& slotMapping, int64_t numKVs, int64_t numLayers, int64_t numSlots,
+                    int64_t rowBytes, bool page2L) {
+    TORCH_CHECK(slotMapping.device().is_cpu() && slotMapping.is_contiguous(),
+                "slot_mapping must be a contiguous cpu tensor.");
+    TORCH_CHECK(static_cast<int64_t>(pagedBases.size()) == numKVs * numLayers,
+                "Expected one paged buffer per kv and layer.");
+    const int64_t numTokens = slotMapping.numel();
+    if (numTokens == 0) {
+        return;
+    }
+    // Extents are capped at a tile so that a chunk that is one long run
+    // still splits into enough work items. The slot mapping changes with
+    // every call, so they are collected each time, but the collection stops
+    // once runs are too short on average to pay off: a fragmented mapping
+    // costs numTokens / MIN_EXTENT_TOKENS extents at most. The same scan
+    // bounds checks every slot before anything is copied.
+    const int64_t tileTokens = std::clamp(TILE_BYTES / std::max<int64_t>(rowBytes, 1),
+                                          MIN_TILE_TOKENS, MAX_TILE_TOKENS);
+    const size_t maxExtents = static_cast<size_t>(numTokens / MIN_EXTENT_TOKENS);
+    std::vector<SlotExtent> extents;
+    extents.reserve(std::min<size_t>(maxExtents, 64));
+    if (collect_slot_extents(slotMapping, numSlots, tileTokens, maxExtents, extents)) {
+        extent_transfer(lmc, pagedBases, extents, numLayers, rowBytes, page2L);
+        return;
+    }
+    if (slotMapping.scalar_type() == at::ScalarType::Long) {
+        paged_transfer_impl(lmc, pagedBases, slotMapping.data_ptr<int64_t>(), numTokens,
+                            numKVs, numLayers, rowBytes, page2L);
+    } else if (slotMapping.scalar_type() == at::ScalarType::Int) {
+        paged_transfer_impl(lmc, pagedBases, slotMapping.data_ptr<int32_t>(), numTokens,
+                            numKVs, numLayers, rowBytes, page2L);
+    } else {
+        TORCH_CHECK(false, "slot_mapping must be int32 or int64.");
+    }
+}
+
+void quantized_paged_transfer(const LMCacheLayout& lmc, const LMCacheLayout& scales,
+                              const std::vector<uint8_t*>& pagedBases, const torch::Tensor& slotMapping,
+                              int64_t numLayers, int64_t numSlots, int64_t hidden, int64_t groupSize,
+                              at::ScalarType pagedType, at::ScalarType qType, bool page2L) {
+    TORCH_CHECK(slotMapping.device().is_cpu() && slotMapping.is_contiguous(),
+                "slot_mapping must be a contiguous cpu tensor.");
+    TORCH_CHECK(groupSize > 0 && hidden % groupSize == 0, "The hidden size must be a multiple of the group size.");
+    const int64_t numTokens = slotMapping.numel();
+    if (numTokens == 0) {
+        return;
+    }
+    if (slotMapping.scalar_type() == at::ScalarType::Long) {
+        quantized_transfer_impl(lmc, scales, pagedBases, slotMapping.data_ptr<int64_t>(), numTokens, numLayers,
+                                hidden, groupSize, numSlots, pagedType, qType, page2L);
+    } else if (slotMapping.scalar_type() == at::ScalarType::Int) {
+        quantized_transfer_impl(lmc, scales, pagedBases, slotMapping.data_ptr<int32_t>(), numTokens, numLayers,
+                                hidden, groupSize, numSlots, pagedType, qType, page2L);
+    } else {
+        TORCH_CHECK(false, "slot_mapping must be int32 or int64.");
+    }
+}
+
+std::vector<SlotExtent> slot_extents(const torch::Tensor& slotMapping, int64_t maxLength) {
+    std::vector<SlotExtent> extents;
+    collect_slot_extents(slotMapping, std::numeric_limits<int64_t>::max(), maxLength,
+                         std::numeric_limits<size_t>::max(), extents);
+    return extents;
+}
+
+void multi_layer_kv_transfer(torch::Tensor& key_value, const torch::Tensor& key_value_ptrs,
+                             const torch::Tensor& slot_mapping, const int page_buffer_size,
+                             const bool direction, const bool use_mla) {
+    const int64_t kv_size = use_mla ? 1 : 2;
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == kv_size,
+                "key_value must be [kv, num_layers, num_tokens, hidden].");
+    TORCH_CHECK(key_value.stride(-1) == 1, "key_value must be contiguous along hidden.");
+    const int64_t num_layers = key_value.size(1);
+    const int64_t elem = key_value.element_size();
+    const int64_t row_bytes = key_value.size(-1) * elem;
+    TORCH_CHECK(page_buffer_size > 0, "page_buffer_size must be greater than 0.");
+
+    const std::vector<uint8_t*> layers = read_ptr_table(key_value_ptrs);
+    TORCH_CHECK(static_cast<int64_t>(layers.size()) == num_layers, "key_value_ptrs must hold one pointer per layer.");
+    std::vector<uint8_t*> paged_bases(kv_size * num_layers);
+    for (int64_t kv = 0; kv < kv_size; ++kv) {
+        for (int64_t layer = 0; layer < num_layers; ++layer) {
+            paged_bases[kv * num_layers + layer] = layers[layer] + kv * page_buffer_size * row_bytes;
+        }
+    }
+    LMCacheLayout lmc{static_cast<uint8_t*>(key_value.data_ptr()), key_value.stride(0) * elem,
+                      key_value.stride(1) * elem, key_value.stride(2) * elem};
+    paged_transfer(lmc, paged_bases, slot_mapping.contiguous(), kv_size, num_layers, page_buffer_size, row_bytes,
+                   direction);
+}
+
+void multi_layer_kv_transfer_unilateral(torch::Tensor& key_value, const torch::Tensor& key_ptrs,
+                                        const torch::Tensor& value_ptrs, const torch::Tensor& slot_mapping,
+                                        const int page_buffer_size, const bool direction) {
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == 2,
+                "key_value must be [2, num_layers, num_tokens, hidden].");
+    TORCH_CHECK(key_value.stride(-1) == 1, "key_value must be contiguous along hidden.");
+    const int64_t num_layers = key_value.size(1);
+    const int64_t elem = key_value.element_size();
+    const int64_t row_bytes = key_value.size(-1) * elem;
+
+    std::vector<uint8_t*> paged_bases = read_ptr_table(key_ptrs);
+    const std::vector<uint8_t*> value_bases = read_ptr_table(value_ptrs);
+    TORCH_CHECK(static_cast<int64_t>(paged_bases.size()) == num_layers &&
+                static_cast<int64_t>(value_bases.size()) == num_layers,
+                "key_ptrs and value_ptrs must hold one pointer per layer.");
+    paged_bases.insert(paged_bases.end(), value_bases.begin(), value_bases.end());
+
+    LMCacheLayout lmc{static_cast<uint8_t*>(key_value.data_ptr()), key_value.stride(0) * elem,
+                      key_value.stride(1) * elem, key_value.stride(2) * elem};
+    TORCH_CHECK(page_buffer_size > 0, "page_buffer_size must be greater than 0.");
+    paged_transfer(lmc, paged_bases, slot_mapping.contiguous(), 2, num_layers, page_buffer_size, row_bytes,
+                   direction);
+}
+
+void single_layer_kv_transfer(torch::Tensor& lmc_key_value_cache, torch::Tensor& vllm_key_cache,
+                              torch::Tensor& vllm_value_cache, const torch::Tensor& slot_mapping,
+                              const bool direction, const bool token_major, const bool use_mla) {
+    // token_major: [num_tokens, kv, hidden], otherwise [kv, num_tokens, hidden]
+    const int kv_dim = token_major ? 1 : 0;
+    const int token_dim = token_major ? 0 : 1;
+    const int64_t kvs = use_mla ? 1 : 2;
+    TORCH_CHECK(lmc_key_value_cache.dim() == 3 && lmc_key_value_cache.size(kv_dim) == kvs,
+                "lmc_key_value_cache must be 3 dimensional with a kv dimension of ", kvs, ".");
+    TORCH_CHECK(lmc_key_value_cache.stride(-1) == 1, "lmc_key_value_cache must be contiguous along hidden.");
+    TORCH_CHECK(vllm_key_cache.is_contiguous() && (use_mla || vllm_value_cache.is_contiguous()),
+                "The paged caches must be contiguous.");
+    const int64_t elem = lmc_key_value_cache.element_size();
+    const int64_t row_bytes = lmc_key_value_cache.size(-1) * elem;
+    const int64_t num_slots = paged_slots(vllm_key_cache, use_mla ? nullptr : &vllm_value_cache, row_bytes);
+
+    LMCacheLayout lmc{static_cast<uint8_t*>(lmc_key_value_cache.data_ptr()),
+                      lmc_key_value_cache.stride(kv_dim) * elem, 0,
+                      lmc_key_value_cache.stride(token_dim) * elem};
+    std::vector<uint8_t*> paged_bases{static_cast<uint8_t*>(vllm_key_cache.data_ptr())};
+    if (!use_mla) {
+        paged_bases.push_back(static_cast<uint8_t*>(vllm_value_cache.data_ptr()));
+    }
+    paged_transfer(lmc, paged_bases, slot_mapping.contiguous(), kvs, 1, num_slots, row_bytes, direction);
+}
+
+void segmented_layer_transfer(const std::vector<torch::Tensor>& lmcCaches,
+                              const std::vector<uint8_t*>& pagedBases, const torch::Tensor& slotMapping,
+                              const std::vector<int64_t>& starts, const std::vector<int64_t>& ends,
+                              int64_t numSlots, int64_t rowBytes, bool page2L, bool tokenMajor) {
+    TORCH_CHECK(slotMapping.device().is_cpu() && slotMapping.is_contiguous(),
+                "slot_mapping must be a contiguous cpu tensor.");
+    std::vector<LMCacheLayout> segments;
+    segments.reserve(lmcCaches.size());
+    const int kvDim = tokenMajor ? 1 : 0;
+    const int tokenDim = tokenMajor ? 0 : 1;
+    for (const torch::Tensor& cache : lmcCaches) {
+        const int64_t elem = cache.element_size();
+        segments.push_back(LMCacheLayout{static_cast<uint8_t*>(cache.data_ptr()), cache.stride(kvDim) * elem, 0,
+                                         cache.stride(tokenDim) * elem});
+    }
+    if (slotMapping.scalar_type() == at::ScalarType::Long) {
+        segmented_transfer_impl(segments, pagedBases, slotMapping.data_ptr<int64_t>(), starts, ends, numSlots,
+                                rowBytes, page2L);
+    } else if (slotMapping.scalar_type() == at::ScalarType::Int) {
+        segmented_transfer_impl(segments, pagedBases, slotMapping.data_ptr<int32_t>(), starts, ends, numSlots,
+                                rowBytes, page2L);
+    } else {
+        TORCH_CHECK(false, "slot_mapping must be int32 or int64.");
+    }
+}
+
+void flash_layer_transfer(torch::Tensor& key_value, torch::Tensor& key_cache,
+                          torch::Tensor& value_cache, const torch::Tensor& slot_mapping,
+                          const int layer_idx, const bool page2L, const bool use_mla) {
+    const int64_t kvs = use_mla ? 1 : 2;
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == kvs,
+                "key_value must be [", kvs, ", num_layers, num_tokens, hidden].");
+    TORCH_CHECK(key_value.stride(-1) == 1, "key_value must be contiguous along hidden.");
+    TORCH_CHECK(layer_idx >= 0 && layer_idx < key_value.size(1), "layer_idx out of range.");
+    TORCH_CHECK(key_cache.is_contiguous() && (use_mla || value_cache.is_contiguous()),
+                "The paged caches must be contiguous.");
+    const int64_t elem = key_value.element_size();
+    const int64_t row_bytes = key_value.size(-1) * elem;
+    const int64_t num_slots = paged_slots(key_cache, use_mla ? nullptr : &value_cache, row_bytes);
+
+    LMCacheLayout lmc{static_cast<uint8_t*>(key_value.data_ptr()) + layer_idx * key_value.stride(1) * elem,
+                      key_value.stride(0) * elem, 0, key_value.stride(2) * elem};
+    std::vector<uint8_t*> paged_bases{static_cast<uint8_t*>(key_cache.data_ptr())};
+    if (!use_mla) {
+        paged_bases.push_back(static_cast<uint8_t*>(value_cache.data_ptr()));
+    }
+    paged_transfer(lmc, paged_bases, slot_mapping.contiguous(), kvs, 1, num_slots, row_bytes, page2L);
+}
+
+} // namespace cpu_ops
@@ -0,0 +1,88 @@
+#pragma once
+#include <torch/torch.h>
+#include <vector>
+
+/*
+ * Host backend of the KV transfer ops.
+ *
+ * Used when the paged memory lives in host memory (cpu-only serving, or
+ * profiling layouts without hardware), and as the reference for the AscendC
+ * kernels: for every valid slot the same bytes are moved, so the results are
+ * bit-identical to the device path. Slots < 0 (vLLM padding) are skipped.
+ *
+ * Argument conventions are those of the ops in mem_kernels.h.
+ */
+namespace cpu_ops {
+
+// Byte layout of the LMCache side of a transfer. Row (kv, layer, token)
+// starts at base + kv * kvStride + layer * layerStride + token * tokenStride.
+struct LMCacheLayout {
+    uint8_t* base;
+    int64_t kvStride;
+    int64_t layerStride;
+    int64_t tokenStride;
+};
+
+// Run of length tokens, starting at token, whose slots are consecutive
+// starting at slot: a single block copy on both sides of the transfer.
+struct SlotExtent {
+    int64_t token;
+    int64_t slot;
+    int64_t length;
+};
+
+// Collapses a (contiguous cpu, int32 / int64) slot mapping into extents of
+// at most maxLength tokens, skipping slots < 0. vLLM allocates whole blocks,
+// so a chunk usually maps to a handful of extents. Host backend only: the
+// AscendC kernels still move one token per slot.
+std::vector<SlotExtent> slot_extents(const torch::Tensor& slotMapping, int64_t maxLength);
+
+// Gathers (page2L = true) or scatters (page2L = false) rowBytes wide rows
+// between the LMCache layout and paged buffers. pagedBases holds one row 0
+// pointer per (kv, layer), indexed kv * numLayers + layer, and the paged row
+// of a token is pagedBases[...] + slot * rowBytes. Each paged buffer holds
+// numSlots rows: a slot past them is an error, raised before any copy.
+void paged_transfer(const LMCacheLayout& lmc, const std::vector<uint8_t*>& pagedBases,
+                    const torch::Tensor& slotMapping, int64_t numKVs, int64_t numLayers, int64_t numSlots,
+                    int64_t rowBytes, bool page2L);
+
+// paged_transfer with the LMCache side in the 8-bit format of kv_quant.h:
+// rows are quantized on offload (page2L) and dequantized on load. lmc
+// addresses the qType rows, scales the float32 rows of hidden / groupSize
+// scales, and pagedType is the dtype of the paged caches.
+void quantized_paged_transfer(const LMCacheLayout& lmc, const LMCacheLayout& scales,
+                              const std::vector<uint8_t*>& pagedBases, const torch::Tensor& slotMapping,
+                              int64_t numLayers, int64_t numSlots, int64_t hidden, int64_t groupSize,
+                              at::ScalarType pagedType, at::ScalarType qType, bool page2L);
+
+// The paged layers behind raw pointers hold page_buffer_size slots each,
+// their row size cannot be checked
+void multi_layer_kv_transfer(torch::Tensor& key_value, const torch::Tensor& key_value_ptrs,
+                             const torch::Tensor& slot_mapping, const int page_buffer_size,
+                             const bool direction, const bool use_mla);
+
+void multi_layer_kv_transfer_unilateral(torch::Tensor& key_value, const torch::Tensor& key_ptrs,
+                                        const torch::Tensor& value_ptrs, const torch::Tensor& slot_mapping,
+                                        const int page_buffer_size, const bool direction);
+
+// With use_mla, vllm_value_cache is ignored and the kv dimension of
+// lmc_key_value_cache is 1 (the latent cache of the layer)
+void single_layer_kv_transfer(torch::Tensor& lmc_key_value_cache, torch::Tensor& vllm_key_cache,
+                              torch::Tensor& vllm_value_cache, const torch::Tensor& slot_mapping,
+                              const bool direction, const bool token_major, const bool use_mla);
+
+// Segment i moves the tokens [starts[i], ends[i]) of slotMapping between
+// lmcCaches[i] ([n, kv, hidden] if tokenMajor, else [kv, n, hidden]) and the
+// paged rows at pagedBases[kv] (K and V, or the MLA latent cache alone), all
+// segments in one parallel pass.
+void segmented_layer_transfer(const std::vector<torch::Tensor>& lmcCaches,
+                              const std::vector<uint8_t*>& pagedBases, const torch::Tensor& slotMapping,
+                              const std::vector<int64_t>& starts, const std::vector<int64_t>& ends,
+                              int64_t numSlots, int64_t rowBytes, bool page2L, bool tokenMajor);
+
+// load_and_reshape_flash (page2L = true) / reshape_and_cache_back_flash (false)
+void flash_layer_transfer(torch::Tensor& key_value, torch::Tensor& key_cache,
+                          torch::Tensor& value_cache, const torch::Tensor& slot_mapping,
+                          const int layer_idx, const bool page2L, const bool use_mla);
+
+} // namespace cpu_ops
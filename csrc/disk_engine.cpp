@@ -0,0 +1,197 @@
+#include "disk_engine.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <limits>
+
+namespace lmc {
+
+DiskEngine::DiskEngine(const std::string& path, const std::vector<torch::Tensor>& buffers, int64_t queue_depth,
+                       bool direct, int64_t size)
+    : queueDepth(queue_depth), buffers(buffers) {
+    TORCH_CHECK(queue_depth > 0 && queue_depth <= 4096, "queue_depth must be in [1, 4096].");
+    // Arguments are checked before the file is opened: the destructor does
+    // not run when the constructor throws
+    for (const torch::Tensor& buffer : this->buffers) {
+        TORCH_CHECK(buffer.device().is_cpu() && buffer.is_contiguous(), "Fixed buffers must be contiguous cpu tensors.");
+        uint8_t* base = static_cast<uint8_t*>(buffer.data_ptr());
+        const int64_t nbytes = buffer.nbytes();
+        for (int64_t offset = 0; offset < nbytes; offset += MAX_FIXED_BUFFER) {
+            this->fixedBuffers.push_back(
+                iovec{base + offset, static_cast<size_t>(std::min(MAX_FIXED_BUFFER, nbytes - offset))});
+        }
+    }
+    if (direct) {
+        this->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_DIRECT | O_CLOEXEC, 0644);
+        // tmpfs and some network filesystems have no O_DIRECT
+        this->isDirect = this->fd >= 0;
+    }
+    if (this->fd < 0) {
+        this->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    }
+    TORCH_CHECK(this->fd >= 0, "Unable to open ", path, ": ", std::strerror(errno));
+
+    struct stat st;
+    if (size > 0 && fstat(this->fd, &st) == 0 && st.st_size < size) {
+        if (fallocate(this->fd, 0, 0, size) != 0 && ftruncate(this->fd, size) != 0) {
+            const int err = errno;
+            ::close(this->fd);
+            TORCH_CHECK(false, "Unable to resize ", path, ": ", std::strerror(err));
+        }
+    }
+
+    int err = this->ring.setup(static_cast<unsigned>(queue_depth));
+    if (err == 0) {
+        err = this->ring.registerFile(this->fd);
+    }
+    if (err != 0) {
+        ::close(this->fd);
+        TORCH_CHECK(false, "io_uring setup failed: ", std::strerror(-err));
+    }
+    this->queueDepth = std::min<int64_t>(queue_depth, this->ring.sqEntries());
+
+    if (!this->fixedBuffers.empty()) {
+        err = this->ring.registerBuffers(this->fixedBuffers);
+        if (err != 0) {
+            // Usually RLIMIT_MEMLOCK: requests still work, page pinning then
+            // happens per request
+            TORCH_WARN("io_uring buffer registration failed (", std::strerror(-err),
+                       "), falling back to unregistered I/O.");
+            this->fixedBuffers.clear();
+        }
+    }
+}
+
+DiskEngine::~DiskEngine() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+int64_t DiskEngine::submit_write(const torch::Tensor& src, int64_t file_offset) {
+    return submit(true, src, file_offset);
+}
+
+int64_t DiskEngine::submit_read(const torch::Tensor& dst, int64_t file_offset) {
+    return submit(false, dst, file_offset);
+}
+
+int64_t DiskEngine::submit(bool write, const torch::Tensor& tensor, int64_t file_offset) {
+    TORCH_CHECK(tensor.device().is_cpu() && tensor.is_contiguous(), "DiskEngine needs contiguous cpu tensors.");
+    const int64_t nbytes = tensor.nbytes();
+    TORCH_CHECK(nbytes > 0 && nbytes <= std::numeric_limits<int32_t>::max(),
+                "A request must move between 1 byte and 2 GiB.");
+    TORCH_CHECK(file_offset >= 0, "file_offset must be non-negative.");
+    uint8_t* addr = static_cast<uint8_t*>(tensor.data_ptr());
+    const int64_t align = alignment();
+    TORCH_CHECK(reinterpret_cast<uintptr_t>(addr) % align == 0 && nbytes % align == 0 && file_offset % align == 0,
+                "O_DIRECT needs the address, size and file offset aligned to ", align, " bytes.");
+
+    std::lock_guard<std::mutex> guard(this->mutex);
+    TORCH_CHECK(this->fd >= 0, "DiskEngine is closed.");
+    const uint64_t id = this->nextId++;
+    const Request request{write, addr, static_cast<uint32_t>(nbytes), static_cast<uint64_t>(file_offset), id};
+    this->pending.emplace(id, Pending{tensor, request, 0});
+    this->backlog.push_back(request);
+    fillRing();
+    return static_cast<int64_t>(id);
+}
+
+int DiskEngine::fixedBufferOf(const uint8_t* addr, uint32_t len) const {
+    for (size_t i = 0; i < this->fixedBuffers.size(); ++i) {
+        const uint8_t* base = static_cast<const uint8_t*>(this->fixedBuffers[i].iov_base);
+        if (addr >= base && addr + len <= base + this->fixedBuffers[i].iov_len) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void DiskEngine::fillRing() {
+    bool prepared = false;
+    while (!this->backlog.empty() && this->inRing < this->queueDepth) {
+        const Request& request = this->backlog.front();
+        if (!this->ring.prepare(request.write, fixedBufferOf(request.addr, request.len), request.addr, request.len,
+                                request.offset, request.id)) {
+            break;
+        }
+        this->backlog.pop_front();
+        ++this->inRing;
+        prepared = true;
+    }
+    if (prepared) {
+        const int err = this->ring.submit(0);
+        TORCH_CHECK(err == 0 || err == -EAGAIN || err == -EBUSY, "io_uring submit failed: ", std::strerror(-err));
+    }
+}
+
+void DiskEngine::reap(std::vector<std::tuple<int64_t, int64_t>>& out, int64_t min) {
+    std::vector<IoRing::Completion> completions;
+    while (true) {
+        completions.clear();
+        this->ring.reap(completions);
+        for (const IoRing::Completion& completion : completions) {
+            --this->inRing;
+            auto it = this->pending.find(completion.userData);
+            Request& remainder = it->second.remainder;
+            int64_t result = completion.result;
+            if (result > 0 && result < remainder.len) {
+                // Short transfer (signal, buffered I/O, end of file): the rest
+                // goes first in the backlog
+                it->second.moved += result;
+                remainder.addr += result;
+                remainder.len -= static_cast<uint32_t>(result);
+                remainder.offset += static_cast<uint64_t>(result);
+                this->backlog.push_front(remainder);
+                continue;
+            }
+            if (result == 0) {
+                // No progress: a read at the end of the file
+                result = remainder.write ? -EIO : -ENODATA;
+            } else if (result > 0) {
+                result += it->second.moved;
+            }
+            out.emplace_back(static_cast<int64_t>(completion.userData), result);
+            this->pending.erase(it);
+        }
+        fillRing();
+        if (static_cast<int64_t>(out.size()) >= min || this->inRing == 0) {
+            return;
+        }
+        const int err = this->ring.submit(1);
+        TORCH_CHECK(err == 0 || err == -EAGAIN || err == -EBUSY, "io_uring wait failed: ", std::strerror(-err));
+    }
+}
+
+std::vector<std::tuple<int64_t, int64_t>> DiskEngine::poll(int64_t min_completions) {
+    std::vector<std::tuple<int64_t, int64_t>> out;
+    std::lock_guard<std::mutex> guard(this->mutex);
+    if (this->fd >= 0) {
+        reap(out, min_completions);
+    }
+    return out;
+}
+
+int64_t DiskEngine::inflight() {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    return static_cast<int64_t>(this->pending.size());
+}
+
+void DiskEngine::close() {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    if (this->fd < 0) {
+        return;
+    }
+    // The kernel may still be writing into or reading from the tensors
+    std::vector<std::tuple<int64_t, int64_t>> drained;
+    while (this->inRing > 0 || !this->backlog.empty()) {
+        reap(drained, std::numeric_limits<int64_t>::max());
+    }
+    this->pending.clear();
+    this->ring.close();
+    ::close(this->fd);
+    this->fd = -1;
+}
+
+} // namespace lmc
@@ -0,0 +1,106 @@
+#pragma once
+#include <torch/torch.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "io_ring.h"
+
+namespace lmc {
+
+/*
+* Asynchronous file I/O between a local disk file and host tensors, exposed
+* to Python as c_ops.DiskEngine.
+*
+* Requests go through io_uring with the file opened O_DIRECT, so chunks move
+* between NVMe and (registered, pinned) host memory without a page cache
+* copy and without the GIL. The buffers given at construction are registered
+* as io_uring fixed buffers: requests on views of them skip the per request
+* page pinning of the kernel. Other tensors work too, through the plain
+* read / write opcodes.
+*
+* At most queue_depth requests are in the ring; later submissions wait in a
+* backlog that is drained as completions are polled. Completions are
+* (request id, bytes moved or -errno) pairs, the tensor of a request is kept
+* alive until its completion has been polled. A short transfer is resubmitted
+* for its remainder, so a request completes with all of its bytes or an
+* error; a read that reaches the end of the file fails with -ENODATA.
+*
+* With O_DIRECT, tensor addresses, sizes and file offsets must be multiples
+* of alignment(). Filesystems without O_DIRECT (tmpfs) fall back to buffered
+* I/O, see direct().
+*/
+class DiskEngine {
+public:
+    static constexpr int64_t DIRECT_ALIGNMENT = 4096;
+    // Kernel limit on the size of one fixed buffer
+    static constexpr int64_t MAX_FIXED_BUFFER = 1LL << 30;
+
+    // -buffers: host tensors registered as fixed buffers, typically the
+    //  pinned pool of the memory allocator
+    // -size: preallocated file size in bytes, 0 to keep the file as is
+    DiskEngine(const std::string& path, const std::vector<torch::Tensor>& buffers, int64_t queue_depth,
+               bool direct, int64_t size);
+    ~DiskEngine();
+
+    DiskEngine(const DiskEngine&) = delete;
+    DiskEngine& operator=(const DiskEngine&) = delete;
+
+    // Request id of writing src (contiguous cpu) at file_offset
+    int64_t submit_write(const torch::Tensor& src, int64_t file_offset);
+    // Request id of reading dst.nbytes() bytes at file_offset into dst
+    int64_t submit_read(const torch::Tensor& dst, int64_t file_offset);
+    // Completions so far, waiting until at least min_completions are
+    // available or nothing is in flight
+    std::vector<std::tuple<int64_t, int64_t>> poll(int64_t min_completions);
+
+    // Requests submitted and not polled yet
+    int64_t inflight();
+    bool direct() const { return isDirect; }
+    int64_t alignment() const { return isDirect ? DIRECT_ALIGNMENT : 1; }
+    int64_t queue_depth() const { return queueDepth; }
+    // Waits for the requests in flight and closes the file
+    void close();
+
+private:
+    struct Request {
+        bool write;
+        uint8_t* addr;
+        uint32_t len;
+        uint64_t offset;
+        uint64_t id;
+    };
+
+    struct Pending {
+        torch::Tensor tensor;
+        // What is left to move, and the bytes moved by earlier short transfers
+        Request remainder;
+        int64_t moved;
+    };
+
+    int64_t submit(bool write, const torch::Tensor& tensor, int64_t file_offset);
+    // Index of the fixed buffer holding [addr, addr + len), -1 if none
+    int fixedBufferOf(const uint8_t* addr, uint32_t len) const;
+    // Moves backlog requests into the ring and submits them
+    void fillRing();
+    // Reaps into out, waiting for min completions in the ring
+    void reap(std::vector<std::tuple<int64_t, int64_t>>& out, int64_t min);
+
+    std::mutex mutex;
+    IoRing ring;
+    int fd = -1;
+    bool isDirect = false;
+    int64_t queueDepth;
+    // Fixed buffers, split at MAX_FIXED_BUFFER
+    std::vector<torch::Tensor> buffers;
+    std::vector<iovec> fixedBuffers;
+    std::deque<Request> backlog;
+    int64_t inRing = 0;
+    uint64_t nextId = 0;
+    // Unpolled requests
+    std::unordered_map<uint64_t, Pending> pending;
+};
+
+} // namespace lmc
@@ -0,0 +1,351 @@
+#include "eviction.h"
+#include <algorithm>
+#include <mutex>
+
+namespace lmc {
+
+namespace {
+
+// Hits remembered per chunk: a chunk in main survives at most this many
+// passes of the clock hand without a new hit
+constexpr uint8_t MAX_FREQ = 3;
+
+} // namespace
+
+EvictionEngine::EvictionEngine(int64_t capacity, double small_ratio)
+    : capacityBytes(capacity), smallTarget(static_cast<int64_t>(static_cast<double>(capacity) * small_ratio)) {
+    TORCH_CHECK(capacity > 0, "capacity must be positive.");
+    TORCH_CHECK(small_ratio > 0 && small_ratio < 1, "small_ratio must be in (0, 1).");
+}
+
+EvictionEngine::Fifo& EvictionEngine::fifo(Queue queue) {
+    switch (queue) {
+    case Queue::SMALL:
+        return this->small;
+    case Queue::MAIN:
+        return this->main;
+    default:
+        return this->pinned;
+    }
+}
+
+void EvictionEngine::push_head(int64_t slot, Queue queue) {
+    Entry& entry = this->entries[slot];
+    Fifo& list = this->fifo(queue);
+    entry.queue = queue;
+    entry.prev = -1;
+    entry.next = list.head;
+    if (list.head >= 0) {
+        this->entries[list.head].prev = slot;
+    } else {
+        list.tail = slot;
+    }
+    list.head = slot;
+    list.count += 1;
+    list.bytes += entry.size;
+}
+
+void EvictionEngine::unlink(int64_t slot) {
+    Entry& entry = this->entries[slot];
+    Fifo& list = this->fifo(entry.queue);
+    if (entry.prev >= 0) {
+        this->entries[entry.prev].next = entry.next;
+    } else {
+        list.head = entry.next;
+    }
+    if (entry.next >= 0) {
+        this->entries[entry.next].prev = entry.prev;
+    } else {
+        list.tail = entry.prev;
+    }
+    list.count -= 1;
+    list.bytes -= entry.size;
+    entry.prev = entry.next = -1;
+    entry.queue = Queue::FREE;
+}
+
+void EvictionEngine::release(int64_t slot, std::vector<Victim>& victims) {
+    Entry& entry = this->entries[slot];
+    victims.emplace_back(entry.key, entry.location);
+    this->index.erase(entry.key);
+    this->usedBytes -= entry.size;
+    this->freeSlots.push_back(slot);
+    this->evictions += 1;
+}
+
+void EvictionEngine::remember_ghost(int64_t key) {
+    const uint64_t generation = ++this->ghostGeneration;
+    this->ghostIndex[key] = generation;
+    this->ghostQueue.emplace_back(key, generation);
+    // As many ghosts as cached chunks, and stale records are dropped once
+    // they outnumber the ghosts
+    const size_t limit = std::max<size_t>(this->index.size(), 1);
+    while (this->ghostIndex.size() > limit || this->ghostQueue.size() > 2 * limit) {
+        const auto [oldest, oldestGeneration] = this->ghostQueue.front();
+        this->ghostQueue.pop_front();
+        auto it = this->ghostIndex.find(oldest);
+        if (it != this->ghostIndex.end() && it->second == oldestGeneration) {
+            this->ghostIndex.erase(it);
+        }
+    }
+}
+
+void EvictionEngine::restore_unpinned() {
+    std::vector<int64_t> slots;
+    {
+        std::lock_guard<std::mutex> guard(this->unpinnedMutex);
+        slots.swap(this->unpinned);
+    }
+    for (const int64_t slot : slots) {
+        Entry& entry = this->entries[slot];
+        if (entry.queue == Queue::PINNED && entry.pins.load(std::memory_order_acquire) == 0) {
+            const Queue home = entry.home;
+            this->unlink(slot);
+            this->push_head(slot, home);
+        }
+    }
+}
+
+bool EvictionEngine::evict_one(std::vector<Victim>& victims) {
+    this->restore_unpinned();
+    // A chunk goes round main at most MAX_FREQ times before its count runs
+    // out, and pinned chunks leave the queues
+    while (this->small.count + this->main.count > 0) {
+        const bool fromSmall =
+            this->small.count > 0 && (this->small.bytes >= this->smallTarget || this->main.count == 0);
+        const Queue queue = fromSmall ? Queue::SMALL : Queue::MAIN;
+        const int64_t slot = this->fifo(queue).tail;
+        Entry& entry = this->entries[slot];
+        this->unlink(slot);
+        if (entry.pins.load(std::memory_order_acquire) > 0) {
+            entry.home = queue;
+            this->push_head(slot, Queue::PINNED);
+            continue;
+        }
+        const uint8_t freq = entry.freq.load(std::memory_order_relaxed);
+        if (fromSmall) {
+            if (freq > 0) {
+                entry.freq.store(0, std::memory_order_relaxed);
+                this->push_head(slot, Queue::MAIN);
+                this->promotions += 1;
+                continue;
+            }
+            this->remember_ghost(entry.key);
+            this->release(slot, victims);
+            return true;
+        }
+        if (freq > 0) {
+            entry.freq.store(freq - 1, std::memory_order_relaxed);
+            this->push_head(slot, Queue::MAIN);
+            continue;
+        }
+        this->release(slot, victims);
+        return true;
+    }
+    return false;
+}
+
+std::vector<EvictionEngine::Victim> EvictionEngine::insert(int64_t key, int64_t size, int64_t location) {
+    TORCH_CHECK(size >= 0, "size must be non negative.");
+    std::unique_lock lock(this->mutex);
+    std::vector<Victim> victims;
+    auto it = this->index.find(key);
+    if (it != this->index.end()) {
+        Entry& entry = this->entries[it->second];
+        this->fifo(entry.queue).bytes += size - entry.size;
+        this->usedBytes += size - entry.size;
+        entry.size = size;
+        entry.location = location;
+        const uint8_t freq = entry.freq.load(std::memory_order_relaxed);
+        entry.freq.store(std::min<uint8_t>(freq + 1, MAX_FREQ), std::memory_order_relaxed);
+        // The chunk itself can be the victim if it is the only one left
+        while (this->usedBytes > this->capacityBytes && this->evict_one(victims)) {
+        }
+        return victims;
+    }
+
+    while (this->usedBytes + size > this->capacityBytes && this->evict_one(victims)) {
+    }
+    int64_t slot;
+    if (this->freeSlots.empty()) {
+        slot = static_cast<int64_t>(this->entries.size());
+        this->entries.emplace_back();
+    } else {
+        slot = this->freeSlots.back();
+        this->freeSlots.pop_back();
+    }
+    Entry& entry = this->entries[slot];
+    entry.key = key;
+    entry.location = location;
+    entry.size = size;
+    entry.freq.store(0, std::memory_order_relaxed);
+    entry.pins.store(0, std::memory_order_relaxed);
+    auto ghost = this->ghostIndex.find(key);
+    if (ghost != this->ghostIndex.end()) {
+        this->ghostIndex.erase(ghost);
+        this->push_head(slot, Queue::MAIN);
+        this->ghostHits += 1;
+    } else {
+        this->push_head(slot, Queue::SMALL);
+    }
+    this->index.emplace(key, slot);
+    this->usedBytes += size;
+    this->insertions += 1;
+    return victims;
+}
+
+const EvictionEngine::Entry* EvictionEngine::find(int64_t key) const {
+    auto it = this->index.find(key);
+    return it == this->index.end() ? nullptr : &this->entries[it->second];
+}
+
+bool EvictionEngine::touch(int64_t key) {
+    std::shared_lock lock(this->mutex);
+    const Entry* entry = this->find(key);
+    if (entry == nullptr) {
+        this->misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // Saturating increment, concurrent hits may race on the same chunk
+    std::atomic<uint8_t>& freq = entry->freq;
+    uint8_t current = freq.load(std::memory_order_relaxed);
+    while (current < MAX_FREQ && !freq.compare_exchange_weak(current, current + 1, std::memory_order_relaxed)) {
+    }
+    this->hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+int64_t EvictionEngine::touch_prefix(const torch::Tensor& keys) {
+    TORCH_CHECK(keys.device().is_cpu() && keys.dim() == 1 && keys.scalar_type() == torch::kInt64,
+                "keys must be a 1-D int64 cpu tensor.");
+    const torch::Tensor contiguous = keys.contiguous();
+    const int64_t* data = contiguous.data_ptr<int64_t>();
+    int64_t matched = 0;
+    while (matched < contiguous.numel() && this->touch(data[matched])) {
+        ++matched;
+    }
+    return matched;
+}
+
+bool EvictionEngine::contains(int64_t key) const {
+    std::shared_lock lock(this->mutex);
+    return this->find(key) != nullptr;
+}
+
+bool EvictionEngine::pin(int64_t key) {
+    std::shared_lock lock(this->mutex);
+    const Entry* entry = this->find(key);
+    if (entry == nullptr) {
+        return false;
+    }
+    entry->pins.fetch_add(1, std::memory_order_acq_rel);
+    return true;
+}
+
+bool EvictionEngine::unpin(int64_t key) {
+    std::shared_lock lock(this->mutex);
+    auto it = this->index.find(key);
+    if (it == this->index.end()) {
+        return false;
+    }
+    const Entry* entry = &this->entries[it->second];
+    const int32_t before = entry->pins.fetch_sub(1, std::memory_order_acq_rel);
+    if (before <= 0) {
+        entry->pins.fetch_add(1, std::memory_order_acq_rel);
+        TORCH_CHECK(false, "unpin of a chunk that is not pinned.");
+    }
+    // queue only changes under the exclusive lock
+    if (before == 1 && entry->queue == Queue::PINNED) {
+        std::lock_guard<std::mutex> guard(this->unpinnedMutex);
+        this->unpinned.push_back(it->second);
+    }
+    return true;
+}
+
+std::optional<int64_t> EvictionEngine::remove(int64_t key) {
+    std::unique_lock lock(this->mutex);
+    auto it = this->index.find(key);
+    if (it == this->index.end()) {
+        return std::nullopt;
+    }
+    const int64_t slot = it->second;
+    Entry& entry = this->entries[slot];
+    // A transfer may still read the chunk, pins only change under the
+    // shared lock
+    if (entry.pins.load(std::memory_order_acquire) > 0) {
+        return std::nullopt;
+    }
+    const int64_t location = entry.location;
+    this->unlink(slot);
+    this->usedBytes -= entry.size;
+    this->index.erase(it);
+    this->freeSlots.push_back(slot);
+    return location;
+}
+
+std::vector<EvictionEngine::Victim> EvictionEngine::evict(int64_t num_bytes) {
+    std::unique_lock lock(this->mutex);
+    std::vector<Victim> victims;
+    const int64_t target = this->usedBytes - num_bytes;
+    while (this->usedBytes > target && this->evict_one(victims)) {
+    }
+    return victims;
+}
+
+void EvictionEngine::clear() {
+    std::unique_lock lock(this->mutex);
+    this->entries.clear();
+    this->freeSlots.clear();
+    this->index.clear();
+    this->small = Fifo{};
+    this->main = Fifo{};
+    this->pinned = Fifo{};
+    this->unpinned.clear();
+    this->ghostQueue.clear();
+    this->ghostIndex.clear();
+    this->usedBytes = 0;
+}
+
+std::map<std::string, int64_t> EvictionEngine::stats() const {
+    std::shared_lock lock(this->mutex);
+    return {
+        {"hits", this->hits.load(std::memory_order_relaxed)},
+        {"misses", this->misses.load(std::memory_order_relaxed)},
+        {"insertions", this->insertions},
+        {"evictions", this->evictions},
+        {"promotions", this->promotions},
+        {"ghost_hits", this->ghostHits},
+        {"small_chunks", this->small.count},
+        {"main_chunks", this->main.count},
+        {"pinned_chunks", this->pinned.count},
+        {"ghost_chunks", static_cast<int64_t>(this->ghostIndex.size())},
+        {"used_bytes", this->usedBytes},
+        {"capacity", this->capacityBytes},
+    };
+}
+
+void EvictionEngine::reset_stats() {
+    std::unique_lock lock(this->mutex);
+    this->hits.store(0, std::memory_order_relaxed);
+    this->misses.store(0, std::memory_order_relaxed);
+    this->insertions = 0;
+    this->evictions = 0;
+    this->promotions = 0;
+    this->ghostHits = 0;
+}
+
+int64_t EvictionEngine::size() const {
+    std::shared_lock lock(this->mutex);
+    return static_cast<int64_t>(this->index.size());
+}
+
+int64_t EvictionEngine::used_bytes() const {
+    std::shared_lock lock(this->mutex);
+    return this->usedBytes;
+}
+
+int64_t EvictionEngine::capacity() const {
+    return this->capacityBytes;
+}
+
+} // namespace lmc
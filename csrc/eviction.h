@@ -0,0 +1,157 @@
+#pragma once
+#include <torch/torch.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lmc {
+
+/*
+* Eviction engine of the host KV pool, exposed to Python as
+* c_ops.EvictionEngine. The policy is S3-FIFO (Yang et al., SOSP '23):
+*
+*  - new chunks enter a small probationary FIFO (small_ratio of the capacity)
+*  - a chunk leaving the small FIFO moves to the main FIFO if it was hit
+*    since it was inserted, otherwise it is evicted and its key is remembered
+*    in a ghost FIFO
+*  - a chunk inserted again while its key is a ghost goes straight to main
+*  - main is a CLOCK: a chunk at its tail that was hit goes back to the head
+*    with one hit less, otherwise it is evicted
+*
+* One-shot prompts therefore pass through the small FIFO without displacing
+* the shared prefixes in main, which plain LRU does under scans.
+*
+* A hit only bumps an atomic counter of the chunk (at most 3), under a
+* shared lock: touch, pin and unpin run concurrently from any thread and
+* never move a chunk. Insertion and eviction take the exclusive lock and
+* only look at the queue tails, O(1) per victim.
+*
+* A chunk is a key (the chunk hash), the bytes it occupies and a location,
+* the opaque int64 the caller frees it with: usually the host address of
+* the memory object inside a region of the HostRegisteredMemoryManager.
+* Pinned chunks (pin count > 0, e.g. while a transfer reads them) are
+* never evicted: one reaching a queue tail is parked on a side list, with
+* its queue and hits unchanged, so that later evictions do not walk over
+* it again. unpin only records the chunk, under the shared lock, and the
+* next eviction puts it back at the head of its queue.
+*/
+class EvictionEngine {
+public:
+    // key, location
+    using Victim = std::pair<int64_t, int64_t>;
+
+    // capacity: bytes the chunks may occupy, small_ratio: share of it for
+    // the probationary FIFO
+    EvictionEngine(int64_t capacity, double small_ratio);
+
+    EvictionEngine(const EvictionEngine&) = delete;
+    EvictionEngine& operator=(const EvictionEngine&) = delete;
+
+    // Adds a chunk, evicting until it fits in the capacity. A chunk already
+    // present gets the new size and location and counts as hit. Returns the
+    // chunks evicted, for the caller to free. When everything else is
+    // pinned the chunk is added anyway and used_bytes exceeds the capacity.
+    std::vector<Victim> insert(int64_t key, int64_t size, int64_t location);
+    // Records a lookup of key, returns whether it is cached
+    bool touch(int64_t key);
+    // touch of keys (1-D int64 tensor) in order up to the first miss, the
+    // chunk by chunk prefix lookup of a request. Returns the number of hits.
+    int64_t touch_prefix(const torch::Tensor& keys);
+    // Whether key is cached, without counting a lookup
+    bool contains(int64_t key) const;
+    // Pins / unpins a chunk, returns false if it is not cached
+    bool pin(int64_t key);
+    bool unpin(int64_t key);
+    // Drops a chunk without evicting it, returns its location. A pinned
+    // chunk is kept and, like a missing one, gives nullopt.
+    std::optional<int64_t> remove(int64_t key);
+    // Evicts chunks until at least num_bytes are freed, or only pinned
+    // chunks are left
+    std::vector<Victim> evict(int64_t num_bytes);
+    void clear();
+
+    // Counters (hits, misses, insertions, evictions, promotions from small
+    // to main, ghost hits) and occupancy (pinned_chunks: parked pinned
+    // chunks, counted in neither queue)
+    std::map<std::string, int64_t> stats() const;
+    void reset_stats();
+    int64_t size() const;
+    int64_t used_bytes() const;
+    int64_t capacity() const;
+
+private:
+    enum class Queue : uint8_t { SMALL, MAIN, PINNED, FREE };
+
+    struct Entry {
+        int64_t key = 0;
+        int64_t location = 0;
+        int64_t size = 0;
+        int64_t prev = -1;
+        int64_t next = -1;
+        Queue queue = Queue::FREE;
+        // Queue a parked chunk goes back to
+        Queue home = Queue::FREE;
+        // Updated under the shared lock
+        mutable std::atomic<uint8_t> freq{0};
+        mutable std::atomic<int32_t> pins{0};
+    };
+
+    // Doubly linked FIFO over entries, new entries at the head
+    struct Fifo {
+        int64_t head = -1;
+        int64_t tail = -1;
+        int64_t count = 0;
+        int64_t bytes = 0;
+    };
+
+    Fifo& fifo(Queue queue);
+    void push_head(int64_t slot, Queue queue);
+    void unlink(int64_t slot);
+    // Evicts one chunk, false when only pinned chunks are left
+    bool evict_one(std::vector<Victim>& victims);
+    // Puts parked chunks unpinned since the last eviction back in their queue
+    void restore_unpinned();
+    void release(int64_t slot, std::vector<Victim>& victims);
+    void remember_ghost(int64_t key);
+    const Entry* find(int64_t key) const;
+
+    mutable std::shared_mutex mutex;
+    const int64_t capacityBytes;
+    const int64_t smallTarget;
+    int64_t usedBytes = 0;
+
+    // Entries live in a deque so that their atomics never move
+    std::deque<Entry> entries;
+    std::vector<int64_t> freeSlots;
+    std::unordered_map<int64_t, int64_t> index;
+    Fifo small;
+    Fifo main;
+    Fifo pinned;
+    // Parked chunks unpinned under the shared lock, restored by the next
+    // eviction. May hold duplicates and chunks pinned again.
+    std::mutex unpinnedMutex;
+    std::vector<int64_t> unpinned;
+
+    // Ghost FIFO of (key, generation): a key is a ghost while ghostIndex
+    // holds its generation, stale queue records are skipped
+    std::deque<std::pair<int64_t, uint64_t>> ghostQueue;
+    std::unordered_map<int64_t, uint64_t> ghostIndex;
+    uint64_t ghostGeneration = 0;
+
+    std::atomic<int64_t> hits{0};
+    std::atomic<int64_t> misses{0};
+    int64_t insertions = 0;
+    int64_t evictions = 0;
+    int64_t promotions = 0;
+    int64_t ghostHits = 0;
+};
+
+} // namespace lmc
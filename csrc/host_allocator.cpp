@@ -0,0 +1,90 @@
+#include "host_allocator.h"
+#include "managed_mem.h"
+
+namespace lmc {
+
+HostAllocator::HostAllocator(torch::Tensor buffer, const std::vector<int64_t>& chunk_sizes)
+    : buffer(buffer) {
+    TORCH_CHECK(buffer.device().is_cpu(), "buffer must be a cpu tensor.");
+    TORCH_CHECK(buffer.dim() == 1 && buffer.scalar_type() == at::ScalarType::Byte && buffer.is_contiguous(),
+                "buffer must be a contiguous 1-D uint8 tensor.");
+    base = static_cast<uint8_t*>(buffer.data_ptr());
+    devBase = reinterpret_cast<uintptr_t>(get_device_ptr(base));
+
+    std::vector<uint64_t> sizes;
+    for (int64_t size : chunk_sizes) {
+        TORCH_CHECK(size > 0, "chunk sizes must be greater than 0.");
+        sizes.push_back(static_cast<uint64_t>(size));
+    }
+    // Blocks start at multiples of ALIGN from base, keep them aligned in memory too
+    const uint64_t misalignment = reinterpret_cast<uintptr_t>(base) % SizeClassArena::ALIGN;
+    const uint64_t skip = misalignment == 0 ? 0 : SizeClassArena::ALIGN - misalignment;
+    const uint64_t usable = static_cast<uint64_t>(buffer.numel()) > skip ? buffer.numel() - skip : 0;
+    base += skip;
+    devBase = devBase == 0 ? 0 : devBase + skip;
+    arena = std::make_unique<SizeClassArena>(usable, sizes);
+    arena->setBase(base);
+}
+
+std::optional<torch::Tensor> HostAllocator::allocate(int64_t nbytes) {
+    TORCH_CHECK(nbytes > 0, "nbytes must be greater than 0.");
+    const uint64_t offset = arena->allocate(static_cast<uint64_t>(nbytes));
+    if (offset == SizeClassArena::NO_BLOCK) {
+        return std::nullopt;
+    }
+    const int64_t start = static_cast<int64_t>(base - static_cast<uint8_t*>(buffer.data_ptr()) + offset);
+    return buffer.narrow(0, start, nbytes);
+}
+
+std::optional<std::vector<torch::Tensor>> HostAllocator::batched_allocate(int64_t nbytes, int64_t count) {
+    std::vector<torch::Tensor> blocks;
+    blocks.reserve(count);
+    for (int64_t i = 0; i < count; ++i) {
+        auto block = allocate(nbytes);
+        if (!block) {
+            batched_free(blocks);
+            return std::nullopt;
+        }
+        blocks.push_back(std::move(*block));
+    }
+    return blocks;
+}
+
+void HostAllocator::free(const torch::Tensor& block) {
+    arena->free(blockOffset(block), static_cast<uint64_t>(block.nbytes()));
+}
+
+void HostAllocator::batched_free(const std::vector<torch::Tensor>& blocks) {
+    for (const auto& block : blocks) {
+        free(block);
+    }
+}
+
+int64_t HostAllocator::device_ptr(const torch::Tensor& view) const {
+    return devBase == 0 ? 0 : static_cast<int64_t>(devBase + blockOffset(view));
+}
+
+int64_t HostAllocator::block_size(int64_t nbytes) const {
+    return static_cast<int64_t>(arena->blockSize(static_cast<uint64_t>(nbytes)));
+}
+
+int64_t HostAllocator::used_bytes() const {
+    return static_cast<int64_t>(arena->used());
+}
+
+int64_t HostAllocator::reserved_bytes() const {
+    return static_cast<int64_t>(arena->reserved());
+}
+
+int64_t HostAllocator::capacity() const {
+    return static_cast<int64_t>(arena->size());
+}
+
+uint64_t HostAllocator::blockOffset(const torch::Tensor& block) const {
+    const uint8_t* ptr = static_cast<const uint8_t*>(block.data_ptr());
+    TORCH_CHECK(ptr >= base && ptr + block.nbytes() <= base + arena->size(),
+                "block is not a view of the allocator buffer.");
+    return static_cast<uint64_t>(ptr - base);
+}
+
+} // namespace lmc
@@ -0,0 +1,51 @@
+#pragma once
+#include <torch/torch.h>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "size_class_arena.h"
+
+namespace lmc {
+
+/*
+* Thread-safe sub-allocator over a (registered) pinned host buffer, exposed
+* to Python as c_ops.HostAllocator. Blocks are handed out as uint8 views of
+* the buffer, device_ptr gives their device address from the buffer
+* registration resolved once at construction. See SizeClassArena for the
+* allocation scheme.
+*/
+class HostAllocator {
+public:
+    // -buffer: 1-D uint8 cpu tensor, usually registered with host_register
+    //  or allocated with alloc_pinned_memory (device address 0 otherwise)
+    // -chunk_sizes: byte sizes that get an exact size class, e.g. full KV chunks
+    HostAllocator(torch::Tensor buffer, const std::vector<int64_t>& chunk_sizes);
+
+    // View of nbytes bytes, or nullopt when out of memory
+    std::optional<torch::Tensor> allocate(int64_t nbytes);
+    // count blocks of nbytes bytes, all or nothing
+    std::optional<std::vector<torch::Tensor>> batched_allocate(int64_t nbytes, int64_t count);
+    // block must be a view returned by allocate or batched_allocate
+    void free(const torch::Tensor& block);
+    void batched_free(const std::vector<torch::Tensor>& blocks);
+
+    // Device address of a view of the buffer
+    int64_t device_ptr(const torch::Tensor& view) const;
+    // Size of the block backing an nbytes request
+    int64_t block_size(int64_t nbytes) const;
+    // Bytes held by live blocks, rounded up to their size class
+    int64_t used_bytes() const;
+    // Bytes carved out of the buffer so far, live or free
+    int64_t reserved_bytes() const;
+    int64_t capacity() const;
+
+private:
+    uint64_t blockOffset(const torch::Tensor& block) const;
+
+    torch::Tensor buffer;
+    uint8_t* base;
+    uintptr_t devBase;
+    std::unique_ptr<SizeClassArena> arena;
+};
+
+} // namespace lmc
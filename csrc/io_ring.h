@@ -0,0 +1,215 @@
+#pragma once
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace lmc {
+
+/*
+* Minimal io_uring on the raw syscalls (liburing is not a dependency): one
+* submission ring, one completion ring, fixed buffers and a single fixed
+* file (index 0).
+*
+* Not thread-safe, the owner serialises calls. The owner also keeps at most
+* sqEntries() requests in flight, so the completion ring (twice as large)
+* can never overflow. Methods return 0 or -errno.
+*/
+class IoRing {
+public:
+    struct Completion {
+        uint64_t userData;
+        int32_t result;
+    };
+
+    IoRing() = default;
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    ~IoRing() {
+        close();
+    }
+
+    int setup(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        const int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return -errno;
+        }
+        ringFd = fd;
+        sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+        }
+        sqRing = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                      IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            sqRing = nullptr;
+            return fail();
+        }
+        if (singleMmap) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                          IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                cqRing = nullptr;
+                return fail();
+            }
+        }
+        sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqesMap = mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                             IORING_OFF_SQES);
+        if (sqesMap == MAP_FAILED) {
+            return fail();
+        }
+        sqes = static_cast<io_uring_sqe*>(sqesMap);
+
+        uint8_t* sq = static_cast<uint8_t*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        uint8_t* cq = static_cast<uint8_t*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        numSqEntries = params.sq_entries;
+        return 0;
+    }
+
+    void close() {
+        if (sqes != nullptr) {
+            munmap(sqes, sqesBytes);
+            sqes = nullptr;
+        }
+        if (cqRing != nullptr && !singleMmap) {
+            munmap(cqRing, cqRingBytes);
+        }
+        if (sqRing != nullptr) {
+            munmap(sqRing, sqRingBytes);
+        }
+        sqRing = cqRing = nullptr;
+        if (ringFd >= 0) {
+            ::close(ringFd);
+            ringFd = -1;
+        }
+    }
+
+    bool ready() const {
+        return sqes != nullptr;
+    }
+
+    unsigned sqEntries() const {
+        return numSqEntries;
+    }
+
+    int registerBuffers(const std::vector<iovec>& buffers) {
+        return enterRegister(IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size()));
+    }
+
+    int registerFile(int fd) {
+        return enterRegister(IORING_REGISTER_FILES, &fd, 1);
+    }
+
+    // Queues a read / write of len bytes at addr from / to offset of the
+    // fixed file. fixedBuffer is the registered buffer holding addr, or -1
+    // for plain memory. False when the submission ring is full.
+    bool prepare(bool write, int fixedBuffer, void* addr, uint32_t len, uint64_t offset, uint64_t userData) {
+        const unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= numSqEntries) {
+            return false;
+        }
+        const unsigned index = tail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        if (fixedBuffer >= 0) {
+            sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->buf_index = static_cast<uint16_t>(fixedBuffer);
+        } else {
+            sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+        }
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->fd = 0;
+        sqe->addr = reinterpret_cast<uint64_t>(addr);
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted;
+        return true;
+    }
+
+    // Submits the prepared requests and waits for minComplete completions
+    int submit(unsigned minComplete) {
+        while (true) {
+            const unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+            const int ret = static_cast<int>(
+                syscall(__NR_io_uring_enter, ringFd, unsubmitted, minComplete, flags, nullptr, 0));
+            if (ret >= 0) {
+                unsubmitted -= static_cast<unsigned>(ret);
+                return 0;
+            }
+            if (errno != EINTR) {
+                return -errno;
+            }
+        }
+    }
+
+    // Appends the available completions to out, returns how many
+    size_t reap(std::vector<Completion>& out) {
+        unsigned head = *cqHead;
+        const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        const size_t count = tail - head;
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            out.push_back(Completion{cqe.user_data, cqe.res});
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+    int enterRegister(unsigned opcode, const void* arg, unsigned count) {
+        const int ret = static_cast<int>(syscall(__NR_io_uring_register, ringFd, opcode, arg, count));
+        return ret < 0 ? -errno : 0;
+    }
+
+    int fail() {
+        const int err = -errno;
+        close();
+        return err;
+    }
+
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingBytes = 0;
+    size_t cqRingBytes = 0;
+    size_t sqesBytes = 0;
+    bool singleMmap = false;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned cqMask = 0;
+    unsigned numSqEntries = 0;
+    unsigned unsubmitted = 0;
+};
+
+} // namespace lmc
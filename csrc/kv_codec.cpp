@@ -0,0 +1,414 @@
+#include "kv_codec.h"
+#include <ATen/Parallel.h>
+#include <dlfcn.h>
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+
+namespace {
+
+constexpr uint32_t FRAME_MAGIC = 0x43564b4c; // "LKVC"
+constexpr uint8_t FRAME_VERSION = 1;
+// Block size flag of a block stored uncompressed
+constexpr uint32_t RAW_BLOCK = 1u << 31;
+constexpr int64_t MAX_BLOCK_BYTES = 1 << 30;
+
+struct FrameHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t codec;
+    uint8_t elemSize;
+    uint8_t reserved;
+    uint32_t blockBytes;
+    uint32_t numBlocks;
+    uint64_t rawBytes;
+};
+static_assert(sizeof(FrameHeader) == 24, "The frame header is 24 bytes.");
+
+enum class Codec : uint8_t { NONE = 0, LZ4 = 1, ZSTD = 2 };
+
+// The few entry points used, declared here since the headers are not
+// required at build time. The libraries stay loaded for the process.
+struct Lz4Api {
+    int (*compressFast)(const char* src, char* dst, int srcSize, int dstCapacity, int acceleration) = nullptr;
+    int (*decompressSafe)(const char* src, char* dst, int compressedSize, int dstCapacity) = nullptr;
+};
+
+struct ZstdApi {
+    void* (*createCCtx)() = nullptr;
+    size_t (*freeCCtx)(void* cctx) = nullptr;
+    size_t (*compressCCtx)(void* cctx, void* dst, size_t dstCapacity, const void* src, size_t srcSize,
+                           int level) = nullptr;
+    void* (*createDCtx)() = nullptr;
+    size_t (*freeDCtx)(void* dctx) = nullptr;
+    size_t (*decompressDCtx)(void* dctx, void* dst, size_t dstCapacity, const void* src, size_t srcSize) = nullptr;
+    unsigned (*isError)(size_t code) = nullptr;
+};
+
+void* open_library(std::initializer_list<const char*> names) {
+    for (const char* name : names) {
+        if (void* handle = dlopen(name, RTLD_NOW | RTLD_LOCAL)) {
+            return handle;
+        }
+    }
+    return nullptr;
+}
+
+template <typename Fn>
+bool load_symbol(void* handle, const char* name, Fn& fn) {
+    fn = reinterpret_cast<Fn>(dlsym(handle, name));
+    return fn != nullptr;
+}
+
+// nullptr if liblz4 is not installed
+const Lz4Api* lz4_api() {
+    static const Lz4Api api = [] {
+        Lz4Api loaded;
+        void* handle = open_library({"liblz4.so.1", "liblz4.so"});
+        if (handle == nullptr || !load_symbol(handle, "LZ4_compress_fast", loaded.compressFast) ||
+            !load_symbol(handle, "LZ4_decompress_safe", loaded.decompressSafe)) {
+            return Lz4Api{};
+        }
+        return loaded;
+    }();
+    return api.compressFast != nullptr ? &api : nullptr;
+}
+
+// nullptr if libzstd is not installed
+const ZstdApi* zstd_api() {
+    static const ZstdApi api = [] {
+        ZstdApi loaded;
+        void* handle = open_library({"libzstd.so.1", "libzstd.so"});
+        if (handle == nullptr || !load_symbol(handle, "ZSTD_createCCtx", loaded.createCCtx) ||
+            !load_symbol(handle, "ZSTD_freeCCtx", loaded.freeCCtx) ||
+            !load_symbol(handle, "ZSTD_compressCCtx", loaded.compressCCtx) ||
+            !load_symbol(handle, "ZSTD_createDCtx", loaded.createDCtx) ||
+            !load_symbol(handle, "ZSTD_freeDCtx", loaded.freeDCtx) ||
+            !load_symbol(handle, "ZSTD_decompressDCtx", loaded.decompressDCtx) ||
+            !load_symbol(handle, "ZSTD_isError", loaded.isError)) {
+            return ZstdApi{};
+        }
+        return loaded;
+    }();
+    return api.createCCtx != nullptr ? &api : nullptr;
+}
+
+bool codec_available(Codec codec) {
+    switch (codec) {
+    case Codec::NONE:
+        return true;
+    case Codec::LZ4:
+        return lz4_api() != nullptr;
+    case Codec::ZSTD:
+        return zstd_api() != nullptr;
+    }
+    return false;
+}
+
+Codec parse_codec(const std::string& name) {
+    Codec codec;
+    if (name == "none") {
+        codec = Codec::NONE;
+    } else if (name == "lz4") {
+        codec = Codec::LZ4;
+    } else if (name == "zstd") {
+        codec = Codec::ZSTD;
+    } else {
+        TORCH_CHECK(false, "Unknown codec ", name, ", expected none, lz4 or zstd.");
+    }
+    TORCH_CHECK(codec_available(codec), "Codec ", name, " is unavailable: lib", name, " was not found.");
+    return codec;
+}
+
+// LZ4 acceleration of a level: like zstd, a higher level never compresses
+// less. Levels from 1 up get the best ratio of the fast LZ4 mode
+// (acceleration 1), lower levels trade ratio for speed as zstd's negative
+// levels do: level 0 is acceleration 2, -1 is 3, ...
+int lz4_acceleration(int level) {
+    constexpr int64_t MAX_ACCELERATION = 65537;  // LZ4_ACCELERATION_MAX
+    return level >= 1 ? 1 : static_cast<int>(std::min(2 - int64_t{level}, MAX_ACCELERATION));
+}
+
+// Codec state of one parallel task: a zstd context is reused for all the
+// blocks of the task
+class BlockCoder {
+public:
+    BlockCoder(Codec codec, int level) : codec(codec), level(level) {}
+    BlockCoder(const BlockCoder&) = delete;
+    BlockCoder& operator=(const BlockCoder&) = delete;
+
+    ~BlockCoder() {
+        if (this->cctx != nullptr) {
+            zstd_api()->freeCCtx(this->cctx);
+        }
+        if (this->dctx != nullptr) {
+            zstd_api()->freeDCtx(this->dctx);
+        }
+    }
+
+    // Compresses into less than size bytes, returns the compressed size or
+    // -1 if the block does not get smaller
+    int64_t compress(const uint8_t* src, int64_t size, uint8_t* dst) {
+        const int64_t capacity = size - 1;
+        if (capacity <= 0 || this->codec == Codec::NONE) {
+            return -1;
+        }
+        if (this->codec == Codec::LZ4) {
+            const int written = lz4_api()->compressFast(reinterpret_cast<const char*>(src),
+                                                        reinterpret_cast<char*>(dst), static_cast<int>(size),
+                                                        static_cast<int>(capacity), lz4_acceleration(this->level));
+            return written > 0 ? written : -1;
+        }
+        const ZstdApi* zstd = zstd_api();
+        if (this->cctx == nullptr) {
+            this->cctx = zstd->createCCtx();
+            TORCH_CHECK(this->cctx != nullptr, "ZSTD_createCCtx failed.");
+        }
+        const size_t written = zstd->compressCCtx(this->cctx, dst, capacity, src, size, this->level);
+        return zstd->isError(written) ? -1 : static_cast<int64_t>(written);
+    }
+
+    // Whether src decodes to exactly size bytes
+    bool decompress(const uint8_t* src, int64_t srcSize, uint8_t* dst, int64_t size) {
+        if (this->codec == Codec::LZ4) {
+            const int read = lz4_api()->decompressSafe(reinterpret_cast<const char*>(src),
+                                                       reinterpret_cast<char*>(dst), static_cast<int>(srcSize),
+                                                       static_cast<int>(size));
+            return read == size;
+        }
+        if (this->codec == Codec::ZSTD) {
+            const ZstdApi* zstd = zstd_api();
+            if (this->dctx == nullptr) {
+                this->dctx = zstd->createDCtx();
+                TORCH_CHECK(this->dctx != nullptr, "ZSTD_createDCtx failed.");
+            }
+            const size_t read = zstd->decompressDCtx(this->dctx, dst, size, src, srcSize);
+            return !zstd->isError(read) && static_cast<int64_t>(read) == size;
+        }
+        return false;
+    }
+
+private:
+    const Codec codec;
+    const int level;
+    void* cctx = nullptr;
+    void* dctx = nullptr;
+};
+
+/*
+ * Byte plane split of numElems elements of N bytes: plane b holds byte b of
+ * every element. N is a constant so that the compiler unrolls the inner
+ * loop and vectorizes the outer one with interleaved loads / stores (ld2 /
+ * st2 on NEON, shuffles on x86), without intrinsics per target.
+ */
+template <int N>
+void split_planes(const uint8_t* src, uint8_t* dst, int64_t numElems) {
+    for (int64_t i = 0; i < numElems; ++i) {
+        for (int b = 0; b < N; ++b) {
+            dst[b * numElems + i] = src[i * N + b];
+        }
+    }
+}
+
+template <int N>
+void merge_planes(const uint8_t* src, uint8_t* dst, int64_t numElems) {
+    for (int64_t i = 0; i < numElems; ++i) {
+        for (int b = 0; b < N; ++b) {
+            dst[i * N + b] = src[b * numElems + i];
+        }
+    }
+}
+
+void shuffle(const uint8_t* src, uint8_t* dst, int64_t size, int64_t elemSize, bool split) {
+    const int64_t numElems = size / elemSize;
+    switch (elemSize) {
+    case 1:
+        std::memcpy(dst, src, size);
+        return;
+    case 2:
+        return split ? split_planes<2>(src, dst, numElems) : merge_planes<2>(src, dst, numElems);
+    case 4:
+        return split ? split_planes<4>(src, dst, numElems) : merge_planes<4>(src, dst, numElems);
+    case 8:
+        return split ? split_planes<8>(src, dst, numElems) : merge_planes<8>(src, dst, numElems);
+    }
+    for (int64_t i = 0; i < numElems; ++i) {
+        for (int64_t b = 0; b < elemSize; ++b) {
+            if (split) {
+                dst[b * numElems + i] = src[i * elemSize + b];
+            } else {
+                dst[i * elemSize + b] = src[b * numElems + i];
+            }
+        }
+    }
+}
+
+int64_t num_blocks(int64_t numBytes, int64_t blockBytes) {
+    return (numBytes + blockBytes - 1) / blockBytes;
+}
+
+int64_t payload_offset(int64_t numBlocks) {
+    return static_cast<int64_t>(sizeof(FrameHeader)) + numBlocks * static_cast<int64_t>(sizeof(uint32_t));
+}
+
+FrameHeader read_header(const torch::Tensor& src) {
+    TORCH_CHECK(src.device().is_cpu() && src.dim() == 1 && src.scalar_type() == torch::kUInt8 &&
+                    src.is_contiguous(),
+                "src must be a contiguous 1-D uint8 cpu tensor.");
+    TORCH_CHECK(src.numel() >= static_cast<int64_t>(sizeof(FrameHeader)), "src is too short for a frame.");
+    FrameHeader header;
+    std::memcpy(&header, src.data_ptr(), sizeof(header));
+    TORCH_CHECK(header.magic == FRAME_MAGIC, "src does not start with a lossless KV frame.");
+    TORCH_CHECK(header.version == FRAME_VERSION, "Unsupported frame version ", static_cast<int>(header.version),
+                ".");
+    TORCH_CHECK(header.elemSize > 0 && header.blockBytes > 0 && header.blockBytes % header.elemSize == 0 &&
+                    header.rawBytes % header.elemSize == 0 &&
+                    header.numBlocks == num_blocks(header.rawBytes, header.blockBytes),
+                "Corrupted frame header.");
+    return header;
+}
+
+} // namespace
+
+std::vector<std::string> lossless_codecs() {
+    std::vector<std::string> codecs{"none"};
+    if (codec_available(Codec::LZ4)) {
+        codecs.emplace_back("lz4");
+    }
+    if (codec_available(Codec::ZSTD)) {
+        codecs.emplace_back("zstd");
+    }
+    return codecs;
+}
+
+int64_t lossless_max_compressed_size(int64_t num_bytes, int64_t block_bytes) {
+    TORCH_CHECK(num_bytes >= 0, "num_bytes must be non negative.");
+    TORCH_CHECK(block_bytes > 0 && block_bytes <= MAX_BLOCK_BYTES, "block_bytes must be in (0, 1 GiB].");
+    return payload_offset(num_blocks(num_bytes, block_bytes)) + num_bytes;
+}
+
+int64_t lossless_compress(const torch::Tensor& src, torch::Tensor& dst, const std::string& codec, int64_t level,
+                          int64_t block_bytes) {
+    TORCH_CHECK(src.device().is_cpu() && src.is_contiguous(), "src must be a contiguous cpu tensor.");
+    TORCH_CHECK(dst.device().is_cpu() && dst.dim() == 1 && dst.scalar_type() == torch::kUInt8 &&
+                    dst.is_contiguous(),
+                "dst must be a contiguous 1-D uint8 cpu tensor.");
+    const Codec kind = parse_codec(codec);
+    const int64_t elemSize = src.element_size();
+    const int64_t rawBytes = src.nbytes();
+    TORCH_CHECK(block_bytes % elemSize == 0, "block_bytes must be a multiple of the element size of src.");
+    TORCH_CHECK(level >= std::numeric_limits<int>::min() && level <= std::numeric_limits<int>::max(),
+                "level is out of range.");
+    const int64_t maxBytes = lossless_max_compressed_size(rawBytes, block_bytes);
+    TORCH_CHECK(dst.numel() >= maxBytes, "dst must hold lossless_max_compressed_size(src) = ", maxBytes,
+                " bytes.");
+    const int64_t numBlocks = num_blocks(rawBytes, block_bytes);
+    TORCH_CHECK(numBlocks <= std::numeric_limits<uint32_t>::max(), "src has too many blocks, use larger ones.");
+
+    const uint8_t* in = static_cast<const uint8_t*>(src.data_ptr());
+    uint8_t* out = dst.data_ptr<uint8_t>();
+    TORCH_CHECK(rawBytes == 0 || out + maxBytes <= in || in + rawBytes <= out, "dst overlaps src.");
+
+    // Block i is first written to its worst case slot, at i * block_bytes
+    // in the payload, then the payload is compacted
+    uint8_t* payload = out + payload_offset(numBlocks);
+    std::vector<uint32_t> sizes(numBlocks);
+    at::parallel_for(0, numBlocks, 1, [&](int64_t begin, int64_t end) {
+        BlockCoder coder(kind, static_cast<int>(level));
+        std::vector<uint8_t> planes(kind == Codec::NONE ? 0 : block_bytes);
+        for (int64_t block = begin; block < end; ++block) {
+            const int64_t first = block * block_bytes;
+            const int64_t size = std::min(block_bytes, rawBytes - first);
+            uint8_t* slot = payload + first;
+            if (kind == Codec::NONE) {
+                shuffle(in + first, slot, size, elemSize, true);
+                sizes[block] = static_cast<uint32_t>(size) | RAW_BLOCK;
+                continue;
+            }
+            shuffle(in + first, planes.data(), size, elemSize, true);
+            const int64_t written = coder.compress(planes.data(), size, slot);
+            if (written < 0) {
+                std::memcpy(slot, planes.data(), size);
+                sizes[block] = static_cast<uint32_t>(size) | RAW_BLOCK;
+            } else {
+                sizes[block] = static_cast<uint32_t>(written);
+            }
+        }
+    });
+
+    int64_t offset = 0;
+    for (int64_t block = 0; block < numBlocks; ++block) {
+        const int64_t size = sizes[block] & ~RAW_BLOCK;
+        if (offset != block * block_bytes) {
+            std::memmove(payload + offset, payload + block * block_bytes, size);
+        }
+        offset += size;
+    }
+
+    const FrameHeader header{FRAME_MAGIC,
+                             FRAME_VERSION,
+                             static_cast<uint8_t>(kind),
+                             static_cast<uint8_t>(elemSize),
+                             0,
+                             static_cast<uint32_t>(block_bytes),
+                             static_cast<uint32_t>(numBlocks),
+                             static_cast<uint64_t>(rawBytes)};
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), sizes.data(), numBlocks * sizeof(uint32_t));
+    return payload_offset(numBlocks) + offset;
+}
+
+int64_t lossless_decompressed_size(const torch::Tensor& src) {
+    return static_cast<int64_t>(read_header(src).rawBytes);
+}
+
+void lossless_decompress(const torch::Tensor& src, torch::Tensor& dst) {
+    const FrameHeader header = read_header(src);
+    TORCH_CHECK(header.codec <= static_cast<uint8_t>(Codec::ZSTD), "Corrupted frame header.");
+    const Codec kind = static_cast<Codec>(header.codec);
+    TORCH_CHECK(codec_available(kind), "The frame codec is unavailable: its library was not found.");
+    TORCH_CHECK(dst.device().is_cpu() && dst.is_contiguous(), "dst must be a contiguous cpu tensor.");
+    TORCH_CHECK(static_cast<uint64_t>(dst.nbytes()) == header.rawBytes, "dst must have the raw size of the frame, ",
+                header.rawBytes, " bytes.");
+    TORCH_CHECK(dst.element_size() == header.elemSize, "dst must have the element size of the compressed tensor, ",
+                static_cast<int>(header.elemSize), " bytes.");
+
+    const int64_t numBlocks = header.numBlocks;
+    const int64_t blockBytes = header.blockBytes;
+    const int64_t rawBytes = static_cast<int64_t>(header.rawBytes);
+    const int64_t frameStart = payload_offset(numBlocks);
+    TORCH_CHECK(src.numel() >= frameStart, "src is too short for the frame.");
+    const uint8_t* in = src.data_ptr<uint8_t>();
+    std::vector<uint32_t> sizes(numBlocks);
+    std::memcpy(sizes.data(), in + sizeof(FrameHeader), numBlocks * sizeof(uint32_t));
+    std::vector<int64_t> offsets(numBlocks);
+    int64_t offset = frameStart;
+    for (int64_t block = 0; block < numBlocks; ++block) {
+        const int64_t size = sizes[block] & ~RAW_BLOCK;
+        const int64_t expected = std::min(blockBytes, rawBytes - block * blockBytes);
+        TORCH_CHECK(!(sizes[block] & RAW_BLOCK) || size == expected, "Corrupted frame: bad stored block size.");
+        offsets[block] = offset;
+        offset += size;
+    }
+    TORCH_CHECK(src.numel() >= offset, "src is too short for the frame.");
+
+    uint8_t* out = static_cast<uint8_t*>(dst.data_ptr());
+    TORCH_CHECK(rawBytes == 0 || out + rawBytes <= in || in + offset <= out, "dst overlaps src.");
+    at::parallel_for(0, numBlocks, 1, [&](int64_t begin, int64_t end) {
+        BlockCoder coder(kind, 0);
+        std::vector<uint8_t> planes;
+        for (int64_t block = begin; block < end; ++block) {
+            const int64_t first = block * blockBytes;
+            const int64_t size = std::min(blockBytes, rawBytes - first);
+            const uint8_t* data = in + offsets[block];
+            if (!(sizes[block] & RAW_BLOCK)) {
+                planes.resize(blockBytes);
+                TORCH_CHECK(coder.decompress(data, sizes[block], planes.data(), size),
+                            "Corrupted frame: block ", block, " does not decode.");
+                data = planes.data();
+            }
+            shuffle(data, out + first, size, header.elemSize, false);
+        }
+    });
+}
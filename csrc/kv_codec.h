@@ -0,0 +1,51 @@
+#pragma once
+#include <torch/torch.h>
+#include <string>
+#include <vector>
+
+/*
+ * Lossless codec of KV chunks, for tiers that need bit exact KV (CacheGen
+ * is lossy). Raw fp16 / bf16 compresses poorly because the bytes of an
+ * element alternate between the sign / exponent byte, which varies little,
+ * and the mantissa byte, which is close to random. So each block is first
+ * split in byte planes (byte 0 of every element, then byte 1, ...) and the
+ * planes are then compressed with LZ4 or zstd. Blocks are independent and
+ * encoded / decoded in parallel.
+ *
+ * Frame (little endian):
+ *
+ *   header    magic, version, codec, element size, block bytes,
+ *             number of blocks, raw bytes                      (24 bytes)
+ *   sizes     uint32 per block, bit 31 set: stored uncompressed
+ *   payload   the blocks, back to back
+ *
+ * A block that does not get smaller is stored as is (still shuffled), so a
+ * frame is never larger than lossless_max_compressed_size. liblz4 and
+ * libzstd are loaded at run time: they are not build dependencies, and a
+ * codec whose library is missing is reported as unavailable.
+ */
+
+constexpr int64_t LOSSLESS_DEFAULT_BLOCK_BYTES = 256 * 1024;
+
+// Codecs usable on this host, among "none" (shuffle only), "lz4", "zstd"
+std::vector<std::string> lossless_codecs();
+
+// Size dst must have for any src of num_bytes
+int64_t lossless_max_compressed_size(int64_t num_bytes, int64_t block_bytes);
+
+// Compresses the bytes of src (contiguous cpu tensor, e.g. a pinned memory
+// object) into dst (1-D uint8 cpu tensor of at least
+// lossless_max_compressed_size bytes). The planes are the bytes of src's
+// elements: pass src.view(torch.uint8) to compress without shuffling.
+// level is the zstd level; for LZ4 levels from 1 up all give its best fast
+// ratio and lower levels are faster (acceleration 2 - level), so a higher
+// level never compresses less with either codec. Returns the frame size.
+int64_t lossless_compress(const torch::Tensor& src, torch::Tensor& dst, const std::string& codec, int64_t level,
+                          int64_t block_bytes);
+
+// Raw size of the chunk in a frame (src: uint8 cpu tensor starting with it)
+int64_t lossless_decompressed_size(const torch::Tensor& src);
+
+// Decodes the frame at the start of src into dst (contiguous cpu tensor of
+// the raw size and of the element size the frame was shuffled with).
+void lossless_decompress(const torch::Tensor& src, torch::Tensor& dst);
@@ -0,0 +1,176 @@
+#include "kv_layout.h"
+#include <ATen/Parallel.h>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// A task converts a tile of about TILE_BYTES of one layer: large enough to
+// amortize the scheduling, small enough for the source and destination lines
+// of a tile to stay in L2.
+constexpr int64_t TILE_BYTES = 256 * 1024;
+constexpr int64_t MIN_TILE_TOKENS = 8;
+
+// Row (kv, layer, token) of a chunk in either layout, strides in bytes
+struct RowLayout {
+    uint8_t* base;
+    int64_t kvStride;
+    int64_t layerStride;
+    int64_t tokenStride;
+
+    uint8_t* row(int64_t kv, int64_t layer, int64_t token) const {
+        return base + kv * kvStride + layer * layerStride + token * tokenStride;
+    }
+};
+
+RowLayout row_layout(const torch::Tensor& chunk, bool tokenMajor) {
+    const int64_t elem = chunk.element_size();
+    const int kvDim = tokenMajor ? 2 : 0;
+    const int layerDim = tokenMajor ? 0 : 1;
+    const int tokenDim = tokenMajor ? 1 : 2;
+    return RowLayout{static_cast<uint8_t*>(chunk.data_ptr()), chunk.stride(kvDim) * elem,
+                     chunk.stride(layerDim) * elem, chunk.stride(tokenDim) * elem};
+}
+
+// Bytes spanned by a tensor, [first, last)
+std::pair<const uint8_t*, const uint8_t*> byte_extent(const torch::Tensor& t) {
+    const uint8_t* first = static_cast<const uint8_t*>(t.data_ptr());
+    int64_t span = 1;
+    for (int64_t dim = 0; dim < t.dim(); ++dim) {
+        span += (t.size(dim) - 1) * t.stride(dim);
+    }
+    return {first, first + span * t.element_size()};
+}
+
+// Out of place conversion. Within a tile rows are visited token by token,
+// so each side is read / written as at most kv sequential streams.
+void convert_rows(const RowLayout& src, const RowLayout& dst, int64_t numKVs, int64_t numLayers,
+                  int64_t numTokens, int64_t rowBytes) {
+    const int64_t tileTokens =
+        std::min(numTokens, std::max(MIN_TILE_TOKENS, TILE_BYTES / std::max<int64_t>(numKVs * rowBytes, 1)));
+    const int64_t tilesPerLayer = (numTokens + tileTokens - 1) / tileTokens;
+    at::parallel_for(0, numLayers * tilesPerLayer, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t item = begin; item < end; ++item) {
+            const int64_t layer = item / tilesPerLayer;
+            const int64_t first = (item % tilesPerLayer) * tileTokens;
+            const int64_t last = std::min(first + tileTokens, numTokens);
+            for (int64_t token = first; token < last; ++token) {
+                for (int64_t kv = 0; kv < numKVs; ++kv) {
+                    std::memcpy(dst.row(kv, layer, token), src.row(kv, layer, token), rowBytes);
+                }
+            }
+        }
+    });
+}
+
+void parallel_copy(uint8_t* dst, const uint8_t* src, int64_t numRows, int64_t rowBytes) {
+    const int64_t grain = std::max<int64_t>(1, TILE_BYTES / rowBytes);
+    at::parallel_for(0, numRows, grain, [&](int64_t begin, int64_t end) {
+        std::memcpy(dst + begin * rowBytes, src + begin * rowBytes, (end - begin) * rowBytes);
+    });
+}
+
+/*
+ * In place conversion of a contiguous kv = 2 chunk of numRows rows per kv.
+ * Layer major, row m of K is at m and row m of V at numRows + m; token
+ * major, they are at 2m and 2m + 1.
+ *
+ * V is staged in scratch and K rows are moved in waves m in [lo, hi) with
+ * lo = ceil(hi / 2): the rows a wave reads ([lo, hi)) and writes
+ * ([2lo, 2hi)) do not overlap, so each wave runs in parallel, and the
+ * waves run from the end of the chunk (interleave) or from its start
+ * (deinterleave) so that no row is overwritten before it is moved.
+ */
+void shuffle_in_place(uint8_t* data, int64_t numRows, int64_t rowBytes, bool toTokenMajor) {
+    std::vector<std::pair<int64_t, int64_t>> waves;
+    for (int64_t hi = numRows; hi > 0;) {
+        const int64_t lo = hi == 1 ? 0 : (hi + 1) / 2;
+        waves.emplace_back(lo, hi);
+        hi = lo;
+    }
+    if (!toTokenMajor) {
+        std::reverse(waves.begin(), waves.end());
+    }
+
+    torch::Tensor scratch = torch::empty({numRows * rowBytes}, torch::TensorOptions().dtype(torch::kUInt8));
+    uint8_t* staged = scratch.data_ptr<uint8_t>();
+    uint8_t* values = data + numRows * rowBytes;
+    if (toTokenMajor) {
+        parallel_copy(staged, values, numRows, rowBytes);
+    }
+    const int64_t grain = std::max<int64_t>(1, TILE_BYTES / (2 * rowBytes));
+    for (const auto& [lo, hi] : waves) {
+        at::parallel_for(lo, hi, grain, [&](int64_t begin, int64_t end) {
+            for (int64_t m = begin; m < end; ++m) {
+                uint8_t* key = data + m * rowBytes;
+                uint8_t* pair = data + 2 * m * rowBytes;
+                if (toTokenMajor) {
+                    if (m > 0) {
+                        std::memcpy(pair, key, rowBytes);
+                    }
+                    std::memcpy(pair + rowBytes, staged + m * rowBytes, rowBytes);
+                } else {
+                    std::memcpy(staged + m * rowBytes, pair + rowBytes, rowBytes);
+                    if (m > 0) {
+                        std::memcpy(key, pair, rowBytes);
+                    }
+                }
+            }
+        });
+    }
+    if (!toTokenMajor) {
+        parallel_copy(values, staged, numRows, rowBytes);
+    }
+}
+
+} // namespace
+
+void convert_kv_layout(const torch::Tensor& src, torch::Tensor& dst, const bool to_token_major) {
+    TORCH_CHECK(src.dim() == 4, "src must be [kv, num_layers, num_tokens, hidden] or "
+                                "[num_layers, num_tokens, kv, hidden].");
+    const int64_t numKVs = src.size(to_token_major ? 0 : 2);
+    const int64_t numLayers = src.size(to_token_major ? 1 : 0);
+    const int64_t numTokens = src.size(to_token_major ? 2 : 1);
+    const int64_t hidden = src.size(3);
+    TORCH_CHECK(numKVs == 1 || numKVs == 2, "The kv dimension must be 2, or 1 for MLA.");
+    const std::vector<int64_t> expected = to_token_major
+                                              ? std::vector<int64_t>{numLayers, numTokens, numKVs, hidden}
+                                              : std::vector<int64_t>{numKVs, numLayers, numTokens, hidden};
+    TORCH_CHECK(dst.dim() == 4 && std::equal(expected.begin(), expected.end(), dst.sizes().begin()),
+                "dst must have the converted shape of src.");
+    TORCH_CHECK(dst.scalar_type() == src.scalar_type(), "dst must have the dtype of src.");
+    TORCH_CHECK(src.device() == dst.device(), "src and dst must be on the same device.");
+    TORCH_CHECK(src.stride(-1) == 1 && dst.stride(-1) == 1, "src and dst must be contiguous along hidden.");
+    if (src.numel() == 0) {
+        return;
+    }
+
+    const bool inPlace = src.data_ptr() == dst.data_ptr() && src.is_contiguous() && dst.is_contiguous();
+    const auto [srcFirst, srcLast] = byte_extent(src);
+    const auto [dstFirst, dstLast] = byte_extent(dst);
+    const bool overlap = srcFirst < dstLast && dstFirst < srcLast;
+    TORCH_CHECK(inPlace || !overlap,
+                "dst overlaps src: it must be src itself (both contiguous) or a separate buffer.");
+
+    if (inPlace && numKVs == 1) {
+        // A single K row per token and layer: both layouts are the same bytes
+        return;
+    }
+    if (!src.device().is_cpu()) {
+        // permute + copy_ cannot run in place: it would need a full chunk
+        // temporary on the device, which the caller is better placed to own
+        TORCH_CHECK(!inPlace, "In place conversion is cpu only: pass a separate dst for device tensors.");
+        dst.copy_(to_token_major ? src.permute({1, 2, 0, 3}) : src.permute({2, 0, 1, 3}));
+        return;
+    }
+
+    const int64_t rowBytes = hidden * src.element_size();
+    if (inPlace) {
+        shuffle_in_place(static_cast<uint8_t*>(dst.data_ptr()), numLayers * numTokens, rowBytes, to_token_major);
+        return;
+    }
+    convert_rows(row_layout(src, !to_token_major), row_layout(dst, to_token_major), numKVs, numLayers, numTokens,
+                 rowBytes);
+}
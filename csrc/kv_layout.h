@@ -0,0 +1,27 @@
+#pragma once
+#include <torch/torch.h>
+
+/*
+ * Conversion of a KV chunk between the two layouts the connectors move:
+ *
+ *   layer major  [kv, num_layers, num_tokens, hidden]  (multi_layer_kv_transfer,
+ *                                                       flash ops)
+ *   token major  [num_layers, num_tokens, kv, hidden]  (layer i is the
+ *                                                       [num_tokens, kv, hidden]
+ *                                                       KV_T2D buffer of the
+ *                                                       single layer ops)
+ *
+ * kv is 2, or 1 for MLA. Both sides are sequences of hidden wide rows, so
+ * the conversion is a row interleave: cpu tensors are converted in parallel
+ * tiles of tokens that read kv source streams and write one destination
+ * stream. Device tensors go through permute + copy_.
+ */
+
+// Writes src, converted to token major (to_token_major) or to layer major,
+// to dst. dst has the converted shape and src's dtype, both must be
+// contiguous along hidden. dst may be src itself (a contiguous tensor
+// viewed with the converted shape): cpu tensors are then converted in
+// place with one extra half chunk of scratch instead of a full copy, and
+// MLA chunks need no data movement at all. Device tensors other than MLA
+// chunks cannot be converted in place. Other overlaps are rejected.
+void convert_kv_layout(const torch::Tensor& src, torch::Tensor& dst, const bool to_token_major);
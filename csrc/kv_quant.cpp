@@ -0,0 +1,247 @@
+#include "kv_quant.h"
+#include <ATen/Parallel.h>
+#include <ATen/cpu/vec/vec.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <type_traits>
+
+namespace cpu_ops {
+
+namespace {
+
+using fVec = at::vec::Vectorized<float>;
+
+// Values are widened to float BLOCK at a time so that the scaling runs on
+// float vectors whatever the storage type; a group is read twice (absmax,
+// then scale) and stays in L1 in between.
+constexpr int64_t BLOCK = 64;
+
+template <typename q_t>
+constexpr float QMAX = 0.0f;
+template <>
+constexpr float QMAX<int8_t> = 127.0f;
+template <>
+constexpr float QMAX<c10::Float8_e4m3fn> = 448.0f;
+
+template <typename scalar_t>
+inline void widen(const scalar_t* src, float* dst, int64_t n) {
+    for (int64_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<float>(src[i]);
+    }
+}
+
+// Round half to even like torch.round, saturating at qmax
+template <typename q_t>
+inline q_t narrow(float v) {
+    v = std::min(std::max(v, -QMAX<q_t>), QMAX<q_t>);
+    if constexpr (std::is_same_v<q_t, int8_t>) {
+        return static_cast<int8_t>(std::nearbyint(v));
+    } else {
+        return q_t(v);
+    }
+}
+
+template <typename scalar_t, typename q_t>
+void quantize_row(const uint8_t* srcBytes, uint8_t* dstBytes, float* scales, int64_t hidden, int64_t groupSize) {
+    const scalar_t* src = reinterpret_cast<const scalar_t*>(srcBytes);
+    q_t* dst = reinterpret_cast<q_t*>(dstBytes);
+    alignas(64) float block[BLOCK];
+    alignas(64) float lanes[fVec::size()];
+    for (int64_t group = 0; group * groupSize < hidden; ++group) {
+        const scalar_t* in = src + group * groupSize;
+        q_t* out = dst + group * groupSize;
+
+        fVec absmax(0.0f);
+        for (int64_t i = 0; i < groupSize; i += BLOCK) {
+            const int64_t n = std::min(BLOCK, groupSize - i);
+            widen(in + i, block, n);
+            for (int64_t j = 0; j < n; j += fVec::size()) {
+                // Partial loads are zero filled, harmless for a max of abs
+                absmax = at::vec::maximum(absmax, fVec::loadu(block + j, std::min<int64_t>(fVec::size(), n - j)).abs());
+            }
+        }
+        absmax.store(lanes);
+        const float scale = *std::max_element(lanes, lanes + fVec::size()) / QMAX<q_t>;
+        scales[group] = scale;
+        const fVec inv(scale > 0.0f ? 1.0f / scale : 0.0f);
+
+        for (int64_t i = 0; i < groupSize; i += BLOCK) {
+            const int64_t n = std::min(BLOCK, groupSize - i);
+            widen(in + i, block, n);
+            for (int64_t j = 0; j < n; j += fVec::size()) {
+                const int64_t count = std::min<int64_t>(fVec::size(), n - j);
+                (fVec::loadu(block + j, count) * inv).store(block + j, count);
+            }
+            for (int64_t j = 0; j < n; ++j) {
+                out[i + j] = narrow<q_t>(block[j]);
+            }
+        }
+    }
+}
+
+template <typename q_t, typename scalar_t>
+void dequantize_row(const uint8_t* srcBytes, const float* scales, uint8_t* dstBytes, int64_t hidden,
+                    int64_t groupSize) {
+    const q_t* src = reinterpret_cast<const q_t*>(srcBytes);
+    scalar_t* dst = reinterpret_cast<scalar_t*>(dstBytes);
+    alignas(64) float block[BLOCK];
+    for (int64_t group = 0; group * groupSize < hidden; ++group) {
+        const q_t* in = src + group * groupSize;
+        scalar_t* out = dst + group * groupSize;
+        const fVec scale(scales[group]);
+        for (int64_t i = 0; i < groupSize; i += BLOCK) {
+            const int64_t n = std::min(BLOCK, groupSize - i);
+            widen(in + i, block, n);
+            for (int64_t j = 0; j < n; j += fVec::size()) {
+                const int64_t count = std::min<int64_t>(fVec::size(), n - j);
+                (fVec::loadu(block + j, count) * scale).store(block + j, count);
+            }
+            for (int64_t j = 0; j < n; ++j) {
+                out[i + j] = static_cast<scalar_t>(block[j]);
+            }
+        }
+    }
+}
+
+template <typename q_t>
+QuantizeRowFn quantize_row_for(at::ScalarType srcType) {
+    switch (srcType) {
+        case at::ScalarType::Float:
+            return &quantize_row<float, q_t>;
+        case at::ScalarType::Half:
+            return &quantize_row<c10::Half, q_t>;
+        case at::ScalarType::BFloat16:
+            return &quantize_row<c10::BFloat16, q_t>;
+        default:
+            TORCH_CHECK(false, "KV to quantize must be float32, float16 or bfloat16.");
+    }
+}
+
+template <typename q_t>
+DequantizeRowFn dequantize_row_for(at::ScalarType dstType) {
+    switch (dstType) {
+        case at::ScalarType::Float:
+            return &dequantize_row<q_t, float>;
+        case at::ScalarType::Half:
+            return &dequantize_row<q_t, c10::Half>;
+        case at::ScalarType::BFloat16:
+            return &dequantize_row<q_t, c10::BFloat16>;
+        default:
+            TORCH_CHECK(false, "Dequantized KV must be float32, float16 or bfloat16.");
+    }
+}
+
+// Row count, hidden size and group size of a quantize_kv / dequantize_kv call
+struct QuantGeometry {
+    int64_t rows;
+    int64_t hidden;
+    int64_t groupSize;
+};
+
+QuantGeometry check_quant_args(const torch::Tensor& kv, const torch::Tensor& quantized, const torch::Tensor& scales) {
+    TORCH_CHECK(kv.dim() >= 1 && kv.sizes() == quantized.sizes(),
+                "The quantized tensor must have the shape of the KV tensor.");
+    TORCH_CHECK(scales.dim() == kv.dim() && scales.scalar_type() == at::ScalarType::Float,
+                "scales must be a float32 tensor with the rank of the KV tensor.");
+    for (int64_t dim = 0; dim + 1 < kv.dim(); ++dim) {
+        TORCH_CHECK(scales.size(dim) == kv.size(dim), "scales must match the KV tensor up to the hidden dimension.");
+    }
+    const int64_t hidden = kv.size(-1);
+    const int64_t groups = scales.size(-1);
+    TORCH_CHECK(groups > 0 && hidden % groups == 0, "The hidden size must be a multiple of the number of scales.");
+    quant_max(quantized.scalar_type());
+    return QuantGeometry{hidden == 0 ? 0 : kv.numel() / hidden, hidden, hidden / groups};
+}
+
+} // namespace
+
+QuantizeRowFn quantize_row_fn(at::ScalarType srcType, at::ScalarType qType) {
+    if (qType == at::ScalarType::Char) {
+        return quantize_row_for<int8_t>(srcType);
+    } else if (qType == at::ScalarType::Float8_e4m3fn) {
+        return quantize_row_for<c10::Float8_e4m3fn>(srcType);
+    }
+    TORCH_CHECK(false, "Quantized KV must be int8 or float8_e4m3fn.");
+}
+
+DequantizeRowFn dequantize_row_fn(at::ScalarType qType, at::ScalarType dstType) {
+    if (qType == at::ScalarType::Char) {
+        return dequantize_row_for<int8_t>(dstType);
+    } else if (qType == at::ScalarType::Float8_e4m3fn) {
+        return dequantize_row_for<c10::Float8_e4m3fn>(dstType);
+    }
+    TORCH_CHECK(false, "Quantized KV must be int8 or float8_e4m3fn.");
+}
+
+float quant_max(at::ScalarType qType) {
+    if (qType == at::ScalarType::Char) {
+        return QMAX<int8_t>;
+    } else if (qType == at::ScalarType::Float8_e4m3fn) {
+        return QMAX<c10::Float8_e4m3fn>;
+    }
+    TORCH_CHECK(false, "Quantized KV must be int8 or float8_e4m3fn.");
+}
+
+} // namespace cpu_ops
+
+void quantize_kv(const torch::Tensor& src, torch::Tensor& dst, torch::Tensor& scales) {
+    const cpu_ops::QuantGeometry geometry = cpu_ops::check_quant_args(src, dst, scales);
+    const float qmax = cpu_ops::quant_max(dst.scalar_type());
+    if (!src.device().is_cpu()) {
+        // Same math on the device with torch ops
+        const torch::Tensor groups =
+            src.to(torch::kFloat).unflatten(-1, {scales.size(-1), geometry.groupSize});
+        const torch::Tensor scale = groups.abs().amax({-1}, true) / qmax;
+        torch::Tensor quantized = (groups / scale.clamp_min(FLT_MIN)).clamp(-qmax, qmax);
+        if (dst.scalar_type() == at::ScalarType::Char) {
+            quantized = quantized.round();
+        }
+        dst.copy_(quantized.to(dst.scalar_type()).flatten(-2), /*non_blocking=*/true);
+        scales.copy_(scale.squeeze(-1), /*non_blocking=*/true);
+        return;
+    }
+    TORCH_CHECK(dst.device().is_cpu() && scales.device().is_cpu(), "src on cpu needs dst and scales on cpu.");
+    TORCH_CHECK(src.is_contiguous() && dst.is_contiguous() && scales.is_contiguous(),
+                "quantize_kv needs contiguous cpu tensors.");
+    const cpu_ops::QuantizeRowFn quantize = cpu_ops::quantize_row_fn(src.scalar_type(), dst.scalar_type());
+    const uint8_t* in = static_cast<const uint8_t*>(src.data_ptr());
+    uint8_t* out = static_cast<uint8_t*>(dst.data_ptr());
+    float* rowScales = scales.data_ptr<float>();
+    const int64_t inRowBytes = geometry.hidden * src.element_size();
+    const int64_t groups = scales.size(-1);
+    at::parallel_for(0, geometry.rows, 16, [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+            quantize(in + row * inRowBytes, out + row * geometry.hidden, rowScales + row * groups,
+                     geometry.hidden, geometry.groupSize);
+        }
+    });
+}
+
+void dequantize_kv(const torch::Tensor& src, const torch::Tensor& scales, torch::Tensor& dst) {
+    const cpu_ops::QuantGeometry geometry = cpu_ops::check_quant_args(dst, src, scales);
+    if (!dst.device().is_cpu()) {
+        // Only the 8-bit values and scales are copied to the device
+        const torch::Tensor quantized = src.to(dst.device(), src.scalar_type(), /*non_blocking=*/true);
+        const torch::Tensor scale = scales.to(dst.device(), scales.scalar_type(), /*non_blocking=*/true);
+        const torch::Tensor groups =
+            quantized.to(torch::kFloat).unflatten(-1, {scales.size(-1), geometry.groupSize});
+        dst.copy_((groups * scale.unsqueeze(-1)).flatten(-2));
+        return;
+    }
+    TORCH_CHECK(src.device().is_cpu() && scales.device().is_cpu(), "dst on cpu needs src and scales on cpu.");
+    TORCH_CHECK(src.is_contiguous() && dst.is_contiguous() && scales.is_contiguous(),
+                "dequantize_kv needs contiguous cpu tensors.");
+    const cpu_ops::DequantizeRowFn dequantize = cpu_ops::dequantize_row_fn(src.scalar_type(), dst.scalar_type());
+    const uint8_t* in = static_cast<const uint8_t*>(src.data_ptr());
+    uint8_t* out = static_cast<uint8_t*>(dst.data_ptr());
+    const float* rowScales = scales.data_ptr<float>();
+    const int64_t outRowBytes = geometry.hidden * dst.element_size();
+    const int64_t groups = scales.size(-1);
+    at::parallel_for(0, geometry.rows, 16, [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+            dequantize(in + row * geometry.hidden, rowScales + row * groups, out + row * outRowBytes,
+                       geometry.hidden, geometry.groupSize);
+        }
+    });
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <torch/torch.h>
+
+/*
+ * 8-bit host format of the KV cache.
+ *
+ * A row of hidden values is split in groups (one per token, or one per head
+ * with num_heads groups), each stored as int8 or float8_e4m3fn values q and
+ * a float32 scale next to them: x ~= q * scale, scale = absmax / qmax.
+ * Scales tensors have the shape of the KV tensor with the hidden dimension
+ * replaced by the number of groups, so the group size is implied by them.
+ */
+namespace cpu_ops {
+
+// Quantizes / dequantizes one row of hidden values, groupSize per scale
+using QuantizeRowFn = void (*)(const uint8_t* src, uint8_t* dst, float* scales, int64_t hidden,
+                               int64_t groupSize);
+using DequantizeRowFn = void (*)(const uint8_t* src, const float* scales, uint8_t* dst, int64_t hidden,
+                                 int64_t groupSize);
+
+QuantizeRowFn quantize_row_fn(at::ScalarType srcType, at::ScalarType qType);
+DequantizeRowFn dequantize_row_fn(at::ScalarType qType, at::ScalarType dstType);
+
+// Largest magnitude of a quantized dtype, int8 or float8_e4m3fn
+float quant_max(at::ScalarType qType);
+
+} // namespace cpu_ops
+
+// dst (int8 / float8_e4m3fn) and scales (float32, [..., num_groups]) from
+// src (float32 / fp16 / bf16, [..., hidden]). Computed on the device of src:
+// with src on the NPU only the 8-bit values and scales cross to the host.
+void quantize_kv(const torch::Tensor& src, torch::Tensor& dst, torch::Tensor& scales);
+
+// Inverse of quantize_kv, computed on the device of dst.
+void dequantize_kv(const torch::Tensor& src, const torch::Tensor& scales, torch::Tensor& dst);
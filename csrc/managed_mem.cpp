@@ -8,16 +8,38 @@
 #endif
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 #include <torch_npu/csrc/core/npu/NPUStream.h>
 #include "driver/ascend_hal_define.h"
 #include "driver/ascend_hal.h"
+#include <dirent.h>
 #include <dlfcn.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
 #include "torch/torch.h"
 #include "torch/extension.h"
 
 namespace lmc {
 constexpr int32_t PROT_FLAGS = static_cast<int32_t>(PROT_READ) | static_cast<int32_t>(PROT_WRITE);
-constexpr int32_t MAP_FLAGS = static_cast<int32_t>(MAP_PRIVATE) | static_cast<int32_t>(MAP_ANONYMOUS) | static_cast<int32_t>(MAP_POPULATE);
+// No MAP_POPULATE: the huge page advice has to be given before the first
+// fault, and the pages are then faulted in by populateHostMemory
+constexpr int32_t MAP_FLAGS = static_cast<int32_t>(MAP_PRIVATE) | static_cast<int32_t>(MAP_ANONYMOUS);
+// Unit of work of the first-touch threads
+constexpr size_t POPULATE_CHUNK_BYTES = 64UL << 20;
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+// hugetlb mappings have to be unmapped with a length aligned to their page size
+inline size_t mappedSize(size_t bufferSize, size_t hugePageSize) {
+    return hugePageSize == 0 ? bufferSize : (bufferSize + hugePageSize - 1) / hugePageSize * hugePageSize;
+}
 
 // Signatures for internal helper functions
 
@@ -31,6 +53,28 @@ int get_device();
 void unregisterPtr(void* ptr);
 // Swaps the host memory allocated to a tensor with the given hostPtr
 void swap_tensor_ptr(void* hostPtr, torch::Tensor& original_tensor);
+// Maps bufferSize bytes of anonymous memory, backed by hugetlb pages of
+// hugePageSize bytes (or advised as transparent huge pages when 0), placed on
+// numaNode (when >= 0, strictly with strictNuma) and faulted in by
+// populateThreads threads.
+// numaNode is reset to -1 if the policy could not be set, hugePageSize to 0
+// if no hugetlb page of that size could be reserved.
+void* mapHostMemory(size_t bufferSize, int populateThreads, int& numaNode, bool strictNuma, size_t& hugePageSize);
+// Maps bufferSize bytes backed by hugetlb pages of hugePageSize bytes, nullptr on failure
+void* mapHugetlb(size_t bufferSize, size_t hugePageSize);
+// Places [hostPtr, hostPtr + bufferSize) on numaNode, returns false on failure.
+// MPOL_PREFERRED by default: pages go to the node while it has free memory and
+// spill to the others instead of OOM killing the worker. strict uses MPOL_BIND.
+bool bindToNumaNode(void* hostPtr, size_t bufferSize, int numaNode, bool strict);
+// Free hugetlb pages of hugePageSize bytes on numaNode, -1 if unknown
+int64_t freeHugePagesOnNode(int numaNode, size_t hugePageSize);
+// Places the area on numaNode (see bindToNumaNode) and populates it, returns
+// false if a hugetlb page could not be faulted in
+bool placeAndPopulate(void* hostPtr, size_t bufferSize, int populateThreads, int& numaNode, bool strictNuma,
+                      size_t hugePageSize);
+// First-touches every page of [hostPtr, hostPtr + bufferSize) in parallel.
+// With hugetlb, returns false if a page could not be faulted in.
+bool populateHostMemory(void* hostPtr, size_t bufferSize, int populateThreads, size_t pageSize, bool hugetlb);
 
 // Class implementations
 
@@ -47,11 +91,17 @@ void HostRegisteredMemoryManager::unregisterAll(){
     // Iterate through each key-value pair in the map.
     for (const auto& pair : this->allocatedMap) {
         void* hostPtr = pair.first;
-        aclrtHostUnregister(hostPtr);
+        memoryStats().removeRegion(pair.second.device, pair.second.buffSize, pair.second.viaHal);
+        if (pair.second.viaHal) {
+            halHostUnregisterEx(hostPtr, static_cast<UINT32>(get_device()), HOST_MEM_MAP_DEV_PCIE_TH);
+        } else {
+            aclrtHostUnregister(hostPtr);
+        }
     }
 
     // After unregistering all pointers, clear the map completely.
     this->allocatedMap.clear();
+    this->regionIndex.publish(this->allocatedMap);
 };
 
 // Register a pointer through high level APIs (aclrt) return devPtr
@@ -66,12 +116,60 @@ RegisteredMemoryRecord HostRegisteredMemoryManager::registerHostPtr(void* hostPt
     }
     
     void* devPtr;
-    aclError err = aclrtHostRegister(hostPtr, static_cast<uint64_t>(bufferSize), 
-        ACL_HOST_REGISTER_MAPPED, (void**)&devPtr);
-    TORCH_CHECK(err == 0, "Unable to host register the host ptr: " + std::to_string(err));
+    aclError err;
+    {
+        ScopedLatency timer(memoryStats().aclRegisterUs);
+        err = aclrtHostRegister(hostPtr, static_cast<uint64_t>(bufferSize),
+            ACL_HOST_REGISTER_MAPPED, (void**)&devPtr);
+    }
+    if (err != 0) {
+        memoryStats().registerFailures++;
+        TORCH_CHECK(false, "Unable to host register the host ptr: " + std::to_string(err));
+    }
+
+    RegisteredMemoryRecord record{reinterpret_cast<uintptr_t>(hostPtr),
+            reinterpret_cast<uintptr_t>(devPtr), bufferSize};
+    record.device = get_device();
+    this->allocatedMap.emplace(hostPtr, record);
+    this->regionIndex.publish(this->allocatedMap);
+    memoryStats().aclRegistrations++;
+    memoryStats().addRegion(record.device, bufferSize, false);
+
+    return this->allocatedMap[hostPtr];
+};
+
+// Register a pointer through high level APIs (aclrt) on memory we map and populate ourselves
+// Returns the created RegisteredMemoryRecord, release it with releaseHostPtr()
+RegisteredMemoryRecord HostRegisteredMemoryManager::allocRegisterHostPtr(size_t bufferSize, int populateThreads,
+                                                                        int numaNode, bool strictNuma,
+                                                                        size_t hugePageSize){
+    TORCH_CHECK(bufferSize > 0, "Error: bufferSize must be greater than 0.");
+    // Mapping and populating is the slow part, no need to hold the lock for it
+    void* hostPtr = mapHostMemory(bufferSize, populateThreads, numaNode, strictNuma, hugePageSize);
+    const std::unique_lock<std::shared_mutex> guard(this->mux);
+
+    void* devPtr;
+    aclError err;
+    {
+        ScopedLatency timer(memoryStats().aclRegisterUs);
+        err = aclrtHostRegister(hostPtr, static_cast<uint64_t>(bufferSize),
+            ACL_HOST_REGISTER_MAPPED, (void**)&devPtr);
+    }
+    if (err != 0) {
+        memoryStats().registerFailures++;
+        munmap(hostPtr, mappedSize(bufferSize, hugePageSize));
+        TORCH_CHECK(false, "Unable to host register the host ptr: " + std::to_string(err));
+    }
 
-    this->allocatedMap.emplace(hostPtr, RegisteredMemoryRecord{reinterpret_cast<uintptr_t>(hostPtr), 
-            reinterpret_cast<uintptr_t>(devPtr), bufferSize});
+    RegisteredMemoryRecord record{reinterpret_cast<uintptr_t>(hostPtr),
+        reinterpret_cast<uintptr_t>(devPtr), bufferSize};
+    record.numaNode = numaNode;
+    record.hugePageSize = hugePageSize;
+    record.device = get_device();
+    this->allocatedMap.emplace(hostPtr, record);
+    this->regionIndex.publish(this->allocatedMap);
+    memoryStats().aclRegistrations++;
+    memoryStats().addRegion(record.device, bufferSize, false);
 
     return this->allocatedMap[hostPtr];
 };
@@ -79,42 +177,89 @@ RegisteredMemoryRecord HostRegisteredMemoryManager::registerHostPtr(void* hostPt
 // Register a pointer through low level APIs (HAL). Allocates a new pinned host memory
 // This should be used for driver versions, where cannot rely on aclrtHostRegister()
 // Returns the created RegisteredMemoryRecord
-RegisteredMemoryRecord HostRegisteredMemoryManager::halRegisterHostPtr(size_t bufferSize){
+RegisteredMemoryRecord HostRegisteredMemoryManager::halRegisterHostPtr(size_t bufferSize, int populateThreads,
+                                                                      int numaNode, bool strictNuma,
+                                                                      size_t hugePageSize){
     // We allocate a new chunk of memory, register it, and replace the tensor.
     // Essentially, the halHostRegister function requires a ptr given by mmap.
-    TORCH_CHECK((bufferSize >= 0), "Error: bufferSize must be greater than 0.");
+    TORCH_CHECK(bufferSize > 0, "Error: bufferSize must be greater than 0.");
+    // Allocate before taking the lock, populating a large pool takes a while
+    void* hostPtr = mapHostMemory(bufferSize, populateThreads, numaNode, strictNuma, hugePageSize);
     const std::unique_lock<std::shared_mutex> guard(this->mux);
 
     void* devPtr;
     int device = get_device();
-    void* hostPtr;
-    // Allocate and register
-    hostPtr = mmap(nullptr, bufferSize, PROT_FLAGS, MAP_FLAGS, -1, 0);
-    TORCH_CHECK(hostPtr != MAP_FAILED, "Unable to alloc memory with mmap.");
-    auto ret = madvise(reinterpret_cast<void*>(hostPtr), bufferSize, MADV_HUGEPAGE);
-    auto drvRet = halHostRegister((void*)hostPtr, static_cast<UINT64>(bufferSize),
-        HOST_MEM_MAP_DEV_PCIE_TH, (UINT32)device, (void**)&devPtr);
-    TORCH_CHECK(drvRet == 0, "Unable to register host memory with hal: " + std::to_string(drvRet))
+    drvError_t drvRet;
+    {
+        ScopedLatency timer(memoryStats().halRegisterUs);
+        drvRet = halHostRegister((void*)hostPtr, static_cast<UINT64>(bufferSize),
+            HOST_MEM_MAP_DEV_PCIE_TH, (UINT32)device, (void**)&devPtr);
+    }
+    if (drvRet != 0) {
+        memoryStats().registerFailures++;
+        munmap(hostPtr, mappedSize(bufferSize, hugePageSize));
+        TORCH_CHECK(false, "Unable to register host memory with hal: " + std::to_string(drvRet))
+    }
 
     // Lock the memory and fail if impossible to lock
-    auto lockErr = mlock(reinterpret_cast<void*>(hostPtr), bufferSize);
+    int lockErr;
+    {
+        ScopedLatency timer(memoryStats().mlockUs);
+        lockErr = mlock(reinterpret_cast<void*>(hostPtr), bufferSize);
+    }
     if (lockErr == -1) {
-        // This can happen in non-privileged mode or not enough rlimit, 
+        memoryStats().registerFailures++;
+        // This can happen in non-privileged mode or not enough rlimit,
         // let's not proceed since we wanted to guarantee pinned
         // because we already alloced, let's free
-        auto ret = halHostUnregisterEx(reinterpret_cast<void*>(hostPtr), 
+        auto ret = halHostUnregisterEx(reinterpret_cast<void*>(hostPtr),
             static_cast<UINT32>(device), HOST_MEM_MAP_DEV_PCIE_TH);
         TORCH_CHECK(ret==0, "Unable to pin host memory, unable to unregister. Error code: " + std::to_string(ret))
-        auto mret = munmap(reinterpret_cast<void*>(hostPtr), bufferSize);
+        auto mret = munmap(reinterpret_cast<void*>(hostPtr), mappedSize(bufferSize, hugePageSize));
         TORCH_CHECK(false, "Unable to pin host memory with error code: " + std::to_string(lockErr))
     }
-    
-    this->allocatedMap.emplace(hostPtr, RegisteredMemoryRecord{reinterpret_cast<uintptr_t>(hostPtr), 
-        reinterpret_cast<uintptr_t>(devPtr), bufferSize});
+
+    RegisteredMemoryRecord record{reinterpret_cast<uintptr_t>(hostPtr),
+        reinterpret_cast<uintptr_t>(devPtr), bufferSize};
+    record.viaHal = true;
+    record.numaNode = numaNode;
+    record.hugePageSize = hugePageSize;
+    record.device = device;
+    this->allocatedMap.emplace(hostPtr, record);
+    this->regionIndex.publish(this->allocatedMap);
+    memoryStats().halRegistrations++;
+    memoryStats().addRegion(device, bufferSize, true);
 
     return this->allocatedMap[hostPtr];
 };
 
+// Unregisters and unmaps an area created by allocRegisterHostPtr() or halRegisterHostPtr()
+void HostRegisteredMemoryManager::releaseHostPtr(void* hostPtr) {
+    TORCH_CHECK(hostPtr != nullptr, "Error: hostPtr cannot be null.");
+    const std::unique_lock<std::shared_mutex> guard(this->mux);
+    auto it = this->allocatedMap.find(hostPtr);
+    if (it == this->allocatedMap.end()) {
+        return;
+    }
+    const RegisteredMemoryRecord record = it->second;
+    memoryStats().removeRegion(record.device, record.buffSize, record.viaHal);
+    if (record.viaHal) {
+        auto ret = halHostUnregisterEx(hostPtr, static_cast<UINT32>(get_device()), HOST_MEM_MAP_DEV_PCIE_TH);
+        if (ret != 0) {
+            std::cout << "Unable to hal host unregister: "<< ret << std::endl;
+        }
+    } else {
+        aclrtHostUnregister(hostPtr);
+    }
+    this->allocatedMap.erase(it);
+    this->regionIndex.publish(this->allocatedMap);
+
+    auto mret = munmap(hostPtr, mappedSize(record.buffSize, record.hugePageSize));
+    if (mret != 0) {
+        std::cout << "Unable to unmap memory: "<< mret << std::endl;
+    }
+};
+
 void HostRegisteredMemoryManager::unregisterMemory(void* hostPtr) {
     TORCH_CHECK(hostPtr != nullptr, "Error: hostPtr cannot be null.");
     
@@ -122,36 +267,33 @@ void HostRegisteredMemoryManager::unregisterMemory(void* hostPtr) {
     // at context destroy it should be unregister anyway.
     const std::unique_lock<std::shared_mutex> guard(this->mux);
     aclError err = aclrtHostUnregister(hostPtr);
-    this->allocatedMap.erase(hostPtr);
+    auto it = this->allocatedMap.find(hostPtr);
+    if (it != this->allocatedMap.end()) {
+        memoryStats().removeRegion(it->second.device, it->second.buffSize, it->second.viaHal);
+        this->allocatedMap.erase(it);
+        this->regionIndex.publish(this->allocatedMap);
+    }
 };
 
 /*
-*    For now we only do a linear search as we probably won't have a long list of ptrs
-*    we go through each record and check whether we are in range, if so
-*    we calculate the offset from the host ptr and apply to the device ptr
-*    finally we return the device ptr.
+*    Lookups run on every kernel launch, once per tensor argument, so they go
+*    through the lock-free regionIndex instead of taking mux: we find the
+*    record whose range contains the host ptr, calculate the offset from the
+*    host ptr and apply it to the device ptr.
 */
 void* HostRegisteredMemoryManager::getDevicePtr(void* hostPtr) {
     if (hostPtr == nullptr) {
         return nullptr;
     }
-    const std::shared_lock<std::shared_mutex> guard(this->mux);
-    
     const uintptr_t hostAddrPtr = reinterpret_cast<uintptr_t>(hostPtr);
-
-    for (const auto& pair: this->allocatedMap) {
-        const RegisteredMemoryRecord& record = pair.second;
-
-        if (hostAddrPtr >= record.ptr && hostAddrPtr < (record.ptr + record.buffSize)) {
-            const size_t offset = hostAddrPtr - record.ptr;
-
-            const uintptr_t deviceAddrPtr = record.devptr + offset;
-
-            return reinterpret_cast<void*>(deviceAddrPtr);
-        }
+    const RegisteredMemoryRecord* record = this->regionIndex.find(hostAddrPtr);
+    memoryStats().lookups.add();
+    if (record == nullptr) {
+        memoryStats().lookupMisses.add();
+        return nullptr;
     }
-
-    return nullptr;
+    const size_t offset = hostAddrPtr - record->ptr;
+    return reinterpret_cast<void*>(record->devptr + offset);
 };
 
 
@@ -159,18 +301,24 @@ size_t HostRegisteredMemoryManager::getRecordSize(void* hostPtr){
     if (hostPtr == nullptr) {
         return 0;
     }
-    const std::shared_lock<std::shared_mutex> guard(this->mux);
-    
-    const uintptr_t hostAddrPtr = reinterpret_cast<uintptr_t>(hostPtr);
+    const RegisteredMemoryRecord* record = this->regionIndex.find(reinterpret_cast<uintptr_t>(hostPtr));
+    return record == nullptr ? 0 : record->buffSize;
+};
 
-    for (const auto& pair: this->allocatedMap) {
-        const RegisteredMemoryRecord& record = pair.second;
+size_t HostRegisteredMemoryManager::getRecordHugePageSize(void* hostPtr){
+    if (hostPtr == nullptr) {
+        return 0;
+    }
+    const RegisteredMemoryRecord* record = this->regionIndex.find(reinterpret_cast<uintptr_t>(hostPtr));
+    return record == nullptr ? 0 : record->hugePageSize;
+};
 
-        if (hostAddrPtr >= record.ptr && hostAddrPtr < (record.ptr + record.buffSize)) {
-            return record.buffSize;
-        }
+int HostRegisteredMemoryManager::getRecordNumaNode(void* hostPtr){
+    if (hostPtr == nullptr) {
+        return -1;
     }
-    return 0;
+    const RegisteredMemoryRecord* record = this->regionIndex.find(reinterpret_cast<uintptr_t>(hostPtr));
+    return record == nullptr ? -1 : record->numaNode;
 };
 
 std::string get_driver_version() {
@@ -262,21 +410,250 @@ int get_device(){
 
 void unregisterPtr(void* ptr) {
     if (ptr){
-        int device = get_device();
         auto& hmm = HostRegisteredMemoryManager::GetInstance();
-        size_t bufferSize = hmm.getRecordSize(ptr);
-        auto ret = halHostUnregisterEx(reinterpret_cast<void*>(ptr), 
-            static_cast<UINT32>(device), HOST_MEM_MAP_DEV_PCIE_TH);
-        if (ret != 0) {
-            std::cout << "Unable to hal host unregister: "<< ret << std::endl;
+        hmm.releaseHostPtr(ptr);
+    }
+}
+
+/*
+*    A hugetlb mapping only reserves pages from the system wide pool, the
+*    node policy is applied when the pages are faulted in. Strictly bound to a
+*    node short of free huge pages, the first touch of a page that node cannot
+*    back would raise SIGBUS. So the node is checked before mapping, and the
+*    pages are faulted in with MADV_POPULATE_WRITE, which fails with an error
+*    instead (pages taken by someone else meanwhile). Either way the area
+*    falls back on THP before it is registered.
+*/
+void* mapHostMemory(size_t bufferSize, int populateThreads, int& numaNode, bool strictNuma, size_t& hugePageSize) {
+    if (hugePageSize != 0) {
+        const int64_t neededPages = static_cast<int64_t>(mappedSize(bufferSize, hugePageSize) / hugePageSize);
+        const int64_t freePages = numaNode >= 0 && strictNuma ? freeHugePagesOnNode(numaNode, hugePageSize) : -1;
+        if (freePages >= 0 && freePages < neededPages) {
+            std::cout << "NUMA node " << numaNode << " has " << freePages << " free " << hugePageSize
+                      << " bytes hugetlb pages, " << neededPages << " needed." << std::endl;
+        } else if (void* hostPtr = mapHugetlb(bufferSize, hugePageSize)) {
+            if (placeAndPopulate(hostPtr, bufferSize, populateThreads, numaNode, strictNuma, hugePageSize)) {
+                return hostPtr;
+            }
+            std::cout << "Unable to fault in " << bufferSize << " bytes of " << hugePageSize
+                      << " bytes hugetlb pages on NUMA node " << numaNode << ", errno: " << errno << "." << std::endl;
+            munmap(hostPtr, mappedSize(bufferSize, hugePageSize));
+        } else {
+            std::cout << "Unable to map " << bufferSize << " bytes of " << hugePageSize
+                      << " bytes hugetlb pages, errno: " << errno << "." << std::endl;
+        }
+        std::cout << "Falling back to transparent huge pages." << std::endl;
+        memoryStats().hugetlbFallbacks++;
+        hugePageSize = 0;
+    }
+    void* hostPtr = mmap(nullptr, bufferSize, PROT_FLAGS, MAP_FLAGS, -1, 0);
+    TORCH_CHECK(hostPtr != MAP_FAILED, "Unable to alloc memory with mmap.");
+    // Best effort, THP may be disabled
+    madvise(hostPtr, bufferSize, MADV_HUGEPAGE);
+    placeAndPopulate(hostPtr, bufferSize, populateThreads, numaNode, strictNuma, 0);
+    return hostPtr;
+}
+
+bool placeAndPopulate(void* hostPtr, size_t bufferSize, int populateThreads, int& numaNode, bool strictNuma,
+                      size_t hugePageSize) {
+    // The policy has to be in place before the first touch, the populate
+    // threads run wherever the scheduler puts them
+    if (numaNode >= 0 && !bindToNumaNode(hostPtr, mappedSize(bufferSize, hugePageSize), numaNode, strictNuma)) {
+        std::cout << "Unable to bind host memory to NUMA node " << numaNode
+                  << ", errno: " << errno << std::endl;
+        memoryStats().numaBindFailures++;
+        numaNode = -1;
+    }
+    ScopedLatency timer(memoryStats().populateUs);
+    return populateHostMemory(hostPtr, mappedSize(bufferSize, hugePageSize), populateThreads,
+        hugePageSize != 0 ? hugePageSize : static_cast<size_t>(sysconf(_SC_PAGESIZE)), hugePageSize != 0);
+}
+
+int64_t freeHugePagesOnNode(int numaNode, size_t hugePageSize) {
+    std::ifstream freeFile("/sys/devices/system/node/node" + std::to_string(numaNode) + "/hugepages/hugepages-" +
+                           std::to_string(hugePageSize >> 10) + "kB/free_hugepages");
+    int64_t freePages = -1;
+    if (!(freeFile >> freePages)) {
+        return -1;
+    }
+    return freePages;
+}
+
+/*
+*    Explicit hugetlb pages come from the pool reserved by the admin
+*    (vm.nr_hugepages or /sys/kernel/mm/hugepages/hugepages-<size>kB), the
+*    mapping fails with ENOMEM right away when the pool is too small, so the
+*    caller can fall back on THP before anything was touched. The pool is
+*    global, whether the pages exist on a given node is only known when they
+*    are faulted in (see mapHostMemory).
+*/
+void* mapHugetlb(size_t bufferSize, size_t hugePageSize) {
+    TORCH_CHECK(hugePageSize != 0 && (hugePageSize & (hugePageSize - 1)) == 0,
+                "Huge page size must be a power of 2.");
+    const int pageShift = __builtin_ctzll(hugePageSize);
+    const int flags = MAP_FLAGS | MAP_HUGETLB | (pageShift << MAP_HUGE_SHIFT);
+    void* hostPtr = mmap(nullptr, mappedSize(bufferSize, hugePageSize), PROT_FLAGS, flags, -1, 0);
+    return hostPtr == MAP_FAILED ? nullptr : hostPtr;
+}
+
+// Raw syscall, libnuma is not a dependency of the extension
+bool bindToNumaNode(void* hostPtr, size_t bufferSize, int numaNode, bool strict) {
+    constexpr size_t BITS = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> nodemask(numaNode / BITS + 1, 0);
+    nodemask[numaNode / BITS] = 1UL << (numaNode % BITS);
+    // maxnode counts one past the last bit the kernel reads
+    const unsigned long maxnode = nodemask.size() * BITS + 1;
+    const int mode = strict ? MPOL_BIND : MPOL_PREFERRED;
+    return syscall(SYS_mbind, hostPtr, bufferSize, mode, nodemask.data(), maxnode, 0) == 0;
+}
+
+/*
+*    The NUMA node of a device is the one of its PCIe slot: dsmi gives the
+*    domain/bus/device/function of the device, sysfs gives the node of the
+*    slot. Drivers without dsmi_get_device_pcie_info_v2 give no domain, the
+*    slot is then looked up in sysfs and only used if a single domain has it.
+*    Returns -1 when unknown (single socket machines report -1 as well).
+*/
+int get_device_numa_node(int device) {
+    struct DsmiPcieInfo {
+        unsigned int deviceid;
+        unsigned int venderid;
+        unsigned int subvenderid;
+        unsigned int subdeviceid;
+        unsigned int bdf_deviceid;
+        unsigned int bdf_busid;
+        unsigned int bdf_funcid;
+    };
+    struct DsmiPcieInfoAll {
+        unsigned int deviceid;
+        unsigned int venderid;
+        unsigned int subvenderid;
+        unsigned int subdeviceid;
+        int domain;
+        unsigned int bdf_busid;
+        unsigned int bdf_deviceid;
+        unsigned int bdf_funcid;
+        unsigned char reserve[32];
+    };
+    int (*dsmi_get_device_pcie_info)(int, DsmiPcieInfo*) = nullptr;
+    int (*dsmi_get_device_pcie_info_v2)(int, DsmiPcieInfoAll*) = nullptr;
+
+    void* handle = dlopen("libdrvdsmi_host.so", RTLD_LAZY);
+    if (!handle) {
+        return -1;
+    }
+    *(void**) (&dsmi_get_device_pcie_info_v2) = dlsym(handle, "dsmi_get_device_pcie_info_v2");
+    *(void**) (&dsmi_get_device_pcie_info) = dlsym(handle, "dsmi_get_device_pcie_info");
+    int domain = -1;
+    unsigned int bus = 0;
+    unsigned int dev = 0;
+    unsigned int func = 0;
+    int ret = -1;
+    if (dsmi_get_device_pcie_info_v2) {
+        DsmiPcieInfoAll info{};
+        ret = dsmi_get_device_pcie_info_v2(device, &info);
+        domain = info.domain;
+        bus = info.bdf_busid;
+        dev = info.bdf_deviceid;
+        func = info.bdf_funcid;
+    } else if (dsmi_get_device_pcie_info) {
+        DsmiPcieInfo info{};
+        ret = dsmi_get_device_pcie_info(device, &info);
+        bus = info.bdf_busid;
+        dev = info.bdf_deviceid;
+        func = info.bdf_funcid;
+    }
+    dlclose(handle);
+    if (ret != 0) {
+        return -1;
+    }
+
+    const std::string devicesDir = "/sys/bus/pci/devices/";
+    std::string slot;
+    char bdf[32];
+    if (domain >= 0) {
+        snprintf(bdf, sizeof(bdf), "%04x:%02x:%02x.%x", domain, bus, dev, func);
+        slot = bdf;
+    } else {
+        // Entries are <domain>:<bus>:<device>.<function>
+        snprintf(bdf, sizeof(bdf), ":%02x:%02x.%x", bus, dev, func);
+        const std::string suffix = bdf;
+        int matches = 0;
+        if (DIR* dir = opendir(devicesDir.c_str())) {
+            while (const dirent* entry = readdir(dir)) {
+                const std::string name = entry->d_name;
+                if (name.size() > suffix.size() &&
+                    name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                    slot = name;
+                    matches++;
+                }
+            }
+            closedir(dir);
         }
-        auto mret = munmap(reinterpret_cast<void*>(ptr), bufferSize);
-        if (mret != 0) {
-            std::cout << "Unable to unmap memory: "<< ret << std::endl;
+        if (matches != 1) {
+            return -1;
         }
     }
+    std::ifstream numaFile(devicesDir + slot + "/numa_node");
+    int numaNode = -1;
+    if (!(numaFile >> numaNode)) {
+        return -1;
+    }
+    return numaNode;
 }
 
+/*
+*    Page faults are most of the startup time of a large pool and they scale
+*    with the number of faulting threads, so the area is cut in
+*    POPULATE_CHUNK_BYTES chunks handed out to the threads through a counter.
+*    Writing one byte per base page is enough: with THP the first write to a
+*    huge page faults all of it in and the following ones are plain stores.
+*    hugetlb pages are faulted in with MADV_POPULATE_WRITE so that a page
+*    the node cannot back is an error rather than SIGBUS; kernels before 5.14
+*    do not have it (EINVAL) and the pages are then touched.
+*/
+bool populateHostMemory(void* hostPtr, size_t bufferSize, int populateThreads, size_t pageSize, bool hugetlb) {
+    const size_t chunkBytes = std::max(POPULATE_CHUNK_BYTES, pageSize);
+    const size_t numChunks = (bufferSize + chunkBytes - 1) / chunkBytes;
+    const size_t numThreads = std::min<size_t>(std::max(populateThreads, 1), numChunks);
+    volatile uint8_t* base = static_cast<volatile uint8_t*>(hostPtr);
+    std::atomic<size_t> nextChunk{0};
+    std::atomic<bool> failed{false};
+    std::atomic<int> error{0};
+
+    auto worker = [&]() {
+        for (size_t chunk = nextChunk++; chunk < numChunks && !failed; chunk = nextChunk++) {
+            const size_t begin = chunk * chunkBytes;
+            const size_t end = std::min(bufferSize, begin + chunkBytes);
+            if (hugetlb) {
+                if (madvise(const_cast<uint8_t*>(base) + begin, end - begin, MADV_POPULATE_WRITE) == 0) {
+                    continue;
+                }
+                if (errno != EINVAL) {
+                    error = errno;
+                    failed = true;
+                    return;
+                }
+            }
+            for (size_t offset = begin; offset < end; offset += pageSize) {
+                base[offset] = 0;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        errno = error;
+    }
+    return !failed;
+}
 
 void swap_tensor_ptr(void* hostPtr, torch::Tensor& original_tensor){
     torch::TensorOptions tensorOpsCpu = torch::TensorOptions()
@@ -308,7 +685,9 @@ void* register_memory(torch::Tensor& tensor) {
         return (void*) hmm.registerHostPtr(hostPtr, tensorSize).devptr;
     } else { // Old driver version, does not support aclrtHostRegister(), we have to use HAL.
         // We ask for a new registerd memory and substitute with the previously allocated.
-        lmc::RegisteredMemoryRecord record = hmm.halRegisterHostPtr(tensorSize);
+        int device = lmc::get_device();
+        lmc::RegisteredMemoryRecord record = hmm.halRegisterHostPtr(tensorSize, 1,
+            lmc::get_device_numa_node(device), false, 0);
         lmc::swap_tensor_ptr((void*) record.ptr, tensor);
         return (void*) record.devptr;
     }
@@ -320,6 +699,95 @@ void unregister_memory(torch::Tensor& tensor) {
     hmm.unregisterMemory(hostPtr);
 };
 
+torch::Tensor alloc_pinned_memory(int64_t size, int64_t populate_threads, int64_t numa_node,
+                                  int64_t huge_page_size, bool strict_numa) {
+    TORCH_CHECK(size > 0, "size must be greater than 0.");
+    TORCH_CHECK(huge_page_size >= 0, "huge_page_size must not be negative.");
+    auto& hmm = lmc::HostRegisteredMemoryManager::GetInstance();
+    const size_t bufferSize = static_cast<size_t>(size);
+    const int populateThreads = static_cast<int>(populate_threads > 0 ?
+        populate_threads : std::thread::hardware_concurrency());
+    const int numaNode = static_cast<int>(numa_node == lmc::NUMA_NODE_LOCAL ?
+        lmc::get_device_numa_node(lmc::get_device()) : numa_node);
+    lmc::RegisteredMemoryRecord record = lmc::is_version_at_least_25(lmc::get_driver_version()) ?
+        hmm.allocRegisterHostPtr(bufferSize, populateThreads, numaNode, strict_numa, huge_page_size) :
+        hmm.halRegisterHostPtr(bufferSize, populateThreads, numaNode, strict_numa, huge_page_size);
+
+    torch::TensorOptions tensorOpsCpu = torch::TensorOptions()
+                                                .dtype(torch::kUInt8)
+                                                .device(torch::kCPU)
+                                                .pinned_memory(true);
+    return torch::from_blob(reinterpret_cast<void*>(record.ptr), {size}, lmc::unregisterPtr, tensorOpsCpu);
+};
+
+int get_host_numa_node(torch::Tensor& tensor) {
+    auto& hmm = lmc::HostRegisteredMemoryManager::GetInstance();
+    return hmm.getRecordNumaNode(tensor.data_ptr());
+};
+
+int64_t get_host_huge_page_size(torch::Tensor& tensor) {
+    auto& hmm = lmc::HostRegisteredMemoryManager::GetInstance();
+    return static_cast<int64_t>(hmm.getRecordHugePageSize(tensor.data_ptr()));
+};
+
+int device_numa_node() {
+    return lmc::get_device_numa_node(lmc::get_device());
+};
+
+int physical_device() {
+    return lmc::get_device();
+};
+
+namespace {
+
+py::dict histogram_to_dict(const lmc::LatencyHistogram& histogram) {
+    py::list buckets;
+    for (const auto& bucket : histogram.buckets) {
+        buckets.append(bucket.load(std::memory_order_relaxed));
+    }
+    py::dict result;
+    result["count"] = histogram.count.load(std::memory_order_relaxed);
+    result["total_us"] = histogram.totalUs.load(std::memory_order_relaxed);
+    result["max_us"] = histogram.maxUs.load(std::memory_order_relaxed);
+    // buckets[i] counts the samples in [2^(i-1), 2^i) us, buckets[0] those under 1 us
+    result["buckets"] = buckets;
+    return result;
+}
+
+} // namespace
+
+py::dict memory_stats() {
+    const lmc::MemoryStats& stats = lmc::memoryStats();
+    py::dict devices;
+    for (int device = 0; device < lmc::MemoryStats::MAX_DEVICES; ++device) {
+        const int64_t acl = stats.aclBytes[device].load(std::memory_order_relaxed);
+        const int64_t hal = stats.halBytes[device].load(std::memory_order_relaxed);
+        if (acl != 0 || hal != 0) {
+            py::dict entry;
+            entry["registered_bytes"] = acl + hal;
+            entry["acl_bytes"] = acl;
+            entry["hal_bytes"] = hal;
+            devices[py::int_(device)] = entry;
+        }
+    }
+
+    py::dict result;
+    result["devices"] = devices;
+    result["registered_regions"] = stats.registeredRegions.load(std::memory_order_relaxed);
+    result["lookups"] = stats.lookups.value();
+    result["lookup_misses"] = stats.lookupMisses.value();
+    result["acl_registrations"] = stats.aclRegistrations.load(std::memory_order_relaxed);
+    result["hal_registrations"] = stats.halRegistrations.load(std::memory_order_relaxed);
+    result["register_failures"] = stats.registerFailures.load(std::memory_order_relaxed);
+    result["hugetlb_fallbacks"] = stats.hugetlbFallbacks.load(std::memory_order_relaxed);
+    result["numa_bind_failures"] = stats.numaBindFailures.load(std::memory_order_relaxed);
+    result["acl_register_us"] = histogram_to_dict(stats.aclRegisterUs);
+    result["hal_register_us"] = histogram_to_dict(stats.halRegisterUs);
+    result["mlock_us"] = histogram_to_dict(stats.mlockUs);
+    result["populate_us"] = histogram_to_dict(stats.populateUs);
+    return result;
+};
+
 void* get_device_ptr(void* ptr) {
     auto& hmm = lmc::HostRegisteredMemoryManager::GetInstance();
     return hmm.getDevicePtr(ptr);
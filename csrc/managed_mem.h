@@ -3,14 +3,17 @@
 #include <map>
 #include <torch/torch.h>
 #include <torch/extension.h>
+#include "region_index.h"
+#include "memory_stats.h"
 
 namespace lmc {
 
-struct RegisteredMemoryRecord {
-    uintptr_t ptr;
-    uintptr_t devptr;
-    size_t buffSize;
-};
+// numa_node value selecting the node local to the current device, shared with
+// Python as c_ops.NUMA_NODE_LOCAL
+constexpr int64_t NUMA_NODE_LOCAL = -2;
+
+// NUMA node of the PCIe slot of device, -1 when unknown
+int get_device_numa_node(int device);
 
 /* 
 * We are not responsible for acl init and ctx initialization,
@@ -26,7 +29,10 @@ private:
     HostRegisteredMemoryManager(HostRegisteredMemoryManager&&) = delete;
     HostRegisteredMemoryManager& operator=(HostRegisteredMemoryManager&&) = delete;
 
+    // Guarded by mux, which only serialises the writers. Lookups go through
+    // regionIndex, republished after every change of allocatedMap.
     std::map<void*, RegisteredMemoryRecord> allocatedMap;
+    RegionIndex regionIndex;
     mutable std::shared_mutex mux;
     
 public:
@@ -48,10 +54,31 @@ public:
     // Returns the created RegisteredMemoryRecord
     // Inputs: 
     // -bufferSize: size of the allocated memory area to register on device
-    RegisteredMemoryRecord  halRegisterHostPtr(size_t bufferSize);
+    // -populateThreads: number of threads first-touching the new memory
+    // -numaNode: NUMA node the memory is placed on, -1 for the default policy
+    // -strictNuma: bind to numaNode (MPOL_BIND) instead of preferring it
+    // -hugePageSize: size of the hugetlb pages backing the memory, 0 for transparent huge pages
+    RegisteredMemoryRecord  halRegisterHostPtr(size_t bufferSize, int populateThreads, int numaNode,
+                                               bool strictNuma, size_t hugePageSize);
+    // Map, populate and register a new host memory area through high level APIs (aclrt)
+    // Returns the created RegisteredMemoryRecord
+    // Inputs:
+    // -bufferSize: size of the memory area to allocate and register on device
+    // -populateThreads: number of threads first-touching the new memory
+    // -numaNode: NUMA node the memory is placed on, -1 for the default policy
+    // -strictNuma: bind to numaNode (MPOL_BIND) instead of preferring it
+    // -hugePageSize: size of the hugetlb pages backing the memory, 0 for transparent huge pages
+    RegisteredMemoryRecord  allocRegisterHostPtr(size_t bufferSize, int populateThreads, int numaNode,
+                                                 bool strictNuma, size_t hugePageSize);
+    // Unregister and unmap an area allocated by halRegisterHostPtr or allocRegisterHostPtr
+    void                    releaseHostPtr(void* hostPtr);
     void                    unregisterMemory(void* hostPtr);
     void*                   getDevicePtr(void* hostPtr);
     size_t                  getRecordSize(void* hostPtr);
+    // NUMA node the area containing hostPtr is placed on, -1 if unbound or unknown
+    int                     getRecordNumaNode(void* hostPtr);
+    // Size of the hugetlb pages backing the area containing hostPtr, 0 if none
+    size_t                  getRecordHugePageSize(void* hostPtr);
     void                    unregisterAll();
 };
 } // namespace lmc
@@ -65,5 +92,37 @@ void* register_memory(torch::Tensor& tensor);
 // Inputs: 
 // -tensor: The tensor to register on the device
 void  unregister_memory(torch::Tensor& tensor);
+// Allocate a pinned host buffer registered on the current device, faulting its
+// pages in from several threads. Much faster to bring up than a pinned
+// torch.empty for pools of hundreds of GB.
+// Inputs:
+// -size: size of the buffer in bytes
+// -populate_threads: threads first-touching the buffer, <= 0 for one per core
+// -numa_node: node to place the buffer on, -1 for the default policy and
+//  lmc::NUMA_NODE_LOCAL (c_ops.NUMA_NODE_LOCAL) for the node local to the
+//  current device
+// -huge_page_size: back the buffer with hugetlb pages of this size (2 MiB or
+//  1 GiB), falls back on transparent huge pages when none can be reserved.
+//  0 for transparent huge pages.
+// -strict_numa: bind the buffer to the node (MPOL_BIND). By default the node
+//  is only preferred, so that a pool larger than the free memory of the node
+//  spills to the others instead of getting the worker OOM killed.
+// Returns a uint8 cpu tensor, the memory is released with the tensor
+torch::Tensor alloc_pinned_memory(int64_t size, int64_t populate_threads, int64_t numa_node,
+                                  int64_t huge_page_size, bool strict_numa);
+// Size of the hugetlb pages backing the registered memory of tensor, 0 if none
+int64_t get_host_huge_page_size(torch::Tensor& tensor);
+// NUMA node the registered memory of tensor is placed on, -1 if unbound or unknown
+int get_host_numa_node(torch::Tensor& tensor);
+// NUMA node local to the current device, -1 when unknown
+int device_numa_node();
+// Id of the current device on the host, ASCEND_RT_VISIBLE_DEVICES applied
+int physical_device();
+// Snapshot of the memory manager counters and latency histograms (see
+// memory_stats.h). "devices" is keyed by physical_device() ids, each entry
+// has the bytes registered through aclrtHostRegister ("acl_bytes", pinned by
+// the driver), through halHostRegister ("hal_bytes", mlock-ed by us) and
+// their sum ("registered_bytes").
+pybind11::dict memory_stats();
 // Takes in input a host pointer, returns the corresponding device pointer
 void* get_device_ptr(void* ptr);
@@ -4,6 +4,9 @@
 #include <torch_npu/csrc/framework/OpCommand.h>
 #include <torch_npu/csrc/npu/Module.h>
 #include "utils.h"
+#include "cpu_mem_kernels.h"
+#include "kv_quant.h"
+#include "transfer_trace.h"
 #include "tiling/platform/platform_ascendc.h"
 #include <pybind11/pybind11.h>
 #include <Python.h>
@@ -25,6 +28,41 @@ T* get_kernel_ptr(TENSOR_TYPE& tensor) {
     }
 }
 
+/*
+ * Transfers run on the host (cpu_ops) when the paged memory is in host
+ * memory. The LMCache buffer, pointer tables and slot mapping must then be
+ * cpu tensors too.
+ */
+template <typename... TENSOR_TYPES>
+bool is_host_transfer(const torch::Device& paged_memory_device, const TENSOR_TYPES&... tensors) {
+    if (!paged_memory_device.is_cpu()) {
+        return false;
+    }
+    TORCH_CHECK((tensors.device().is_cpu() && ...),
+                "Paged memory is on cpu, every operand of the transfer must be a cpu tensor.");
+    return true;
+}
+
+/*
+ * Trace record of a transfer moving the hidden rows of lmc_buffer for every
+ * token of slot_mapping, rows_per_token rows (kv x layers) per token. Left
+ * empty while tracing is off, the TraceSpan then records nothing anyway: a
+ * transfer racing start_transfer_trace may record an empty span.
+ */
+lmc::TraceInfo transfer_trace_info(const torch::Tensor& lmc_buffer, const torch::Tensor& slot_mapping,
+                                   int64_t rows_per_token, int32_t layer, bool page2L, bool host) {
+    lmc::TraceInfo info;
+    if (!lmc::TransferTracer::GetInstance().enabled()) {
+        return info;
+    }
+    info.tokens = slot_mapping.size(0);
+    info.bytes = info.tokens * rows_per_token * lmc_buffer.size(-1) * lmc_buffer.element_size();
+    info.layer = layer;
+    info.direction = page2L ? lmc::TraceDirection::OFFLOAD : lmc::TraceDirection::RETRIEVE;
+    info.host = host;
+    return info;
+}
+
 /**
  * Quickly offload KV cache from vLLM paged memory to the offloading buffer
  * Processes all the layers at the same time
@@ -51,6 +89,16 @@ void multi_layer_kv_transfer(torch::Tensor& key_value, // [kv, num_layer, num_to
                              const torch::Device& paged_memory_device,
                              const int page_buffer_size, const bool direction,
                              const bool use_mla) {
+    const bool host = is_host_transfer(paged_memory_device, key_value, key_value_ptrs, slot_mapping);
+    const lmc::TraceInfo trace = transfer_trace_info(key_value, slot_mapping, key_value.size(0) * key_value.size(1),
+                                                     -1, direction, host);
+    if (host) {
+        lmc::TraceSpan span("multi_layer_kv_transfer", trace);
+        cpu_ops::multi_layer_kv_transfer(key_value, key_value_ptrs, slot_mapping, page_buffer_size,
+                                         direction, use_mla);
+        return;
+    }
+
     uint8_t* key_value_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(key_value);
     // it is actually a uint8_t**. we will reinterpret it inside the kernel
     uint8_t* page_buffer_ptrs = get_kernel_ptr<uint8_t, const torch::Tensor>(key_value_ptrs);
@@ -77,7 +125,8 @@ void multi_layer_kv_transfer(torch::Tensor& key_value, // [kv, num_layer, num_to
     cmd.Name("multi_layer_kv_transfer_kernel");
     cmd.SetCustomHandler([scalar_type, slot_type, socName, stream, page_buffer_ptrs, key_value_ptr,
                           slot_mapping_ptr, hidden_dims, kv_size, num_layers, page_buffer_size,
-                          num_tokens, direction]()->int{
+                          num_tokens, direction, trace]()->int{
+        lmc::TraceSpan span("multi_layer_kv_transfer", trace);
         auto slot_num = vllm_ascend::get_dtype_from_torch(slot_type);
         auto dtype_num = vllm_ascend::get_dtype_from_torch(scalar_type);
         auto ascendcPlatform = platform_ascendc::PlatformAscendCManager::GetInstance(socName);
@@ -92,32 +141,111 @@ void multi_layer_kv_transfer(torch::Tensor& key_value, // [kv, num_layer, num_to
 };
 
 
-void multi_layer_kv_transfer_unilateral(torch::Tensor& key_value,
-                                        const torch::Tensor& key_ptrs,
-                                        const torch::Tensor& value_ptrs,
-                                        const torch::Tensor& slot_mapping,
+/**
+ * Same as multi_layer_kv_transfer, for engines that keep K and V of a layer
+ * in separate allocations: key_ptrs[layer] and value_ptrs[layer] each point
+ * to a [PAGE_BUFFER_SIZE, num_heads*head_size] buffer.
+ *
+ * On the device, K and V are each a single-kv (MLA-shaped) transfer over all
+ * layers, so the whole offload is two kernel launches whatever the number of
+ * layers.
+ *
+ * Param:
+ *  - direction: false  means LMCache to PagedBuffer, true  means PagedBuffer to
+ * LMCache
+ */
+void multi_layer_kv_transfer_unilateral(torch::Tensor& key_value, // [2, num_layer, num_tokens, hidden]
+                                        const torch::Tensor& key_ptrs, // [num_layers]
+                                        const torch::Tensor& value_ptrs, // [num_layers]
+                                        const torch::Tensor& slot_mapping, // [num_tokens]
                                         const torch::Device& paged_memory_device,
                                         const int page_buffer_size,
                                         const bool direction){
-       // TODO:
-    PyErr_SetString(PyExc_NotImplementedError, "Please contact LMCache Ascend.");
-    throw py::error_already_set();
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == 2 && key_value.is_contiguous(),
+                "key_value must be a contiguous [2, num_layers, num_tokens, hidden] tensor.");
+    int num_layers = key_value.size(1);
+    int num_tokens = slot_mapping.size(0);
+    int hidden_dims = key_value.size(-1);
+    TORCH_CHECK(key_ptrs.numel() == num_layers && value_ptrs.numel() == num_layers,
+                "key_ptrs and value_ptrs must hold one pointer per layer.");
+
+    const bool host = is_host_transfer(paged_memory_device, key_value, key_ptrs, value_ptrs, slot_mapping);
+    const lmc::TraceInfo trace = transfer_trace_info(key_value, slot_mapping, 2 * num_layers, -1, direction, host);
+    if (host) {
+        lmc::TraceSpan span("multi_layer_kv_transfer_unilateral", trace);
+        cpu_ops::multi_layer_kv_transfer_unilateral(key_value, key_ptrs, value_ptrs, slot_mapping, page_buffer_size,
+                                                    direction);
+        return;
+    }
+
+    uint8_t* key_value_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(key_value);
+    uint8_t* value_part_ptr = key_value_ptr + key_value.stride(0) * key_value.element_size();
+    // they are actually uint8_t**. we will reinterpret them inside the kernel
+    uint8_t* key_buffer_ptrs = get_kernel_ptr<uint8_t, const torch::Tensor>(key_ptrs);
+    uint8_t* value_buffer_ptrs = get_kernel_ptr<uint8_t, const torch::Tensor>(value_ptrs);
+    uint8_t* slot_mapping_ptr = get_kernel_ptr<uint8_t, const torch::Tensor>(slot_mapping);
+
+    const c10::OptionalDeviceGuard device_guard(paged_memory_device);
+    // we require the kv ptr lists to be on the device too
+    const c10::OptionalDeviceGuard kv_device_guard(device_of(key_ptrs));
+
+    const aclrtStream stream = c10_npu::getCurrentNPUStream().stream();
+    at::ScalarType scalar_type = key_value.scalar_type();
+    at::ScalarType slot_type = slot_mapping.scalar_type();
+    const char* socName = aclrtGetSocName();
+
+    at_npu::native::OpCommand cmd;
+    cmd.Name("multi_layer_kv_transfer_unilateral_kernel");
+    cmd.SetCustomHandler([scalar_type, slot_type, socName, stream, key_buffer_ptrs, value_buffer_ptrs,
+                          key_value_ptr, value_part_ptr, slot_mapping_ptr, hidden_dims, num_layers,
+                          page_buffer_size, num_tokens, direction, trace]()->int{
+        lmc::TraceSpan span("multi_layer_kv_transfer_unilateral", trace);
+        auto slot_num = vllm_ascend::get_dtype_from_torch(slot_type);
+        auto dtype_num = vllm_ascend::get_dtype_from_torch(scalar_type);
+        auto ascendcPlatform = platform_ascendc::PlatformAscendCManager::GetInstance(socName);
+        uint32_t aiv_num = ascendcPlatform->GetCoreNumAiv();
+        kvcache_ops::multi_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, key_buffer_ptrs,
+                                        key_value_ptr, slot_mapping_ptr, hidden_dims, 1, num_layers,
+                                        page_buffer_size, num_tokens, direction);
+        kvcache_ops::multi_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, value_buffer_ptrs,
+                                        value_part_ptr, slot_mapping_ptr, hidden_dims, 1, num_layers,
+                                        page_buffer_size, num_tokens, direction);
+        return 0;
+    });
+    cmd.Run();
+    return ;
 };
 
 
 void single_layer_kv_transfer(torch::Tensor& lmc_key_value_cache, // [num_tokens, 2, num_heads*head_size]
                                                                   // or
                                                                   // [2, num_tokens, num_heads*head_size]
+                                                                  // ([.., 1, ..] with use_mla)
                               torch::Tensor& vllm_key_cache, // [num_blocks, block_size, num_heads, head_size]
-                              torch::Tensor& vllm_value_cache, // [....]
+                              torch::Tensor& vllm_value_cache, // [....], ignored with use_mla
                               torch::Tensor& slot_mapping, // [num_tokens]
                               const bool direction, // false: LMCache to PagedBuffer, true: PagedBuffer to LMCache
-                              const bool token_major // true: lmc_key_value_cache is [num_tokens, 2, num_heads*head_size]
-                                                     // false: otherwise
+                              const bool token_major, // true: lmc_key_value_cache is [num_tokens, 2, ...]
+                                                      // false: otherwise
+                              const bool use_mla // true: vllm_key_cache is the latent cache of the layer
 ) {
+    const int64_t kvs = use_mla ? 1 : 2;
+    const bool host = use_mla ? is_host_transfer(vllm_key_cache.device(), lmc_key_value_cache, slot_mapping)
+                              : is_host_transfer(vllm_key_cache.device(), lmc_key_value_cache, vllm_value_cache,
+                                                 slot_mapping);
+    const lmc::TraceInfo trace = transfer_trace_info(lmc_key_value_cache, slot_mapping, kvs, -1, direction, host);
+    if (host) {
+        lmc::TraceSpan span("single_layer_kv_transfer", trace);
+        cpu_ops::single_layer_kv_transfer(lmc_key_value_cache, vllm_key_cache, vllm_value_cache,
+                                          slot_mapping, direction, token_major, use_mla);
+        return;
+    }
+    TORCH_CHECK(lmc_key_value_cache.dim() == 3 && lmc_key_value_cache.size(token_major ? 1 : 0) == kvs,
+                "lmc_key_value_cache must be 3 dimensional with a kv dimension of ", kvs, ".");
+
     uint8_t *lmc_key_value_cache_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(lmc_key_value_cache);
     uint8_t *vllm_key_cache_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(vllm_key_cache);
-    uint8_t *vllm_value_cache_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(vllm_value_cache);
+    uint8_t *vllm_value_cache_ptr = use_mla ? nullptr : get_kernel_ptr<uint8_t, torch::Tensor>(vllm_value_cache);
     uint8_t *slot_mapping_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(slot_mapping);
 
     int num_tokens = slot_mapping.size(0);
@@ -136,32 +264,272 @@ void single_layer_kv_transfer(torch::Tensor& lmc_key_value_cache, // [num_tokens
     cmd.Name("single_layer_kv_transfer_kernel");
     cmd.SetCustomHandler([scalar_type, slot_type, socName, stream, lmc_key_value_cache_ptr,
                           vllm_key_cache_ptr, vllm_value_cache_ptr, slot_mapping_ptr,
-                          hidden_dims, num_tokens, direction, token_major]() -> int {
+                          hidden_dims, num_tokens, direction, token_major, use_mla, trace]() -> int {
+        lmc::TraceSpan span("single_layer_kv_transfer", trace);
         auto slot_num = vllm_ascend::get_dtype_from_torch(slot_type);
         auto dtype_num = vllm_ascend::get_dtype_from_torch(scalar_type);
         auto ascendcPlatform = platform_ascendc::PlatformAscendCManager::GetInstance(socName);
         uint32_t aiv_num = ascendcPlatform->GetCoreNumAiv();
-        // TODO: We will add the isMLA argument once the signature have support for the MLA.
         kvcache_ops::single_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, lmc_key_value_cache_ptr,
                                          vllm_key_cache_ptr, vllm_value_cache_ptr, slot_mapping_ptr,
-                                         hidden_dims, num_tokens, direction, token_major, false);
+                                         hidden_dims, num_tokens, direction, token_major, use_mla);
         return 0;
     });
     cmd.Run();
     return ;
 };
 
+/*
+ * Shared by single_layer_kv_transfer_segmented and the plan: segment i moves
+ * the tokens [starts[i], ends[i]) of slot_mapping between lmc_caches[i] and
+ * the paged caches of one layer. value_cache_ptr is null for MLA, the
+ * segments then are [n, 1, hidden] / [1, n, hidden].
+ *
+ * The slot mapping is never copied: each segment reads its slots in place.
+ * On the device, token major segments that follow each other both in memory
+ * (chunks carved one after the other out of the pinned pool, or views of
+ * one staging buffer) and in slot_mapping are coalesced into one kernel
+ * launch, and all launches of a call share a single OpCommand.
+ */
+void segmented_single_layer_transfer(const std::vector<torch::Tensor>& lmc_caches,
+                                     const torch::Device& paged_memory_device,
+                                     uint8_t* key_cache_ptr, uint8_t* value_cache_ptr,
+                                     const at::ScalarType scalar_type, const int64_t hidden_dims,
+                                     const int64_t num_slots, const torch::Tensor& slot_mapping,
+                                     const std::vector<int64_t>& starts, const std::vector<int64_t>& ends,
+                                     const int32_t layer, const bool direction, const bool token_major,
+                                     uint32_t aiv_num) {
+    TORCH_CHECK(lmc_caches.size() == starts.size() && starts.size() == ends.size(),
+                "Expected one start and one end per LMCache tensor.");
+    TORCH_CHECK(slot_mapping.dim() == 1 && slot_mapping.is_contiguous(), "slot_mapping must be a contiguous 1-D tensor.");
+    const bool use_mla = value_cache_ptr == nullptr;
+    const int64_t kvs = use_mla ? 1 : 2;
+    int64_t total_tokens = 0;
+    for (size_t i = 0; i < lmc_caches.size(); ++i) {
+        const torch::Tensor& cache = lmc_caches[i];
+        const int64_t num_tokens = ends[i] - starts[i];
+        TORCH_CHECK(starts[i] >= 0 && num_tokens >= 0 && ends[i] <= slot_mapping.size(0),
+                    "Segment out of the slot_mapping range.");
+        TORCH_CHECK(cache.dim() == 3 && cache.size(token_major ? 0 : 1) == num_tokens &&
+                    cache.size(token_major ? 1 : 0) == kvs && cache.size(-1) == hidden_dims,
+                    "Each LMCache tensor must be [end - start, kv, hidden] (token_major) or [kv, end - start, hidden], "
+                    "with kv = ", kvs, ".");
+        TORCH_CHECK(cache.scalar_type() == scalar_type && cache.stride(-1) == 1,
+                    "LMCache tensors must have the dtype of the paged caches and be contiguous along hidden.");
+        total_tokens += num_tokens;
+    }
+
+    const int64_t elem = c10::elementSize(scalar_type);
+    lmc::TraceInfo trace;
+    trace.tokens = total_tokens;
+    trace.bytes = total_tokens * kvs * hidden_dims * elem;
+    trace.layer = layer;
+    trace.direction = direction ? lmc::TraceDirection::OFFLOAD : lmc::TraceDirection::RETRIEVE;
+    trace.host = paged_memory_device.is_cpu();
+    if (trace.host) {
+        for (const torch::Tensor& cache : lmc_caches) {
+            TORCH_CHECK(cache.device().is_cpu(), "Paged memory is on cpu, every operand of the transfer must be a cpu tensor.");
+        }
+        lmc::TraceSpan span("single_layer_kv_transfer_segmented", trace);
+        std::vector<uint8_t*> paged_bases{key_cache_ptr};
+        if (!use_mla) {
+            paged_bases.push_back(value_cache_ptr);
+        }
+        cpu_ops::segmented_layer_transfer(lmc_caches, paged_bases, slot_mapping.contiguous(), starts, ends,
+                                          num_slots, hidden_dims * elem, direction, token_major);
+        return;
+    }
+
+    struct Run {
+        uint8_t* lmc;
+        uint8_t* slots;
+        int64_t start;
+        int64_t end;
+    };
+    uint8_t* slot_mapping_ptr = get_kernel_ptr<uint8_t, const torch::Tensor>(slot_mapping);
+    const int64_t slot_elem = slot_mapping.element_size();
+    const int64_t token_bytes = kvs * hidden_dims * elem;
+    std::vector<Run> runs;
+    for (size_t i = 0; i < lmc_caches.size(); ++i) {
+        if (starts[i] == ends[i]) {
+            continue;
+        }
+        TORCH_CHECK(lmc_caches[i].is_contiguous(), "LMCache tensors must be contiguous.");
+        uint8_t* lmc_ptr = get_kernel_ptr<uint8_t, const torch::Tensor>(lmc_caches[i]);
+        if (token_major && !runs.empty() && runs.back().end == starts[i] &&
+            runs.back().lmc + (runs.back().end - runs.back().start) * token_bytes == lmc_ptr) {
+            runs.back().end = ends[i];
+            continue;
+        }
+        runs.push_back(Run{lmc_ptr, slot_mapping_ptr + starts[i] * slot_elem, starts[i], ends[i]});
+    }
+    if (runs.empty()) {
+        return;
+    }
+
+    const c10::OptionalDeviceGuard device_guard(paged_memory_device);
+    const aclrtStream stream = c10_npu::getCurrentNPUStream().stream();
+    const auto dtype_num = vllm_ascend::get_dtype_from_torch(scalar_type);
+    const auto slot_num = vllm_ascend::get_dtype_from_torch(slot_mapping.scalar_type());
+    if (aiv_num == 0) {
+        aiv_num = platform_ascendc::PlatformAscendCManager::GetInstance(aclrtGetSocName())->GetCoreNumAiv();
+    }
+
+    at_npu::native::OpCommand cmd;
+    cmd.Name("single_layer_kv_transfer_kernel");
+    cmd.SetCustomHandler([dtype_num, slot_num, aiv_num, stream, runs = std::move(runs), key_cache_ptr,
+                          value_cache_ptr, hidden_dims, direction, token_major, use_mla, trace]() -> int {
+        lmc::TraceSpan span("single_layer_kv_transfer_segmented", trace);
+        for (const Run& run : runs) {
+            kvcache_ops::single_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, run.lmc,
+                                             key_cache_ptr, value_cache_ptr, run.slots, hidden_dims,
+                                             static_cast<int32_t>(run.end - run.start), direction,
+                                             token_major, use_mla);
+        }
+        return 0;
+    });
+    cmd.Run();
+}
+
+void single_layer_kv_transfer_segmented(const std::vector<torch::Tensor>& lmc_key_value_caches,
+                                        torch::Tensor& vllm_key_cache, // [num_blocks, block_size, num_heads, head_size]
+                                        torch::Tensor& vllm_value_cache, // [....]
+                                        const torch::Tensor& slot_mapping, // [num_tokens]
+                                        const std::vector<int64_t>& starts,
+                                        const std::vector<int64_t>& ends,
+                                        const bool direction,
+                                        const bool token_major,
+                                        const bool use_mla) {
+    TORCH_CHECK(vllm_key_cache.is_contiguous() && (use_mla || vllm_value_cache.is_contiguous()),
+                "The paged caches must be contiguous.");
+    TORCH_CHECK((use_mla || vllm_key_cache.device() == vllm_value_cache.device()) &&
+                vllm_key_cache.device() == slot_mapping.device(),
+                "The paged caches and slot_mapping must be on the same device.");
+    TORCH_CHECK(use_mla || (vllm_value_cache.sizes() == vllm_key_cache.sizes() &&
+                            vllm_value_cache.scalar_type() == vllm_key_cache.scalar_type()),
+                "The key and value caches must have the same shape and dtype.");
+    const int64_t num_slots = vllm_key_cache.size(0) * vllm_key_cache.size(1);
+    const int64_t hidden_dims = vllm_key_cache.numel() / num_slots;
+    segmented_single_layer_transfer(lmc_key_value_caches, vllm_key_cache.device(),
+                                    static_cast<uint8_t*>(vllm_key_cache.data_ptr()),
+                                    use_mla ? nullptr : static_cast<uint8_t*>(vllm_value_cache.data_ptr()),
+                                    vllm_key_cache.scalar_type(), hidden_dims, num_slots, slot_mapping, starts,
+                                    ends, -1, direction, token_major, 0);
+}
+
+/*
+ * Host path of the quantized single layer transfers: rows are quantized /
+ * dequantized straight from / into the paged caches of one layer, K and V
+ * or the MLA latent cache alone.
+ */
+void host_quantized_layer_transfer(torch::Tensor& lmc_key_value_cache, torch::Tensor& scales,
+                                   const std::vector<uint8_t*>& paged_bases,
+                                   const at::ScalarType paged_type, const int64_t hidden_dims,
+                                   const int64_t num_slots, const torch::Tensor& slot_mapping,
+                                   const bool direction, const bool token_major) {
+    const int kv_dim = token_major ? 1 : 0;
+    const int token_dim = token_major ? 0 : 1;
+    TORCH_CHECK(lmc_key_value_cache.dim() == 3 && lmc_key_value_cache.size(-1) == hidden_dims &&
+                lmc_key_value_cache.stride(-1) == 1 &&
+                lmc_key_value_cache.size(kv_dim) == static_cast<int64_t>(paged_bases.size()),
+                "lmc_key_value_cache must be 3 dimensional, contiguous along hidden and hold one row per paged "
+                "cache and token.");
+    TORCH_CHECK(scales.dim() == 3 && scales.scalar_type() == at::ScalarType::Float && scales.stride(-1) == 1 &&
+                scales.size(0) == lmc_key_value_cache.size(0) && scales.size(1) == lmc_key_value_cache.size(1),
+                "scales must be a float32 tensor of lmc_key_value_cache's shape up to the hidden dimension.");
+    TORCH_CHECK(scales.size(-1) > 0 && hidden_dims % scales.size(-1) == 0,
+                "The hidden size must be a multiple of the number of scales.");
+    TORCH_CHECK(lmc_key_value_cache.element_size() == 1, "lmc_key_value_cache must hold 8-bit values.");
+    // LMCacheLayout strides are in bytes
+    const int64_t elem = lmc_key_value_cache.element_size();
+    const int64_t scale_bytes = sizeof(float);
+    cpu_ops::LMCacheLayout lmc{static_cast<uint8_t*>(lmc_key_value_cache.data_ptr()),
+                               lmc_key_value_cache.stride(kv_dim) * elem, 0,
+                               lmc_key_value_cache.stride(token_dim) * elem};
+    cpu_ops::LMCacheLayout scale_rows{static_cast<uint8_t*>(scales.data_ptr()), scales.stride(kv_dim) * scale_bytes,
+                                      0, scales.stride(token_dim) * scale_bytes};
+    cpu_ops::quantized_paged_transfer(lmc, scale_rows, paged_bases, slot_mapping.contiguous(),
+                                      1, num_slots, hidden_dims, hidden_dims / scales.size(-1), paged_type,
+                                      lmc_key_value_cache.scalar_type(), direction);
+}
+
+/**
+ * single_layer_kv_transfer with lmc_key_value_cache in the 8-bit format of
+ * kv_quant.h (int8 / float8_e4m3fn values, float32 scales per token or
+ * per head). On the host the rows are converted during the copy. On the
+ * device the layer goes through a full precision device staging tensor and
+ * quantize_kv / dequantize_kv, so only 8-bit data crosses PCIe.
+ */
+void single_layer_kv_transfer_quantized(torch::Tensor& lmc_key_value_cache, // [num_tokens, 2, hidden]
+                                                                           // or [2, num_tokens, hidden]
+                                        torch::Tensor& scales, // [num_tokens, 2, groups] or [2, num_tokens, groups]
+                                        torch::Tensor& vllm_key_cache,
+                                        torch::Tensor& vllm_value_cache,
+                                        torch::Tensor& slot_mapping,
+                                        const bool direction,
+                                        const bool token_major,
+                                        const bool use_mla) {
+    TORCH_CHECK(vllm_key_cache.is_contiguous() && (use_mla || vllm_value_cache.is_contiguous()),
+                "The paged caches must be contiguous.");
+    const int64_t num_slots = vllm_key_cache.size(0) * vllm_key_cache.size(1);
+    const int64_t hidden_dims = vllm_key_cache.numel() / num_slots;
+    const bool host = use_mla ? is_host_transfer(vllm_key_cache.device(), lmc_key_value_cache, scales, slot_mapping)
+                              : is_host_transfer(vllm_key_cache.device(), lmc_key_value_cache, scales,
+                                                 vllm_value_cache, slot_mapping);
+    if (host) {
+        const lmc::TraceInfo trace = transfer_trace_info(lmc_key_value_cache, slot_mapping, use_mla ? 1 : 2, -1,
+                                                         direction, host);
+        lmc::TraceSpan span("single_layer_kv_transfer_quantized", trace);
+        std::vector<uint8_t*> paged_bases{static_cast<uint8_t*>(vllm_key_cache.data_ptr())};
+        if (!use_mla) {
+            paged_bases.push_back(static_cast<uint8_t*>(vllm_value_cache.data_ptr()));
+        }
+        TORCH_CHECK(use_mla || (vllm_value_cache.sizes() == vllm_key_cache.sizes() &&
+                                vllm_value_cache.scalar_type() == vllm_key_cache.scalar_type()),
+                    "The key and value caches must have the same shape and dtype.");
+        host_quantized_layer_transfer(lmc_key_value_cache, scales, paged_bases, vllm_key_cache.scalar_type(),
+                                      hidden_dims, num_slots, slot_mapping, direction, token_major);
+        return;
+    }
+
+    torch::Tensor staging = torch::empty(lmc_key_value_cache.sizes(), vllm_key_cache.options());
+    if (direction) {
+        single_layer_kv_transfer(staging, vllm_key_cache, vllm_value_cache, slot_mapping, true, token_major, use_mla);
+        quantize_kv(staging, lmc_key_value_cache, scales);
+    } else {
+        dequantize_kv(lmc_key_value_cache, scales, staging);
+        single_layer_kv_transfer(staging, vllm_key_cache, vllm_value_cache, slot_mapping, false, token_major,
+                                 use_mla);
+    }
+}
+
 void load_and_reshape_flash(
     torch::Tensor& key_value, // [2, num_layer, num_tokens, num_heads*head_size]
+                              // ([1, ...] with use_mla)
                               // must be one gpu / pinned cpu
     torch::Tensor& key_cache, // [num_blocks, block_size, num_heads, head_size]
-    torch::Tensor& value_cache, // [num_blocks, block_size, num_heads, head_size]
+    torch::Tensor& value_cache, // [num_blocks, block_size, num_heads, head_size], ignored with use_mla
     torch::Tensor& slot_mapping, // [num_tokens],
-    const int layer_idx) {
-    
+    const int layer_idx,
+    const bool use_mla) {
+    const bool host = use_mla ? is_host_transfer(key_cache.device(), key_value, slot_mapping)
+                              : is_host_transfer(key_cache.device(), key_value, value_cache, slot_mapping);
+    const lmc::TraceInfo trace = transfer_trace_info(key_value, slot_mapping, use_mla ? 1 : 2, layer_idx, true, host);
+    if (host) {
+        lmc::TraceSpan span("load_and_reshape_flash", trace);
+        cpu_ops::flash_layer_transfer(key_value, key_cache, value_cache, slot_mapping, layer_idx, true, use_mla);
+        return;
+    }
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == (use_mla ? 1 : 2) && layer_idx >= 0 &&
+                layer_idx < key_value.size(1),
+                "key_value must be [kv, num_layers, num_tokens, hidden] and hold layer_idx.");
+
     uint8_t* key_value_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(key_value);
     uint8_t* key_cache_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(key_cache);
-    uint8_t* value_cache_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(value_cache);
+    uint8_t* value_cache_ptr = use_mla ? nullptr : get_kernel_ptr<uint8_t, torch::Tensor>(value_cache);
+    // The flash kernel has no MLA mode: the latent rows of the layer are a
+    // [1, num_tokens, hidden] slice, moved by the single layer kernel
+    uint8_t* layer_ptr = key_value_ptr + layer_idx * key_value.stride(1) * key_value.element_size();
 
     uint8_t* slot_mapping_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(slot_mapping);
 
@@ -182,11 +550,18 @@ void load_and_reshape_flash(
     cmd.SetCustomHandler([scalar_type, slot_type, socName, stream, key_value_ptr,
                           key_cache_ptr, value_cache_ptr, slot_mapping_ptr,
                           hidden_dims, num_blocks, block_size,
-                          num_tokens, num_layers, layer_idx]()->int {
+                          num_tokens, num_layers, layer_idx, use_mla, layer_ptr, trace]()->int {
+        lmc::TraceSpan span("load_and_reshape_flash", trace);
         auto slot_num = vllm_ascend::get_dtype_from_torch(slot_type);
         auto dtype_num = vllm_ascend::get_dtype_from_torch(scalar_type);
         auto ascendcPlatform = platform_ascendc::PlatformAscendCManager::GetInstance(socName);
         uint32_t aiv_num = ascendcPlatform->GetCoreNumAiv();
+        if (use_mla) {
+            kvcache_ops::single_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, layer_ptr,
+                                             key_cache_ptr, nullptr, slot_mapping_ptr, hidden_dims,
+                                             num_tokens, true, false, true);
+            return 0;
+        }
         kvcache_ops::load_and_reshape_flash_kernel(dtype_num, slot_num, aiv_num, stream, key_value_ptr,
                                        key_cache_ptr, value_cache_ptr, slot_mapping_ptr,
                                        hidden_dims, num_blocks, block_size,
@@ -199,15 +574,31 @@ void load_and_reshape_flash(
 
 void reshape_and_cache_back_flash(
     torch::Tensor& key_value, // [2, num_layer, num_tokens, num_heads*head_size]
+                              // ([1, ...] with use_mla)
                               // must be one gpu / pinned cpu
     torch::Tensor& key_cache, // [num_blocks, block_size, num_heads, head_size]
-    torch::Tensor& value_cache, // [num_blocks, block_size, num_heads, head_size]
+    torch::Tensor& value_cache, // [num_blocks, block_size, num_heads, head_size], ignored with use_mla
     torch::Tensor& slot_mapping, // [num_tokens],
-    const int layer_idx) {
-    
+    const int layer_idx,
+    const bool use_mla) {
+    const bool host = use_mla ? is_host_transfer(key_cache.device(), key_value, slot_mapping)
+                              : is_host_transfer(key_cache.device(), key_value, value_cache, slot_mapping);
+    const lmc::TraceInfo trace = transfer_trace_info(key_value, slot_mapping, use_mla ? 1 : 2, layer_idx, false, host);
+    if (host) {
+        lmc::TraceSpan span("reshape_and_cache_back_flash", trace);
+        cpu_ops::flash_layer_transfer(key_value, key_cache, value_cache, slot_mapping, layer_idx, false, use_mla);
+        return;
+    }
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == (use_mla ? 1 : 2) && layer_idx >= 0 &&
+                layer_idx < key_value.size(1),
+                "key_value must be [kv, num_layers, num_tokens, hidden] and hold layer_idx.");
+
     uint8_t* key_value_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(key_value);
     uint8_t* key_cache_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(key_cache);
-    uint8_t* value_cache_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(value_cache);
+    uint8_t* value_cache_ptr = use_mla ? nullptr : get_kernel_ptr<uint8_t, torch::Tensor>(value_cache);
+    // The flash kernel has no MLA mode: the latent rows of the layer are a
+    // [1, num_tokens, hidden] slice, moved by the single layer kernel
+    uint8_t* layer_ptr = key_value_ptr + layer_idx * key_value.stride(1) * key_value.element_size();
 
     uint8_t* slot_mapping_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(slot_mapping);
 
@@ -229,11 +620,18 @@ void reshape_and_cache_back_flash(
     cmd.SetCustomHandler([scalar_type, slot_type, socName, stream, key_value_ptr,
                           key_cache_ptr, value_cache_ptr, slot_mapping_ptr,
                           hidden_dims, num_blocks, block_size,
-                          num_tokens, num_layers, layer_idx]() -> int {
+                          num_tokens, num_layers, layer_idx, use_mla, layer_ptr, trace]() -> int {
+        lmc::TraceSpan span("reshape_and_cache_back_flash", trace);
         auto slot_num = vllm_ascend::get_dtype_from_torch(slot_type);
         auto dtype_num = vllm_ascend::get_dtype_from_torch(scalar_type);
         auto ascendcPlatform = platform_ascendc::PlatformAscendCManager::GetInstance(socName);
         uint32_t aiv_num = ascendcPlatform->GetCoreNumAiv();
+        if (use_mla) {
+            kvcache_ops::single_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, layer_ptr,
+                                             key_cache_ptr, nullptr, slot_mapping_ptr, hidden_dims,
+                                             num_tokens, false, false, true);
+            return 0;
+        }
         kvcache_ops::load_and_reshape_flash_kernel(dtype_num, slot_num, aiv_num, stream, key_value_ptr,
                                        key_cache_ptr, value_cache_ptr, slot_mapping_ptr,
                                        hidden_dims, num_blocks, block_size,
@@ -243,3 +641,344 @@ void reshape_and_cache_back_flash(
     cmd.Run();
     return;
 };
+
+torch::Tensor slot_mapping_extents(const torch::Tensor& slot_mapping, const int64_t max_length) {
+    const torch::Tensor slots = slot_mapping.to(torch::kCPU).contiguous();
+    const std::vector<cpu_ops::SlotExtent> extents = cpu_ops::slot_extents(slots, max_length);
+    torch::Tensor out = torch::empty({static_cast<int64_t>(extents.size()), 3}, slots.options().dtype(torch::kInt64));
+    int64_t* rows = out.data_ptr<int64_t>();
+    for (const cpu_ops::SlotExtent& extent : extents) {
+        *rows++ = extent.token;
+        *rows++ = extent.slot;
+        *rows++ = extent.length;
+    }
+    return out;
+}
+
+/*
+ * Everything that does not depend on the call is resolved here: the paged
+ * layout, the kernel dtype, the AIV core count and, on the device, the
+ * per layer pointer tables. A call then only resolves the LMCache buffer
+ * and the slot mapping, and enqueues the launch.
+ */
+KVTransferPlan::KVTransferPlan(const std::vector<torch::Tensor>& key_caches,
+                               const std::vector<torch::Tensor>& value_caches)
+    : keyCaches(key_caches), valueCaches(value_caches),
+      device(key_caches.empty() ? torch::Device(torch::kCPU) : key_caches[0].device()) {
+    TORCH_CHECK(!key_caches.empty(), "key_caches must hold one paged cache per layer.");
+    TORCH_CHECK(value_caches.empty() || value_caches.size() == key_caches.size(),
+                "value_caches must be empty (MLA) or hold one paged cache per layer.");
+    const torch::Tensor& first = key_caches[0];
+    TORCH_CHECK(first.dim() >= 3, "Paged caches must be [num_blocks, block_size, ...].");
+    this->numLayers = static_cast<int64_t>(key_caches.size());
+    this->numBlocks = first.size(0);
+    this->blockSize = first.size(1);
+    this->pageBufferSize = this->numBlocks * this->blockSize;
+    this->hiddenDims = first.numel() / this->pageBufferSize;
+    this->scalarType = first.scalar_type();
+    this->useMLA = value_caches.empty();
+
+    const int64_t layerBytes = first.nbytes();
+    this->kvAdjacent = !this->useMLA;
+    std::vector<int64_t> keyPtrs, valuePtrs;
+    for (int64_t layer = 0; layer < this->numLayers; ++layer) {
+        for (const torch::Tensor* cache : {&key_caches[layer], this->useMLA ? nullptr : &value_caches[layer]}) {
+            if (cache == nullptr) {
+                continue;
+            }
+            TORCH_CHECK(cache->sizes() == first.sizes() && cache->scalar_type() == this->scalarType,
+                        "Every paged cache must have the shape and dtype of the first one.");
+            TORCH_CHECK(cache->is_contiguous() && cache->device() == this->device,
+                        "Paged caches must be contiguous and on the same device.");
+        }
+        uint8_t* keyBase = static_cast<uint8_t*>(key_caches[layer].data_ptr());
+        this->keyBases.push_back(keyBase);
+        keyPtrs.push_back(reinterpret_cast<int64_t>(keyBase));
+        if (!this->useMLA) {
+            uint8_t* valueBase = static_cast<uint8_t*>(value_caches[layer].data_ptr());
+            this->valueBases.push_back(valueBase);
+            valuePtrs.push_back(reinterpret_cast<int64_t>(valueBase));
+            // vLLM allocates a layer as [2, num_blocks, ...], K and V then
+            // are a single kvs = 2 buffer for the multi layer kernel
+            this->kvAdjacent = this->kvAdjacent && valueBase == keyBase + layerBytes;
+        }
+    }
+    this->pagedBases = this->keyBases;
+    this->pagedBases.insert(this->pagedBases.end(), this->valueBases.begin(), this->valueBases.end());
+
+    this->keyPtrTable = torch::tensor(keyPtrs, torch::kInt64);
+    if (this->device.is_cpu()) {
+        return;
+    }
+    const c10::OptionalDeviceGuard device_guard(this->device);
+    this->keyPtrTable = this->keyPtrTable.to(this->device);
+    this->keyTablePtr = static_cast<uint8_t*>(this->keyPtrTable.data_ptr());
+    if (!this->useMLA) {
+        this->valuePtrTable = torch::tensor(valuePtrs, torch::kInt64).to(this->device);
+        this->valueTablePtr = static_cast<uint8_t*>(this->valuePtrTable.data_ptr());
+    }
+    this->dtypeNum = vllm_ascend::get_dtype_from_torch(this->scalarType);
+    this->aivNum = platform_ascendc::PlatformAscendCManager::GetInstance(aclrtGetSocName())->GetCoreNumAiv();
+}
+
+void KVTransferPlan::multi_layer_transfer(torch::Tensor& key_value, // [kv, num_layer, num_tokens, hidden]
+                                          const torch::Tensor& slot_mapping, // [num_tokens]
+                                          const bool direction) {
+    const int64_t kvs = this->useMLA ? 1 : 2;
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == kvs && key_value.size(1) == this->numLayers &&
+                key_value.size(-1) == this->hiddenDims && key_value.is_contiguous(),
+                "key_value must be a contiguous [kv, num_layers, num_tokens, hidden] tensor of the plan geometry.");
+    TORCH_CHECK(key_value.scalar_type() == this->scalarType, "key_value must have the dtype of the paged caches.");
+    const bool host = is_host_transfer(this->device, key_value, slot_mapping);
+    const lmc::TraceInfo trace = transfer_trace_info(key_value, slot_mapping, kvs * this->numLayers,
+                                                     -1, direction, host);
+    if (host) {
+        lmc::TraceSpan span("multi_layer_kv_transfer", trace);
+        const int64_t elem = key_value.element_size();
+        cpu_ops::LMCacheLayout lmc{static_cast<uint8_t*>(key_value.data_ptr()), key_value.stride(0) * elem,
+                                   key_value.stride(1) * elem, key_value.stride(2) * elem};
+        cpu_ops::paged_transfer(lmc, this->pagedBases, slot_mapping.contiguous(), kvs, this->numLayers,
+                                this->pageBufferSize, this->hiddenDims * elem, direction);
+        return;
+    }
+
+    uint8_t* key_value_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(key_value);
+    uint8_t* value_part_ptr = key_value_ptr + key_value.stride(0) * key_value.element_size();
+    uint8_t* slot_mapping_ptr = get_kernel_ptr<uint8_t, const torch::Tensor>(slot_mapping);
+    const auto slot_num = vllm_ascend::get_dtype_from_torch(slot_mapping.scalar_type());
+    const int num_tokens = slot_mapping.size(0);
+
+    const c10::OptionalDeviceGuard device_guard(this->device);
+    const aclrtStream stream = c10_npu::getCurrentNPUStream().stream();
+
+    // One kvs = 2 launch when K and V of a layer are contiguous, one kvs = 1
+    // launch per table otherwise (see multi_layer_kv_transfer_unilateral)
+    const bool split = !this->useMLA && !this->kvAdjacent;
+    at_npu::native::OpCommand cmd;
+    cmd.Name("multi_layer_kv_transfer_kernel");
+    cmd.SetCustomHandler([dtype_num = this->dtypeNum, slot_num, aiv_num = this->aivNum, stream,
+                          key_table = this->keyTablePtr, value_table = this->valueTablePtr,
+                          key_value_ptr, value_part_ptr, slot_mapping_ptr, hidden_dims = this->hiddenDims,
+                          num_layers = this->numLayers, page_buffer_size = this->pageBufferSize,
+                          kvs, split, num_tokens, direction, trace]() -> int {
+        lmc::TraceSpan span("multi_layer_kv_transfer", trace);
+        kvcache_ops::multi_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, key_table,
+                                        key_value_ptr, slot_mapping_ptr, hidden_dims, split ? 1 : kvs,
+                                        num_layers, page_buffer_size, num_tokens, direction);
+        if (split) {
+            kvcache_ops::multi_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, value_table,
+                                            value_part_ptr, slot_mapping_ptr, hidden_dims, 1, num_layers,
+                                            page_buffer_size, num_tokens, direction);
+        }
+        return 0;
+    });
+    cmd.Run();
+}
+
+void KVTransferPlan::single_layer_transfer(torch::Tensor& lmc_key_value_cache, // [num_tokens, 2, hidden]
+                                                                              // or [2, num_tokens, hidden]
+                                           const torch::Tensor& slot_mapping, // [num_tokens]
+                                           const int layer_idx, const bool direction, const bool token_major) {
+    const int64_t kvs = this->useMLA ? 1 : 2;
+    TORCH_CHECK(layer_idx >= 0 && layer_idx < this->numLayers, "layer_idx out of range.");
+    TORCH_CHECK(lmc_key_value_cache.dim() == 3 && lmc_key_value_cache.size(token_major ? 1 : 0) == kvs &&
+                lmc_key_value_cache.size(-1) == this->hiddenDims &&
+                lmc_key_value_cache.scalar_type() == this->scalarType,
+                "lmc_key_value_cache must be a 3 dimensional tensor of the plan kv count, hidden size and dtype.");
+    const bool host = is_host_transfer(this->device, lmc_key_value_cache, slot_mapping);
+    const lmc::TraceInfo trace = transfer_trace_info(lmc_key_value_cache, slot_mapping, kvs, layer_idx,
+                                                     direction, host);
+    if (host) {
+        lmc::TraceSpan span("single_layer_kv_transfer", trace);
+        TORCH_CHECK(lmc_key_value_cache.stride(-1) == 1, "lmc_key_value_cache must be contiguous along hidden.");
+        const int64_t elem = lmc_key_value_cache.element_size();
+        const int kv_dim = token_major ? 1 : 0;
+        const int token_dim = token_major ? 0 : 1;
+        cpu_ops::LMCacheLayout lmc{static_cast<uint8_t*>(lmc_key_value_cache.data_ptr()),
+                                   lmc_key_value_cache.stride(kv_dim) * elem, 0,
+                                   lmc_key_value_cache.stride(token_dim) * elem};
+        cpu_ops::paged_transfer(lmc, this->layer_bases(layer_idx), slot_mapping.contiguous(), kvs, 1,
+                                this->pageBufferSize, this->hiddenDims * elem, direction);
+        return;
+    }
+
+    uint8_t* lmc_key_value_cache_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(lmc_key_value_cache);
+    uint8_t* slot_mapping_ptr = get_kernel_ptr<uint8_t, const torch::Tensor>(slot_mapping);
+    const auto slot_num = vllm_ascend::get_dtype_from_torch(slot_mapping.scalar_type());
+    const int num_tokens = slot_mapping.size(0);
+
+    const c10::OptionalDeviceGuard device_guard(this->device);
+    const aclrtStream stream = c10_npu::getCurrentNPUStream().stream();
+
+    at_npu::native::OpCommand cmd;
+    cmd.Name("single_layer_kv_transfer_kernel");
+    cmd.SetCustomHandler([dtype_num = this->dtypeNum, slot_num, aiv_num = this->aivNum, stream,
+                          lmc_key_value_cache_ptr, key_cache_ptr = this->keyBases[layer_idx],
+                          value_cache_ptr = this->value_base(layer_idx), slot_mapping_ptr,
+                          hidden_dims = this->hiddenDims, num_tokens, direction, token_major,
+                          use_mla = this->useMLA, trace]() -> int {
+        lmc::TraceSpan span("single_layer_kv_transfer", trace);
+        kvcache_ops::single_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, lmc_key_value_cache_ptr,
+                                         key_cache_ptr, value_cache_ptr, slot_mapping_ptr,
+                                         hidden_dims, num_tokens, direction, token_major, use_mla);
+        return 0;
+    });
+    cmd.Run();
+}
+
+void KVTransferPlan::single_layer_transfer_segmented(const std::vector<torch::Tensor>& lmc_key_value_caches,
+                                                     const torch::Tensor& slot_mapping, // [num_tokens]
+                                                     const std::vector<int64_t>& starts,
+                                                     const std::vector<int64_t>& ends,
+                                                     const int layer_idx, const bool direction,
+                                                     const bool token_major) {
+    TORCH_CHECK(layer_idx >= 0 && layer_idx < this->numLayers, "layer_idx out of range.");
+    TORCH_CHECK(slot_mapping.device() == this->device, "slot_mapping must be on the device of the paged caches.");
+    segmented_single_layer_transfer(lmc_key_value_caches, this->device, this->keyBases[layer_idx],
+                                    this->value_base(layer_idx), this->scalarType, this->hiddenDims,
+                                    this->pageBufferSize, slot_mapping, starts, ends, layer_idx, direction,
+                                    token_major, this->aivNum);
+}
+
+void KVTransferPlan::flash_layer_transfer(torch::Tensor& key_value, // [kv, num_layer, num_tokens, hidden]
+                                          const torch::Tensor& slot_mapping, // [num_tokens]
+                                          const int layer_idx, const bool direction) {
+    const int64_t kvs = this->useMLA ? 1 : 2;
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == kvs && key_value.size(-1) == this->hiddenDims &&
+                key_value.scalar_type() == this->scalarType,
+                "key_value must be a [kv, num_layers, num_tokens, hidden] tensor of the plan geometry and dtype.");
+    TORCH_CHECK(layer_idx >= 0 && layer_idx < key_value.size(1) && layer_idx < this->numLayers,
+                "layer_idx out of range.");
+    const bool host = is_host_transfer(this->device, key_value, slot_mapping);
+    const lmc::TraceInfo trace = transfer_trace_info(key_value, slot_mapping, kvs, layer_idx, direction, host);
+    if (host) {
+        lmc::TraceSpan span(direction ? "load_and_reshape_flash" : "reshape_and_cache_back_flash", trace);
+        TORCH_CHECK(key_value.stride(-1) == 1, "key_value must be contiguous along hidden.");
+        const int64_t elem = key_value.element_size();
+        cpu_ops::LMCacheLayout lmc{static_cast<uint8_t*>(key_value.data_ptr()) + layer_idx * key_value.stride(1) * elem,
+                                   key_value.stride(0) * elem, 0, key_value.stride(2) * elem};
+        cpu_ops::paged_transfer(lmc, this->layer_bases(layer_idx), slot_mapping.contiguous(), kvs, 1,
+                                this->pageBufferSize, this->hiddenDims * elem, direction);
+        return;
+    }
+
+    uint8_t* key_value_ptr = get_kernel_ptr<uint8_t, torch::Tensor>(key_value);
+    // MLA goes through the single layer kernel, see load_and_reshape_flash
+    uint8_t* layer_ptr = key_value_ptr + layer_idx * key_value.stride(1) * key_value.element_size();
+    uint8_t* slot_mapping_ptr = get_kernel_ptr<uint8_t, const torch::Tensor>(slot_mapping);
+    const auto slot_num = vllm_ascend::get_dtype_from_torch(slot_mapping.scalar_type());
+    const int num_tokens = slot_mapping.size(0);
+    const int num_layers = key_value.size(1);
+
+    const c10::OptionalDeviceGuard device_guard(this->device);
+    const aclrtStream stream = c10_npu::getCurrentNPUStream().stream();
+
+    at_npu::native::OpCommand cmd;
+    cmd.Name(direction ? "load_and_reshape_flash_kernel" : "reshape_and_cache_back_flash");
+    cmd.SetCustomHandler([dtype_num = this->dtypeNum, slot_num, aiv_num = this->aivNum, stream, key_value_ptr,
+                          layer_ptr, key_cache_ptr = this->keyBases[layer_idx],
+                          value_cache_ptr = this->value_base(layer_idx), slot_mapping_ptr,
+                          hidden_dims = this->hiddenDims, num_blocks = this->numBlocks,
+                          block_size = this->blockSize, num_tokens, num_layers, layer_idx, direction,
+                          use_mla = this->useMLA, trace]() -> int {
+        lmc::TraceSpan span(direction ? "load_and_reshape_flash" : "reshape_and_cache_back_flash", trace);
+        if (use_mla) {
+            kvcache_ops::single_layer_kv_transfer_kernel(dtype_num, slot_num, aiv_num, stream, layer_ptr,
+                                             key_cache_ptr, nullptr, slot_mapping_ptr, hidden_dims,
+                                             num_tokens, direction, false, true);
+            return 0;
+        }
+        kvcache_ops::load_and_reshape_flash_kernel(dtype_num, slot_num, aiv_num, stream, key_value_ptr,
+                                       key_cache_ptr, value_cache_ptr, slot_mapping_ptr,
+                                       hidden_dims, num_blocks, block_size,
+                                       num_tokens, num_layers, layer_idx, direction);
+        return 0;
+    });
+    cmd.Run();
+}
+
+void KVTransferPlan::multi_layer_transfer_quantized(torch::Tensor& key_value, // [kv, num_layer, num_tokens, hidden]
+                                                    torch::Tensor& scales, // [kv, num_layer, num_tokens, groups]
+                                                    const torch::Tensor& slot_mapping, // [num_tokens]
+                                                    const bool direction) {
+    const int64_t kvs = this->useMLA ? 1 : 2;
+    TORCH_CHECK(key_value.dim() == 4 && key_value.size(0) == kvs && key_value.size(1) == this->numLayers &&
+                key_value.size(-1) == this->hiddenDims && key_value.is_contiguous(),
+                "key_value must be a contiguous [kv, num_layers, num_tokens, hidden] tensor of the plan geometry.");
+    const bool host = is_host_transfer(this->device, key_value, scales, slot_mapping);
+    if (host) {
+        TORCH_CHECK(scales.dim() == 4 && scales.scalar_type() == at::ScalarType::Float && scales.is_contiguous() &&
+                    scales.size(0) == kvs && scales.size(1) == this->numLayers &&
+                    scales.size(2) == key_value.size(2),
+                    "scales must be a contiguous float32 [kv, num_layers, num_tokens, groups] tensor.");
+        TORCH_CHECK(scales.size(-1) > 0 && this->hiddenDims % scales.size(-1) == 0,
+                    "The hidden size must be a multiple of the number of scales.");
+        TORCH_CHECK(key_value.element_size() == 1, "key_value must hold 8-bit values.");
+        const lmc::TraceInfo trace = transfer_trace_info(key_value, slot_mapping, kvs * this->numLayers,
+                                                         -1, direction, host);
+        lmc::TraceSpan span("multi_layer_kv_transfer_quantized", trace);
+        // LMCacheLayout strides are in bytes
+        const int64_t elem = key_value.element_size();
+        const int64_t scale_bytes = sizeof(float);
+        cpu_ops::LMCacheLayout lmc{static_cast<uint8_t*>(key_value.data_ptr()), key_value.stride(0) * elem,
+                                   key_value.stride(1) * elem, key_value.stride(2) * elem};
+        cpu_ops::LMCacheLayout scale_rows{static_cast<uint8_t*>(scales.data_ptr()), scales.stride(0) * scale_bytes,
+                                          scales.stride(1) * scale_bytes, scales.stride(2) * scale_bytes};
+        cpu_ops::quantized_paged_transfer(lmc, scale_rows, this->pagedBases, slot_mapping.contiguous(),
+                                          this->numLayers, this->pageBufferSize, this->hiddenDims,
+                                          this->hiddenDims / scales.size(-1),
+                                          this->scalarType, key_value.scalar_type(), direction);
+        return;
+    }
+
+    torch::Tensor staging =
+        torch::empty(key_value.sizes(), torch::TensorOptions().dtype(this->scalarType).device(this->device));
+    if (direction) {
+        this->multi_layer_transfer(staging, slot_mapping, true);
+        quantize_kv(staging, key_value, scales);
+    } else {
+        dequantize_kv(key_value, scales, staging);
+        this->multi_layer_transfer(staging, slot_mapping, false);
+    }
+}
+
+void KVTransferPlan::single_layer_transfer_quantized(torch::Tensor& lmc_key_value_cache, // [num_tokens, 2, hidden]
+                                                                                        // or [2, num_tokens, hidden]
+                                                     torch::Tensor& scales, // [num_tokens, 2, groups]
+                                                                            // or [2, num_tokens, groups]
+                                                     const torch::Tensor& slot_mapping, // [num_tokens]
+                                                     const int layer_idx, const bool direction,
+                                                     const bool token_major) {
+    TORCH_CHECK(layer_idx >= 0 && layer_idx < this->numLayers, "layer_idx out of range.");
+    const bool host = is_host_transfer(this->device, lmc_key_value_cache, scales, slot_mapping);
+    if (host) {
+        const lmc::TraceInfo trace = transfer_trace_info(lmc_key_value_cache, slot_mapping, this->useMLA ? 1 : 2,
+                                                         layer_idx, direction, host);
+        lmc::TraceSpan span("single_layer_kv_transfer_quantized", trace);
+        host_quantized_layer_transfer(lmc_key_value_cache, scales, this->layer_bases(layer_idx), this->scalarType,
+                                      this->hiddenDims, this->pageBufferSize, slot_mapping, direction,
+                                      token_major);
+        return;
+    }
+
+    torch::Tensor staging = torch::empty(lmc_key_value_cache.sizes(),
+                                         torch::TensorOptions().dtype(this->scalarType).device(this->device));
+    if (direction) {
+        this->single_layer_transfer(staging, slot_mapping, layer_idx, true, token_major);
+        quantize_kv(staging, lmc_key_value_cache, scales);
+    } else {
+        dequantize_kv(lmc_key_value_cache, scales, staging);
+        this->single_layer_transfer(staging, slot_mapping, layer_idx, false, token_major);
+    }
+}
+
+std::vector<uint8_t*> KVTransferPlan::layer_bases(const int layer_idx) const {
+    if (this->useMLA) {
+        return {this->keyBases[layer_idx]};
+    }
+    return {this->keyBases[layer_idx], this->valueBases[layer_idx]};
+}
+
+uint8_t* KVTransferPlan::value_base(const int layer_idx) const {
+    return this->useMLA ? nullptr : this->valueBases[layer_idx];
+}
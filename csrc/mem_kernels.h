@@ -40,19 +40,154 @@ void multi_layer_kv_transfer_unilateral(torch::Tensor& key_value,
                                         const int page_buffer_size,
                                         const bool direction);
 
+// With use_mla, vllm_key_cache is the latent cache of the layer,
+// vllm_value_cache is ignored and the LMCache side has a kv dimension of 1
+// ([num_tokens, 1, hidden] or [1, num_tokens, hidden]). The same holds for
+// the single layer and flash ops below.
 void single_layer_kv_transfer(torch::Tensor& lmc_key_value_cache,
                               torch::Tensor& vllm_key_cache,
                               torch::Tensor& vllm_value_cache,
                               torch::Tensor& slot_mapping,
                               const bool direction,
-                              const bool token_major = false);
+                              const bool token_major = false,
+                              const bool use_mla = false);
 
+// single_layer_kv_transfer over several LMCache tensors in one call:
+// lmc_key_value_caches[i] holds the tokens [starts[i], ends[i]) of
+// slot_mapping, e.g. the chunks of a request for one layer
+void single_layer_kv_transfer_segmented(const std::vector<torch::Tensor>& lmc_key_value_caches,
+                                        torch::Tensor& vllm_key_cache,
+                                        torch::Tensor& vllm_value_cache,
+                                        const torch::Tensor& slot_mapping,
+                                        const std::vector<int64_t>& starts,
+                                        const std::vector<int64_t>& ends,
+                                        const bool direction,
+                                        const bool token_major = true,
+                                        const bool use_mla = false);
+
+// single_layer_kv_transfer with lmc_key_value_cache in the 8-bit host
+// format of kv_quant.h: int8 / float8_e4m3fn values and float32 scales
+// ([num_tokens, 2, groups] or [2, num_tokens, groups]), quantized on
+// offload (direction = true) and dequantized on load
+void single_layer_kv_transfer_quantized(torch::Tensor& lmc_key_value_cache,
+                                        torch::Tensor& scales,
+                                        torch::Tensor& vllm_key_cache,
+                                        torch::Tensor& vllm_value_cache,
+                                        torch::Tensor& slot_mapping,
+                                        const bool direction,
+                                        const bool token_major = false,
+                                        const bool use_mla = false);
+
+// key_value is [1, num_layers, num_tokens, hidden] with use_mla
 void load_and_reshape_flash(torch::Tensor& key_value, torch::Tensor& key_cache,
                             torch::Tensor& value_cache,
-                            torch::Tensor& slot_mapping, const int layer_idx);
+                            torch::Tensor& slot_mapping, const int layer_idx,
+                            const bool use_mla = false);
 
 void reshape_and_cache_back_flash(torch::Tensor& key_value,
                                   torch::Tensor& key_cache,
                                   torch::Tensor& value_cache,
                                   torch::Tensor& slot_mapping,
-                                  const int layer_idx);
\ No newline at end of file
+                                  const int layer_idx,
+                                  const bool use_mla = false);
+
+// Runs of consecutive slots in slot_mapping, as an int64 [num_extents, 3]
+// tensor of (first token, first slot, length). Runs are cut at max_length
+// tokens and slots < 0 are skipped. This is the plan the host backend
+// follows: an extent is moved as one block per (kv, layer). The device
+// kernels do not use extents.
+torch::Tensor slot_mapping_extents(const torch::Tensor& slot_mapping,
+                                   const int64_t max_length);
+
+/*
+ * The transfer ops above redo the same setup on every call: pointer
+ * resolution, SoC and core count queries, dtype conversion. A plan does it
+ * once for a set of paged KV caches (when the connector initialises its
+ * pointers) and its calls only take the LMCache buffer and slot mapping.
+ * Arguments have the meaning of the matching op above.
+ */
+class KVTransferPlan {
+public:
+    // -key_caches / value_caches: per layer paged K and V caches,
+    //  contiguous [num_blocks, block_size, ...] tensors on one device.
+    //  value_caches is empty for MLA (a single latent cache per layer),
+    //  the LMCache buffers of every call then have a kv dimension of 1
+    KVTransferPlan(const std::vector<torch::Tensor>& key_caches,
+                   const std::vector<torch::Tensor>& value_caches);
+
+    // multi_layer_kv_transfer
+    void multi_layer_transfer(torch::Tensor& key_value,
+                              const torch::Tensor& slot_mapping,
+                              const bool direction);
+    // single_layer_kv_transfer on the caches of layer_idx
+    void single_layer_transfer(torch::Tensor& lmc_key_value_cache,
+                               const torch::Tensor& slot_mapping,
+                               const int layer_idx,
+                               const bool direction,
+                               const bool token_major);
+    // single_layer_kv_transfer_segmented on the caches of layer_idx
+    void single_layer_transfer_segmented(const std::vector<torch::Tensor>& lmc_key_value_caches,
+                                         const torch::Tensor& slot_mapping,
+                                         const std::vector<int64_t>& starts,
+                                         const std::vector<int64_t>& ends,
+                                         const int layer_idx,
+                                         const bool direction,
+                                         const bool token_major);
+    // multi_layer_transfer / single_layer_transfer with the LMCache buffer
+    // in the 8-bit format of kv_quant.h, scales shaped like it up to the
+    // hidden dimension (see single_layer_kv_transfer_quantized)
+    void multi_layer_transfer_quantized(torch::Tensor& key_value,
+                                        torch::Tensor& scales,
+                                        const torch::Tensor& slot_mapping,
+                                        const bool direction);
+    void single_layer_transfer_quantized(torch::Tensor& lmc_key_value_cache,
+                                         torch::Tensor& scales,
+                                         const torch::Tensor& slot_mapping,
+                                         const int layer_idx,
+                                         const bool direction,
+                                         const bool token_major);
+    // load_and_reshape_flash (direction = true) or
+    // reshape_and_cache_back_flash (direction = false)
+    void flash_layer_transfer(torch::Tensor& key_value,
+                              const torch::Tensor& slot_mapping,
+                              const int layer_idx,
+                              const bool direction);
+
+    int64_t num_layers() const { return numLayers; }
+    int64_t page_buffer_size() const { return pageBufferSize; }
+    bool use_mla() const { return useMLA; }
+    // Device table of the per layer K (or latent) cache pointers, the
+    // key_value_ptrs argument of multi_layer_kv_transfer
+    torch::Tensor key_ptrs() const { return keyPtrTable; }
+
+private:
+    // Paged caches of a layer, K and V or the MLA latent cache alone
+    std::vector<uint8_t*> layer_bases(const int layer_idx) const;
+    // V cache of a layer, null for MLA
+    uint8_t* value_base(const int layer_idx) const;
+
+    // Keep the caches alive for the resolved pointers
+    std::vector<torch::Tensor> keyCaches;
+    std::vector<torch::Tensor> valueCaches;
+    torch::Device device;
+    int64_t numLayers;
+    int64_t numBlocks;
+    int64_t blockSize;
+    int64_t pageBufferSize;
+    int64_t hiddenDims;
+    at::ScalarType scalarType;
+    bool useMLA;
+    // V of every layer starts right after its K
+    bool kvAdjacent;
+    // Row 0 of each paged cache, K of every layer then V of every layer
+    std::vector<uint8_t*> keyBases;
+    std::vector<uint8_t*> valueBases;
+    std::vector<uint8_t*> pagedBases;
+    // Device only
+    torch::Tensor keyPtrTable;
+    torch::Tensor valuePtrTable;
+    uint8_t* keyTablePtr = nullptr;
+    uint8_t* valueTablePtr = nullptr;
+    kvcache_ops::AscendType dtypeNum{};
+    uint32_t aivNum = 0;
+};
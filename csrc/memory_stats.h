@@ -0,0 +1,132 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace lmc {
+
+/*
+* Counters and latency histograms of HostRegisteredMemoryManager, exported
+* by c_ops.memory_stats(). Everything is a relaxed atomic: registration
+* events are rare, and the per launch lookup counters are sharded per
+* thread so concurrent kernel launches do not bounce a shared cache line.
+*/
+
+// Log2 latency histogram, bucket i counts samples in [2^(i-1), 2^i) us
+struct LatencyHistogram {
+    static constexpr int NUM_BUCKETS = 40;
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> totalUs{0};
+    std::atomic<uint64_t> maxUs{0};
+
+    void record(uint64_t us) {
+        const int bucket = us == 0 ? 0 : std::min(NUM_BUCKETS - 1, 64 - __builtin_clzll(us));
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        totalUs.fetch_add(us, std::memory_order_relaxed);
+        uint64_t prev = maxUs.load(std::memory_order_relaxed);
+        while (prev < us && !maxUs.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+class ShardedCounter {
+public:
+    void add(uint64_t n = 1) {
+        shards[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const {
+        uint64_t sum = 0;
+        for (const auto& shard : shards) {
+            sum += shard.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+private:
+    static constexpr int NUM_SHARDS = 64;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    static int shardIndex() {
+        static std::atomic<int> nextShard{0};
+        thread_local const int shard = nextShard.fetch_add(1, std::memory_order_relaxed) % NUM_SHARDS;
+        return shard;
+    }
+
+    std::array<Shard, NUM_SHARDS> shards;
+};
+
+struct MemoryStats {
+    static constexpr int MAX_DEVICES = 64;
+
+    // Per physical device id, bytes currently registered through
+    // aclrtHostRegister and through halHostRegister (mlock-ed by us)
+    std::array<std::atomic<int64_t>, MAX_DEVICES> aclBytes{};
+    std::array<std::atomic<int64_t>, MAX_DEVICES> halBytes{};
+    std::atomic<int64_t> registeredRegions{0};
+
+    // getDevicePtr calls, and those that found no registered region
+    ShardedCounter lookups;
+    ShardedCounter lookupMisses;
+
+    std::atomic<uint64_t> aclRegistrations{0};
+    // Registrations through halHostRegister, for drivers without aclrtHostRegister
+    std::atomic<uint64_t> halRegistrations{0};
+    std::atomic<uint64_t> registerFailures{0};
+    std::atomic<uint64_t> hugetlbFallbacks{0};
+    std::atomic<uint64_t> numaBindFailures{0};
+
+    LatencyHistogram aclRegisterUs;
+    LatencyHistogram halRegisterUs;
+    LatencyHistogram mlockUs;
+    LatencyHistogram populateUs;
+
+    void addRegion(int device, int64_t bytes, bool viaHal) {
+        registeredRegions.fetch_add(1, std::memory_order_relaxed);
+        addBytes(device, bytes, viaHal);
+    }
+
+    void removeRegion(int device, int64_t bytes, bool viaHal) {
+        registeredRegions.fetch_sub(1, std::memory_order_relaxed);
+        addBytes(device, -bytes, viaHal);
+    }
+
+private:
+    void addBytes(int device, int64_t bytes, bool viaHal) {
+        if (device < 0 || device >= MAX_DEVICES) {
+            return;
+        }
+        (viaHal ? halBytes : aclBytes)[device].fetch_add(bytes, std::memory_order_relaxed);
+    }
+};
+
+inline MemoryStats& memoryStats() {
+    static MemoryStats stats;
+    return stats;
+}
+
+// Records the lifetime of the scope into a histogram
+class ScopedLatency {
+public:
+    explicit ScopedLatency(LatencyHistogram& histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedLatency() {
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+
+private:
+    LatencyHistogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+} // namespace lmc
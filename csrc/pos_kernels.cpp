@@ -1,14 +1,208 @@
 #include "pos_kernels.h"
-#include <pybind11/pybind11.h>
-#include <Python.h> 
+#include <ATen/Dispatch.h>
+#include <ATen/Parallel.h>
+#include <ATen/cpu/vec/vec.h>
+#include <vector>
 
-namespace py = pybind11;
+/*
+ * Rotates K in place from old_positions to new_positions.
+ *
+ * RoPE is a per-pair rotation by pos * inv_freq, so undoing the rotation at
+ * the old position and applying the one at the new position is a single
+ * rotation by (new - old) * inv_freq. Its cos/sin come from the two cache
+ * rows through the angle difference identities:
+ *   cos(n - o) = cos(n) cos(o) + sin(n) sin(o)
+ *   sin(n - o) = sin(n) cos(o) - cos(n) sin(o)
+ * so each token reads its cache rows once and K is read and written once,
+ * instead of the reverse rope + forward rope round trip (and the dummy q)
+ * of DummyFusedRope.
+ *
+ * key:           [num_tokens, num_heads, head_size] (last dim contiguous)
+ * cos_sin_cache: [max_position, rot_dim], cos in the first rot_dim / 2
+ *                columns, sin in the rest (vLLM layout)
+ * is_neox:       rotate (x[i], x[i + rot_dim / 2]) pairs, otherwise the
+ *                GPT-J (x[2i], x[2i + 1]) pairs
+ */
+
+namespace {
+
+using fVec = at::vec::Vectorized<float>;
+
+// x1 <- x1 * cos - x2 * sin, x2 <- x2 * cos + x1 * sin
+inline void rotate_pairs(float* x1, float* x2, const float* cos, const float* sin, int64_t n) {
+    int64_t i = 0;
+    for (; i + fVec::size() <= n; i += fVec::size()) {
+        const fVec a = fVec::loadu(x1 + i);
+        const fVec b = fVec::loadu(x2 + i);
+        const fVec c = fVec::loadu(cos + i);
+        const fVec s = fVec::loadu(sin + i);
+        (a * c - b * s).store(x1 + i);
+        (b * c + a * s).store(x2 + i);
+    }
+    for (; i < n; ++i) {
+        const float a = x1[i];
+        const float b = x2[i];
+        x1[i] = a * cos[i] - b * sin[i];
+        x2[i] = b * cos[i] + a * sin[i];
+    }
+}
+
+// cos/sin of the angle difference between the new and the old cache rows
+template <typename cache_t>
+inline void delta_cos_sin(const cache_t* old_row, const cache_t* new_row, float* cos, float* sin,
+                          float* scratch, int64_t embed_dim) {
+    float* old_cos = scratch;
+    float* old_sin = scratch + embed_dim;
+    float* new_cos = scratch + 2 * embed_dim;
+    float* new_sin = scratch + 3 * embed_dim;
+    for (int64_t i = 0; i < embed_dim; ++i) {
+        old_cos[i] = static_cast<float>(old_row[i]);
+        old_sin[i] = static_cast<float>(old_row[embed_dim + i]);
+        new_cos[i] = static_cast<float>(new_row[i]);
+        new_sin[i] = static_cast<float>(new_row[embed_dim + i]);
+    }
+    int64_t i = 0;
+    for (; i + fVec::size() <= embed_dim; i += fVec::size()) {
+        const fVec oc = fVec::loadu(old_cos + i);
+        const fVec os = fVec::loadu(old_sin + i);
+        const fVec nc = fVec::loadu(new_cos + i);
+        const fVec ns = fVec::loadu(new_sin + i);
+        (nc * oc + ns * os).store(cos + i);
+        (ns * oc - nc * os).store(sin + i);
+    }
+    for (; i < embed_dim; ++i) {
+        cos[i] = new_cos[i] * old_cos[i] + new_sin[i] * old_sin[i];
+        sin[i] = new_sin[i] * old_cos[i] - new_cos[i] * old_sin[i];
+    }
+}
+
+template <typename scalar_t, typename cache_t>
+void rotary_embedding_k_fused_cpu(const int64_t* old_positions, const int64_t* new_positions,
+                                  scalar_t* key, const cache_t* cos_sin_cache, int64_t num_tokens,
+                                  int64_t num_heads, int64_t rot_dim, int64_t token_stride,
+                                  int64_t head_stride, bool is_neox) {
+    const int64_t embed_dim = rot_dim / 2;
+    at::parallel_for(0, num_tokens, 16, [&](int64_t begin, int64_t end) {
+        // cos | sin | x1 | x2 | 4 x scratch
+        std::vector<float> buffer(8 * embed_dim);
+        float* cos = buffer.data();
+        float* sin = cos + embed_dim;
+        float* x1 = sin + embed_dim;
+        float* x2 = x1 + embed_dim;
+        float* scratch = x2 + embed_dim;
+
+        for (int64_t t = begin; t < end; ++t) {
+            const int64_t old_pos = old_positions[t];
+            const int64_t new_pos = new_positions[t];
+            if (old_pos == new_pos) {
+                continue;
+            }
+            delta_cos_sin(cos_sin_cache + old_pos * rot_dim, cos_sin_cache + new_pos * rot_dim,
+                          cos, sin, scratch, embed_dim);
+
+            for (int64_t h = 0; h < num_heads; ++h) {
+                scalar_t* head = key + t * token_stride + h * head_stride;
+                if (is_neox) {
+                    for (int64_t i = 0; i < embed_dim; ++i) {
+                        x1[i] = static_cast<float>(head[i]);
+                        x2[i] = static_cast<float>(head[embed_dim + i]);
+                    }
+                    rotate_pairs(x1, x2, cos, sin, embed_dim);
+                    for (int64_t i = 0; i < embed_dim; ++i) {
+                        head[i] = static_cast<scalar_t>(x1[i]);
+                        head[embed_dim + i] = static_cast<scalar_t>(x2[i]);
+                    }
+                } else {
+                    for (int64_t i = 0; i < embed_dim; ++i) {
+                        x1[i] = static_cast<float>(head[2 * i]);
+                        x2[i] = static_cast<float>(head[2 * i + 1]);
+                    }
+                    rotate_pairs(x1, x2, cos, sin, embed_dim);
+                    for (int64_t i = 0; i < embed_dim; ++i) {
+                        head[2 * i] = static_cast<scalar_t>(x1[i]);
+                        head[2 * i + 1] = static_cast<scalar_t>(x2[i]);
+                    }
+                }
+            }
+        }
+    });
+}
+
+/*
+ * Device path: the same delta rotation composed from ATen ops, so it is NOT
+ * fused. It runs about a dozen kernels (two index_select of the cache rows,
+ * the cos / sin differences, the rotation and a cat / stack + copy_ back)
+ * with float temporaries of K. It still avoids the dummy q and the reverse
+ * + forward round trip of DummyFusedRope; a single kernel needs an AscendC
+ * op in kvcache-ops.
+ */
+void rotary_embedding_k_delta_composite(const torch::Tensor& old_positions, const torch::Tensor& new_positions,
+                                        torch::Tensor& key, const torch::Tensor& cos_sin_cache, bool is_neox) {
+    const int64_t rot_dim = cos_sin_cache.size(1);
+    const int64_t embed_dim = rot_dim / 2;
+
+    const auto old_rows = cos_sin_cache.index_select(0, old_positions.flatten()).to(at::kFloat);
+    const auto new_rows = cos_sin_cache.index_select(0, new_positions.flatten()).to(at::kFloat);
+    const auto old_cos = old_rows.narrow(-1, 0, embed_dim);
+    const auto old_sin = old_rows.narrow(-1, embed_dim, embed_dim);
+    const auto new_cos = new_rows.narrow(-1, 0, embed_dim);
+    const auto new_sin = new_rows.narrow(-1, embed_dim, embed_dim);
+    const auto cos = (new_cos * old_cos + new_sin * old_sin).unsqueeze(1);
+    const auto sin = (new_sin * old_cos - new_cos * old_sin).unsqueeze(1);
+
+    auto rot = key.narrow(-1, 0, rot_dim);
+    const auto rot_f = rot.to(at::kFloat);
+    if (is_neox) {
+        const auto x1 = rot_f.narrow(-1, 0, embed_dim);
+        const auto x2 = rot_f.narrow(-1, embed_dim, embed_dim);
+        rot.copy_(at::cat({x1 * cos - x2 * sin, x2 * cos + x1 * sin}, -1));
+    } else {
+        const auto x1 = rot_f.slice(-1, 0, rot_dim, 2);
+        const auto x2 = rot_f.slice(-1, 1, rot_dim, 2);
+        rot.copy_(at::stack({x1 * cos - x2 * sin, x2 * cos + x1 * sin}, -1).flatten(-2));
+    }
+}
+
+} // namespace
 
 void rotary_embedding_k_fused(const torch::Tensor& old_positions,
                               const torch::Tensor& new_positions,
                               torch::Tensor& key, int64_t head_size,
                               const torch::Tensor& cos_sin_cache, bool is_neox) {
-    // TODO:
-    PyErr_SetString(PyExc_NotImplementedError, "Please contact LMCache Ascend.");
-    throw py::error_already_set();
-};
\ No newline at end of file
+    TORCH_CHECK(key.dim() == 3, "key must be [num_tokens, num_heads, head_size].");
+    TORCH_CHECK(key.size(2) == head_size, "key head dim does not match head_size.");
+    TORCH_CHECK(key.stride(2) == 1, "key must be contiguous along head_size.");
+    TORCH_CHECK(cos_sin_cache.dim() == 2, "cos_sin_cache must be [max_position, rot_dim].");
+    const int64_t rot_dim = cos_sin_cache.size(1);
+    TORCH_CHECK(rot_dim % 2 == 0 && rot_dim <= head_size, "rot_dim must be even and not larger than head_size.");
+
+    const int64_t num_tokens = key.size(0);
+    TORCH_CHECK(old_positions.numel() == num_tokens && new_positions.numel() == num_tokens,
+                "positions must have one entry per token.");
+    TORCH_CHECK(key.device() == cos_sin_cache.device(), "key and cos_sin_cache must be on the same device.");
+
+    if (!key.device().is_cpu()) {
+        rotary_embedding_k_delta_composite(old_positions, new_positions, key, cos_sin_cache, is_neox);
+        return;
+    }
+
+    const auto old_pos = old_positions.flatten().to(at::kLong).contiguous();
+    const auto new_pos = new_positions.flatten().to(at::kLong).contiguous();
+    const auto cache = cos_sin_cache.contiguous();
+    const int64_t max_position = cache.size(0);
+    const int64_t* old_ptr = old_pos.data_ptr<int64_t>();
+    const int64_t* new_ptr = new_pos.data_ptr<int64_t>();
+    for (int64_t t = 0; t < num_tokens; ++t) {
+        TORCH_CHECK(old_ptr[t] >= 0 && old_ptr[t] < max_position && new_ptr[t] >= 0 && new_ptr[t] < max_position,
+                    "position out of the cos_sin_cache range.");
+    }
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(at::kHalf, at::kBFloat16, key.scalar_type(), "rotary_embedding_k_fused", [&] {
+        using key_t = scalar_t;
+        AT_DISPATCH_FLOATING_TYPES_AND2(at::kHalf, at::kBFloat16, cache.scalar_type(), "rotary_embedding_k_fused", [&] {
+            rotary_embedding_k_fused_cpu<key_t, scalar_t>(old_ptr, new_ptr, key.data_ptr<key_t>(),
+                                                          cache.data_ptr<scalar_t>(), num_tokens, key.size(1),
+                                                          rot_dim, key.stride(0), key.stride(1), is_neox);
+        });
+    });
+};
@@ -4,6 +4,9 @@
 #include <torch/torch.h>
 #include <torch/extension.h>
 
+// Rotates key in place from old_positions to new_positions with one rotation
+// by the position difference. Fused (K read and written once) on the cpu;
+// on the NPU it is a composition of ATen ops, see pos_kernels.cpp.
 void rotary_embedding_k_fused(const torch::Tensor& old_positions,
                               const torch::Tensor& new_positions,
                               torch::Tensor& key, int64_t head_size,
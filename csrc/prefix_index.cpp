@@ -0,0 +1,288 @@
+#include "prefix_index.h"
+#include <algorithm>
+#include <mutex>
+
+namespace lmc {
+
+struct PrefixIndex::Node {
+    // Edge from the parent: keys and the location of each
+    std::vector<int64_t> keys;
+    std::vector<int64_t> locations;
+    // Sorted by the first key of the child edge
+    std::vector<std::pair<int64_t, std::unique_ptr<Node>>> children;
+
+    using Child = std::pair<int64_t, std::unique_ptr<Node>>;
+
+    // Frees the subtree without recursing: a tree as deep as the longest
+    // branching sequence would overflow the stack
+    ~Node() {
+        std::vector<std::unique_ptr<Node>> pending;
+        for (Child& child : children) {
+            pending.push_back(std::move(child.second));
+        }
+        while (!pending.empty()) {
+            std::unique_ptr<Node> node = std::move(pending.back());
+            pending.pop_back();
+            for (Child& child : node->children) {
+                pending.push_back(std::move(child.second));
+            }
+            node->children.clear();
+        }
+    }
+
+    std::vector<Child>::iterator lowerBound(int64_t key) {
+        return std::lower_bound(children.begin(), children.end(), key,
+                                [](const Child& child, int64_t k) { return child.first < k; });
+    }
+
+    Node* child(int64_t key) const {
+        auto it = const_cast<Node*>(this)->lowerBound(key);
+        return it != children.end() && it->first == key ? it->second.get() : nullptr;
+    }
+};
+
+namespace {
+
+torch::Tensor key_tensor(const torch::Tensor& keys, const char* name) {
+    TORCH_CHECK(keys.device().is_cpu() && keys.dim() == 1, name, " must be a 1-D cpu tensor.");
+    TORCH_CHECK(keys.scalar_type() == torch::kInt64 || keys.scalar_type() == torch::kInt32, name,
+                " must be int32 or int64.");
+    return keys.to(torch::kInt64).contiguous();
+}
+
+} // namespace
+
+PrefixIndex::PrefixIndex() : root(std::make_unique<Node>()) {}
+
+PrefixIndex::~PrefixIndex() {
+    clear();
+}
+
+int64_t PrefixIndex::walk(const int64_t* keys, int64_t length, const Node** node, int64_t* edgeMatched) const {
+    const Node* current = this->root.get();
+    int64_t matched = 0;
+    int64_t onEdge = 0;
+    while (matched < length) {
+        if (onEdge == static_cast<int64_t>(current->keys.size())) {
+            const Node* next = current->child(keys[matched]);
+            if (next == nullptr) {
+                break;
+            }
+            current = next;
+            onEdge = 0;
+        }
+        // Compare the rest of the edge in one go
+        const int64_t span = std::min<int64_t>(current->keys.size() - onEdge, length - matched);
+        const int64_t* edge = current->keys.data() + onEdge;
+        const int64_t same = std::mismatch(edge, edge + span, keys + matched).first - edge;
+        matched += same;
+        onEdge += same;
+        if (same < span) {
+            break;
+        }
+    }
+    *node = current;
+    *edgeMatched = onEdge;
+    return matched;
+}
+
+int64_t PrefixIndex::match(const int64_t* keys, int64_t length, int64_t* locations) const {
+    const Node* current = this->root.get();
+    int64_t matched = 0;
+    while (matched < length) {
+        current = current->child(keys[matched]);
+        if (current == nullptr) {
+            break;
+        }
+        const int64_t span = std::min<int64_t>(current->keys.size(), length - matched);
+        const int64_t* edge = current->keys.data();
+        const int64_t same = std::mismatch(edge, edge + span, keys + matched).first - edge;
+        std::copy_n(current->locations.data(), same, locations + matched);
+        matched += same;
+        if (same < static_cast<int64_t>(current->keys.size())) {
+            break;
+        }
+    }
+    return matched;
+}
+
+int64_t PrefixIndex::insert(const torch::Tensor& keys, const torch::Tensor& locations) {
+    const torch::Tensor k = key_tensor(keys, "keys");
+    const torch::Tensor l = key_tensor(locations, "locations");
+    TORCH_CHECK(k.numel() == l.numel(), "keys and locations must have the same length.");
+    const int64_t* key = k.data_ptr<int64_t>();
+    const int64_t* location = l.data_ptr<int64_t>();
+    const int64_t length = k.numel();
+
+    std::unique_lock<std::shared_mutex> lock(this->mutex);
+    Node* current = this->root.get();
+    int64_t done = 0;
+    while (done < length) {
+        auto it = current->lowerBound(key[done]);
+        if (it == current->children.end() || it->first != key[done]) {
+            // New branch with the rest of the sequence
+            auto leaf = std::make_unique<Node>();
+            leaf->keys.assign(key + done, key + length);
+            leaf->locations.assign(location + done, location + length);
+            current->children.emplace(it, key[done], std::move(leaf));
+            ++this->numNodes;
+            this->numChunks += length - done;
+            return length - done;
+        }
+        Node* next = it->second.get();
+        const int64_t span = std::min<int64_t>(next->keys.size(), length - done);
+        const int64_t* edge = next->keys.data();
+        const int64_t same = std::mismatch(edge, edge + span, key + done).first - edge;
+        std::copy_n(location + done, same, next->locations.data());
+        done += same;
+        if (same == static_cast<int64_t>(next->keys.size()) && next->children.empty() && done < length) {
+            // The sequence extends a leaf, e.g. a session storing its next
+            // chunks: grow the edge rather than chaining a node
+            next->keys.insert(next->keys.end(), key + done, key + length);
+            next->locations.insert(next->locations.end(), location + done, location + length);
+            this->numChunks += length - done;
+            return length - done;
+        }
+        if (same < static_cast<int64_t>(next->keys.size())) {
+            if (done == length) {
+                // Every chunk was already present
+                break;
+            }
+            // Split the edge where the sequence branches off
+            auto tail = std::make_unique<Node>();
+            tail->keys.assign(next->keys.begin() + same, next->keys.end());
+            tail->locations.assign(next->locations.begin() + same, next->locations.end());
+            tail->children = std::move(next->children);
+            next->keys.resize(same);
+            next->locations.resize(same);
+            next->children.clear();
+            const int64_t tailKey = tail->keys.front();
+            next->children.emplace_back(tailKey, std::move(tail));
+            ++this->numNodes;
+        }
+        current = next;
+    }
+    return 0;
+}
+
+int64_t PrefixIndex::longest_prefix(const torch::Tensor& keys) const {
+    const torch::Tensor k = key_tensor(keys, "keys");
+    std::shared_lock<std::shared_mutex> lock(this->mutex);
+    const Node* node;
+    int64_t edgeMatched;
+    return walk(k.data_ptr<int64_t>(), k.numel(), &node, &edgeMatched);
+}
+
+std::vector<int64_t> PrefixIndex::longest_prefixes(const std::vector<torch::Tensor>& keys) const {
+    std::vector<torch::Tensor> converted;
+    converted.reserve(keys.size());
+    for (const torch::Tensor& sequence : keys) {
+        converted.push_back(key_tensor(sequence, "keys"));
+    }
+    std::vector<int64_t> out(keys.size());
+    std::shared_lock<std::shared_mutex> lock(this->mutex);
+    for (size_t i = 0; i < converted.size(); ++i) {
+        const Node* node;
+        int64_t edgeMatched;
+        out[i] = walk(converted[i].data_ptr<int64_t>(), converted[i].numel(), &node, &edgeMatched);
+    }
+    return out;
+}
+
+torch::Tensor PrefixIndex::lookup(const torch::Tensor& keys) const {
+    const torch::Tensor k = key_tensor(keys, "keys");
+    torch::Tensor locations = torch::empty({k.numel()}, k.options());
+    int64_t matched;
+    {
+        std::shared_lock<std::shared_mutex> lock(this->mutex);
+        matched = match(k.data_ptr<int64_t>(), k.numel(), locations.data_ptr<int64_t>());
+    }
+    return locations.slice(0, 0, matched);
+}
+
+void PrefixIndex::collect(const Node& node, int64_t from, std::vector<int64_t>& locations, int64_t& nodes) {
+    locations.insert(locations.end(), node.locations.begin() + from, node.locations.end());
+    // Explicit stack, see ~Node
+    std::vector<const Node*> pending;
+    for (const auto& child : node.children) {
+        pending.push_back(child.second.get());
+    }
+    while (!pending.empty()) {
+        const Node* current = pending.back();
+        pending.pop_back();
+        ++nodes;
+        locations.insert(locations.end(), current->locations.begin(), current->locations.end());
+        for (const auto& child : current->children) {
+            pending.push_back(child.second.get());
+        }
+    }
+}
+
+torch::Tensor PrefixIndex::remove(const torch::Tensor& keys) {
+    const torch::Tensor k = key_tensor(keys, "keys");
+    std::vector<int64_t> removed;
+    {
+        std::unique_lock<std::shared_mutex> lock(this->mutex);
+        const int64_t length = k.numel();
+        const Node* found;
+        int64_t edgeMatched;
+        if (length > 0 && walk(k.data_ptr<int64_t>(), length, &found, &edgeMatched) == length) {
+            Node* node = const_cast<Node*>(found);
+            // The last key of the sequence is at edgeMatched - 1 on the edge
+            const int64_t cut = edgeMatched - 1;
+            int64_t nodes = 0;
+            collect(*node, cut, removed, nodes);
+            if (cut > 0) {
+                node->keys.resize(cut);
+                node->locations.resize(cut);
+                node->children.clear();
+            } else {
+                // The whole edge goes: unlink the node from its parent
+                const int64_t parentMatched = length - edgeMatched;
+                Node* parent = this->root.get();
+                if (parentMatched > 0) {
+                    const Node* p;
+                    int64_t pEdge;
+                    walk(k.data_ptr<int64_t>(), parentMatched, &p, &pEdge);
+                    parent = const_cast<Node*>(p);
+                }
+                ++nodes;
+                parent->children.erase(parent->lowerBound(node->keys.front()));
+                // Restore path compression: a parent left with one child
+                // absorbs it
+                if (parent != this->root.get() && parent->children.size() == 1) {
+                    std::unique_ptr<Node> only = std::move(parent->children.front().second);
+                    parent->keys.insert(parent->keys.end(), only->keys.begin(), only->keys.end());
+                    parent->locations.insert(parent->locations.end(), only->locations.begin(),
+                                             only->locations.end());
+                    parent->children = std::move(only->children);
+                    ++nodes;
+                }
+            }
+            this->numNodes -= nodes;
+            this->numChunks -= static_cast<int64_t>(removed.size());
+        }
+    }
+    torch::Tensor out = torch::empty({static_cast<int64_t>(removed.size())}, k.options());
+    std::copy(removed.begin(), removed.end(), out.data_ptr<int64_t>());
+    return out;
+}
+
+void PrefixIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(this->mutex);
+    this->root->children.clear();
+    this->numChunks = 0;
+    this->numNodes = 0;
+}
+
+int64_t PrefixIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(this->mutex);
+    return this->numChunks;
+}
+
+int64_t PrefixIndex::num_nodes() const {
+    std::shared_lock<std::shared_mutex> lock(this->mutex);
+    return this->numNodes;
+}
+
+} // namespace lmc
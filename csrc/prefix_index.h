@@ -0,0 +1,77 @@
+#pragma once
+#include <torch/torch.h>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace lmc {
+
+/*
+* Longest-prefix index of cached KV, exposed to Python as c_ops.PrefixIndex.
+*
+* Sequences of int64 keys (chunk hashes, or token ids) are kept in a
+* compressed radix tree: an edge holds a run of keys shared by every
+* sequence below it, so a run of chunks no other session branches off costs
+* one node. Every key on an edge carries the location of its chunk (the
+* opaque int64 the caller uses to find the memory object), and a key is in
+* the tree exactly when its chunk is cached. Removing a chunk therefore
+* removes everything after it, which is never reachable by a prefix lookup
+* anyway.
+*
+* Children are kept in a vector sorted by their first key: most nodes have a
+* handful of children, and this is much smaller than a hash map per node.
+*
+* Lookups take a shared lock and run concurrently, writers are serialised.
+* A write holds the lock exclusively, so lookups wait for it: one lock keeps
+* edge splits and merges, which touch a parent and its children, simple, and
+* a write costs about a lookup of the same sequence plus copying its new
+* keys, so readers wait for about that long. Sharding the lock by the first
+* key would only pay off with many concurrent writers.
+*
+* Nothing recurses over the tree, so its depth is not bounded by the stack.
+*/
+class PrefixIndex {
+public:
+    PrefixIndex();
+    ~PrefixIndex();
+
+    PrefixIndex(const PrefixIndex&) = delete;
+    PrefixIndex& operator=(const PrefixIndex&) = delete;
+
+    // Adds the chunks of keys with their locations (1-D tensors of the same
+    // length), updating the location of chunks already present. Returns the
+    // number of chunks added.
+    int64_t insert(const torch::Tensor& keys, const torch::Tensor& locations);
+    // Number of leading chunks of keys in the index
+    int64_t longest_prefix(const torch::Tensor& keys) const;
+    // longest_prefix of each sequence, under a single lock
+    std::vector<int64_t> longest_prefixes(const std::vector<torch::Tensor>& keys) const;
+    // int64 locations of the leading chunks of keys in the index
+    torch::Tensor lookup(const torch::Tensor& keys) const;
+    // Removes the last chunk of keys and every chunk after it. Returns the
+    // locations removed, for the caller to free.
+    torch::Tensor remove(const torch::Tensor& keys);
+    void clear();
+
+    // Number of chunks, and of tree nodes
+    int64_t size() const;
+    int64_t num_nodes() const;
+
+private:
+    struct Node;
+
+    // Walks keys from the root: the deepest node reached and the number of
+    // keys matched on its edge. Returns the number of keys matched.
+    int64_t walk(const int64_t* keys, int64_t length, const Node** node, int64_t* edgeMatched) const;
+    int64_t match(const int64_t* keys, int64_t length, int64_t* locations) const;
+    static void collect(const Node& node, int64_t from, std::vector<int64_t>& locations, int64_t& nodes);
+
+    mutable std::shared_mutex mutex;
+    std::unique_ptr<Node> root;
+    int64_t numChunks = 0;
+    int64_t numNodes = 0;
+};
+
+} // namespace lmc
@@ -1,26 +1,219 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include "mem_kernels.h"
 #include "managed_mem.h"
 #include "cachegen_kernels.h"
 #include "pos_kernels.h"
+#include "blend_kernels.h"
+#include "host_allocator.h"
+#include "transfer_trace.h"
+#include "kv_quant.h"
+#include "disk_engine.h"
+#include "chunk_store.h"
+#include "chunk_hash.h"
+#include "prefix_index.h"
+#include "kv_layout.h"
+#include "eviction.h"
+#include "kv_codec.h"
 #include <torch/torch.h>
 #include <iostream>
+#include <limits>
 
 namespace py = pybind11;
 
 PYBIND11_MODULE(c_ops, m) {
   m.def("host_register", &register_memory);
+  m.def("alloc_pinned_memory", &alloc_pinned_memory, py::arg("size"),
+        py::arg("populate_threads"),
+        py::arg("numa_node") = lmc::NUMA_NODE_LOCAL,
+        py::arg("huge_page_size") = 0, py::arg("strict_numa") = false,
+        py::call_guard<py::gil_scoped_release>());
+  m.attr("NUMA_NODE_LOCAL") = lmc::NUMA_NODE_LOCAL;
+  m.def("get_host_huge_page_size", &get_host_huge_page_size);
+  m.def("get_host_numa_node", &get_host_numa_node);
+  m.def("device_numa_node", &device_numa_node);
+  m.def("physical_device", &physical_device);
+  m.def("memory_stats", &memory_stats);
+  py::class_<lmc::HostAllocator>(m, "HostAllocator")
+      .def(py::init<torch::Tensor, const std::vector<int64_t>&>(),
+           py::arg("buffer"), py::arg("chunk_sizes") = std::vector<int64_t>{})
+      .def("allocate", &lmc::HostAllocator::allocate,
+           py::call_guard<py::gil_scoped_release>())
+      .def("batched_allocate", &lmc::HostAllocator::batched_allocate,
+           py::call_guard<py::gil_scoped_release>())
+      .def("free", &lmc::HostAllocator::free,
+           py::call_guard<py::gil_scoped_release>())
+      .def("batched_free", &lmc::HostAllocator::batched_free,
+           py::call_guard<py::gil_scoped_release>())
+      .def("device_ptr", &lmc::HostAllocator::device_ptr)
+      .def("block_size", &lmc::HostAllocator::block_size)
+      .def("used_bytes", &lmc::HostAllocator::used_bytes)
+      .def("reserved_bytes", &lmc::HostAllocator::reserved_bytes)
+      .def("capacity", &lmc::HostAllocator::capacity);
+  py::class_<lmc::DiskEngine>(m, "DiskEngine")
+      .def(py::init<const std::string&, const std::vector<torch::Tensor>&,
+                    int64_t, bool, int64_t>(),
+           py::arg("path"), py::arg("buffers") = std::vector<torch::Tensor>{},
+           py::arg("queue_depth") = 64, py::arg("direct") = true,
+           py::arg("size") = 0)
+      .def("submit_write", &lmc::DiskEngine::submit_write,
+           py::call_guard<py::gil_scoped_release>())
+      .def("submit_read", &lmc::DiskEngine::submit_read,
+           py::call_guard<py::gil_scoped_release>())
+      .def("poll", &lmc::DiskEngine::poll, py::arg("min_completions") = 0,
+           py::call_guard<py::gil_scoped_release>())
+      .def("inflight", &lmc::DiskEngine::inflight)
+      .def("direct", &lmc::DiskEngine::direct)
+      .def("alignment", &lmc::DiskEngine::alignment)
+      .def("queue_depth", &lmc::DiskEngine::queue_depth)
+      .def("close", &lmc::DiskEngine::close,
+           py::call_guard<py::gil_scoped_release>());
+  py::class_<lmc::ChunkStore>(m, "ChunkStore")
+      .def(py::init<const std::string&, int64_t, int64_t>(), py::arg("path"),
+           py::arg("slot_size") = 0, py::arg("num_slots") = 0)
+      .def("put", &lmc::ChunkStore::put,
+           py::call_guard<py::gil_scoped_release>())
+      .def("get", &lmc::ChunkStore::get,
+           py::call_guard<py::gil_scoped_release>())
+      .def("contains", &lmc::ChunkStore::contains)
+      .def("remove", &lmc::ChunkStore::remove)
+      .def("keys", &lmc::ChunkStore::keys)
+      .def("flush", &lmc::ChunkStore::flush, py::arg("sync") = true,
+           py::call_guard<py::gil_scoped_release>())
+      .def("data", &lmc::ChunkStore::data)
+      .def("num_chunks", &lmc::ChunkStore::num_chunks)
+      .def("num_slots", &lmc::ChunkStore::num_slots)
+      .def("slot_size", &lmc::ChunkStore::slot_size)
+      .def("close", &lmc::ChunkStore::close);
+  py::class_<lmc::PrefixIndex>(m, "PrefixIndex")
+      .def(py::init<>())
+      .def("insert", &lmc::PrefixIndex::insert, py::arg("keys"),
+           py::arg("locations"), py::call_guard<py::gil_scoped_release>())
+      .def("longest_prefix", &lmc::PrefixIndex::longest_prefix,
+           py::call_guard<py::gil_scoped_release>())
+      .def("longest_prefixes", &lmc::PrefixIndex::longest_prefixes,
+           py::call_guard<py::gil_scoped_release>())
+      .def("lookup", &lmc::PrefixIndex::lookup,
+           py::call_guard<py::gil_scoped_release>())
+      .def("remove", &lmc::PrefixIndex::remove,
+           py::call_guard<py::gil_scoped_release>())
+      .def("clear", &lmc::PrefixIndex::clear)
+      .def("size", &lmc::PrefixIndex::size)
+      .def("num_nodes", &lmc::PrefixIndex::num_nodes);
+  py::class_<lmc::EvictionEngine>(m, "EvictionEngine")
+      .def(py::init<int64_t, double>(), py::arg("capacity"),
+           py::arg("small_ratio") = 0.1)
+      .def("insert", &lmc::EvictionEngine::insert, py::arg("key"),
+           py::arg("size"), py::arg("location") = 0,
+           py::call_guard<py::gil_scoped_release>())
+      .def("touch", &lmc::EvictionEngine::touch,
+           py::call_guard<py::gil_scoped_release>())
+      .def("touch_prefix", &lmc::EvictionEngine::touch_prefix,
+           py::call_guard<py::gil_scoped_release>())
+      .def("contains", &lmc::EvictionEngine::contains,
+           py::call_guard<py::gil_scoped_release>())
+      .def("pin", &lmc::EvictionEngine::pin,
+           py::call_guard<py::gil_scoped_release>())
+      .def("unpin", &lmc::EvictionEngine::unpin,
+           py::call_guard<py::gil_scoped_release>())
+      .def("remove", &lmc::EvictionEngine::remove)
+      .def("evict", &lmc::EvictionEngine::evict,
+           py::call_guard<py::gil_scoped_release>())
+      .def("clear", &lmc::EvictionEngine::clear)
+      .def("stats", &lmc::EvictionEngine::stats)
+      .def("reset_stats", &lmc::EvictionEngine::reset_stats)
+      .def("size", &lmc::EvictionEngine::size)
+      .def("used_bytes", &lmc::EvictionEngine::used_bytes)
+      .def("capacity", &lmc::EvictionEngine::capacity);
   m.def("multi_layer_kv_transfer", &multi_layer_kv_transfer);
-  m.def("single_layer_kv_transfer", &single_layer_kv_transfer);
+  m.def("single_layer_kv_transfer", &single_layer_kv_transfer,
+        py::arg("lmc_key_value_cache"), py::arg("vllm_key_cache"),
+        py::arg("vllm_value_cache"), py::arg("slot_mapping"),
+        py::arg("direction"), py::arg("token_major") = false,
+        py::arg("use_mla") = false);
+  m.def("single_layer_kv_transfer_segmented",
+        &single_layer_kv_transfer_segmented, py::arg("lmc_key_value_caches"),
+        py::arg("vllm_key_cache"), py::arg("vllm_value_cache"),
+        py::arg("slot_mapping"), py::arg("starts"), py::arg("ends"),
+        py::arg("direction"), py::arg("token_major") = true,
+        py::arg("use_mla") = false);
+  m.def("slot_mapping_extents", &slot_mapping_extents, py::arg("slot_mapping"),
+        py::arg("max_length") = std::numeric_limits<int64_t>::max());
+  m.def("single_layer_kv_transfer_quantized",
+        &single_layer_kv_transfer_quantized, py::arg("lmc_key_value_cache"),
+        py::arg("scales"), py::arg("vllm_key_cache"),
+        py::arg("vllm_value_cache"), py::arg("slot_mapping"),
+        py::arg("direction"), py::arg("token_major") = false,
+        py::arg("use_mla") = false);
+  m.def("quantize_kv", &quantize_kv, py::arg("src"), py::arg("dst"),
+        py::arg("scales"));
+  m.def("dequantize_kv", &dequantize_kv, py::arg("src"), py::arg("scales"),
+        py::arg("dst"));
+  m.def("convert_kv_layout", &convert_kv_layout, py::arg("src"),
+        py::arg("dst"), py::arg("to_token_major"),
+        py::call_guard<py::gil_scoped_release>());
+  m.def("lossless_codecs", &lossless_codecs);
+  m.def("lossless_max_compressed_size", &lossless_max_compressed_size,
+        py::arg("num_bytes"),
+        py::arg("block_bytes") = LOSSLESS_DEFAULT_BLOCK_BYTES);
+  m.def("lossless_compress", &lossless_compress, py::arg("src"),
+        py::arg("dst"), py::arg("codec") = "zstd", py::arg("level") = 1,
+        py::arg("block_bytes") = LOSSLESS_DEFAULT_BLOCK_BYTES,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("lossless_decompressed_size", &lossless_decompressed_size,
+        py::arg("src"));
+  m.def("lossless_decompress", &lossless_decompress, py::arg("src"),
+        py::arg("dst"), py::call_guard<py::gil_scoped_release>());
+  m.def("chunk_hashes", &chunk_hashes, py::arg("tokens"),
+        py::arg("chunk_size"), py::arg("prefix_hash") = 0,
+        py::arg("include_partial") = true,
+        py::call_guard<py::gil_scoped_release>());
   m.def("multi_layer_kv_transfer_unilateral",
         &multi_layer_kv_transfer_unilateral);
-  m.def("load_and_reshape_flash", &load_and_reshape_flash);
-  m.def("reshape_and_cache_back_flash", &reshape_and_cache_back_flash);
-  m.def("encode_fast_new", &encode_cuda_new);
-  m.def("decode_fast_new", &decode_cuda_new);
-  m.def("decode_fast_prefsum", &decode_cuda_prefsum);
-  m.def("calculate_cdf", &calculate_cdf);
-  m.def("rotary_embedding_k_fused", &rotary_embedding_k_fused);
+  m.def("load_and_reshape_flash", &load_and_reshape_flash,
+        py::arg("key_value"), py::arg("key_cache"), py::arg("value_cache"),
+        py::arg("slot_mapping"), py::arg("layer_idx"),
+        py::arg("use_mla") = false);
+  m.def("reshape_and_cache_back_flash", &reshape_and_cache_back_flash,
+        py::arg("key_value"), py::arg("key_cache"), py::arg("value_cache"),
+        py::arg("slot_mapping"), py::arg("layer_idx"),
+        py::arg("use_mla") = false);
+  py::class_<KVTransferPlan>(m, "KVTransferPlan")
+      .def(py::init<const std::vector<torch::Tensor>&,
+                    const std::vector<torch::Tensor>&>(),
+           py::arg("key_caches"),
+           py::arg("value_caches") = std::vector<torch::Tensor>{})
+      .def("multi_layer_transfer", &KVTransferPlan::multi_layer_transfer)
+      .def("single_layer_transfer", &KVTransferPlan::single_layer_transfer)
+      .def("single_layer_transfer_segmented",
+           &KVTransferPlan::single_layer_transfer_segmented)
+      .def("multi_layer_transfer_quantized",
+           &KVTransferPlan::multi_layer_transfer_quantized)
+      .def("single_layer_transfer_quantized",
+           &KVTransferPlan::single_layer_transfer_quantized)
+      .def("flash_layer_transfer", &KVTransferPlan::flash_layer_transfer)
+      .def("num_layers", &KVTransferPlan::num_layers)
+      .def("page_buffer_size", &KVTransferPlan::page_buffer_size)
+      .def("use_mla", &KVTransferPlan::use_mla)
+      .def("key_ptrs", &KVTransferPlan::key_ptrs);
+  m.def("start_transfer_trace", &start_transfer_trace,
+        py::arg("capacity") = lmc::TransferTracer::DEFAULT_CAPACITY);
+  m.def("stop_transfer_trace", &stop_transfer_trace);
+  m.def("dump_transfer_trace", &dump_transfer_trace,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("encode_fast_new", &encode_cuda_new,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("decode_fast_new", &decode_cuda_new,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("decode_fast_prefsum", &decode_cuda_prefsum,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("calculate_cdf", &calculate_cdf,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("rotary_embedding_k_fused", &rotary_embedding_k_fused,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("select_deviated_tokens", &select_deviated_tokens, py::arg("q"),
+        py::arg("k"), py::arg("v"), py::arg("residual"), py::arg("old_k"),
+        py::arg("topk"), py::call_guard<py::gil_scoped_release>());
 }
\ No newline at end of file
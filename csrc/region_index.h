@@ -0,0 +1,86 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace lmc {
+
+struct RegisteredMemoryRecord {
+    uintptr_t ptr;
+    uintptr_t devptr;
+    size_t buffSize;
+    // Registered through halHostRegister rather than aclrtHostRegister
+    bool viaHal = false;
+    // NUMA node the memory is bound to, -1 if unbound
+    int numaNode = -1;
+    // Size of the hugetlb pages backing the memory, 0 if none
+    size_t hugePageSize = 0;
+    // Device the memory is registered on
+    int device = -1;
+};
+
+/*
+* Host address -> registered region lookup, read without locks.
+*
+* The regions are kept as an immutable snapshot sorted by host address, so a
+* lookup is an upper_bound over a flat array of start addresses. Writers
+* (register / unregister, serialised by the caller) build a new snapshot and
+* publish it with a single atomic store; readers load the current snapshot and
+* never block, whatever the number of concurrent offload / retrieve threads.
+*
+* Replaced snapshots are only freed on destruction: readers may still be
+* walking them, and registrations happen a handful of times per process, so
+* keeping them is cheaper than tracking when the last reader left.
+*/
+class RegionIndex {
+public:
+    RegionIndex() {
+        publish({});
+    }
+
+    RegionIndex(const RegionIndex&) = delete;
+    RegionIndex& operator=(const RegionIndex&) = delete;
+
+    // Returns the region containing addr, or nullptr. The record stays valid
+    // for the lifetime of the index.
+    const RegisteredMemoryRecord* find(uintptr_t addr) const {
+        const Snapshot* snapshot = current.load(std::memory_order_acquire);
+        const auto& starts = snapshot->starts;
+        auto it = std::upper_bound(starts.begin(), starts.end(), addr);
+        if (it == starts.begin()) {
+            return nullptr;
+        }
+        const RegisteredMemoryRecord& record = snapshot->records[(it - starts.begin()) - 1];
+        return addr - record.ptr < record.buffSize ? &record : nullptr;
+    }
+
+    // Rebuilds the index from the registered regions (keyed by host pointer,
+    // so already sorted). Must not be called concurrently with itself.
+    void publish(const std::map<void*, RegisteredMemoryRecord>& regions) {
+        auto snapshot = std::make_unique<Snapshot>();
+        snapshot->starts.reserve(regions.size());
+        snapshot->records.reserve(regions.size());
+        for (const auto& pair : regions) {
+            snapshot->starts.push_back(pair.second.ptr);
+            snapshot->records.push_back(pair.second);
+        }
+        current.store(snapshot.get(), std::memory_order_release);
+        snapshots.push_back(std::move(snapshot));
+    }
+
+private:
+    struct Snapshot {
+        std::vector<uintptr_t> starts;
+        std::vector<RegisteredMemoryRecord> records;
+    };
+
+    std::atomic<const Snapshot*> current{nullptr};
+    // Every snapshot ever published, the last one is current
+    std::vector<std::unique_ptr<const Snapshot>> snapshots;
+};
+
+} // namespace lmc
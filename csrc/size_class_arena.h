@@ -0,0 +1,323 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace lmc {
+
+/*
+* Size-class sub-allocator over a fixed region, in byte offsets.
+*
+* Requests are rounded up to a size class and served O(1) from, in order:
+*   - the calling thread's cache of the class (a few blocks, uncontended),
+*   - the class free list, a lock-free Treiber stack whose links are stored
+*     in the free blocks themselves,
+*   - the untouched tail of the region (atomic bump).
+* KV chunks come in a handful of sizes, so a freed block stays in its class
+* and is reused by the next chunk of the same shape. The chunk sizes given at
+* construction get exact classes, every other size goes to a geometric class
+* (4 per power of two, <= 25% waste).
+*
+* When the region is exhausted the thread caches are drained into the free
+* lists, then the free blocks of all classes are coalesced under a lock (see
+* reclaim), so memory freed by one class can be used by another. That slow
+* path costs O(F log F) for F free blocks and only runs when the fast paths
+* failed.
+*/
+class SizeClassArena {
+public:
+    static constexpr uint64_t ALIGN = 256;
+    static constexpr int MAX_CHUNK_CLASSES = 8;
+    static constexpr int CACHE_SLOTS = 64;
+    static constexpr int CACHE_DEPTH = 4;
+    static constexpr uint64_t NO_BLOCK = ~0ULL;
+
+    SizeClassArena(uint64_t capacity, const std::vector<uint64_t>& chunkSizes)
+        : capacity(capacity / ALIGN * ALIGN) {
+        for (uint64_t size : chunkSizes) {
+            const uint64_t rounded = roundUp(size);
+            if (rounded > 0 && numChunkClasses < MAX_CHUNK_CLASSES &&
+                std::find(chunkClasses.begin(), chunkClasses.begin() + numChunkClasses, rounded) ==
+                    chunkClasses.begin() + numChunkClasses) {
+                chunkClasses[numChunkClasses++] = rounded;
+            }
+        }
+        for (auto& head : freeHeads) {
+            head.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    SizeClassArena(const SizeClassArena&) = delete;
+    SizeClassArena& operator=(const SizeClassArena&) = delete;
+
+    // base is the address of offset 0, free blocks hold their free list link
+    void setBase(uint8_t* regionBase) {
+        base = regionBase;
+    }
+
+    // Offset of a block of at least nbytes, NO_BLOCK when the region is full
+    uint64_t allocate(uint64_t nbytes) {
+        if (nbytes == 0 || nbytes > capacity) {
+            return NO_BLOCK;
+        }
+        const int cls = classOf(nbytes);
+        uint64_t offset = popCache(cls);
+        if (offset == NO_BLOCK) {
+            offset = popFree(cls);
+        }
+        if (offset == NO_BLOCK) {
+            offset = bump(classSize(cls));
+        }
+        if (offset == NO_BLOCK) {
+            drainCaches();
+            offset = popFree(cls);
+        }
+        if (offset == NO_BLOCK) {
+            offset = reclaim(classSize(cls));
+        }
+        if (offset != NO_BLOCK) {
+            usedBytes.fetch_add(classSize(cls), std::memory_order_relaxed);
+        }
+        return offset;
+    }
+
+    // nbytes must be the size the block was allocated with
+    void free(uint64_t offset, uint64_t nbytes) {
+        const int cls = classOf(nbytes);
+        usedBytes.fetch_sub(classSize(cls), std::memory_order_relaxed);
+        if (!pushCache(cls, offset)) {
+            pushFree(cls, offset);
+        }
+    }
+
+    // Size of the block backing an nbytes request
+    uint64_t blockSize(uint64_t nbytes) const {
+        return classSize(classOf(nbytes));
+    }
+
+    // Bytes held by live blocks, rounded up to their class
+    uint64_t used() const {
+        return usedBytes.load(std::memory_order_relaxed);
+    }
+
+    // Bytes carved out of the region, live or free, up to the last block in use
+    // as of the last reclaim
+    uint64_t reserved() const {
+        return bumpOffset.load(std::memory_order_relaxed);
+    }
+
+    uint64_t size() const {
+        return capacity;
+    }
+
+private:
+    // 4 linear classes up to 1 KiB, then 4 per power of two up to 2^63
+    static constexpr int NUM_GEOMETRIC_CLASSES = 4 + 4 * (63 - 10);
+    static constexpr int NUM_CLASSES = MAX_CHUNK_CLASSES + NUM_GEOMETRIC_CLASSES;
+    // Free list heads: (tag << OFFSET_BITS) | (offset / ALIGN + 1), 0 when empty.
+    // The tag changes on every update so a stale head fails its CAS (ABA).
+    static constexpr int OFFSET_BITS = 40;
+    static constexpr uint64_t OFFSET_MASK = (1ULL << OFFSET_BITS) - 1;
+
+    static uint64_t roundUp(uint64_t nbytes) {
+        return (nbytes + ALIGN - 1) / ALIGN * ALIGN;
+    }
+
+    static int log2Floor(uint64_t value) {
+        return 63 - __builtin_clzll(value);
+    }
+
+    int classOf(uint64_t nbytes) const {
+        const uint64_t rounded = roundUp(nbytes);
+        for (int i = 0; i < numChunkClasses; ++i) {
+            if (chunkClasses[i] == rounded) {
+                return i;
+            }
+        }
+        if (rounded <= 1024) {
+            return MAX_CHUNK_CLASSES + static_cast<int>(rounded / ALIGN) - 1;
+        }
+        // rounded in (2^p, 2^(p+1)], classes 2^p + k * 2^(p-2) for k = 1..4
+        const int p = log2Floor(rounded - 1);
+        const uint64_t step = 1ULL << (p - 2);
+        const uint64_t k = (rounded - (1ULL << p) + step - 1) / step;
+        return MAX_CHUNK_CLASSES + 4 + (p - 10) * 4 + static_cast<int>(k) - 1;
+    }
+
+    uint64_t classSize(int cls) const {
+        if (cls < MAX_CHUNK_CLASSES) {
+            return chunkClasses[cls];
+        }
+        const int geometric = cls - MAX_CHUNK_CLASSES;
+        if (geometric < 4) {
+            return static_cast<uint64_t>(geometric + 1) * ALIGN;
+        }
+        const int p = 10 + (geometric - 4) / 4;
+        const uint64_t k = (geometric - 4) % 4 + 1;
+        return (1ULL << p) + k * (1ULL << (p - 2));
+    }
+
+    uint64_t bump(uint64_t blockBytes) {
+        uint64_t offset = bumpOffset.load(std::memory_order_relaxed);
+        do {
+            if (blockBytes > capacity - offset) {
+                return NO_BLOCK;
+            }
+        // acquire: the range may have been given back by reclaim
+        } while (!bumpOffset.compare_exchange_weak(offset, offset + blockBytes, std::memory_order_acquire,
+                                                   std::memory_order_relaxed));
+        return offset;
+    }
+
+    uint64_t* link(uint64_t offset) const {
+        return reinterpret_cast<uint64_t*>(base + offset);
+    }
+
+    void pushFree(int cls, uint64_t offset) {
+        std::atomic<uint64_t>& head = freeHeads[cls];
+        uint64_t old = head.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            __atomic_store_n(link(offset), old & OFFSET_MASK, __ATOMIC_RELAXED);
+            next = (((old >> OFFSET_BITS) + 1) << OFFSET_BITS) | (offset / ALIGN + 1);
+        } while (!head.compare_exchange_weak(old, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    uint64_t popFree(int cls) {
+        std::atomic<uint64_t>& head = freeHeads[cls];
+        uint64_t old = head.load(std::memory_order_acquire);
+        uint64_t next;
+        uint64_t offset;
+        do {
+            if ((old & OFFSET_MASK) == 0) {
+                return NO_BLOCK;
+            }
+            offset = ((old & OFFSET_MASK) - 1) * ALIGN;
+            // May read a block another thread just popped and reused; the tag
+            // then makes the CAS fail and the garbage link is never installed.
+            const uint64_t nextLink = __atomic_load_n(link(offset), __ATOMIC_RELAXED);
+            next = (((old >> OFFSET_BITS) + 1) << OFFSET_BITS) | nextLink;
+        } while (!head.compare_exchange_weak(old, next, std::memory_order_acquire, std::memory_order_acquire));
+        return offset;
+    }
+
+    // Empties the free lists of all classes into spans, merges the adjacent
+    // ones, gives the span ending at the bump offset back to the region and
+    // serves blockBytes from the region or the first span large enough.
+    // Spans left over are kept for the next call. Concurrent allocations keep
+    // using the lock-free paths, they just find the free lists empty.
+    uint64_t reclaim(uint64_t blockBytes) {
+        std::lock_guard<std::mutex> lock(reclaimMutex);
+        for (int cls = 0; cls < NUM_CLASSES; ++cls) {
+            for (uint64_t offset = popFree(cls); offset != NO_BLOCK; offset = popFree(cls)) {
+                spans.emplace_back(offset, classSize(cls));
+            }
+        }
+        std::sort(spans.begin(), spans.end());
+        size_t merged = 0;
+        for (size_t i = 1; i < spans.size(); ++i) {
+            if (spans[merged].first + spans[merged].second == spans[i].first) {
+                spans[merged].second += spans[i].second;
+            } else {
+                spans[++merged] = spans[i];
+            }
+        }
+        spans.resize(spans.empty() ? 0 : merged + 1);
+        if (!spans.empty()) {
+            // Fails if a block was bumped since, the span then stays a span
+            uint64_t end = spans.back().first + spans.back().second;
+            if (bumpOffset.compare_exchange_strong(end, spans.back().first, std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+                spans.pop_back();
+            }
+        }
+        uint64_t offset = bump(blockBytes);
+        if (offset != NO_BLOCK) {
+            return offset;
+        }
+        for (size_t i = 0; i < spans.size(); ++i) {
+            if (spans[i].second >= blockBytes) {
+                offset = spans[i].first;
+                spans[i].first += blockBytes;
+                spans[i].second -= blockBytes;
+                if (spans[i].second == 0) {
+                    spans.erase(spans.begin() + i);
+                }
+                return offset;
+            }
+        }
+        return NO_BLOCK;
+    }
+
+    // Thread caches. Threads are spread over CACHE_SLOTS slots, each guarded
+    // by a flag that its thread takes with a single uncontended exchange; a
+    // thread whose slot is busy (shared slot or drain) bypasses the cache.
+    struct alignas(64) ThreadCache {
+        std::atomic<bool> busy{false};
+        std::array<uint8_t, NUM_CLASSES> count{};
+        std::array<std::array<uint64_t, CACHE_DEPTH>, NUM_CLASSES> blocks;
+    };
+
+    static int threadSlot() {
+        static std::atomic<int> nextSlot{0};
+        thread_local const int slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % CACHE_SLOTS;
+        return slot;
+    }
+
+    uint64_t popCache(int cls) {
+        ThreadCache& cache = caches[threadSlot()];
+        if (cache.busy.exchange(true, std::memory_order_acquire)) {
+            return NO_BLOCK;
+        }
+        uint64_t offset = NO_BLOCK;
+        if (cache.count[cls] > 0) {
+            offset = cache.blocks[cls][--cache.count[cls]];
+        }
+        cache.busy.store(false, std::memory_order_release);
+        return offset;
+    }
+
+    bool pushCache(int cls, uint64_t offset) {
+        ThreadCache& cache = caches[threadSlot()];
+        if (cache.busy.exchange(true, std::memory_order_acquire)) {
+            return false;
+        }
+        const bool cached = cache.count[cls] < CACHE_DEPTH;
+        if (cached) {
+            cache.blocks[cls][cache.count[cls]++] = offset;
+        }
+        cache.busy.store(false, std::memory_order_release);
+        return cached;
+    }
+
+    void drainCaches() {
+        for (ThreadCache& cache : caches) {
+            while (cache.busy.exchange(true, std::memory_order_acquire)) {
+            }
+            for (int cls = 0; cls < NUM_CLASSES; ++cls) {
+                while (cache.count[cls] > 0) {
+                    pushFree(cls, cache.blocks[cls][--cache.count[cls]]);
+                }
+            }
+            cache.busy.store(false, std::memory_order_release);
+        }
+    }
+
+    const uint64_t capacity;
+    uint8_t* base = nullptr;
+    std::array<uint64_t, MAX_CHUNK_CLASSES> chunkClasses{};
+    int numChunkClasses = 0;
+    std::array<std::atomic<uint64_t>, NUM_CLASSES> freeHeads;
+    std::atomic<uint64_t> bumpOffset{0};
+    std::atomic<uint64_t> usedBytes{0};
+    std::array<ThreadCache, CACHE_SLOTS> caches;
+    // Coalesced free (offset, bytes) ranges in no free list, see reclaim
+    std::mutex reclaimMutex;
+    std::vector<std::pair<uint64_t, uint64_t>> spans;
+};
+
+} // namespace lmc
@@ -0,0 +1,150 @@
+#include "transfer_trace.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <torch/torch.h>
+
+namespace lmc {
+
+namespace {
+
+int32_t currentTid() {
+    thread_local const int32_t tid = static_cast<int32_t>(syscall(SYS_gettid));
+    return tid;
+}
+
+const char* directionName(int32_t direction) {
+    switch (static_cast<TraceDirection>(direction)) {
+        case TraceDirection::RETRIEVE:
+            return "retrieve";
+        case TraceDirection::OFFLOAD:
+            return "offload";
+        default:
+            return "none";
+    }
+}
+
+} // namespace
+
+void TransferTracer::start(size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < std::max<size_t>(capacity, 1)) {
+        rounded <<= 1;
+    }
+    const std::lock_guard<std::mutex> guard(this->mux);
+    Ring* current = this->ring.load(std::memory_order_relaxed);
+    if (current == nullptr || current->mask + 1 < rounded) {
+        this->rings.push_back(std::make_unique<Ring>(rounded));
+        current = this->rings.back().get();
+    } else {
+        current->limit.store(rounded, std::memory_order_relaxed);
+        current->first.store(current->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    this->ring.store(current, std::memory_order_release);
+    this->on.store(true, std::memory_order_relaxed);
+}
+
+void TransferTracer::stop() {
+    const std::lock_guard<std::mutex> guard(this->mux);
+    this->on.store(false, std::memory_order_relaxed);
+}
+
+void TransferTracer::record(const char* name, uint64_t startNs, uint64_t endNs, const TraceInfo& info) {
+    Ring* current = this->ring.load(std::memory_order_acquire);
+    if (current == nullptr) {
+        return;
+    }
+    const uint64_t index = current->head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = current->slots[index & current->mask];
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.tokens.store(info.tokens, std::memory_order_relaxed);
+    slot.bytes.store(info.bytes, std::memory_order_relaxed);
+    slot.layer.store(info.layer, std::memory_order_relaxed);
+    slot.direction.store(static_cast<int32_t>(info.direction), std::memory_order_relaxed);
+    slot.tid.store(currentTid(), std::memory_order_relaxed);
+    slot.host.store(info.host, std::memory_order_relaxed);
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+/*
+*    Spans still being written, or overwritten while we read them, fail the
+*    sequence check and are skipped: a dump taken while transfers run is a
+*    consistent subset of the ring, not a blocking snapshot.
+*/
+std::string TransferTracer::toJson(size_t* numSpans) const {
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    size_t written = 0;
+    const Ring* current = this->ring.load(std::memory_order_acquire);
+    if (current != nullptr) {
+        const int pid = static_cast<int>(getpid());
+        const uint64_t head = current->head.load(std::memory_order_acquire);
+        const uint64_t limit = current->limit.load(std::memory_order_relaxed);
+        const uint64_t first =
+            std::max(current->first.load(std::memory_order_relaxed), head > limit ? head - limit : uint64_t{0});
+        for (uint64_t index = first; index < head; ++index) {
+            const Slot& slot = current->slots[index & current->mask];
+            const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != 2 * index + 2) {
+                continue;
+            }
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            const uint64_t startNs = slot.startNs.load(std::memory_order_relaxed);
+            const uint64_t endNs = slot.endNs.load(std::memory_order_relaxed);
+            const int64_t tokens = slot.tokens.load(std::memory_order_relaxed);
+            const int64_t bytes = slot.bytes.load(std::memory_order_relaxed);
+            const int32_t layer = slot.layer.load(std::memory_order_relaxed);
+            const int32_t direction = slot.direction.load(std::memory_order_relaxed);
+            const int32_t tid = slot.tid.load(std::memory_order_relaxed);
+            const bool host = slot.host.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq) {
+                continue;
+            }
+
+            out << (written == 0 ? "" : ",")
+                << "{\"name\":\"" << name << "\",\"cat\":\"" << (host ? "cpu" : "npu")
+                << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid
+                << ",\"ts\":" << startNs / 1000 << "." << (startNs % 1000) / 100
+                << ",\"dur\":" << (endNs - startNs) / 1000 << "." << ((endNs - startNs) % 1000) / 100
+                << ",\"args\":{\"tokens\":" << tokens << ",\"bytes\":" << bytes
+                << ",\"layer\":" << layer << ",\"direction\":\"" << directionName(direction) << "\"}}";
+            ++written;
+        }
+    }
+    out << "]}";
+    if (numSpans != nullptr) {
+        *numSpans = written;
+    }
+    return out.str();
+}
+
+size_t TransferTracer::dump(const std::string& path) const {
+    size_t numSpans = 0;
+    const std::string json = toJson(&numSpans);
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    file << json;
+    TORCH_CHECK(file.good(), "Unable to write the transfer trace to " + path);
+    return numSpans;
+}
+
+} // namespace lmc
+
+void start_transfer_trace(int64_t capacity) {
+    TORCH_CHECK(capacity > 0, "capacity must be greater than 0.");
+    lmc::TransferTracer::GetInstance().start(static_cast<size_t>(capacity));
+}
+
+void stop_transfer_trace() {
+    lmc::TransferTracer::GetInstance().stop();
+}
+
+int64_t dump_transfer_trace(const std::string& path) {
+    return static_cast<int64_t>(lmc::TransferTracer::GetInstance().dump(path));
+}
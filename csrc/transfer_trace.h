@@ -0,0 +1,144 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lmc {
+
+/*
+* Opt-in tracing of the KV transfer ops (mem_kernels.cpp and their cpu_ops
+* fallbacks), exported as Chrome trace JSON (chrome://tracing, Perfetto).
+*
+* Spans go into a fixed size ring buffer: a writer claims a slot with one
+* fetch_add and fills it under a per slot sequence number, so concurrent
+* launch threads never wait on each other and the oldest spans are simply
+* overwritten. While tracing is off a TraceSpan costs one relaxed load.
+*
+* For device ops the span covers the OpCommand handler, i.e. the kernel
+* launch on the dispatch thread, not the kernel execution on the stream.
+*/
+
+enum class TraceDirection : int32_t {
+    NONE = 0,
+    // LMCache buffer -> paged KV cache
+    RETRIEVE = 1,
+    // paged KV cache -> LMCache buffer
+    OFFLOAD = 2,
+};
+
+struct TraceInfo {
+    int64_t tokens = 0;
+    int64_t bytes = 0;
+    // -1 for ops spanning every layer
+    int32_t layer = -1;
+    TraceDirection direction = TraceDirection::NONE;
+    // Served by cpu_ops rather than a device kernel
+    bool host = false;
+};
+
+class TransferTracer {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+    static TransferTracer& GetInstance() {
+        static TransferTracer tracer;
+        return tracer;
+    }
+
+    TransferTracer(const TransferTracer&) = delete;
+    TransferTracer& operator=(const TransferTracer&) = delete;
+
+    bool enabled() const {
+        return on.load(std::memory_order_relaxed);
+    }
+
+    // Starts recording into a ring of capacity spans (rounded up to a power
+    // of two). Spans recorded so far are dropped.
+    void start(size_t capacity);
+    void stop();
+
+    // Writes the spans currently held by the ring as Chrome trace JSON,
+    // returns the number of spans written
+    size_t dump(const std::string& path) const;
+    std::string toJson(size_t* numSpans = nullptr) const;
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs, const TraceInfo& info);
+
+    static uint64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    TransferTracer() = default;
+
+    // Fields are relaxed atomics so a reader racing a writer sees a stale or
+    // torn slot, never undefined behaviour; seq tells the two apart
+    struct Slot {
+        // 2 * index + 1 while index is being written, 2 * index + 2 once done
+        std::atomic<uint64_t> seq{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> startNs{0};
+        std::atomic<uint64_t> endNs{0};
+        std::atomic<int64_t> tokens{0};
+        std::atomic<int64_t> bytes{0};
+        std::atomic<int32_t> layer{0};
+        std::atomic<int32_t> direction{0};
+        std::atomic<int32_t> tid{0};
+        std::atomic<bool> host{false};
+    };
+
+    struct Ring {
+        explicit Ring(size_t capacity) : mask(capacity - 1), slots(capacity), limit(capacity) {}
+        const size_t mask;
+        std::vector<Slot> slots;
+        std::atomic<uint64_t> head{0};
+        // A reused ring reports the spans from index first on, at most the
+        // limit capacity of the start() that reused it
+        std::atomic<uint64_t> first{0};
+        std::atomic<uint64_t> limit;
+    };
+
+    std::atomic<bool> on{false};
+    std::atomic<Ring*> ring{nullptr};
+    // Serialises start / stop; replaced rings are kept alive since writers
+    // that loaded them may still be filling a slot. start() reuses the
+    // current ring unless it is too small, so each ring is at least twice
+    // the previous one and they take less than twice the largest.
+    std::mutex mux;
+    std::vector<std::unique_ptr<Ring>> rings;
+};
+
+// Records the lifetime of the scope as a span when tracing is on
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const TraceInfo& info)
+        : name(TransferTracer::GetInstance().enabled() ? name : nullptr), info(info),
+          startNs(this->name != nullptr ? TransferTracer::nowNs() : 0) {}
+
+    ~TraceSpan() {
+        if (name != nullptr) {
+            TransferTracer::GetInstance().record(name, startNs, TransferTracer::nowNs(), info);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const TraceInfo info;
+    const uint64_t startNs;
+};
+
+} // namespace lmc
+
+// Starts tracing the transfer ops into a ring of capacity spans
+void start_transfer_trace(int64_t capacity);
+void stop_transfer_trace();
+// Writes the traced spans to path as Chrome trace JSON, returns their number
+int64_t dump_transfer_trace(const std::string& path);
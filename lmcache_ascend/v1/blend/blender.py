@@ -8,6 +8,7 @@ import torch
 
 # First Party
 from lmcache.logging import init_logger
+import lmcache.c_ops as lmc_ops
 from lmcache.v1.compute.blend.metadata import LMCBlendCommonMetadata, LMCBlendMetadata
 from lmcache_ascend.v1.blend.models.utils import infer_model_from_vllm
 
@@ -81,20 +82,16 @@ class LMCBlender:
             q, k = attn_layer.rotary_emb(self.metadata.positions, q, k)
 
         if layer_id in self.common_metadata.check_layers:
-            diff_k = torch.sum(
-                (k.to(torch.float32) - old_k.to(torch.float32)) ** 2, dim=[1]
-            )
-            total_len = diff_k.shape[0]
+            total_len = k.shape[0]
 
             # TODO(Jiayi): remove `[0]` hardcode
             topk_num = int(total_len * self.common_metadata.recomp_ratios[0])
 
-            top_indices = torch.topk(diff_k, k=topk_num).indices
-            top_indices, _ = torch.sort(top_indices)
-
-            k, v = k[top_indices], v[top_indices]
-            q = q[top_indices]
-            residual = residual[top_indices]
+            # Scores the key deviation and gathers the selected rows in one
+            # pass, without float copies of k and old_k
+            top_indices, q, k, v, residual = lmc_ops.select_deviated_tokens(
+                q, k, v, residual, old_k, topk_num
+            )
 
             logger.debug(f"Picking indices: {top_indices}")
             self.metadata.imp_indices = top_indices
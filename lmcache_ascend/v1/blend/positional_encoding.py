@@ -158,7 +158,7 @@ def validate_reverse_correctness(rope, reverse_rope, fused_rope, head_size) -> b
 
     max_k_error_fused = (k_pos2 - k_pos2_fused).abs().max()
 
-    logger.info(f"Max K error (fused): {max_k_error.item()}")
+    logger.info(f"Max K error (fused): {max_k_error_fused.item()}")
 
     return max_q_error < 0.1 and max_k_error < 0.1 and max_k_error_fused < 0.1
 
@@ -202,8 +202,7 @@ def get_fused_rope(
     )
 
     reverse_rope = BasicReverseRope(rope, rotary_dim, is_neox_style)
-    # fused_rope = FusedRope(rope, is_neox_style)
-    fused_rope = DummyFusedRope(rope, reverse_rope, is_neox_style)
+    fused_rope = FusedRope(rope, is_neox_style)
 
     correct = validate_reverse_correctness(rope, reverse_rope, fused_rope, head_size)
     if not correct:
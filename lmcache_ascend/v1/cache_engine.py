@@ -6,6 +6,9 @@ from lmcache.v1.config import LMCacheEngineConfig
 from lmcache.v1.memory_management import MemoryAllocatorInterface
 from .memory_management import AscendMixedMemoryAllocator
 
+# extra_config pin_huge_pages values, "" keeps transparent huge pages
+_HUGE_PAGE_SIZES = {"": 0, "2M": 2 << 20, "1G": 1 << 30}
+
 
 def _ascend_create_memory_allocator(
     config: LMCacheEngineConfig,
@@ -18,4 +21,35 @@ def _ascend_create_memory_allocator(
         raise NotImplementedError("Ascend does not support Direct Storage.")
 
     max_local_cpu_size = config.max_local_cpu_size
-    return AscendMixedMemoryAllocator(int(max_local_cpu_size * 1024**3))
+    extra_config = getattr(config, "extra_config", None) or {}
+    populate_threads = extra_config.get("pin_populate_threads")
+    numa_node = extra_config.get("pin_numa_node")
+    strict_numa = bool(extra_config.get("pin_strict_numa", False))
+    huge_page_size = _HUGE_PAGE_SIZES.get(
+        str(extra_config.get("pin_huge_pages", "")).upper()
+    )
+    if huge_page_size is None:
+        raise ValueError(
+            "pin_huge_pages must be one of "
+            f"{[k for k in _HUGE_PAGE_SIZES if k]}, "
+            f"got {extra_config.get('pin_huge_pages')}"
+        )
+    native_allocator = bool(extra_config.get("native_pin_allocator", False))
+    # Full chunks get an exact size class in the native allocator
+    chunk_bytes = metadata.kv_dtype.itemsize
+    for dim in metadata.kv_shape:
+        chunk_bytes *= dim
+    if huge_page_size and populate_threads is None:
+        # hugetlb backing needs the native allocation path
+        populate_threads = 0
+    return AscendMixedMemoryAllocator(
+        int(max_local_cpu_size * 1024**3),
+        populate_threads=(
+            int(populate_threads) if populate_threads is not None else None
+        ),
+        numa_node=int(numa_node) if numa_node is not None else None,
+        huge_page_size=huge_page_size,
+        strict_numa=strict_numa,
+        native_allocator=native_allocator,
+        chunk_sizes=[chunk_bytes],
+    )
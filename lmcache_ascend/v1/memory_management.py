@@ -1,6 +1,7 @@
 # SPDX-License-Identifier: Apache-2.0
 # Standard
 from contextlib import nullcontext
+from typing import List, Optional, Sequence
 import threading
 
 # Third Party
@@ -9,9 +10,14 @@ import torch
 # First Party
 from lmcache.logging import init_logger
 from lmcache.v1.memory_management import (
+    MemoryAllocatorInterface,
+    MemoryFormat,
+    MemoryObj,
+    MemoryObjMetadata,
     MixedMemoryAllocator,
     PagedTensorMemoryAllocator,
     TensorMemoryAllocator,
+    TensorMemoryObj,
     BufferAllocator,
     PinMemoryAllocator,
 )
@@ -29,6 +35,86 @@ def is_310p():
     return _IS_310P
 
 
+class NativeTensorMemoryAllocator(MemoryAllocatorInterface):
+    """
+    Allocates memory objects from a pinned buffer through the c_ops
+    HostAllocator: size classes, per-thread caches and lock-free free lists,
+    so it is thread safe without a host_mem_lock and alloc/free are O(1).
+    """
+
+    def __init__(self, tensor: torch.Tensor, chunk_sizes: Sequence[int] = ()):
+        """
+        :param torch.Tensor tensor: The (registered) buffer to allocate from.
+        :param Sequence[int] chunk_sizes: Byte sizes served without rounding,
+            typically the size of a full KV chunk.
+        """
+        self.buffer = tensor.view(torch.uint8).flatten()
+        self.allocator = lmc_ops.HostAllocator(self.buffer, list(chunk_sizes))
+
+    def _make_obj(self, raw_data, shape, dtype, fmt) -> TensorMemoryObj:
+        return TensorMemoryObj(
+            raw_data=raw_data,
+            metadata=MemoryObjMetadata(
+                shape=shape,
+                dtype=dtype,
+                address=raw_data.data_ptr() - self.buffer.data_ptr(),
+                phy_size=raw_data.numel(),
+                ref_count=1,
+                fmt=fmt,
+            ),
+            parent_allocator=self,
+        )
+
+    def allocate(
+        self,
+        shape,
+        dtype: Optional[torch.dtype],
+        fmt: MemoryFormat = MemoryFormat.KV_2LTD,
+        allocator_type: Optional[str] = None,
+    ) -> Optional[MemoryObj]:
+        shape = torch.Size(shape)
+        block = self.allocator.allocate(shape.numel() * dtype.itemsize)
+        if block is None:
+            return None
+        return self._make_obj(block, shape, dtype, fmt)
+
+    def batched_allocate(
+        self,
+        shape,
+        dtype: Optional[torch.dtype],
+        batch_size: int,
+        fmt: MemoryFormat = MemoryFormat.KV_2LTD,
+        allocator_type: Optional[str] = None,
+    ) -> Optional[List[MemoryObj]]:
+        shape = torch.Size(shape)
+        blocks = self.allocator.batched_allocate(
+            shape.numel() * dtype.itemsize, batch_size
+        )
+        if blocks is None:
+            return None
+        return [self._make_obj(block, shape, dtype, fmt) for block in blocks]
+
+    def free(self, memory_obj: MemoryObj, allocator_type: Optional[str] = None):
+        if not memory_obj.is_valid():
+            return
+        self.allocator.free(memory_obj.raw_data)
+        memory_obj.invalidate()
+
+    def batched_free(
+        self, memory_objs: List[MemoryObj], allocator_type: Optional[str] = None
+    ):
+        valid = [obj for obj in memory_objs if obj.is_valid()]
+        self.allocator.batched_free([obj.raw_data for obj in valid])
+        for obj in valid:
+            obj.invalidate()
+
+    def memcheck(self) -> bool:
+        return True
+
+    def close(self):
+        pass
+
+
 # NOTE (Gingfung): it is not really used in v1, mainly for testing.
 class AscendPinMemoryAllocator(PinMemoryAllocator):
     """Allocates memory in the pre-allocated pinned memory."""
@@ -69,17 +155,75 @@ class AscendPinMemoryAllocator(PinMemoryAllocator):
 
 
 class AscendMixedMemoryAllocator(MixedMemoryAllocator):
-    def __init__(self, size: int, use_paging: bool = False, **kwargs) -> None:
+    def __init__(
+        self,
+        size: int,
+        use_paging: bool = False,
+        populate_threads: Optional[int] = None,
+        numa_node: Optional[int] = None,
+        huge_page_size: int = 0,
+        strict_numa: bool = False,
+        native_allocator: bool = False,
+        chunk_sizes: Sequence[int] = (),
+        **kwargs,
+    ) -> None:
         """
         :param int size: The size of the pinned memory in bytes.
+        :param Optional[int] populate_threads: When set, the pinned memory is
+            mapped and registered natively and its pages are faulted in by
+            this many threads (0 for one per core), which brings up large
+            pools much faster than a pinned torch.empty.
+        :param Optional[int] numa_node: With populate_threads, the NUMA node
+            the pinned memory is placed on. Defaults to the node local to the
+            current device (lmc_ops.NUMA_NODE_LOCAL), -1 disables placement.
+        :param int huge_page_size: With populate_threads, back the pinned
+            memory with hugetlb pages of this size (2 MiB or 1 GiB). Falls
+            back on transparent huge pages when the hugetlb pool is too
+            small, the size actually used is in self.huge_page_size.
+        :param bool strict_numa: Bind the pinned memory to numa_node. By
+            default the node is only preferred, so a pool larger than the
+            free memory of the node spills to other nodes instead of getting
+            the worker OOM killed.
+        :param bool native_allocator: Serve the pinned memory with
+            NativeTensorMemoryAllocator instead of the Python
+            TensorMemoryAllocator and its lock. Ignored with use_paging.
+        :param Sequence[int] chunk_sizes: With native_allocator, byte sizes
+            served without rounding (full KV chunks).
         """
 
-        self.buffer = torch.empty(
-            size, dtype=torch.uint8, device="cpu", pin_memory=True
-        )
+        # Size of the hugetlb pages backing the buffer, 0 if none
+        self.huge_page_size = 0
 
-        if not is_310p():
-            lmc_ops.host_register(self.buffer)
+        if populate_threads is not None and not is_310p():
+            self.buffer = lmc_ops.alloc_pinned_memory(
+                size,
+                populate_threads,
+                numa_node=lmc_ops.NUMA_NODE_LOCAL if numa_node is None else numa_node,
+                huge_page_size=huge_page_size,
+                strict_numa=strict_numa,
+            )
+            self.huge_page_size = lmc_ops.get_host_huge_page_size(self.buffer)
+            if huge_page_size and self.huge_page_size != huge_page_size:
+                logger.warning(
+                    "Not enough %d bytes hugetlb pages reserved, "
+                    "pinned memory falls back on transparent huge pages",
+                    huge_page_size,
+                )
+            logger.info(
+                "Allocated %d bytes of pinned memory on NUMA node %d, %s",
+                size,
+                lmc_ops.get_host_numa_node(self.buffer),
+                f"{self.huge_page_size} bytes hugetlb pages"
+                if self.huge_page_size
+                else "transparent huge pages",
+            )
+        else:
+            self.buffer = torch.empty(
+                size, dtype=torch.uint8, device="cpu", pin_memory=True
+            )
+
+            if not is_310p():
+                lmc_ops.host_register(self.buffer)
 
         if use_paging:
             assert "shape" in kwargs, (
@@ -95,10 +239,16 @@ class AscendMixedMemoryAllocator(MixedMemoryAllocator):
                 dtype=kwargs["dtype"],
                 fmt=kwargs["fmt"],
             )
+        elif native_allocator:
+            self.pin_allocator = NativeTensorMemoryAllocator(self.buffer, chunk_sizes)
         else:
             self.pin_allocator = TensorMemoryAllocator(self.buffer)
 
-        self.host_mem_lock = threading.Lock() if not use_paging else nullcontext()
+        self.host_mem_lock = (
+            threading.Lock()
+            if not use_paging and not native_allocator
+            else nullcontext()
+        )
 
         self.buffer_allocator = BufferAllocator("cpu")
 
@@ -22,28 +22,123 @@ class VLLMBufferLayerwiseNPUConnector(VLLMBufferLayerwiseGPUConnector):
 
 class VLLMPagedMemNPUConnectorV2(VLLMPagedMemGPUConnectorV2):
     def _initialize_pointers(self, kv_caches: List[torch.Tensor]) -> torch.Tensor:
-        self.kv_cache_pointers.numpy()[:] = [t.data_ptr() for t in kv_caches]
         device = kv_caches[0].device
         assert device.type == "npu", "The device should be Ascend NPU."
-        idx = device.index
-        if idx not in self.kv_cache_pointers_on_gpu:
-            self.kv_cache_pointers_on_gpu[idx] = torch.empty(
-                self.num_layers, dtype=torch.int64, device=device
+        # Called before every transfer, the plan (pointer tables, geometry)
+        # is only rebuilt when vLLM hands over new caches. Every layer is in
+        # the key: re-registered caches may reuse some of the old addresses.
+        plan_key = tuple(t.data_ptr() for t in kv_caches)
+        if getattr(self, "_transfer_plan_key", None) != plan_key:
+            self.kv_cache_pointers.numpy()[:] = [t.data_ptr() for t in kv_caches]
+            if self.use_mla:
+                # kv_caches[0].shape: [num_pages, page_size, head_size]
+                # kv_caches[0].shape: [1, num_pages, page_size, head_size] (vllm-Ascend)
+                self.page_buffer_size = kv_caches[0].shape[-3] * kv_caches[0].shape[-2]
+                self.transfer_plan = lmc_ops.KVTransferPlan(
+                    [t.view(-1, t.shape[-2], t.shape[-1]) for t in kv_caches]
+                )
+            else:
+                # kv_caches[0].shape: [2, num_pages, page_size, num_heads, head_size]
+                assert kv_caches[0].dim() == 5
+                self.page_buffer_size = kv_caches[0].shape[1] * kv_caches[0].shape[2]
+                self.transfer_plan = lmc_ops.KVTransferPlan(
+                    [t[0] for t in kv_caches], [t[1] for t in kv_caches]
+                )
+            self.kv_cache_pointers_on_gpu[device.index] = self.transfer_plan.key_ptrs()
+            self._transfer_plan_key = plan_key
+
+        return self.kv_cache_pointers_on_gpu[device.index]
+
+    def to_gpu(self, memory_obj: MemoryObj, start: int, end: int, **kwargs):
+        """
+        VLLMPagedMemGPUConnectorV2.to_gpu through the transfer plan, which
+        launches without resolving pointers or querying the SoC again.
+        """
+        assert memory_obj.tensor is not None
+
+        self.initialize_kvcaches_ptr(**kwargs)
+        assert self.kvcaches is not None, (
+            "kvcaches should be provided in kwargs or initialized beforehand."
+        )
+
+        fmt = MemoryFormat.KV_MLA_FMT if self.use_mla else MemoryFormat.KV_2LTD
+        if memory_obj.metadata.fmt != fmt:
+            raise ValueError(
+                f"The memory object should be in {fmt} format in"
+                " order to be processed by VLLMPagedMemNPUConnectorV2"
             )
-        self.kv_cache_pointers_on_gpu[idx].copy_(self.kv_cache_pointers)
-        if self.use_mla:
-            # kv_caches[0].shape: [num_pages, page_size, head_size]
-            # kv_caches[0].shape: [1, num_pages, page_size, head_size] (vllm-Ascend)
-            self.page_buffer_size = kv_caches[0].shape[-3] * kv_caches[0].shape[-2]
-        else:
-            # kv_caches[0].shape: [2, num_pages, page_size, num_heads, head_size]
-            assert kv_caches[0].dim() == 5
-            self.page_buffer_size = kv_caches[0].shape[1] * kv_caches[0].shape[2]
 
-        return self.kv_cache_pointers_on_gpu[idx]
+        if "slot_mapping" not in kwargs:
+            raise ValueError("'slot_mapping' should be provided in kwargs.")
+
+        slot_mapping: torch.Tensor = kwargs["slot_mapping"]
+        self._initialize_pointers(self.kvcaches)
+        self.transfer_plan.multi_layer_transfer(
+            memory_obj.tensor, slot_mapping[start:end], False
+        )
+
+    def from_gpu(self, memory_obj: MemoryObj, start: int, end: int, **kwargs):
+        """
+        VLLMPagedMemGPUConnectorV2.from_gpu through the transfer plan.
+        """
+        assert memory_obj.tensor is not None
+
+        self.initialize_kvcaches_ptr(**kwargs)
+        assert self.kvcaches is not None, (
+            "kvcaches should be provided in kwargs or initialized beforehand."
+        )
+
+        if "slot_mapping" not in kwargs:
+            raise ValueError("'slot_mapping' should be provided in kwargs.")
+
+        slot_mapping: torch.Tensor = kwargs["slot_mapping"]
+        self._initialize_pointers(self.kvcaches)
+
+        gpu_buffer = getattr(self, "gpu_buffer", None)
+        with torch.cuda.stream(self.store_stream):
+            if gpu_buffer is None or end - start != gpu_buffer.shape[2]:
+                self.transfer_plan.multi_layer_transfer(
+                    memory_obj.tensor, slot_mapping[start:end], True
+                )
+            else:
+                # kvcaches -> gpu_buffer -> memobj
+                assert gpu_buffer.device == self.kvcaches[0].device
+                tmp_gpu_buffer = gpu_buffer[:, :, : end - start, :]
+                self.transfer_plan.multi_layer_transfer(
+                    tmp_gpu_buffer, slot_mapping[start:end], True
+                )
+                memory_obj.tensor.copy_(tmp_gpu_buffer, non_blocking=True)
+
+        if memory_obj.tensor.device.type == "cpu":
+            # The caller reads the memory object right away
+            self.store_stream.synchronize()
+
+        if self.use_mla:
+            memory_obj.metadata.fmt = MemoryFormat.KV_MLA_FMT
 
 
 class VLLMPagedMemLayerwiseNPUConnector(VLLMPagedMemLayerwiseGPUConnector):
+    def _get_transfer_plan(self) -> lmc_ops.KVTransferPlan:
+        """
+        Transfer plan of self.kvcaches: pointers, geometry and kernel
+        parameters are resolved once instead of on each of the num_layers x
+        chunks transfers of a request. Rebuilt when vLLM hands over new caches.
+        """
+        plan_key = tuple(kv.data_ptr() for kv in self.kvcaches)
+        if getattr(self, "_transfer_plan_key", None) != plan_key:
+            if getattr(self, "use_mla", False):
+                # One latent cache per layer, the LMCache buffers then are
+                # [num_tokens, 1, hidden]
+                self._transfer_plan = lmc_ops.KVTransferPlan(
+                    [t.view(-1, t.shape[-2], t.shape[-1]) for t in self.kvcaches]
+                )
+            else:
+                self._transfer_plan = lmc_ops.KVTransferPlan(
+                    [kv[0] for kv in self.kvcaches], [kv[1] for kv in self.kvcaches]
+                )
+            self._transfer_plan_key = plan_key
+        return self._transfer_plan
+
     def batched_to_gpu(self, starts: List[int], ends: List[int], **kwargs):
         """
         This function is a generator that moves the KV cache from the memory
@@ -79,15 +174,11 @@ class VLLMPagedMemLayerwiseNPUConnector(VLLMPagedMemLayerwiseGPUConnector):
         sync: bool = kwargs["sync"]
 
         self._lazy_initialize_buffer(self.kvcaches)
+        transfer_plan = self._get_transfer_plan()
 
-        slot_mapping_chunks = []
-        for start, end in zip(starts, ends, strict=False):
-            slot_mapping_chunks.append(slot_mapping[start:end])
-
-        # TODO(Jiayi): Optimize away this `cat`
-        slot_mapping_full = torch.cat(slot_mapping_chunks, dim=0)
-
-        num_tokens = len(slot_mapping_full)
+        # The segmented transfer reads each chunk's slots in place, no need
+        # to concatenate them
+        num_tokens = sum(end - start for start, end in zip(starts, ends, strict=False))
 
         if self.use_gpu:
             buffer_shape = self.get_shape(num_tokens)
@@ -100,6 +191,12 @@ class VLLMPagedMemLayerwiseNPUConnector(VLLMPagedMemLayerwiseGPUConnector):
             assert tmp_gpu_buffer_obj.tensor is not None
 
         offset = starts[0]
+        if self.use_gpu:
+            # Adjacent views of the staging buffer, moved in a single launch
+            staging_chunks = [
+                tmp_gpu_buffer_obj.tensor[start - offset : end - offset]
+                for start, end in zip(starts, ends, strict=False)
+            ]
         current_stream = torch.cuda.current_stream()
 
         for layer_id in range(self.num_layers):
@@ -111,33 +208,20 @@ class VLLMPagedMemLayerwiseNPUConnector(VLLMPagedMemLayerwiseGPUConnector):
 
             # memobj -> gpu_buffer -> kvcaches
             with torch.cuda.stream(self.load_stream):
-                for start, end, memory_obj in zip(
-                    starts, ends, memory_objs_layer, strict=False
-                ):
+                for memory_obj in memory_objs_layer:
                     assert memory_obj.metadata.fmt == MemoryFormat.KV_T2D
-                    if self.use_gpu:
-                        tmp_gpu_buffer_obj.tensor[start - offset : end - offset].copy_(
-                            memory_obj.tensor, non_blocking=True
-                        )
-                    else:
-                        lmc_ops.single_layer_kv_transfer(
-                            memory_obj.tensor,
-                            self.kvcaches[layer_id][0],
-                            self.kvcaches[layer_id][1],
-                            slot_mapping[start:end],
-                            False,
-                            True,
-                        )
-
                 if self.use_gpu:
-                    lmc_ops.single_layer_kv_transfer(
-                        tmp_gpu_buffer_obj.tensor,
-                        self.kvcaches[layer_id][0],
-                        self.kvcaches[layer_id][1],
-                        slot_mapping_full,
-                        False,
-                        True,
-                    )
+                    for staging_chunk, memory_obj in zip(
+                        staging_chunks, memory_objs_layer, strict=False
+                    ):
+                        staging_chunk.copy_(memory_obj.tensor, non_blocking=True)
+                    lmc_chunks = staging_chunks
+                else:
+                    lmc_chunks = [memory_obj.tensor for memory_obj in memory_objs_layer]
+
+                transfer_plan.single_layer_transfer_segmented(
+                    lmc_chunks, slot_mapping, starts, ends, layer_id, False, True
+                )
         yield
 
         # synchronize the last layer
@@ -196,14 +280,9 @@ class VLLMPagedMemLayerwiseNPUConnector(VLLMPagedMemLayerwiseGPUConnector):
         sync: bool = kwargs["sync"]
 
         self._lazy_initialize_buffer(self.kvcaches)
+        transfer_plan = self._get_transfer_plan()
 
-        slot_mapping_chunks = []
-        for start, end in zip(starts, ends, strict=False):
-            slot_mapping_chunks.append(slot_mapping[start:end])
-
-        slot_mapping_full = torch.cat(slot_mapping_chunks, dim=0)
-
-        num_tokens = len(slot_mapping_full)
+        num_tokens = sum(end - start for start, end in zip(starts, ends, strict=False))
 
         if self.use_gpu:
             buffer_shape = self.get_shape(num_tokens)
@@ -216,6 +295,12 @@ class VLLMPagedMemLayerwiseNPUConnector(VLLMPagedMemLayerwiseGPUConnector):
             assert tmp_gpu_buffer_obj.tensor is not None
 
         offset = starts[0]
+        if self.use_gpu:
+            # Adjacent views of the staging buffer, moved in a single launch
+            staging_chunks = [
+                tmp_gpu_buffer_obj.tensor[start - offset : end - offset]
+                for start, end in zip(starts, ends, strict=False)
+            ]
         current_stream = torch.cuda.current_stream()
 
         for layer_id in range(self.num_layers):
@@ -223,33 +308,21 @@ class VLLMPagedMemLayerwiseNPUConnector(VLLMPagedMemLayerwiseGPUConnector):
             # kvcaches -> gpu_buffer -> memobj
             with torch.cuda.stream(self.store_stream):
                 self.store_stream.wait_stream(current_stream)
-                if self.use_gpu:
-                    lmc_ops.single_layer_kv_transfer(
-                        tmp_gpu_buffer_obj.tensor,
-                        self.kvcaches[layer_id][0],
-                        self.kvcaches[layer_id][1],
-                        slot_mapping_full,
-                        True,
-                        True,
-                    )
-                for start, end, memory_obj in zip(
-                    starts, ends, memory_objs_layer, strict=False
-                ):
+                for memory_obj in memory_objs_layer:
                     assert memory_obj.tensor is not None
-                    if self.use_gpu:
-                        memory_obj.tensor.copy_(
-                            tmp_gpu_buffer_obj.tensor[start - offset : end - offset],
-                            non_blocking=True,
-                        )
-                    else:
-                        lmc_ops.single_layer_kv_transfer(
-                            memory_obj.tensor,
-                            self.kvcaches[layer_id][0],
-                            self.kvcaches[layer_id][1],
-                            slot_mapping[start:end],
-                            True,
-                            True,
-                        )
+                if self.use_gpu:
+                    lmc_chunks = staging_chunks
+                else:
+                    lmc_chunks = [memory_obj.tensor for memory_obj in memory_objs_layer]
+
+                transfer_plan.single_layer_transfer_segmented(
+                    lmc_chunks, slot_mapping, starts, ends, layer_id, True, True
+                )
+                if self.use_gpu:
+                    for staging_chunk, memory_obj in zip(
+                        staging_chunks, memory_objs_layer, strict=False
+                    ):
+                        memory_obj.tensor.copy_(staging_chunk, non_blocking=True)
 
             yield
             if sync:
@@ -0,0 +1,84 @@
+# SPDX-License-Identifier: Apache-2.0
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+
+def _reference(q, k, v, residual, old_k, topk):
+    # Selection of LMCBlender.process_qkv before the fused op
+    diff_k = torch.sum((k.to(torch.float32) - old_k.to(torch.float32)) ** 2, dim=[1])
+    indices = torch.sort(torch.topk(diff_k, k=topk).indices).values
+    return indices, q[indices], k[indices], v[indices], residual[indices]
+
+
+@pytest.mark.parametrize("dtype", [torch.float32, torch.bfloat16, torch.float16])
+@pytest.mark.parametrize("num_tokens,ratio", [(1000, 0.05), (37, 0.5), (300, 1.0)])
+def test_select_deviated_tokens(dtype, num_tokens, ratio):
+    num_heads, num_kv_heads, head_size = 8, 2, 128
+    q_size, kv_size = num_heads * head_size, num_kv_heads * head_size
+    # q, k and v are column slices of the fused qkv projection, as in vLLM
+    qkv = torch.randn(num_tokens, q_size + 2 * kv_size, dtype=dtype)
+    q, k, v = qkv.split([q_size, kv_size, kv_size], dim=-1)
+    residual = torch.randn(num_tokens, 512, dtype=dtype)
+    # Well separated deviations so that rounding does not reorder tokens
+    scale = torch.randperm(num_tokens).to(torch.float32) / num_tokens + 0.01
+    noise = torch.randn(num_tokens, kv_size).sign() * scale[:, None]
+    old_k = (k.float() + noise).to(dtype).view(num_tokens, num_kv_heads, head_size)
+    topk = int(num_tokens * ratio)
+
+    out = lmc_ops.select_deviated_tokens(q, k, v, residual, old_k, topk)
+    expected = _reference(q, k, v, residual, old_k.view(num_tokens, -1), topk)
+    assert len(out) == 5
+    for got, want in zip(out, expected, strict=True):
+        assert got.dtype == want.dtype
+        assert torch.equal(got, want)
+    assert out[1].is_contiguous()
+
+
+def test_select_deviated_tokens_edge_cases():
+    k = torch.randn(10, 16)
+    old_k = k.clone()
+    old_k[3] += 1
+    old_k[7] += 2
+    out = lmc_ops.select_deviated_tokens(k, k, k, k, old_k, 2)
+    assert out[0].tolist() == [3, 7]
+    # Ties go to the earlier tokens
+    out = lmc_ops.select_deviated_tokens(k, k, k, k, k.clone(), 3)
+    assert out[0].tolist() == [0, 1, 2]
+    out = lmc_ops.select_deviated_tokens(k, k, k, k, old_k, 0)
+    assert out[0].numel() == 0 and out[1].shape == (0, 16)
+    with pytest.raises(RuntimeError, match="shape of k"):
+        lmc_ops.select_deviated_tokens(k, k, k, k, old_k[:5], 2)
+
+
+def test_select_deviated_tokens_nan():
+    k = torch.randn(10, 16)
+    # inf - inf is NaN too
+    k[8, 0] = float("inf")
+    old_k = k.clone()
+    old_k[2] += 1
+    old_k[5] += 2
+    old_k[4, 3] = float("nan")
+    out = lmc_ops.select_deviated_tokens(k, k, k, k, old_k, 3)
+    # NaN deviations rank below every finite one, the earlier token first
+    assert out[0].tolist() == [0, 2, 5]
+    out = lmc_ops.select_deviated_tokens(k, k, k, k, old_k, 10)
+    assert out[0].tolist() == list(range(10))
+
+
+def test_select_deviated_tokens_strided_rows():
+    num_tokens, heads, head_size = 64, 4, 32
+    k = torch.randn(num_tokens, heads * head_size)
+    old_k = k + torch.randn_like(k) * torch.rand(num_tokens, 1)
+    # [T, H, D] views whose trailing dims are not dense, not viewable as rows
+    q = torch.randn(num_tokens, head_size, heads).transpose(1, 2)
+    residual = torch.randn(num_tokens, 16, heads).transpose(1, 2)
+    v = torch.randn(heads * head_size, num_tokens).t()
+
+    out = lmc_ops.select_deviated_tokens(q, k, v, residual, old_k, 10)
+    expected = _reference(q, k, v, residual, old_k, 10)
+    for got, want in zip(out, expected, strict=True):
+        assert torch.equal(got, want)
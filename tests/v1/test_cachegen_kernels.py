@@ -0,0 +1,103 @@
+# SPDX-License-Identifier: Apache-2.0
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+
+def _generate_symbols(nlayers, ntokens, nchannels, max_bins):
+    # KV quantisation output is centred around max_bins // 2
+    centre = max_bins // 2
+    sym = torch.randn(nlayers, ntokens, nchannels) * (max_bins / 8) + centre
+    return sym.round().clamp_(0, max_bins - 1).to(torch.int8)
+
+
+def _reference_cdf(sym, max_bins):
+    nlayers, ntokens, nchannels = sym.shape
+    counts = torch.nn.functional.one_hot(sym.long(), max_bins).sum(dim=1)
+    cdf = torch.zeros(nlayers, nchannels, max_bins + 1, dtype=torch.float32)
+    cdf[..., 1:] = torch.cumsum(counts, dim=-1).to(torch.float32) / ntokens
+    cdf = (cdf * (2**16 - max_bins)).round().to(torch.int32)
+    cdf += torch.arange(max_bins + 1, dtype=torch.int32)
+    return cdf.to(torch.int16)
+
+
+def _collect_bytes(output_buffer, output_lengths):
+    streams = output_buffer.flatten(0, 1)
+    lengths = output_lengths.flatten().tolist()
+    return torch.cat([streams[i, :n] for i, n in enumerate(lengths)])
+
+
+@pytest.mark.parametrize("max_bins", [16, 32])
+def test_calculate_cdf(max_bins):
+    sym = _generate_symbols(4, 256, 1024, max_bins)
+    cdf = lmc_ops.calculate_cdf(sym, max_bins)
+
+    assert cdf.shape == (4, 1024, max_bins + 1)
+    assert cdf.dtype == torch.int16
+    assert (cdf == _reference_cdf(sym, max_bins)).all()
+    # uint16 view must be strictly increasing over the symbol range
+    cdf_u = cdf[..., :-1].to(torch.int32) & 0xFFFF
+    assert (cdf_u[..., 1:] > cdf_u[..., :-1]).all()
+
+
+@pytest.mark.parametrize("ntokens", [1, 256, 1000])
+@pytest.mark.parametrize("max_bins", [16, 32])
+def test_encode_decode_roundtrip(ntokens, max_bins):
+    nlayers, nchannels = 8, 1024
+    sym = _generate_symbols(nlayers, ntokens, nchannels, max_bins).pin_memory()
+    cdf = lmc_ops.calculate_cdf(sym, max_bins)
+
+    output_buffer = torch.zeros(
+        (nlayers, nchannels, ntokens + 8), dtype=torch.uint8
+    ).pin_memory()
+    output_lengths = torch.zeros((nlayers, nchannels), dtype=torch.int32)
+    lmc_ops.encode_fast_new(cdf, sym, output_buffer, output_lengths)
+
+    assert (output_lengths > 0).all()
+    bytestreams = _collect_bytes(output_buffer, output_lengths)
+    assert bytestreams.numel() < sym.numel() or ntokens == 1
+
+    output = torch.zeros_like(sym)
+    lmc_ops.decode_fast_new(cdf, bytestreams, output_lengths, output)
+    assert (output == sym).all()
+
+
+@pytest.mark.parametrize("threads", [1, 4])
+def test_decode_prefsum_uneven_streams(threads):
+    nlayers, ntokens, nchannels, max_bins = 4, 512, 256, 32
+    sym = _generate_symbols(nlayers, ntokens, nchannels, max_bins)
+    # Make the first layer nearly constant so its streams are far shorter
+    sym[0] = max_bins // 2
+    cdf = lmc_ops.calculate_cdf(sym, max_bins)
+
+    output_buffer = torch.zeros(
+        (nlayers, nchannels, ntokens + 8), dtype=torch.uint8
+    ).pin_memory()
+    output_lengths = torch.zeros((nlayers, nchannels), dtype=torch.int32)
+    lmc_ops.encode_fast_new(cdf, sym, output_buffer, output_lengths)
+    bytestreams = _collect_bytes(output_buffer, output_lengths)
+    assert output_lengths[0].max() < output_lengths[1:].min()
+
+    lengths_prefsum = (
+        output_lengths.flatten().cumsum(0).reshape(output_lengths.shape).to(torch.int32)
+    )
+    prev_threads = torch.get_num_threads()
+    torch.set_num_threads(threads)
+    try:
+        output = torch.zeros_like(sym)
+        lmc_ops.decode_fast_prefsum(cdf, bytestreams, lengths_prefsum, output)
+    finally:
+        torch.set_num_threads(prev_threads)
+    assert (output == sym).all()
+
+
+def test_encode_buffer_overflow():
+    sym = _generate_symbols(1, 1024, 16, 32)
+    cdf = lmc_ops.calculate_cdf(sym, 32)
+    output_buffer = torch.zeros((1, 16, 4), dtype=torch.uint8)
+    output_lengths = torch.zeros((1, 16), dtype=torch.int32)
+    with pytest.raises(RuntimeError):
+        lmc_ops.encode_fast_new(cdf, sym, output_buffer, output_lengths)
@@ -0,0 +1,70 @@
+# SPDX-License-Identifier: Apache-2.0
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+
+def test_chunk_hashes_reference_values():
+    # Keys must not change across hosts or releases, or stored chunks are lost
+    hashes = lmc_ops.chunk_hashes(torch.arange(10), 4)
+    assert hashes.dtype == torch.int64
+    assert hashes.tolist() == [
+        4703284857649916207,
+        8875208624781599483,
+        168617638956970847,
+    ]
+
+
+@pytest.mark.parametrize("chunk_size", [1, 16, 256])
+def test_chunk_hashes_prefix_chain(chunk_size):
+    tokens = torch.randint(0, 150000, [5000], dtype=torch.int64)
+    hashes = lmc_ops.chunk_hashes(tokens, chunk_size)
+    num_full = tokens.numel() // chunk_size
+    num_chunks = (tokens.numel() + chunk_size - 1) // chunk_size
+    assert hashes.numel() == num_chunks
+    assert hashes.unique().numel() == num_chunks
+
+    # Same keys for int32 tokens, for a prefix, and for a continued chain
+    assert torch.equal(lmc_ops.chunk_hashes(tokens.int(), chunk_size), hashes)
+    assert torch.equal(
+        lmc_ops.chunk_hashes(tokens, chunk_size, include_partial=False),
+        hashes[:num_full],
+    )
+    split = num_full // 2 * chunk_size
+    head = lmc_ops.chunk_hashes(tokens[:split], chunk_size)
+    tail = lmc_ops.chunk_hashes(
+        tokens[split:], chunk_size, prefix_hash=int(head[-1]) if split else 0
+    )
+    assert torch.equal(torch.cat([head, tail]), hashes)
+    # Non-contiguous input
+    assert torch.equal(
+        lmc_ops.chunk_hashes(torch.stack([tokens, tokens], 1)[:, 0], chunk_size),
+        hashes,
+    )
+
+    # A changed token changes the key of its chunk and of every later one
+    changed = tokens.clone()
+    position = tokens.numel() // 2
+    changed[position] += 1
+    changed_hashes = lmc_ops.chunk_hashes(changed, chunk_size)
+    first = position // chunk_size
+    assert torch.equal(changed_hashes[:first], hashes[:first])
+    assert (changed_hashes[first:] != hashes[first:]).all()
+
+
+def test_chunk_hashes_edge_cases():
+    empty = lmc_ops.chunk_hashes(torch.empty(0, dtype=torch.int64), 256)
+    assert empty.numel() == 0
+    short = torch.arange(100)
+    assert lmc_ops.chunk_hashes(short, 256, include_partial=False).numel() == 0
+    assert lmc_ops.chunk_hashes(short, 256).numel() == 1
+    assert not torch.equal(
+        lmc_ops.chunk_hashes(short, 256), lmc_ops.chunk_hashes(short, 256, 1)
+    )
+    with pytest.raises(RuntimeError, match="int32 or int64"):
+        lmc_ops.chunk_hashes(short.float(), 256)
+    with pytest.raises(RuntimeError, match="chunk_size"):
+        lmc_ops.chunk_hashes(short, 0)
@@ -0,0 +1,148 @@
+# SPDX-License-Identifier: Apache-2.0
+# Standard
+import os
+
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+PAGE = 4096
+
+
+def _chunk(nbytes, seed):
+    generator = torch.Generator().manual_seed(seed)
+    return torch.randint(0, 256, [nbytes], dtype=torch.uint8, generator=generator)
+
+
+def test_chunk_store_put_get(tmp_path):
+    path = str(tmp_path / "store.bin")
+    store = lmc_ops.ChunkStore(path, 5000, 8)
+    assert store.slot_size() == 2 * PAGE
+    assert store.num_slots() == 8
+    assert store.data().numel() == 8 * 2 * PAGE
+
+    chunks = {
+        key: _chunk(1000 + 100 * i, i) for i, key in enumerate([3, -7, 2**40])
+    }
+    for key, chunk in chunks.items():
+        assert store.put(key, chunk)
+    # Any dtype goes in, bytes come out
+    floats = torch.randn(64, 16, dtype=torch.bfloat16)
+    assert store.put(11, floats)
+
+    assert store.num_chunks() == 4
+    assert sorted(store.keys()) == sorted([*chunks, 11])
+    for key, chunk in chunks.items():
+        assert store.contains(key)
+        assert torch.equal(store.get(key), chunk)
+    assert torch.equal(store.get(11).view(torch.bfloat16).view(64, 16), floats)
+    assert store.get(12) is None
+    assert not store.contains(12)
+
+    with pytest.raises(RuntimeError, match="does not fit"):
+        store.put(12, _chunk(2 * PAGE + 1, 0))
+    store.close()
+    with pytest.raises(RuntimeError, match="closed"):
+        store.get(3)
+
+
+def test_chunk_store_overwrite_remove_full(tmp_path):
+    store = lmc_ops.ChunkStore(str(tmp_path / "store.bin"), PAGE, 4)
+    for key in range(4):
+        assert store.put(key, _chunk(100, key))
+    # Every slot is taken: new keys and overwrites are refused
+    assert not store.put(4, _chunk(100, 4))
+    assert not store.put(0, _chunk(50, 5))
+    assert torch.equal(store.get(0), _chunk(100, 0))
+
+    assert store.remove(1)
+    assert not store.remove(1)
+    assert store.get(1) is None
+    assert store.put(0, _chunk(50, 5))
+    assert torch.equal(store.get(0), _chunk(50, 5))
+    assert store.num_chunks() == 3
+
+    # Churn leaves tombstones in the index, lookups stay correct
+    for key in range(100, 1100):
+        assert store.put(key, _chunk(8, key))
+        assert store.remove(key)
+    assert sorted(store.keys()) == [0, 2, 3]
+
+
+def test_chunk_store_reopen(tmp_path):
+    path = str(tmp_path / "store.bin")
+    chunks = {key: _chunk(3000 + key, key) for key in range(6)}
+    store = lmc_ops.ChunkStore(path, PAGE, 16)
+    for key, chunk in chunks.items():
+        store.put(key, chunk)
+    store.remove(5)
+    store.flush()
+    store.close()
+    # Sparse file: untouched slots use no disk space
+    assert os.stat(path).st_blocks * 512 < os.path.getsize(path)
+
+    with pytest.raises(RuntimeError, match="slot_size does not match"):
+        lmc_ops.ChunkStore(path, 2 * PAGE, 0)
+    store = lmc_ops.ChunkStore(path)
+    assert store.num_slots() == 16
+    assert sorted(store.keys()) == list(range(5))
+    for key in range(5):
+        assert torch.equal(store.get(key), chunks[key])
+    # New writes do not clobber recovered chunks
+    for key in range(10, 20):
+        assert store.put(key, _chunk(10, key))
+    assert not store.put(20, _chunk(10, 20))
+    for key in range(5):
+        assert torch.equal(store.get(key), chunks[key])
+
+
+def test_chunk_store_detects_corruption(tmp_path):
+    path = str(tmp_path / "store.bin")
+    store = lmc_ops.ChunkStore(path, PAGE, 4)
+    store.put(1, _chunk(500, 1))
+    store.put(2, _chunk(500, 2))
+    # Views write through to the file
+    store.get(2)[17] ^= 0xFF
+    store.close()
+
+    store = lmc_ops.ChunkStore(path)
+    assert torch.equal(store.get(1), _chunk(500, 1))
+    assert store.get(2) is None
+    assert not store.contains(2)
+    assert store.num_chunks() == 1
+
+
+def test_chunk_store_rejects_other_files(tmp_path):
+    path = tmp_path / "other.bin"
+    path.write_bytes(b"not a chunk store")
+    with pytest.raises(RuntimeError, match="not a chunk store"):
+        lmc_ops.ChunkStore(str(path))
+    with pytest.raises(RuntimeError, match="slot_size"):
+        lmc_ops.ChunkStore(str(tmp_path / "new.bin"))
+
+
+def test_chunk_store_rejects_bad_layout(tmp_path):
+    path = tmp_path / "store.bin"
+    lmc_ops.ChunkStore(str(path), PAGE, 4).close()
+    original = path.read_bytes()
+
+    def corrupt(offset, value):
+        path.write_bytes(
+            original[:offset] + value.to_bytes(8, "little") + original[offset + 8 :]
+        )
+
+    # Header.indexCapacity, not a power of two
+    corrupt(32, 12)
+    with pytest.raises(RuntimeError, match="corrupted chunk store header"):
+        lmc_ops.ChunkStore(str(path))
+    # Header.fileSize, past the end of the file
+    corrupt(64, len(original) + PAGE)
+    with pytest.raises(RuntimeError, match="truncated"):
+        lmc_ops.ChunkStore(str(path))
+    # Header.dataOffset, overlapping the index
+    corrupt(56, PAGE)
+    with pytest.raises(RuntimeError, match="corrupted chunk store header"):
+        lmc_ops.ChunkStore(str(path))
@@ -0,0 +1,102 @@
+# SPDX-License-Identifier: Apache-2.0
+# Standard
+import errno
+import os
+
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+ALIGNMENT = 4096
+
+
+def _aligned_buffer(nbytes):
+    """uint8 cpu tensor whose address is a multiple of ALIGNMENT"""
+    raw = torch.empty(nbytes + ALIGNMENT, dtype=torch.uint8)
+    offset = -raw.data_ptr() % ALIGNMENT
+    return raw[offset : offset + nbytes]
+
+
+def _open_engine(path, buffers, queue_depth, direct, size=0):
+    try:
+        return lmc_ops.DiskEngine(path, buffers, queue_depth, direct, size)
+    except RuntimeError as e:
+        if "io_uring" in str(e):
+            pytest.skip(f"io_uring unavailable: {e}")
+        raise
+
+
+@pytest.mark.parametrize("direct", [True, False])
+@pytest.mark.parametrize("registered", [True, False])
+def test_disk_engine_round_trip(tmp_path, direct, registered):
+    chunk_size = 64 * 1024
+    num_chunks = 20
+    pool = _aligned_buffer(chunk_size * num_chunks)
+    pool.copy_(torch.randint(0, 256, [pool.numel()], dtype=torch.uint8))
+    path = str(tmp_path / "chunks.bin")
+    engine = _open_engine(
+        path, [pool] if registered else [], 4, direct, chunk_size * num_chunks
+    )
+    assert engine.queue_depth() <= 4
+    assert engine.alignment() == (ALIGNMENT if engine.direct() else 1)
+    assert os.path.getsize(path) == chunk_size * num_chunks
+
+    # More requests than the queue depth: the rest waits in the backlog
+    ids = [
+        engine.submit_write(pool[offset : offset + chunk_size], offset)
+        for offset in range(0, chunk_size * num_chunks, chunk_size)
+    ]
+    assert engine.inflight() == num_chunks
+    completions = []
+    while engine.inflight() > 0:
+        completions.extend(engine.poll(1))
+    assert sorted(completions) == [(i, chunk_size) for i in ids]
+
+    # Reads in reverse order into an unregistered buffer
+    restored = _aligned_buffer(chunk_size * num_chunks)
+    for i in reversed(range(num_chunks)):
+        offset = i * chunk_size
+        engine.submit_read(restored[offset : offset + chunk_size], offset)
+    completions = engine.poll(num_chunks)
+    assert len(completions) == num_chunks
+    assert all(result == chunk_size for _, result in completions)
+    assert (restored == pool).all()
+    assert engine.poll() == []
+    engine.close()
+
+
+def test_disk_engine_errors(tmp_path):
+    engine = _open_engine(str(tmp_path / "chunks.bin"), [], 2, True)
+    buffer = _aligned_buffer(2 * ALIGNMENT)
+    if engine.direct():
+        with pytest.raises(RuntimeError, match="aligned"):
+            engine.submit_write(buffer[1 : ALIGNMENT + 1], 0)
+        with pytest.raises(RuntimeError, match="aligned"):
+            engine.submit_write(buffer[:ALIGNMENT], 100)
+    with pytest.raises(RuntimeError, match="contiguous"):
+        engine.submit_write(buffer.view(2, -1)[:, :16], 0)
+
+    # Reading past the end of the file is an error rather than a short read
+    request = engine.submit_read(buffer[:ALIGNMENT], 0)
+    assert engine.poll(1) == [(request, -errno.ENODATA)]
+    # Also when the first part is read: the remainder is resubmitted
+    request = engine.submit_write(buffer[:ALIGNMENT], 0)
+    assert engine.poll(1) == [(request, ALIGNMENT)]
+    request = engine.submit_read(buffer, 0)
+    assert engine.poll(1) == [(request, -errno.ENODATA)]
+    engine.close()
+    with pytest.raises(RuntimeError, match="closed"):
+        engine.submit_read(buffer[:ALIGNMENT], 0)
+
+
+def test_disk_engine_bad_buffers_open_nothing(tmp_path):
+    path = tmp_path / "chunks.bin"
+    strided = _aligned_buffer(2 * ALIGNMENT).view(2, -1)[:, :16]
+    num_fds = len(os.listdir("/proc/self/fd"))
+    with pytest.raises(RuntimeError, match="contiguous"):
+        lmc_ops.DiskEngine(str(path), [strided], 2, True, 0)
+    assert not path.exists()
+    assert len(os.listdir("/proc/self/fd")) == num_fds
@@ -0,0 +1,190 @@
+# SPDX-License-Identifier: Apache-2.0
+# Standard
+import threading
+
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+
+def _keys(values):
+    return torch.tensor(values, dtype=torch.int64)
+
+
+def test_eviction_engine_insert_and_evict():
+    engine = lmc_ops.EvictionEngine(1000, 0.1)
+    for key in range(10):
+        assert engine.insert(key, 100, key * 10) == []
+    assert engine.size() == 10
+    assert engine.used_bytes() == 1000
+
+    # Nothing was hit: the oldest chunk goes first
+    assert engine.insert(10, 100, 100) == [(0, 0)]
+    assert not engine.contains(0)
+    assert engine.evict(250) == [(1, 10), (2, 20), (3, 30)]
+    assert engine.used_bytes() == 700
+
+    assert engine.remove(5) == 50
+    assert engine.remove(5) is None
+    stats = engine.stats()
+    assert stats["insertions"] == 11
+    assert stats["evictions"] == 4
+    assert stats["used_bytes"] == 600
+    assert stats["capacity"] == 1000
+
+    engine.clear()
+    assert engine.size() == 0
+    assert engine.used_bytes() == 0
+
+
+def test_eviction_engine_scan_resistance():
+    # 50 hot prefix chunks fill half of the pool, then a scan of one-shot
+    # chunks ten times the pool size goes through
+    engine = lmc_ops.EvictionEngine(100 * 100, 0.1)
+    hot = list(range(50))
+    for key in hot:
+        engine.insert(key, 100)
+    for key in range(1000, 11000):
+        engine.insert(key, 100)
+        engine.touch_prefix(_keys(hot[key % 50 :][:4]))
+
+    assert all(engine.contains(key) for key in hot)
+    stats = engine.stats()
+    assert stats["promotions"] == 50
+    assert stats["misses"] == 0
+
+
+def test_eviction_engine_ghost_readmission():
+    engine = lmc_ops.EvictionEngine(1000, 0.2)
+    for key in range(10):
+        engine.insert(key, 100)
+    engine.insert(10, 100)
+    assert not engine.contains(0)
+    assert engine.stats()["ghost_chunks"] == 1
+
+    # Evicted from the small FIFO and inserted again: it goes to main
+    engine.insert(0, 100)
+    stats = engine.stats()
+    assert stats["ghost_hits"] == 1
+    assert stats["main_chunks"] == 1
+
+
+def test_eviction_engine_pins():
+    engine = lmc_ops.EvictionEngine(1000, 0.1)
+    for key in range(10):
+        engine.insert(key, 100)
+    assert engine.pin(0)
+    assert engine.pin(0)
+    assert engine.unpin(0)
+    assert not engine.pin(42)
+
+    for key in range(10, 100):
+        engine.insert(key, 100)
+    assert engine.contains(0)
+
+    assert engine.unpin(0)
+    with pytest.raises(RuntimeError, match="not pinned"):
+        engine.unpin(0)
+
+    # Pinned chunks leaving the small FIFO are parked, not promoted
+    assert engine.stats()["promotions"] == 0
+
+    # Everything pinned: the pool goes over its capacity instead of evicting
+    for key in range(100):
+        engine.pin(key)
+    assert engine.insert(100, 100) == []
+    engine.pin(100)
+    assert engine.evict(500) == []
+    assert engine.used_bytes() == 1100
+    stats = engine.stats()
+    assert stats["pinned_chunks"] == 11
+    assert stats["small_chunks"] + stats["main_chunks"] == 0
+
+
+def test_eviction_engine_unpinned_chunks_return():
+    engine = lmc_ops.EvictionEngine(1000, 0.5)
+    for key in range(10):
+        engine.insert(key, 100, key)
+    engine.pin(0)
+    # The pinned tail of the small FIFO is skipped, not promoted
+    assert engine.insert(10, 100, 10) == [(1, 1)]
+    stats = engine.stats()
+    assert stats["promotions"] == 0
+    assert stats["pinned_chunks"] == 1
+    assert stats["small_chunks"] == 9
+
+    # Once unpinned it goes back to the small FIFO, still without a hit
+    engine.unpin(0)
+    victims = engine.evict(1000)
+    assert (0, 0) in victims and len(victims) == 10
+    stats = engine.stats()
+    assert stats["promotions"] == 0
+    assert stats["pinned_chunks"] == 0
+    assert engine.size() == 0
+
+
+def test_eviction_engine_remove_keeps_pinned_chunks():
+    engine = lmc_ops.EvictionEngine(1000, 0.5)
+    for key in range(10):
+        engine.insert(key, 100, key)
+    engine.pin(0)
+    engine.pin(5)
+    # 0 is parked by the next eviction, 5 is still queued
+    assert engine.insert(10, 100, 10) == [(1, 1)]
+    for key in (0, 5):
+        assert engine.remove(key) is None
+        assert engine.contains(key)
+    assert engine.used_bytes() == 1000
+
+    engine.unpin(0)
+    engine.unpin(5)
+    assert engine.remove(0) == 0
+    assert engine.remove(5) == 5
+    assert engine.used_bytes() == 800
+    assert engine.stats()["pinned_chunks"] == 0
+
+
+def test_eviction_engine_touch_prefix():
+    engine = lmc_ops.EvictionEngine(1000)
+    engine.insert(1, 10)
+    engine.insert(2, 10)
+    assert engine.touch_prefix(_keys([1, 2, 3, 1])) == 2
+    assert engine.touch(2)
+    assert not engine.touch(3)
+    stats = engine.stats()
+    assert stats["hits"] == 3
+    assert stats["misses"] == 2
+
+    engine.reset_stats()
+    assert engine.stats()["hits"] == 0
+    with pytest.raises(RuntimeError, match="int64"):
+        engine.touch_prefix(torch.tensor([1, 2], dtype=torch.int32))
+
+
+def test_eviction_engine_concurrent_touch():
+    engine = lmc_ops.EvictionEngine(1 << 20, 0.1)
+    stop = threading.Event()
+
+    def reader(seed):
+        keys = _keys([(seed + i) % 5000 for i in range(16)])
+        while not stop.is_set():
+            engine.touch_prefix(keys)
+            if engine.pin(seed):
+                engine.unpin(seed)
+
+    readers = [threading.Thread(target=reader, args=(seed,)) for seed in range(4)]
+    for thread in readers:
+        thread.start()
+    for key in range(20000):
+        engine.insert(key % 7000, 200, key)
+    stop.set()
+    for thread in readers:
+        thread.join()
+
+    assert engine.used_bytes() <= engine.capacity()
+    stats = engine.stats()
+    chunks = stats["small_chunks"] + stats["main_chunks"] + stats["pinned_chunks"]
+    assert chunks == engine.size()
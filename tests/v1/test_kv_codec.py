@@ -0,0 +1,93 @@
+# SPDX-License-Identifier: Apache-2.0
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+CODECS = ["none", "lz4", "zstd"]
+
+
+def _compress(src, codec, block_bytes=64 * 1024, level=1):
+    max_bytes = lmc_ops.lossless_max_compressed_size(src.nbytes, block_bytes)
+    dst = torch.empty(max_bytes, dtype=torch.uint8)
+    size = lmc_ops.lossless_compress(src, dst, codec, level, block_bytes)
+    assert 0 < size <= max_bytes
+    return dst[:size]
+
+
+def _skip_unavailable(codec):
+    if codec not in lmc_ops.lossless_codecs():
+        pytest.skip(f"lib{codec} is not installed")
+
+
+@pytest.mark.parametrize("codec", CODECS)
+@pytest.mark.parametrize("dtype", [torch.bfloat16, torch.float16, torch.float32])
+@pytest.mark.parametrize("num_tokens", [1, 37, 256])
+def test_lossless_round_trip(codec, dtype, num_tokens):
+    _skip_unavailable(codec)
+    # [2, num_layers, num_tokens, hidden] chunk, last block partial
+    chunk = (torch.randn([2, 4, num_tokens, 136]) * 0.05).to(dtype)
+    frame = _compress(chunk, codec, block_bytes=6000)
+    assert lmc_ops.lossless_decompressed_size(frame) == chunk.nbytes
+
+    out = torch.empty_like(chunk)
+    lmc_ops.lossless_decompress(frame, out)
+    assert torch.equal(out.view(torch.uint8), chunk.view(torch.uint8))
+
+
+@pytest.mark.parametrize("codec", ["lz4", "zstd"])
+def test_lossless_byte_planes_compress(codec):
+    _skip_unavailable(codec)
+    chunk = (torch.randn([2, 8, 256, 128]) * 0.05).to(torch.bfloat16)
+    shuffled = _compress(chunk, codec)
+    unshuffled = _compress(chunk.view(torch.uint8), codec)
+    assert shuffled.numel() < unshuffled.numel() <= chunk.nbytes + 1024
+
+    # Incompressible blocks are stored as is
+    noise = torch.randint(0, 256, [1 << 20], dtype=torch.uint8)
+    stored = _compress(noise, codec)
+    assert stored.numel() == lmc_ops.lossless_max_compressed_size(noise.nbytes, 65536)
+    out = torch.empty_like(noise)
+    lmc_ops.lossless_decompress(stored, out)
+    assert torch.equal(out, noise)
+
+
+@pytest.mark.parametrize("codec", ["lz4", "zstd"])
+def test_lossless_higher_level_compresses_more(codec):
+    _skip_unavailable(codec)
+    chunk = (torch.randn([2, 8, 256, 128]) * 0.05).to(torch.bfloat16)
+    sizes = [_compress(chunk, codec, level=level).numel() for level in (-20, 1, 3)]
+    assert sizes[0] > sizes[1] >= sizes[2]
+
+
+def test_lossless_pinned_source():
+    chunk = torch.randn([2, 4, 64, 128]).to(torch.float16)
+    frame = _compress(chunk.pin_memory(), "none")
+    out = torch.empty_like(chunk)
+    lmc_ops.lossless_decompress(frame, out)
+    assert torch.equal(out, chunk)
+
+
+def test_lossless_errors():
+    chunk = torch.randn([1000]).to(torch.float16)
+    dst = torch.empty(lmc_ops.lossless_max_compressed_size(2000), dtype=torch.uint8)
+    with pytest.raises(RuntimeError, match="Unknown codec"):
+        lmc_ops.lossless_compress(chunk, dst, "lz5")
+    with pytest.raises(RuntimeError, match="multiple of the element size"):
+        lmc_ops.lossless_compress(chunk, dst, "none", 1, 4095)
+    with pytest.raises(RuntimeError, match="lossless_max_compressed_size"):
+        lmc_ops.lossless_compress(chunk, dst[:100], "none")
+
+    frame = _compress(chunk, "none")
+    with pytest.raises(RuntimeError, match="element size"):
+        lmc_ops.lossless_decompress(frame, torch.empty(2000, dtype=torch.uint8))
+    with pytest.raises(RuntimeError, match="too short"):
+        lmc_ops.lossless_decompress(frame[:-1], torch.empty_like(chunk))
+    with pytest.raises(RuntimeError, match="overlaps"):
+        lmc_ops.lossless_decompress(frame, frame[: chunk.nbytes].view(torch.float16))
+    corrupted = frame.clone()
+    corrupted[0] ^= 1
+    with pytest.raises(RuntimeError, match="lossless KV frame"):
+        lmc_ops.lossless_decompress(corrupted, torch.empty_like(chunk))
@@ -0,0 +1,69 @@
+# SPDX-License-Identifier: Apache-2.0
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+
+def _token_major(layer_major):
+    return layer_major.permute(1, 2, 0, 3).contiguous()
+
+
+@pytest.mark.parametrize("dtype", [torch.bfloat16, torch.float32, torch.uint8])
+@pytest.mark.parametrize("kvs", [1, 2])
+@pytest.mark.parametrize("num_layers,num_tokens", [(1, 1), (3, 37), (32, 256)])
+def test_convert_kv_layout(dtype, kvs, num_layers, num_tokens):
+    hidden = 96
+    layer_major = torch.randint(0, 100, [kvs, num_layers, num_tokens, hidden]).to(
+        dtype
+    )
+    expected = _token_major(layer_major)
+
+    token_major = torch.empty_like(expected)
+    lmc_ops.convert_kv_layout(layer_major, token_major, True)
+    assert torch.equal(token_major, expected)
+
+    back = torch.empty_like(layer_major)
+    lmc_ops.convert_kv_layout(token_major, back, False)
+    assert torch.equal(back, layer_major)
+
+
+@pytest.mark.parametrize("kvs", [1, 2])
+@pytest.mark.parametrize("num_layers,num_tokens", [(1, 1), (2, 3), (32, 255)])
+def test_convert_kv_layout_in_place(kvs, num_layers, num_tokens):
+    hidden = 64
+    layer_major = torch.randn([kvs, num_layers, num_tokens, hidden])
+    expected = _token_major(layer_major)
+
+    chunk = layer_major.clone()
+    token_major = chunk.view(num_layers, num_tokens, kvs, hidden)
+    lmc_ops.convert_kv_layout(chunk, token_major, True)
+    assert torch.equal(token_major, expected)
+
+    lmc_ops.convert_kv_layout(token_major, chunk, False)
+    assert torch.equal(chunk, layer_major)
+
+
+def test_convert_kv_layout_strided():
+    # Slices of larger buffers, e.g. one chunk of a staging tensor
+    layer_major = torch.randn([2, 4, 100, 64])[:, 1:3, 10:60]
+    token_major = torch.zeros([2, 50, 4, 64])[:, :, 1:3]
+    lmc_ops.convert_kv_layout(layer_major, token_major, True)
+    assert torch.equal(token_major, _token_major(layer_major))
+
+
+def test_convert_kv_layout_errors():
+    layer_major = torch.randn([2, 2, 8, 16])
+    with pytest.raises(RuntimeError, match="converted shape"):
+        lmc_ops.convert_kv_layout(layer_major, torch.empty([2, 2, 8, 16]), True)
+    with pytest.raises(RuntimeError, match="dtype"):
+        lmc_ops.convert_kv_layout(
+            layer_major, torch.empty([2, 8, 2, 16], dtype=torch.half), True
+        )
+    buffer = torch.empty(2 * 2 * 8 * 16 + 16)
+    with pytest.raises(RuntimeError, match="overlaps"):
+        lmc_ops.convert_kv_layout(
+            buffer[:-16].view(2, 2, 8, 16), buffer[16:].view(2, 8, 2, 16), True
+        )
@@ -0,0 +1,170 @@
+# SPDX-License-Identifier: Apache-2.0
+# Standard
+import random
+
+# Third Party
+from utils import generate_kv_cache_paged
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+QMAX = {torch.int8: 127.0, torch.float8_e4m3fn: 448.0}
+
+
+def _reference_quantize(src, qtype, num_groups):
+    groups = src.float().unflatten(-1, (num_groups, -1))
+    scales = groups.abs().amax(-1, keepdim=True) / QMAX[qtype]
+    quantized = (groups / scales.clamp_min(torch.finfo(torch.float32).tiny)).clamp(
+        -QMAX[qtype], QMAX[qtype]
+    )
+    if qtype == torch.int8:
+        quantized = quantized.round()
+    return quantized.to(qtype).flatten(-2), scales.squeeze(-1)
+
+
+@pytest.mark.parametrize("qtype", [torch.int8, torch.float8_e4m3fn])
+@pytest.mark.parametrize("dtype", [torch.float32, torch.float16, torch.bfloat16])
+@pytest.mark.parametrize("num_groups", [1, 8])
+def test_quantize_kv_cpu(qtype, dtype, num_groups):
+    num_heads, head_size = 8, 128
+    src = torch.randn([2, 4, 100, num_heads * head_size], dtype=dtype) * 3
+    # An all zero group must round trip without NaN
+    src[0, 0, 0] = 0
+    dst = torch.empty(src.shape, dtype=qtype)
+    scales = torch.empty([2, 4, 100, num_groups], dtype=torch.float32)
+    lmc_ops.quantize_kv(src, dst, scales)
+
+    expected, expected_scales = _reference_quantize(src, qtype, num_groups)
+    assert torch.allclose(scales, expected_scales)
+    # The kernel multiplies by 1 / scale, values on a rounding boundary may
+    # land one step away from the reference
+    assert (dst.float() - expected.float()).abs().max() <= (
+        1 if qtype == torch.int8 else 32
+    )
+
+    # Dequantized to float32 so that the error is the quantization error only
+    restored = torch.empty(src.shape, dtype=torch.float32)
+    lmc_ops.dequantize_kv(dst, scales, restored)
+    assert not restored.isnan().any()
+    assert (restored[0, 0, 0] == 0).all()
+    error = (restored - src.float()).abs()
+    bound = src.float().abs().amax() * (0.5 / 127 if qtype == torch.int8 else 1 / 16)
+    assert error.max() <= bound * 1.001
+
+    restored_native = torch.empty_like(src)
+    lmc_ops.dequantize_kv(dst, scales, restored_native)
+    assert (restored_native == restored.to(dtype)).all()
+
+
+@pytest.mark.parametrize("qtype", [torch.int8, torch.float8_e4m3fn])
+@pytest.mark.parametrize("token_major", [True, False])
+def test_single_layer_kernel_quantized_cpu(qtype, token_major):
+    num_tokens = 300
+    num_blocks = 100
+    block_size = 16
+    num_heads, head_size = 8, 128
+    hidden_dim_size = num_heads * head_size
+    dtype = torch.bfloat16
+    kv_cache = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    kv_cache_new = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    slot_mapping = torch.tensor(
+        random.sample(range(0, num_blocks * block_size), num_tokens)
+    )
+    slot_mapping[0] = -1
+    valid = slot_mapping >= 0
+    shape = [num_tokens, 2] if token_major else [2, num_tokens]
+    full = torch.empty(shape + [hidden_dim_size], dtype=dtype)
+    quantized = torch.empty(shape + [hidden_dim_size], dtype=qtype)
+    scales = torch.empty(shape + [num_heads], dtype=torch.float32)
+    expected = torch.empty_like(quantized)
+    expected_scales = torch.empty_like(scales)
+
+    for layer_id in range(len(kv_cache)):
+        key_cache, value_cache = kv_cache[layer_id]
+        lmc_ops.single_layer_kv_transfer_quantized(
+            quantized, scales, key_cache, value_cache, slot_mapping, True, token_major
+        )
+        # Same result as a full precision transfer followed by quantize_kv
+        lmc_ops.single_layer_kv_transfer(
+            full, key_cache, value_cache, slot_mapping, True, token_major
+        )
+        lmc_ops.quantize_kv(full, expected, expected_scales)
+        if token_major:
+            assert (quantized[valid] == expected[valid]).all()
+            assert (scales[valid] == expected_scales[valid]).all()
+        else:
+            assert (quantized[:, valid] == expected[:, valid]).all()
+            assert (scales[:, valid] == expected_scales[:, valid]).all()
+
+        lmc_ops.single_layer_kv_transfer_quantized(
+            quantized,
+            scales,
+            kv_cache_new[layer_id][0],
+            kv_cache_new[layer_id][1],
+            slot_mapping,
+            False,
+            token_major,
+        )
+        lmc_ops.dequantize_kv(expected, expected_scales, full)
+        for kv_id in range(2):
+            paged = kv_cache_new[layer_id][kv_id].reshape(-1, hidden_dim_size)
+            loaded = full[valid, kv_id] if token_major else full[kv_id, valid]
+            assert (paged[slot_mapping[valid]] == loaded).all()
+
+
+def test_transfer_plan_quantized_cpu():
+    num_tokens = 200
+    num_blocks = 100
+    block_size = 16
+    hidden_dim_size = 8 * 128
+    dtype = torch.float16
+    kv_cache = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    kv_cache_new = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    num_layers = len(kv_cache)
+    plan = lmc_ops.KVTransferPlan(
+        [kv[0] for kv in kv_cache], [kv[1] for kv in kv_cache]
+    )
+    plan_new = lmc_ops.KVTransferPlan(
+        [kv[0] for kv in kv_cache_new], [kv[1] for kv in kv_cache_new]
+    )
+    slot_mapping = torch.tensor(
+        random.sample(range(0, num_blocks * block_size), num_tokens)
+    )
+
+    shape = [2, num_layers, num_tokens]
+    key_value = torch.empty(shape + [hidden_dim_size], dtype=dtype)
+    quantized = torch.empty(shape + [hidden_dim_size], dtype=torch.int8)
+    scales = torch.empty(shape + [1], dtype=torch.float32)
+    plan.multi_layer_transfer(key_value, slot_mapping, True)
+    plan.multi_layer_transfer_quantized(quantized, scales, slot_mapping, True)
+    expected = torch.empty_like(quantized)
+    expected_scales = torch.empty_like(scales)
+    lmc_ops.quantize_kv(key_value, expected, expected_scales)
+    assert (quantized == expected).all()
+    assert (scales == expected_scales).all()
+
+    plan_new.multi_layer_transfer_quantized(quantized, scales, slot_mapping, False)
+    lmc_ops.dequantize_kv(quantized, scales, key_value)
+    restored = torch.empty_like(key_value)
+    plan_new.multi_layer_transfer(restored, slot_mapping, True)
+    assert (restored == key_value).all()
+
+    # Per layer path of the plan
+    layer = torch.empty([num_tokens, 2, hidden_dim_size], dtype=torch.int8)
+    layer_scales = torch.empty([num_tokens, 2, 1], dtype=torch.float32)
+    for layer_id in range(num_layers):
+        plan.single_layer_transfer_quantized(
+            layer, layer_scales, slot_mapping, layer_id, True, True
+        )
+        assert (layer.transpose(0, 1) == quantized[:, layer_id]).all()
+        assert (layer_scales.transpose(0, 1) == scales[:, layer_id]).all()
+
+    # The LMCache side must hold the 8-bit values, not full precision rows
+    with pytest.raises(RuntimeError, match="8-bit values"):
+        plan.multi_layer_transfer_quantized(key_value, scales, slot_mapping, True)
+    with pytest.raises(RuntimeError, match="8-bit values"):
+        plan.single_layer_transfer_quantized(
+            layer.half(), layer_scales, slot_mapping, 0, True, True
+        )
@@ -1,12 +1,14 @@
 # SPDX-License-Identifier: Apache-2.0
 # Standard
 from typing import List
+import json
 import random
 
 # Third Party
 from utils import (
     check_mem_obj_equal,
     check_paged_kv_cache_equal,
+    check_paged_kv_cache_equal_with_mla,
     generate_kv_cache_paged,
     generate_kv_cache_paged_list_tensors,
     generate_mla_kv_cache_paged_list_tensors,
@@ -474,3 +476,583 @@ def test_single_layer_kernel(num_tokens, token_major):
         kv_cache_new,
         slot_mapping,
     )
+
+
+@pytest.mark.parametrize("num_tokens", [256, 500, 1024])
+@pytest.mark.parametrize("device", ["cuda", "cpu"])
+def test_multi_layer_kernel_unilateral(num_tokens, device):
+    num_layers = 32
+    num_blocks = 1000
+    block_size = 16
+    num_heads = 8
+    head_size = 128
+    hidden_dim_size = num_heads * head_size
+    dtype = torch.bfloat16
+    kv_cache = generate_kv_cache_paged(num_blocks, device, block_size, dtype)
+    kv_cache_new = generate_kv_cache_paged(num_blocks, device, block_size, dtype)
+    page_buffer_size = num_blocks * block_size
+
+    slot_mapping = random.sample(range(0, num_blocks * block_size), num_tokens)
+    slot_mapping = torch.tensor(slot_mapping, device=device)
+
+    def _ptr_tables(cache):
+        key_ptrs = torch.tensor([kv[0].data_ptr() for kv in cache], dtype=torch.int64)
+        value_ptrs = torch.tensor([kv[1].data_ptr() for kv in cache], dtype=torch.int64)
+        # NOTE: Ascend kernels require the pointer tables to be on dev
+        return key_ptrs.to(device), value_ptrs.to(device)
+
+    mem_allocator = None
+    shape = [2, num_layers, num_tokens, hidden_dim_size]
+    if device == "cpu":
+        key_value = torch.empty(shape, dtype=dtype)
+    else:
+        mem_allocator = PinMemoryAllocator(1024 * 1024 * 1024)
+        key_value = mem_allocator.allocate(shape, dtype).tensor
+
+    key_ptrs, value_ptrs = _ptr_tables(kv_cache)
+    lmc_ops.multi_layer_kv_transfer_unilateral(
+        key_value,
+        key_ptrs,
+        value_ptrs,
+        slot_mapping,
+        kv_cache[0][0].device,
+        page_buffer_size,
+        True,
+    )
+    torch.cuda.synchronize()
+
+    for layer_id in range(num_layers):
+        for kv_id in range(2):
+            expected = kv_cache[layer_id][kv_id].reshape(-1, hidden_dim_size)
+            assert (
+                key_value[kv_id, layer_id] == expected[slot_mapping].cpu()
+            ).all()
+
+    key_ptrs_new, value_ptrs_new = _ptr_tables(kv_cache_new)
+    lmc_ops.multi_layer_kv_transfer_unilateral(
+        key_value,
+        key_ptrs_new,
+        value_ptrs_new,
+        slot_mapping,
+        kv_cache_new[0][0].device,
+        page_buffer_size,
+        False,
+    )
+    torch.cuda.synchronize()
+
+    check_paged_kv_cache_equal(kv_cache, kv_cache_new, slot_mapping)
+
+    if mem_allocator is not None:
+        mem_allocator.close()
+
+
+@pytest.mark.parametrize("num_tokens", [1, 255, 1024])
+@pytest.mark.parametrize("use_mla", [False, True])
+def test_multi_layer_kernel_cpu(num_tokens, use_mla):
+    device = "cpu"
+    num_blocks = 100
+    block_size = 16
+    hidden_dim_size = 128 if use_mla else 8 * 128
+    kv_size = 1 if use_mla else 2
+    dtype = torch.bfloat16
+    kv_cache = generate_kv_cache_paged_list_tensors(
+        num_blocks, device, block_size, dtype, use_mla
+    )
+    kv_cache_new = generate_kv_cache_paged_list_tensors(
+        num_blocks, device, block_size, dtype, use_mla
+    )
+    num_layers = len(kv_cache)
+    page_buffer_size = num_blocks * block_size
+
+    slot_mapping = random.sample(range(0, page_buffer_size), num_tokens)
+    slot_mapping = torch.tensor(slot_mapping)
+    key_value = torch.empty(
+        [kv_size, num_layers, num_tokens, hidden_dim_size], dtype=dtype
+    )
+
+    kv_cache_pointers = torch.tensor([t.data_ptr() for t in kv_cache])
+    lmc_ops.multi_layer_kv_transfer(
+        key_value,
+        kv_cache_pointers,
+        slot_mapping,
+        torch.device("cpu"),
+        page_buffer_size,
+        True,
+        use_mla,
+    )
+    for layer_id in range(num_layers):
+        paged = kv_cache[layer_id].reshape(kv_size, -1, hidden_dim_size)
+        assert (key_value[:, layer_id] == paged[:, slot_mapping]).all()
+
+    kv_cache_pointers_new = torch.tensor([t.data_ptr() for t in kv_cache_new])
+    lmc_ops.multi_layer_kv_transfer(
+        key_value,
+        kv_cache_pointers_new,
+        slot_mapping,
+        torch.device("cpu"),
+        page_buffer_size,
+        False,
+        use_mla,
+    )
+    for left, right in zip(kv_cache, kv_cache_new, strict=False):
+        left = left.reshape(kv_size, -1, hidden_dim_size)
+        right = right.reshape(kv_size, -1, hidden_dim_size)
+        assert (left[:, slot_mapping] == right[:, slot_mapping]).all()
+
+
+@pytest.mark.parametrize("num_tokens", [1, 500])
+@pytest.mark.parametrize("token_major", [True, False])
+def test_single_layer_kernel_cpu(num_tokens, token_major):
+    device = "cpu"
+    num_blocks = 100
+    block_size = 16
+    hidden_dim_size = 8 * 128
+    dtype = torch.float16
+    kv_cache = generate_kv_cache_paged(num_blocks, device, block_size, dtype)
+    kv_cache_new = generate_kv_cache_paged(num_blocks, device, block_size, dtype)
+    slot_mapping = random.sample(range(0, num_blocks * block_size), num_tokens)
+    slot_mapping = torch.tensor(slot_mapping, dtype=torch.int32)
+    # vLLM pads the slot mapping with -1, those tokens must be left untouched
+    slot_mapping[0] = -1
+
+    if token_major:
+        buffer = torch.zeros((num_tokens, 2, hidden_dim_size), dtype=dtype)
+        k_view, v_view = buffer[:, 0], buffer[:, 1]
+    else:
+        buffer = torch.zeros((2, num_tokens, hidden_dim_size), dtype=dtype)
+        k_view, v_view = buffer[0], buffer[1]
+
+    for layer_id in range(len(kv_cache)):
+        lmc_ops.single_layer_kv_transfer(
+            buffer,
+            kv_cache[layer_id][0],
+            kv_cache[layer_id][1],
+            slot_mapping,
+            True,
+            token_major,
+        )
+        valid = slot_mapping[1:].long()
+        key = kv_cache[layer_id][0].reshape(-1, hidden_dim_size)
+        value = kv_cache[layer_id][1].reshape(-1, hidden_dim_size)
+        assert (k_view[1:] == key[valid]).all()
+        assert (v_view[1:] == value[valid]).all()
+        assert (k_view[0] == 0).all()
+
+        lmc_ops.single_layer_kv_transfer(
+            buffer,
+            kv_cache_new[layer_id][0],
+            kv_cache_new[layer_id][1],
+            slot_mapping,
+            False,
+            token_major,
+        )
+
+    check_paged_kv_cache_equal(kv_cache, kv_cache_new, slot_mapping[1:].long())
+
+
+def test_host_transfer_rejects_bad_slots():
+    num_blocks, block_size, hidden_dim_size = 4, 16, 8 * 128
+    kv_cache = generate_kv_cache_paged_list_tensors(
+        num_blocks, "cpu", block_size, torch.float16
+    )[:2]
+    original = [paged.clone() for paged in kv_cache]
+    page_buffer_size = num_blocks * block_size
+    pointers = torch.tensor([t.data_ptr() for t in kv_cache])
+    key_value = torch.empty([2, len(kv_cache), 3, hidden_dim_size], dtype=torch.float16)
+    for slot in (page_buffer_size, 1 << 40):
+        slot_mapping = torch.tensor([0, slot, 1])
+        with pytest.raises(RuntimeError, match="slot_mapping holds slot"):
+            lmc_ops.multi_layer_kv_transfer(
+                key_value,
+                pointers,
+                slot_mapping,
+                torch.device("cpu"),
+                page_buffer_size,
+                False,
+                False,
+            )
+    # Slots are checked before anything is written
+    for paged, before in zip(kv_cache, original, strict=True):
+        assert torch.equal(paged, before)
+
+    key_cache = torch.zeros([num_blocks, block_size, 2, 128], dtype=torch.float16)
+    value_cache = torch.zeros_like(key_cache)
+    slot_mapping = torch.tensor([0, 5, 9])
+    with pytest.raises(RuntimeError, match="size of the LMCache rows"):
+        lmc_ops.single_layer_kv_transfer(
+            torch.zeros([3, 2, 512], dtype=torch.float16),
+            key_cache,
+            value_cache,
+            slot_mapping,
+            True,
+            True,
+        )
+    with pytest.raises(RuntimeError, match="slot_mapping holds slot"):
+        lmc_ops.single_layer_kv_transfer(
+            torch.zeros([3, 2, 256], dtype=torch.float16),
+            key_cache,
+            value_cache,
+            torch.tensor([0, page_buffer_size, 9], dtype=torch.int32),
+            True,
+            True,
+        )
+
+
+def test_extract_and_load_back_cpu():
+    device = "cpu"
+    num_tokens = 700
+    num_blocks = 100
+    block_size = 16
+    hidden_dim_size = 8 * 128
+    num_layers = 32
+    dtype = torch.bfloat16
+    kv_cache = generate_kv_cache_paged(num_blocks, device, block_size, dtype)
+    kv_cache_new = generate_kv_cache_paged(num_blocks, device, block_size, dtype)
+    slot_mapping = random.sample(range(0, num_blocks * block_size), num_tokens)
+    slot_mapping = torch.tensor(slot_mapping)
+
+    key_value = torch.empty([2, num_layers, num_tokens, hidden_dim_size], dtype=dtype)
+    for layer_id in range(num_layers):
+        lmc_ops.load_and_reshape_flash(
+            key_value,
+            kv_cache[layer_id][0],
+            kv_cache[layer_id][1],
+            slot_mapping,
+            layer_id,
+        )
+        key = kv_cache[layer_id][0].reshape(-1, hidden_dim_size)
+        assert (key_value[0, layer_id] == key[slot_mapping]).all()
+
+    for layer_id in range(num_layers):
+        lmc_ops.reshape_and_cache_back_flash(
+            key_value,
+            kv_cache_new[layer_id][0],
+            kv_cache_new[layer_id][1],
+            slot_mapping,
+            layer_id,
+        )
+    check_paged_kv_cache_equal(kv_cache, kv_cache_new, slot_mapping)
+
+
+def test_transfer_trace_cpu(tmp_path):
+    num_tokens = 100
+    num_blocks = 10
+    block_size = 16
+    hidden_dim_size = 8 * 128
+    num_layers = 4
+    dtype = torch.bfloat16
+    kv_cache = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    slot_mapping = torch.tensor(
+        random.sample(range(0, num_blocks * block_size), num_tokens)
+    )
+    key_value = torch.empty([2, num_layers, num_tokens, hidden_dim_size], dtype=dtype)
+
+    def transfer_layers():
+        for layer_id in range(num_layers):
+            lmc_ops.load_and_reshape_flash(
+                key_value,
+                kv_cache[layer_id][0],
+                kv_cache[layer_id][1],
+                slot_mapping,
+                layer_id,
+            )
+
+    trace_path = tmp_path / "trace.json"
+    lmc_ops.start_transfer_trace(capacity=1024)
+    transfer_layers()
+    lmc_ops.stop_transfer_trace()
+    # Nothing is recorded while tracing is off
+    transfer_layers()
+    assert lmc_ops.dump_transfer_trace(str(trace_path)) == num_layers
+
+    events = json.loads(trace_path.read_text())["traceEvents"]
+    assert [event["args"]["layer"] for event in events] == list(range(num_layers))
+    for event in events:
+        assert event["name"] == "load_and_reshape_flash"
+        assert event["ph"] == "X" and event["cat"] == "cpu"
+        assert event["dur"] >= 0
+        assert event["args"]["tokens"] == num_tokens
+        assert event["args"]["direction"] == "offload"
+        assert event["args"]["bytes"] == (
+            2 * num_tokens * hidden_dim_size * key_value.element_size()
+        )
+
+    # A restart reuses the ring: earlier spans are dropped and a smaller
+    # capacity still bounds the spans kept
+    lmc_ops.start_transfer_trace(capacity=2)
+    assert lmc_ops.dump_transfer_trace(str(trace_path)) == 0
+    transfer_layers()
+    lmc_ops.stop_transfer_trace()
+    assert lmc_ops.dump_transfer_trace(str(trace_path)) == 2
+    events = json.loads(trace_path.read_text())["traceEvents"]
+    assert [event["args"]["layer"] for event in events] == [2, 3]
+
+
+@pytest.mark.parametrize("num_tokens", [1, 300])
+def test_transfer_plan_cpu(num_tokens):
+    num_blocks = 100
+    block_size = 16
+    hidden_dim_size = 8 * 128
+    dtype = torch.bfloat16
+    kv_cache = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    kv_cache_new = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    num_layers = len(kv_cache)
+    plan = lmc_ops.KVTransferPlan(
+        [kv[0] for kv in kv_cache], [kv[1] for kv in kv_cache]
+    )
+    plan_new = lmc_ops.KVTransferPlan(
+        [kv[0] for kv in kv_cache_new], [kv[1] for kv in kv_cache_new]
+    )
+    assert plan.num_layers() == num_layers
+    assert plan.page_buffer_size() == num_blocks * block_size
+    slot_mapping = torch.tensor(
+        random.sample(range(0, num_blocks * block_size), num_tokens)
+    )
+
+    # K and V are separate allocations: the multi layer path splits the tables
+    key_value = torch.empty([2, num_layers, num_tokens, hidden_dim_size], dtype=dtype)
+    plan.multi_layer_transfer(key_value, slot_mapping, True)
+    for layer_id in range(num_layers):
+        for kv_id in range(2):
+            paged = kv_cache[layer_id][kv_id].reshape(-1, hidden_dim_size)
+            assert (key_value[kv_id, layer_id] == paged[slot_mapping]).all()
+
+    # Same bytes as the free functions, layer by layer
+    buffer = torch.empty([num_tokens, 2, hidden_dim_size], dtype=dtype)
+    expected = torch.empty_like(buffer)
+    flash = torch.empty_like(key_value)
+    for layer_id in range(num_layers):
+        plan.single_layer_transfer(buffer, slot_mapping, layer_id, True, True)
+        lmc_ops.single_layer_kv_transfer(
+            expected,
+            kv_cache[layer_id][0],
+            kv_cache[layer_id][1],
+            slot_mapping,
+            True,
+            True,
+        )
+        assert (buffer == expected).all()
+        plan.flash_layer_transfer(flash, slot_mapping, layer_id, True)
+        plan_new.flash_layer_transfer(flash, slot_mapping, layer_id, False)
+    assert (flash == key_value).all()
+    check_paged_kv_cache_equal(kv_cache, kv_cache_new, slot_mapping)
+
+
+@pytest.mark.parametrize("chunk_size", [16, 256])
+@pytest.mark.parametrize("adjacent", [True, False])
+def test_single_layer_kernel_segmented_cpu(chunk_size, adjacent):
+    num_tokens = 1000
+    num_blocks = 100
+    block_size = 16
+    hidden_dim_size = 8 * 128
+    dtype = torch.bfloat16
+    kv_cache = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    kv_cache_new = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    slot_mapping = torch.tensor(
+        random.sample(range(0, num_blocks * block_size), num_tokens)
+    )
+    slot_mapping[0] = -1
+    starts = list(range(0, num_tokens, chunk_size))
+    ends = [min(start + chunk_size, num_tokens) for start in starts]
+    if adjacent:
+        # Views of one buffer, like the chunks of the staging buffer
+        buffer = torch.zeros([num_tokens, 2, hidden_dim_size], dtype=dtype)
+        chunks = [buffer[start:end] for start, end in zip(starts, ends, strict=False)]
+    else:
+        chunks = [
+            torch.zeros([end - start, 2, hidden_dim_size], dtype=dtype)
+            for start, end in zip(starts, ends, strict=False)
+        ]
+    plan_new = lmc_ops.KVTransferPlan(
+        [kv[0] for kv in kv_cache_new], [kv[1] for kv in kv_cache_new]
+    )
+
+    for layer_id in range(len(kv_cache)):
+        lmc_ops.single_layer_kv_transfer_segmented(
+            chunks,
+            kv_cache[layer_id][0],
+            kv_cache[layer_id][1],
+            slot_mapping,
+            starts,
+            ends,
+            True,
+        )
+        expected = torch.zeros([num_tokens, 2, hidden_dim_size], dtype=dtype)
+        lmc_ops.single_layer_kv_transfer(
+            expected,
+            kv_cache[layer_id][0],
+            kv_cache[layer_id][1],
+            slot_mapping,
+            True,
+            True,
+        )
+        assert (torch.cat(chunks) == expected).all()
+
+        plan_new.single_layer_transfer_segmented(
+            chunks, slot_mapping, starts, ends, layer_id, False, True
+        )
+
+    check_paged_kv_cache_equal(kv_cache, kv_cache_new, slot_mapping[1:])
+
+
+@pytest.mark.parametrize("num_tokens", [1, 300])
+@pytest.mark.parametrize("token_major", [True, False])
+def test_layerwise_kernels_use_mla_cpu(num_tokens, token_major):
+    num_blocks = 20
+    block_size = 64
+    hidden_dim_size = 576
+    num_layers = 4
+    dtype = torch.bfloat16
+    kv_cache = generate_mla_kv_cache_paged_list_tensors(
+        num_blocks, "cpu", block_size, dtype, num_layers
+    )
+    kv_cache_new = generate_mla_kv_cache_paged_list_tensors(
+        num_blocks, "cpu", block_size, dtype, num_layers
+    )
+    plan = lmc_ops.KVTransferPlan(kv_cache)
+    plan_new = lmc_ops.KVTransferPlan(kv_cache_new)
+    assert plan.use_mla()
+    slot_mapping = torch.tensor(
+        random.sample(range(0, num_blocks * block_size), num_tokens)
+    )
+    if token_major:
+        shape = [num_tokens, 1, hidden_dim_size]
+    else:
+        shape = [1, num_tokens, hidden_dim_size]
+    # The value cache argument is ignored for MLA
+    unused = torch.empty(0, dtype=dtype)
+
+    buffer = torch.empty(shape, dtype=dtype)
+    flash = torch.empty([1, num_layers, num_tokens, hidden_dim_size], dtype=dtype)
+    for layer_id in range(num_layers):
+        latent = kv_cache[layer_id].reshape(-1, hidden_dim_size)[slot_mapping]
+        lmc_ops.single_layer_kv_transfer(
+            buffer, kv_cache[layer_id], unused, slot_mapping, True, token_major, True
+        )
+        assert (buffer.reshape(num_tokens, hidden_dim_size) == latent).all()
+        expected = buffer.clone()
+        plan.single_layer_transfer(buffer, slot_mapping, layer_id, True, token_major)
+        assert (buffer == expected).all()
+
+        lmc_ops.load_and_reshape_flash(
+            flash, kv_cache[layer_id], unused, slot_mapping, layer_id, use_mla=True
+        )
+        assert (flash[0, layer_id] == latent).all()
+
+        plan_new.single_layer_transfer(
+            buffer, slot_mapping, layer_id, False, token_major
+        )
+        if token_major:
+            chunks = list(buffer.split(128))
+            starts = list(range(0, num_tokens, 128))
+            ends = [start + len(c) for start, c in zip(starts, chunks, strict=False)]
+            segmented = [torch.zeros_like(chunk) for chunk in chunks]
+            lmc_ops.single_layer_kv_transfer_segmented(
+                segmented,
+                kv_cache[layer_id],
+                unused,
+                slot_mapping,
+                starts,
+                ends,
+                True,
+                use_mla=True,
+            )
+            assert (torch.cat(segmented) == buffer).all()
+    check_paged_kv_cache_equal_with_mla(
+        kv_cache, kv_cache_new, slot_mapping, hidden_dim_size
+    )
+
+    # Loading the flash buffer back restores the same rows
+    kv_cache_flash = generate_mla_kv_cache_paged_list_tensors(
+        num_blocks, "cpu", block_size, dtype, num_layers
+    )
+    for layer_id in range(num_layers):
+        lmc_ops.reshape_and_cache_back_flash(
+            flash,
+            kv_cache_flash[layer_id],
+            unused,
+            slot_mapping,
+            layer_id,
+            use_mla=True,
+        )
+    check_paged_kv_cache_equal_with_mla(
+        kv_cache, kv_cache_flash, slot_mapping, hidden_dim_size
+    )
+
+    with pytest.raises(RuntimeError, match="kv dimension"):
+        lmc_ops.single_layer_kv_transfer(
+            torch.empty([num_tokens, 2, hidden_dim_size], dtype=dtype),
+            kv_cache[0],
+            unused,
+            slot_mapping,
+            True,
+            True,
+            True,
+        )
+
+
+def test_slot_mapping_extents():
+    slot_mapping = torch.tensor([32, 33, 34, -1, 35, 36, 8, 9, 10, 11, 12, 40])
+    extents = lmc_ops.slot_mapping_extents(slot_mapping)
+    assert extents.tolist() == [[0, 32, 3], [4, 35, 2], [6, 8, 5], [11, 40, 1]]
+    extents = lmc_ops.slot_mapping_extents(slot_mapping.int(), max_length=2)
+    assert extents.tolist() == [
+        [0, 32, 2],
+        [2, 34, 1],
+        [4, 35, 2],
+        [6, 8, 2],
+        [8, 10, 2],
+        [10, 12, 1],
+        [11, 40, 1],
+    ]
+    assert lmc_ops.slot_mapping_extents(torch.tensor([-1, -1])).shape == (0, 3)
+
+
+@pytest.mark.parametrize("num_tokens", [16, 1000])
+@pytest.mark.parametrize("token_major", [True, False])
+def test_transfer_block_slots_cpu(num_tokens, token_major):
+    """
+    Slots in whole blocks, as vLLM allocates them, take the extent path of
+    the host backend. Results must match a per token copy.
+    """
+    num_blocks = 100
+    block_size = 16
+    hidden_dim_size = 8 * 128
+    dtype = torch.bfloat16
+    kv_cache = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    kv_cache_new = generate_kv_cache_paged(num_blocks, "cpu", block_size, dtype)
+    num_used = (num_tokens + block_size - 1) // block_size
+    blocks = torch.tensor(random.sample(range(num_blocks), num_used))
+    slot_mapping = (
+        blocks[:, None] * block_size + torch.arange(block_size)
+    ).flatten()[:num_tokens]
+    # Padding in the middle of a run
+    slot_mapping[num_tokens // 2] = -1
+    valid = slot_mapping >= 0
+    if token_major:
+        buffer = torch.zeros([num_tokens, 2, hidden_dim_size], dtype=dtype)
+    else:
+        buffer = torch.zeros([2, num_tokens, hidden_dim_size], dtype=dtype)
+
+    for layer_id in range(len(kv_cache)):
+        key_cache = kv_cache[layer_id][0]
+        value_cache = kv_cache[layer_id][1]
+        lmc_ops.single_layer_kv_transfer(
+            buffer, key_cache, value_cache, slot_mapping, True, token_major
+        )
+        key_value = buffer if token_major else buffer.transpose(0, 1)
+        keys = key_cache.reshape(-1, hidden_dim_size)[slot_mapping[valid]]
+        values = value_cache.reshape(-1, hidden_dim_size)[slot_mapping[valid]]
+        assert (key_value[valid, 0] == keys).all()
+        assert (key_value[valid, 1] == values).all()
+
+        lmc_ops.single_layer_kv_transfer(
+            buffer,
+            kv_cache_new[layer_id][0],
+            kv_cache_new[layer_id][1],
+            slot_mapping,
+            False,
+            token_major,
+        )
+
+    check_paged_kv_cache_equal(kv_cache, kv_cache_new, slot_mapping[valid])
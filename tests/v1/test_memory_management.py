@@ -14,9 +14,11 @@ from lmcache.v1.memory_management import (
     TensorMemoryAllocator,
 )
 
+import lmcache_ascend.c_ops as lmc_ops
 from lmcache_ascend.v1.memory_management import (
     AscendPinMemoryAllocator as PinMemoryAllocator,
     AscendMixedMemoryAllocator as MixedMemoryAllocator,
+    NativeTensorMemoryAllocator,
 )
 
 
@@ -274,3 +276,196 @@ def test_mixed_alloc(alloc_cls):
     assert len(data1.byte_array) == 512
 
     allocator.close()
+
+
+@pytest.mark.parametrize("populate_threads", [1, 4])
+def test_mixed_alloc_populated(populate_threads):
+    total_size = 1 << 28
+    allocator = MixedMemoryAllocator(total_size, populate_threads=populate_threads)
+    assert allocator.buffer.numel() == total_size
+    assert allocator.buffer.dtype == torch.uint8
+    assert (allocator.buffer[:: 1 << 20] == 0).all()
+
+    check_allocator(allocator, total_size)
+    allocator.close()
+
+
+def test_mixed_alloc_numa_local():
+    total_size = 1 << 26
+    allocator = MixedMemoryAllocator(total_size, populate_threads=2)
+    # -1 when the machine does not report a node for the device
+    assert lmc_ops.get_host_numa_node(allocator.buffer) == lmc_ops.device_numa_node()
+    check_allocator(allocator, total_size)
+    allocator.close()
+
+    allocator = MixedMemoryAllocator(total_size, populate_threads=2, numa_node=-1)
+    assert lmc_ops.get_host_numa_node(allocator.buffer) == -1
+    allocator.close()
+
+
+def test_mixed_alloc_numa_strict():
+    total_size = 1 << 26
+    allocator = MixedMemoryAllocator(
+        total_size,
+        populate_threads=2,
+        numa_node=lmc_ops.NUMA_NODE_LOCAL,
+        strict_numa=True,
+    )
+    assert lmc_ops.get_host_numa_node(allocator.buffer) == lmc_ops.device_numa_node()
+    check_allocator(allocator, total_size)
+    allocator.close()
+
+
+@pytest.mark.parametrize("huge_page_size", [2 << 20, 1 << 30])
+def test_mixed_alloc_hugetlb(huge_page_size):
+    total_size = 1 << 30
+    allocator = MixedMemoryAllocator(
+        total_size, populate_threads=4, huge_page_size=huge_page_size
+    )
+    # Falls back on transparent huge pages when the hugetlb pool is too small
+    assert allocator.huge_page_size in (0, huge_page_size)
+    assert allocator.huge_page_size == lmc_ops.get_host_huge_page_size(
+        allocator.buffer
+    )
+    check_allocator(allocator, total_size)
+    allocator.close()
+
+
+def test_mixed_alloc_hugetlb_node_short():
+    # The hugetlb pool is global: a strict binding to a node that lacks free
+    # pages must fall back on transparent huge pages, not SIGBUS in populate
+    node = lmc_ops.device_numa_node()
+    path = (
+        f"/sys/devices/system/node/node{node}/hugepages/"
+        "hugepages-2048kB/free_hugepages"
+    )
+    try:
+        with open(path) as f:
+            free_pages = int(f.read())
+    except (OSError, ValueError):
+        pytest.skip("free 2 MiB hugetlb pages of the device node are unknown")
+    if free_pages > 512:
+        pytest.skip("too many free hugetlb pages to exhaust them")
+
+    total_size = (free_pages + 1) * (2 << 20)
+    allocator = MixedMemoryAllocator(
+        total_size,
+        populate_threads=2,
+        numa_node=node,
+        huge_page_size=2 << 20,
+        strict_numa=True,
+    )
+    assert allocator.huge_page_size == 0
+    assert lmc_ops.get_host_huge_page_size(allocator.buffer) == 0
+    check_allocator(allocator, total_size)
+    allocator.close()
+
+
+def test_memory_stats():
+    total_size = 1 << 26
+    before = lmc_ops.memory_stats()
+    allocator = MixedMemoryAllocator(total_size, populate_threads=2)
+    after = lmc_ops.memory_stats()
+
+    # Keyed by the physical id, not torch's index under ASCEND_RT_VISIBLE_DEVICES
+    device = lmc_ops.physical_device()
+
+    def registered(stats, key="registered_bytes"):
+        return stats["devices"].get(device, {}).get(key, 0)
+
+    assert registered(after) - registered(before) == total_size
+    assert (registered(after, "acl_bytes") - registered(before, "acl_bytes")) + (
+        registered(after, "hal_bytes") - registered(before, "hal_bytes")
+    ) == total_size
+    assert after["registered_regions"] == before["registered_regions"] + 1
+    registrations = after["acl_registrations"] + after["hal_registrations"]
+    assert registrations == before["acl_registrations"] + before[
+        "hal_registrations"
+    ] + 1
+    latency = after["populate_us"]
+    assert latency["count"] == before["populate_us"]["count"] + 1
+    assert sum(latency["buckets"]) == latency["count"]
+
+    check_allocator(allocator, total_size)
+    assert lmc_ops.memory_stats()["lookups"] >= after["lookups"]
+    allocator.close()
+
+
+def test_native_tensor_allocator():
+    total_size = 1024 * 1024 * 128  # 128MB
+    tensor_buffer = torch.zeros(total_size, dtype=torch.uint8, device="cpu")
+    allocator = NativeTensorMemoryAllocator(tensor_buffer, chunk_sizes=[1 << 20])
+    check_allocator(allocator, total_size)
+
+    # Full chunks are not rounded, freed blocks are reused
+    chunk = allocator.allocate([512, 512], torch.float)
+    assert chunk.metadata.phy_size == 1 << 20
+    address = chunk.metadata.address
+    allocator.free(chunk)
+    chunk = allocator.allocate([512, 512], torch.float)
+    assert chunk.metadata.address == address
+    allocator.close()
+
+
+def test_native_tensor_allocator_threads():
+    # Standard
+    from concurrent.futures import ThreadPoolExecutor
+
+    total_size = 1 << 26
+    tensor_buffer = torch.zeros(total_size, dtype=torch.uint8, device="cpu")
+    allocator = NativeTensorMemoryAllocator(tensor_buffer, chunk_sizes=[64 * 1024])
+
+    def worker(seed):
+        objs = []
+        for i in range(500):
+            obj = allocator.allocate([16 * 1024 + (seed * 7 + i) % 3], torch.float)
+            obj.tensor.fill_(seed)
+            objs.append(obj)
+            if len(objs) > 8:
+                old = objs.pop(0)
+                assert (old.tensor == seed).all()
+                allocator.free(old)
+        allocator.batched_free(objs)
+
+    with ThreadPoolExecutor(8) as pool:
+        list(pool.map(worker, range(8)))
+    assert allocator.allocator.used_bytes() == 0
+
+
+def test_native_tensor_allocator_reuse_across_classes():
+    # Blocks start 256-byte aligned: slice an aligned 1 MiB out of a larger
+    # buffer so that all of it is usable
+    buffer = torch.zeros((1 << 20) + 256, dtype=torch.uint8)
+    skip = -buffer.data_ptr() % 256
+    buffer = buffer[skip : skip + (1 << 20)]
+    allocator = lmc_ops.HostAllocator(buffer, [64 * 1024, 96 * 1024])
+
+    # Class A fills the buffer and frees everything
+    blocks = []
+    while (block := allocator.allocate(64 * 1024)) is not None:
+        blocks.append(block)
+    assert len(blocks) == 16
+    allocator.batched_free(blocks)
+
+    # Class B gets the whole buffer back
+    blocks = allocator.batched_allocate(96 * 1024, 10)
+    assert blocks is not None
+    assert allocator.allocate(96 * 1024) is None
+
+    # Holes left by B between live blocks serve A
+    allocator.batched_free(blocks[::2])
+    small = [allocator.allocate(64 * 1024) for _ in range(6)]
+    assert all(block is not None for block in small)
+    allocator.batched_free(blocks[1::2] + small)
+    assert allocator.used_bytes() == 0
+    assert allocator.allocate(1 << 20) is not None
+
+
+def test_mixed_alloc_native():
+    total_size = 1 << 25
+    allocator = MixedMemoryAllocator(total_size, native_allocator=True)
+    data = allocator.allocate([512, 10], torch.float)
+    assert allocator.pin_allocator.allocator.device_ptr(data.raw_data) != 0
+    allocator.free(data)
+    check_allocator(allocator, total_size)
+    allocator.close()
@@ -0,0 +1,63 @@
+# SPDX-License-Identifier: Apache-2.0
+# Third Party
+import pytest
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+
+def _cos_sin_cache(max_position, rot_dim, base=10000.0, dtype=torch.float32):
+    inv_freq = 1.0 / (base ** (torch.arange(0, rot_dim, 2, dtype=torch.float) / rot_dim))
+    t = torch.arange(max_position, dtype=torch.float)
+    freqs = torch.einsum("i,j -> ij", t, inv_freq)
+    return torch.cat((freqs.cos(), freqs.sin()), dim=-1).to(dtype)
+
+
+def _apply_rope(positions, key, cos_sin_cache, is_neox):
+    # key: [num_tokens, num_heads, head_size], rotates in float32
+    rot_dim = cos_sin_cache.shape[-1]
+    cos, sin = cos_sin_cache[positions].float().chunk(2, dim=-1)
+    cos, sin = cos.unsqueeze(1), sin.unsqueeze(1)
+    k = key.float()
+    rot, rest = k[..., :rot_dim], k[..., rot_dim:]
+    if is_neox:
+        x1, x2 = rot.chunk(2, dim=-1)
+        rot = torch.cat((x1 * cos - x2 * sin, x2 * cos + x1 * sin), dim=-1)
+    else:
+        x1, x2 = rot[..., ::2], rot[..., 1::2]
+        rot = torch.stack((x1 * cos - x2 * sin, x2 * cos + x1 * sin), dim=-1)
+        rot = rot.flatten(-2)
+    return torch.cat((rot, rest), dim=-1).to(key.dtype)
+
+
+@pytest.mark.parametrize("is_neox", [True, False])
+@pytest.mark.parametrize("dtype", [torch.float32, torch.bfloat16, torch.float16])
+@pytest.mark.parametrize("rot_dim", [128, 64])
+def test_rotary_embedding_k_fused_cpu(is_neox, dtype, rot_dim):
+    num_tokens, num_heads, head_size, max_position = 300, 8, 128, 4096
+    cos_sin_cache = _cos_sin_cache(max_position, rot_dim, dtype=dtype)
+
+    key = torch.randn(num_tokens, num_heads, head_size, dtype=dtype)
+    old_positions = torch.arange(num_tokens)
+    new_positions = torch.randint(0, max_position, (num_tokens,))
+    new_positions[:10] = old_positions[:10]
+
+    k_old = _apply_rope(old_positions, key, cos_sin_cache, is_neox)
+    expected = _apply_rope(new_positions, key, cos_sin_cache, is_neox)
+
+    lmc_ops.rotary_embedding_k_fused(
+        old_positions, new_positions, k_old, head_size, cos_sin_cache, is_neox
+    )
+
+    atol = 1e-4 if dtype == torch.float32 else 0.1
+    torch.testing.assert_close(k_old, expected, atol=atol, rtol=0.02)
+
+
+def test_rotary_embedding_k_fused_out_of_range():
+    cos_sin_cache = _cos_sin_cache(16, 128)
+    key = torch.randn(4, 2, 128)
+    with pytest.raises(RuntimeError):
+        lmc_ops.rotary_embedding_k_fused(
+            torch.arange(4), torch.arange(14, 18), key, 128, cos_sin_cache, True
+        )
@@ -0,0 +1,103 @@
+# SPDX-License-Identifier: Apache-2.0
+# Standard
+import random
+import threading
+
+# Third Party
+import torch
+
+# First Party
+import lmcache.c_ops as lmc_ops
+
+
+def _keys(values):
+    return torch.tensor(values, dtype=torch.int64)
+
+
+def test_prefix_index_lookup():
+    index = lmc_ops.PrefixIndex()
+    assert index.insert(_keys([1, 2, 3, 4]), _keys([10, 20, 30, 40])) == 4
+    # Shares [1, 2], branches at the third chunk
+    assert index.insert(_keys([1, 2, 5]), _keys([11, 21, 50])) == 1
+    assert index.size() == 5
+    assert index.num_nodes() == 3
+
+    # Locations of shared chunks were updated by the second insert
+    assert index.lookup(_keys([1, 2, 3, 9])).tolist() == [11, 21, 30]
+    assert index.lookup(_keys([1, 2, 5, 6])).tolist() == [11, 21, 50]
+    assert index.lookup(_keys([7])).tolist() == []
+    assert index.longest_prefix(_keys([1, 2, 3, 4, 5])) == 4
+    assert index.longest_prefix(torch.tensor([1, 2, 5], dtype=torch.int32)) == 3
+    assert index.longest_prefixes([_keys([1]), _keys([2]), _keys([])]) == [1, 0, 0]
+
+    # Extending a leaf grows its edge
+    assert index.insert(_keys([1, 2, 5, 6, 7]), _keys([11, 21, 50, 60, 70])) == 2
+    assert index.num_nodes() == 3
+    assert index.insert(_keys([1, 2, 5]), _keys([11, 21, 50])) == 0
+
+
+def test_prefix_index_remove():
+    index = lmc_ops.PrefixIndex()
+    index.insert(_keys([1, 2, 3, 4]), _keys([10, 20, 30, 40]))
+    index.insert(_keys([1, 2, 5, 6]), _keys([10, 20, 50, 60]))
+
+    # Removing a chunk removes every chunk after it
+    assert sorted(index.remove(_keys([1, 2, 3])).tolist()) == [30, 40]
+    assert index.longest_prefix(_keys([1, 2, 3, 4])) == 2
+    # The remaining branch is merged back into one edge
+    assert index.num_nodes() == 1
+    assert index.lookup(_keys([1, 2, 5, 6])).tolist() == [10, 20, 50, 60]
+
+    assert index.remove(_keys([9])).tolist() == []
+    assert sorted(index.remove(_keys([1])).tolist()) == [10, 20, 50, 60]
+    assert index.size() == 0
+    assert index.num_nodes() == 0
+
+
+def test_prefix_index_matches_dict_probing():
+    rng = random.Random(0)
+    index = lmc_ops.PrefixIndex()
+    cached = {}
+    prefixes = [[rng.randrange(1 << 62) for _ in range(20)] for _ in range(10)]
+    for session in range(200):
+        keys = prefixes[session % 10][: rng.randrange(1, 20)]
+        keys = keys + [rng.randrange(1 << 62) for _ in range(rng.randrange(10))]
+        locations = [session * 100 + i for i in range(len(keys))]
+        index.insert(_keys(keys), _keys(locations))
+        for i in range(len(keys)):
+            cached[tuple(keys[: i + 1])] = locations[i]
+    assert index.size() == len(cached)
+
+    for session in range(100):
+        query = prefixes[session % 10][: rng.randrange(20)] + [1, 2]
+        expected = []
+        for i in range(len(query)):
+            if tuple(query[: i + 1]) not in cached:
+                break
+            expected.append(cached[tuple(query[: i + 1])])
+        assert index.lookup(_keys(query)).tolist() == expected
+
+
+def test_prefix_index_concurrent_readers():
+    index = lmc_ops.PrefixIndex()
+    base = list(range(64))
+    index.insert(_keys(base), _keys(base))
+    errors = []
+
+    def reader():
+        for _ in range(200):
+            if index.longest_prefix(_keys(base)) < 64:
+                errors.append("lost chunks")
+
+    threads = [threading.Thread(target=reader) for _ in range(4)]
+    for thread in threads:
+        thread.start()
+    # A writer adding and removing branches while the readers run
+    for i in range(200):
+        branch = base[:32] + [1000 + i, 2000 + i]
+        index.insert(_keys(branch), _keys(branch))
+        index.remove(_keys(branch[:33]))
+    for thread in threads:
+        thread.join()
+    assert not errors
+    assert index.size() == 64